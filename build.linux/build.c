@@ -0,0 +1,126 @@
+// Automatically generated by configure - DO NOT EDIT!
+
+#include "build.h"
+
+const char* build_config_str =
+  "Configure arguments:\n"
+  "  --disable-libav --disable-ffmpeg_static --disable-hdhomerun_static --disable-pcloud_cache --disable-dvbscan --disable-avahi --disable-dbus_1 --disable-tvhcsa --python=python3" "\n"
+  "" "\n"
+  "Compiler:" "\n"
+  "  Using C compiler:                        cc" "\n"
+  "  Build for arch:                          x86_64" "\n"
+  "" "\n"
+  "Binaries:" "\n"
+  "  Using PYTHON:                            python3" "\n"
+  "  Using GZIP:                              gzip" "\n"
+  "  Using BZIP2:                             bzip2" "\n"
+  "" "\n"
+  "Options:" "\n"
+  "  pie                                      yes" "\n"
+  "  ccdebug                                  no" "\n"
+  "  cardclient                               yes" "\n"
+  "  cwc                                      yes" "\n"
+  "  cccam                                    yes" "\n"
+  "  capmt                                    yes" "\n"
+  "  constcw                                  yes" "\n"
+  "  linuxdvb                                 yes" "\n"
+  "  satip_server                             yes" "\n"
+  "  satip_client                             yes" "\n"
+  "  hdhomerun_client                         no" "\n"
+  "  hdhomerun_static                         no" "\n"
+  "  iptv                                     yes" "\n"
+  "  tsfile                                   yes" "\n"
+  "  dvbscan                                  no" "\n"
+  "  timeshift                                yes" "\n"
+  "  trace                                    yes" "\n"
+  "  mempool                                  yes" "\n"
+  "  avahi                                    no" "\n"
+  "  zlib                                     yes" "\n"
+  "  libav                                    no" "\n"
+  "  ffmpeg_static                            no" "\n"
+  "  libx264                                  yes" "\n"
+  "  libx264_static                           yes" "\n"
+  "  libx265                                  yes" "\n"
+  "  libx265_static                           yes" "\n"
+  "  libvpx                                   yes" "\n"
+  "  libvpx_static                            yes" "\n"
+  "  libtheora                                yes" "\n"
+  "  libtheora_static                         yes" "\n"
+  "  libvorbis                                yes" "\n"
+  "  libvorbis_static                         yes" "\n"
+  "  libfdkaac                                no" "\n"
+  "  libfdkaac_static                         yes" "\n"
+  "  libopus                                  yes" "\n"
+  "  libopus_static                           yes" "\n"
+  "  nvenc                                    no" "\n"
+  "  vaapi                                    no" "\n"
+  "  mmal                                     no" "\n"
+  "  omx                                      no" "\n"
+  "  inotify                                  yes" "\n"
+  "  epoll                                    yes" "\n"
+  "  pcre                                     no" "\n"
+  "  pcre2                                    no" "\n"
+  "  uriparser                                no" "\n"
+  "  ccache                                   no" "\n"
+  "  tvhcsa                                   no" "\n"
+  "  bundle                                   no" "\n"
+  "  pngquant                                 no" "\n"
+  "  kqueue                                   no" "\n"
+  "  dbus_1                                   no" "\n"
+  "  android                                  no" "\n"
+  "  gtimer_check                             no" "\n"
+  "  slow_memoryinfo                          no" "\n"
+  "  libsystemd_daemon                        no" "\n"
+  "  pcloud_cache                             no" "\n"
+  "  ddci                                     yes" "\n"
+  "  cclang_threadsan                         no" "\n"
+  "  gperftools                               no" "\n"
+  "  execinfo                                 yes" "\n"
+  "  mmx                                      yes" "\n"
+  "  sse2                                     yes" "\n"
+  "  W_unused_result                          yes" "\n"
+  "  f_stack_protector                        yes" "\n"
+  "  f_stack_protector_strong                 yes" "\n"
+  "  f_stack_check                            yes" "\n"
+  "  f_PIE                                    yes" "\n"
+  "  fdatasync                                yes" "\n"
+  "  getloadavg                               yes" "\n"
+  "  atomic32                                 yes" "\n"
+  "  atomic64                                 yes" "\n"
+  "  atomic_time_t                            yes" "\n"
+  "  atomic_ptr                               yes" "\n"
+  "  bitops64                                 yes" "\n"
+  "  lockowner                                yes" "\n"
+  "  qsort_r                                  yes" "\n"
+  "  gmtoff                                   yes" "\n"
+  "  recvmmsg                                 yes" "\n"
+  "  sendmmsg                                 yes" "\n"
+  "  ifnames                                  yes" "\n"
+  "  py_gzip                                  yes" "\n"
+  "  bin_pkg_config                           yes" "\n"
+  "  bin_xgettext                             yes" "\n"
+  "  bin_msgmerge                             yes" "\n"
+  "  bin_gzip                                 yes" "\n"
+  "  bin_bzip2                                yes" "\n"
+  "  ssl                                      yes" "\n"
+  "  linuxdvbapi                              yes" "\n"
+  "  linuxdvb_ca                              yes" "\n"
+  "  upnp                                     yes" "\n"
+  "  inotify_h                                yes" "\n"
+  "  inotify_init1                            yes" "\n"
+  "  epoll_create1                            yes" "\n"
+  "  mpegts                                   yes" "\n"
+  "  mpegts_dvb                               yes" "\n"
+  "" "\n"
+  "Packages:" "\n"
+  "  openssl                                  3.0.17" "\n"
+  "  zlib                                     1.2.13" "\n"
+  "" "\n"
+  "Installation paths:" "\n"
+  "  Prefix:                                  /usr/local" "\n"
+  "  Binaries:                                ${prefix}/bin" "\n"
+  "  Libraries:                               ${prefix}/lib" "\n"
+  "  Data files:                              ${prefix}/share" "\n"
+  "  Man pages:                               ${datadir}/man" "\n"
+  "" "\n"
+  "";
@@ -0,0 +1,2 @@
+#include "build.h"
+const char* build_timestamp = "2026-10-16T12:47:01+0000";
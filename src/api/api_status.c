@@ -26,6 +26,7 @@
 #include "api.h"
 #include "tcp.h"
 #include "input.h"
+#include "dvr/dvr.h"
 
 static int
 api_status_inputs
@@ -94,6 +95,28 @@ api_status_connections
   return 0;
 }
 
+static int
+api_status_autorec
+  ( access_t *perm, void *opaque, const char *op, htsmsg_t *args, htsmsg_t **resp )
+{
+  tvh_mutex_lock(&global_lock);
+  *resp = dvr_autorec_stats();
+  tvh_mutex_unlock(&global_lock);
+  return 0;
+}
+
+#if ENABLE_IPTV
+static int
+api_status_iptv
+  ( access_t *perm, void *opaque, const char *op, htsmsg_t *args, htsmsg_t **resp )
+{
+  tvh_mutex_lock(&global_lock);
+  *resp = iptv_input_thread_stats();
+  tvh_mutex_unlock(&global_lock);
+  return 0;
+}
+#endif
+
 static int
 api_connections_cancel
   ( access_t *perm, void *opaque, const char *op, htsmsg_t *args, htsmsg_t **resp )
@@ -178,6 +201,10 @@ void api_status_init ( void )
     { "status/subscriptions", ACCESS_ADMIN, api_status_subscriptions, NULL },
     { "status/inputs",        ACCESS_ADMIN, api_status_inputs, NULL },
     { "status/inputclrstats", ACCESS_ADMIN, api_status_input_clear_stats, NULL },
+    { "status/autorec",       ACCESS_ADMIN, api_status_autorec, NULL },
+#if ENABLE_IPTV
+    { "status/iptv",          ACCESS_ADMIN, api_status_iptv, NULL },
+#endif
     { "connections/cancel",   ACCESS_ADMIN, api_connections_cancel, NULL },
     { NULL },
   };
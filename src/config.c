@@ -1761,6 +1761,7 @@ config_boot
   config.realm = strdup("tvheadend");
   config.info_area = strdup("login,storage,time");
   config.cookie_expires = 7;
+  config.http_write_size = 64;
   config.ticket_expires = 5 * 60;
   config.dscp = -1;
   config.descrambler_buffer = 9000;
@@ -1821,6 +1822,9 @@ config_boot
   if ((config_lock_fd = file_lock(config_lock, 3)) < 0)
     exit(78); /* config error */
 
+  /* The single-file store is modified only with the lock held */
+  hts_settings_store_open();
+
   if (chown(config_lock, uid, gid))
     tvhwarn(LS_CONFIG, "unable to chown lock file %s UID:%d GID:%d", config_lock, uid, gid);
 
@@ -1869,7 +1873,7 @@ config_boot
 }
 
 void
-config_init ( int backup )
+config_init ( int backup, int settings_db )
 {
   const char *path = hts_settings_get_root();
 
@@ -1895,6 +1899,12 @@ config_init ( int backup )
     if (config_migrate(backup))
       config_check();
   }
+
+  /* Convert the tree to the single-file store (after migrations) */
+  if (settings_db && hts_settings_convert()) {
+    tvherror(LS_CONFIG, "unable to convert the configuration tree");
+    exit(78); /* config error */
+  }
   tvhinfo(LS_CONFIG, "loaded");
 }
 
@@ -2495,6 +2505,34 @@ const idclass_t config_class = {
       .opts   = PO_EXPERT,
       .group  = 5
     },
+    {
+      .type   = PT_U32,
+      .intextra = INTEXTRA_RANGE(0, 64, 1),
+      .id     = "tcp_workers",
+      .name   = N_("HTTP worker threads"),
+      .desc   = N_("Zero means one thread per HTTP connection (default). "
+                   "Other values enable the event-driven connection engine: "
+                   "idle connections wait in the poll set without a thread "
+                   "and the requests are served by this many worker threads. "
+                   "A streaming connection takes its worker out of the pool. "
+                   "The change applies to new connections."),
+      .off    = offsetof(config_t, tcp_workers),
+      .opts   = PO_EXPERT,
+      .group  = 5
+    },
+    {
+      .type   = PT_U32,
+      .intextra = INTEXTRA_RANGE(0, 1024, 1),
+      .id     = "http_write_size",
+      .name   = N_("HTTP stream write size (KB)"),
+      .desc   = N_("The HTTP streaming output is gathered and sent "
+                   "using one system call when this size is reached "
+                   "or when all queued packets were processed. "
+                   "Zero writes every packet immediately."),
+      .off    = offsetof(config_t, http_write_size),
+      .opts   = PO_EXPERT,
+      .group  = 5
+    },
     {
       .type   = PT_U32,
       .intextra = INTEXTRA_RANGE(30, 3600, 1),
@@ -61,6 +61,8 @@ typedef struct config {
   uint32_t tvhtime_tolerance;
   char *cors_origin;
   uint32_t cookie_expires;
+  uint32_t tcp_workers;
+  uint32_t http_write_size;
   int dscp;
   uint32_t descrambler_buffer;
   int caclient_ui;
@@ -82,7 +84,7 @@ extern config_t config;
 
 void config_boot
   ( const char *path, gid_t gid, uid_t uid, const char *http_user_agent );
-void config_init( int backup );
+void config_init( int backup, int settings_db );
 void config_done( void );
 
 const char *config_get_server_name ( void );
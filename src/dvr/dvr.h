@@ -60,6 +60,9 @@ typedef struct dvr_vfs {
   LIST_ENTRY(dvr_vfs) link;
   tvh_fsid_t fsid;
   uint64_t used_size;
+  struct dvr_entry **rem_heap; /* "Maintained space" recordings, min-heap by stop time */
+  int rem_count;
+  int rem_size;
 } dvr_vfs_t;
 
 typedef struct dvr_config {
@@ -235,6 +238,9 @@ typedef struct dvr_entry {
   char *de_image;               /* Programme Image */
   char *de_fanart_image;        /* Programme fanart image */
   htsmsg_t *de_files; /* List of all used files */
+  dvr_vfs_t *de_vfs;  /* Disk space cleanup heap (removable recordings only) */
+  int de_vfs_index;
+  time_t de_vfs_stop;
   char *de_directory; /* Can be set for autorec entries, will override any 
                          directory setting from the configuration */
   lang_str_t *de_title;      /* Title in UTF-8 (from EPG) */
@@ -425,6 +431,9 @@ typedef struct dvr_autorec_entry {
   time_t dae_stop_extra;
   
   int dae_record;
+
+  uint32_t dae_index_seq;   /* position in autorec_entries */
+  uint32_t dae_index_mark;  /* candidate de-duplication */
   
 } dvr_autorec_entry_t;
 
@@ -667,6 +676,8 @@ void dvr_spawn_fetch_artwork(dvr_entry_t *de);
 
 void dvr_vfs_refresh_entry(dvr_entry_t *de);
 void dvr_vfs_remove_entry(dvr_entry_t *de);
+void dvr_vfs_entry_update(dvr_entry_t *de);
+void dvr_vfs_entry_unlink(dvr_entry_t *de);
 int64_t dvr_vfs_update_filename(const char *filename, htsmsg_t *fdata);
 int dvr_vfs_rec_start_check(dvr_config_t *cfg);
 
@@ -709,6 +720,8 @@ const char *dvr_entry_get_fanart_image(const dvr_entry_t *o);
 
 void dvr_autorec_check_event(epg_broadcast_t *e);
 
+htsmsg_t *dvr_autorec_stats(void);
+
 void autorec_destroy_by_config(dvr_config_t *cfg, int delconf);
 
 void autorec_destroy_by_channel(channel_t *ch, int delconf);
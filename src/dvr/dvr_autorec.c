@@ -27,6 +27,10 @@
 
 struct dvr_autorec_entry_queue autorec_entries;
 
+static int autorec_index_dirty = 1;
+
+static void autorec_index_done(void);
+
 static void autorec_regfree(dvr_autorec_entry_t *dae)
 {
   if (dae->dae_title) {
@@ -410,6 +414,7 @@ dvr_autorec_create(const char *uuid, htsmsg_t *conf)
   LIST_INSERT_HEAD(&dae->dae_config->dvr_autorec_entries, dae, dae_config_link);
 
   TAILQ_INSERT_TAIL(&autorec_entries, dae, dae_link);
+  autorec_index_dirty = 1;
 
   idnode_load(&dae->dae_id, conf);
 
@@ -505,6 +510,7 @@ autorec_entry_destroy(dvr_autorec_entry_t *dae, int delconf)
   htsp_autorec_entry_delete(dae);
 
   TAILQ_REMOVE(&autorec_entries, dae, dae_link);
+  autorec_index_dirty = 1;
   idnode_unlink(&dae->dae_id);
 
   if(dae->dae_config)
@@ -601,6 +607,7 @@ dvr_autorec_entry_class_channel_set(void *o, const void *v)
     if (dae->dae_channel) {
       LIST_REMOVE(dae, dae_channel_link);
       dae->dae_channel = NULL;
+      autorec_index_dirty = 1;
       return 1;
     }
   } else if (dae->dae_channel != ch) {
@@ -611,6 +618,7 @@ dvr_autorec_entry_class_channel_set(void *o, const void *v)
       LIST_REMOVE(dae, dae_channel_link);
     dae->dae_channel = ch;
     LIST_INSERT_HEAD(&ch->ch_autorecs, dae, dae_channel_link);
+    autorec_index_dirty = 1;
     return 1;
   }
   return 0;
@@ -649,6 +657,7 @@ dvr_autorec_entry_class_title_set(void *o, const void *v)
       dae->dae_title = strdup(title);
     else
       dae->dae_error = 1;
+    autorec_index_dirty = 1;
     return 1;
   }
   return 0;
@@ -663,12 +672,14 @@ dvr_autorec_entry_class_tag_set(void *o, const void *v)
   if (tag == NULL && dae->dae_channel_tag) {
     LIST_REMOVE(dae, dae_channel_tag_link);
     dae->dae_channel_tag = NULL;
+    autorec_index_dirty = 1;
     return 1;
   } else if (dae->dae_channel_tag != tag) {
     if (dae->dae_channel_tag)
       LIST_REMOVE(dae, dae_channel_tag_link);
     dae->dae_channel_tag = tag;
     LIST_INSERT_HEAD(&tag->ct_autorecs, dae, dae_channel_tag_link);
+    autorec_index_dirty = 1;
     return 1;
   }
   return 0;
@@ -1476,6 +1487,7 @@ dvr_autorec_done(void)
   tvh_mutex_lock(&global_lock);
   while ((dae = TAILQ_FIRST(&autorec_entries)) != NULL)
     autorec_entry_destroy(dae, 0);
+  autorec_index_done();
   tvh_mutex_unlock(&global_lock);
 }
 
@@ -1512,23 +1524,351 @@ dvr_autorec_async_reschedule(void)
                  sec2mono(60));
 }
 
+/* **************************************************************************
+ * Match index
+ * **************************************************************************/
+
+/*
+ * The rules with a channel or a channel tag are found through the
+ * broadcast channel (ch_autorecs, ct_autorecs). The other rules are
+ * keyed by one property which every matching broadcast must have:
+ * the series link, a title (fulltext) trigram, the major genre or
+ * the week hours of the start time window. The rules without such
+ * property are always checked. The candidates are verified using
+ * dvr_autorec_cmp() in the rule order.
+ */
+
+#define AUTOREC_KEY_SERIES  1
+#define AUTOREC_KEY_TITLE   2
+#define AUTOREC_KEY_TEXT    3
+#define AUTOREC_KEY_GENRE   4
+#define AUTOREC_KEY_SLOT    5
+#define AUTOREC_KEY_MAX     6
+
+#define AUTOREC_KEY(t, v)   (((uint32_t)(t) << 24) | ((uint32_t)(v) & 0xffffff))
+
+typedef struct autorec_key {
+  uint32_t             key;
+  dvr_autorec_entry_t *dae;
+} autorec_key_t;
+
+static uint32_t              autorec_index_epg;
+static uint32_t              autorec_index_mark;
+static autorec_key_t        *autorec_index_keys;
+static uint32_t              autorec_index_keys_count;
+static uint32_t              autorec_index_keys_size;
+static dvr_autorec_entry_t **autorec_index_any;
+static uint32_t              autorec_index_any_count;
+static uint32_t              autorec_index_any_size;
+static uint32_t              autorec_index_rules[AUTOREC_KEY_MAX];
+static uint32_t              autorec_index_total;
+static dvr_autorec_entry_t **autorec_index_cand;
+static uint32_t              autorec_index_cand_count;
+static uint32_t              autorec_index_cand_size;
+
+static struct {
+  uint32_t channel;
+  uint32_t tag;
+  uint32_t disabled;
+  uint64_t events;
+  uint64_t compared;
+  uint64_t matched;
+  uint64_t skipped;
+  uint64_t rescans;
+  uint64_t rescan_compared;
+  uint64_t rescan_skipped;
+  int64_t  rescan_time;
+} autorec_stats;
+
+static inline uint32_t
+autorec_index_str_hash(const char *s)
+{
+  uint32_t h = 2166136261U;
+  while (*s)
+    h = (h ^ (uint8_t)*s++) * 16777619U;
+  return h;
+}
+
+static void
+autorec_index_key_add(uint32_t key, dvr_autorec_entry_t *dae)
+{
+  if (autorec_index_keys_count == autorec_index_keys_size) {
+    autorec_index_keys_size = MAX(64, autorec_index_keys_size * 2);
+    autorec_index_keys = realloc(autorec_index_keys,
+                                 autorec_index_keys_size * sizeof(autorec_key_t));
+  }
+  autorec_index_keys[autorec_index_keys_count].key = key;
+  autorec_index_keys[autorec_index_keys_count].dae = dae;
+  autorec_index_keys_count++;
+}
+
+static void
+autorec_index_any_add(dvr_autorec_entry_t *dae)
+{
+  if (autorec_index_any_count == autorec_index_any_size) {
+    autorec_index_any_size = MAX(16, autorec_index_any_size * 2);
+    autorec_index_any = realloc(autorec_index_any,
+                                autorec_index_any_size * sizeof(dae));
+  }
+  autorec_index_any[autorec_index_any_count++] = dae;
+}
+
+static int
+autorec_index_key_cmp(const void *a, const void *b)
+{
+  const autorec_key_t *x = a, *y = b;
+  if (x->key != y->key)
+    return x->key < y->key ? -1 : 1;
+  return x->dae->dae_index_seq < y->dae->dae_index_seq ? -1 :
+         (x->dae->dae_index_seq > y->dae->dae_index_seq);
+}
+
+/*
+ * Week hours (monday 00:00 = 0) in which the rule may match. The time
+ * window is extended by one hour on both sides (daylight saving time).
+ * Returns 0 when the rule may match at any time.
+ */
+static int
+autorec_index_slots(dvr_autorec_entry_t *dae, uint8_t *slots)
+{
+  uint8_t hours[24];
+  int d, h, h0, h1, all = 1;
+
+  memset(hours, 1, sizeof(hours));
+  if (dae->dae_start >= 0 && dae->dae_start_window >= 0 &&
+      dae->dae_start < 24*60 && dae->dae_start_window < 24*60) {
+    h0 = dae->dae_start / 60 - 1;
+    h1 = dae->dae_start_window / 60 + 1;
+    if (dae->dae_start > dae->dae_start_window)
+      h1 += 24;
+    if (h1 - h0 < 23) {
+      memset(hours, 0, sizeof(hours));
+      for (h = h0; h <= h1; h++)
+        hours[(h + 24) % 24] = 1;
+      all = 0;
+    }
+  }
+  if (all && (dae->dae_weekdays & 0x7f) == 0x7f)
+    return 0;
+  for (d = 0; d < 7; d++)
+    for (h = 0; h < 24; h++)
+      slots[d * 24 + h] = ((dae->dae_weekdays >> d) & 1) && hours[h];
+  return 1;
+}
+
+static void
+autorec_index_rule(dvr_autorec_entry_t *dae)
+{
+  uint8_t slots[7 * 24];
+  uint32_t key;
+  int i;
+
+  if (dae->dae_serieslink_uri) {
+    autorec_index_key_add(AUTOREC_KEY(AUTOREC_KEY_SERIES,
+                          autorec_index_str_hash(dae->dae_serieslink_uri)), dae);
+    autorec_index_rules[AUTOREC_KEY_SERIES]++;
+  } else if (dae->dae_title && dae->dae_title[0] &&
+             !epg_index_regex_key(dae->dae_title, dae->dae_fulltext, &key)) {
+    i = dae->dae_fulltext ? AUTOREC_KEY_TEXT : AUTOREC_KEY_TITLE;
+    autorec_index_key_add(AUTOREC_KEY(i, key), dae);
+    autorec_index_rules[i]++;
+  } else if (dae->dae_content_type) {
+    autorec_index_key_add(AUTOREC_KEY(AUTOREC_KEY_GENRE,
+                          dae->dae_content_type & 0xf0), dae);
+    autorec_index_rules[AUTOREC_KEY_GENRE]++;
+  } else if (autorec_index_slots(dae, slots)) {
+    for (i = 0; i < 7 * 24; i++)
+      if (slots[i])
+        autorec_index_key_add(AUTOREC_KEY(AUTOREC_KEY_SLOT, i), dae);
+    autorec_index_rules[AUTOREC_KEY_SLOT]++;
+  } else {
+    autorec_index_any_add(dae);
+    autorec_index_rules[0]++;
+  }
+}
+
+static void
+autorec_index_build(void)
+{
+  dvr_autorec_entry_t *dae;
+  uint32_t seq = 0;
+
+  autorec_index_keys_count = 0;
+  autorec_index_any_count = 0;
+  memset(autorec_index_rules, 0, sizeof(autorec_index_rules));
+  autorec_stats.channel = autorec_stats.tag = autorec_stats.disabled = 0;
+  /* the trigram choice depends on the EPG contents */
+  autorec_index_epg = epg_index_count();
+
+  TAILQ_FOREACH(dae, &autorec_entries, dae_link) {
+    dae->dae_index_seq = ++seq;
+    if (!dae->dae_enabled || !dae->dae_weekdays)
+      autorec_stats.disabled++;
+    else if (dae->dae_channel)
+      autorec_stats.channel++;
+    else if (dae->dae_channel_tag)
+      autorec_stats.tag++;
+    else
+      autorec_index_rule(dae);
+  }
+  autorec_index_total = seq;
+  if (autorec_index_keys_count > 1)
+    qsort(autorec_index_keys, autorec_index_keys_count,
+          sizeof(autorec_key_t), autorec_index_key_cmp);
+  autorec_index_dirty = 0;
+}
+
+static void
+autorec_index_add(dvr_autorec_entry_t *dae)
+{
+  if (dae->dae_index_mark == autorec_index_mark)
+    return;
+  dae->dae_index_mark = autorec_index_mark;
+  if (autorec_index_cand_count == autorec_index_cand_size) {
+    autorec_index_cand_size = MAX(32, autorec_index_cand_size * 2);
+    autorec_index_cand = realloc(autorec_index_cand,
+                                 autorec_index_cand_size * sizeof(dae));
+  }
+  autorec_index_cand[autorec_index_cand_count++] = dae;
+}
+
+static void
+autorec_index_lookup(uint32_t key)
+{
+  uint32_t lo = 0, hi = autorec_index_keys_count, mid;
+
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (autorec_index_keys[mid].key < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  for ( ; lo < autorec_index_keys_count && autorec_index_keys[lo].key == key; lo++)
+    autorec_index_add(autorec_index_keys[lo].dae);
+}
+
+static int
+autorec_index_seq_cmp(const void *a, const void *b)
+{
+  const dvr_autorec_entry_t *x = *(dvr_autorec_entry_t **)a;
+  const dvr_autorec_entry_t *y = *(dvr_autorec_entry_t **)b;
+  return x->dae_index_seq < y->dae_index_seq ? -1 :
+         (x->dae_index_seq > y->dae_index_seq);
+}
+
+static void
+autorec_index_done(void)
+{
+  free(autorec_index_keys);
+  free(autorec_index_any);
+  free(autorec_index_cand);
+  autorec_index_keys = NULL;
+  autorec_index_any = NULL;
+  autorec_index_cand = NULL;
+  autorec_index_keys_count = autorec_index_keys_size = 0;
+  autorec_index_any_count = autorec_index_any_size = 0;
+  autorec_index_cand_count = autorec_index_cand_size = 0;
+  autorec_index_dirty = 1;
+}
+
 /**
  *
  */
 void
 dvr_autorec_check_event(epg_broadcast_t *e)
 {
-  dvr_autorec_entry_t *dae;
+  dvr_autorec_entry_t *dae, **cand;
+  idnode_list_mapping_t *ilm;
+  epg_genre_t *g;
+  const uint32_t *keys;
+  uint32_t i, count;
+  struct tm tm;
 
-  if (e->channel && !e->channel->ch_enabled)
+  if (e->channel == NULL || !e->channel->ch_enabled)
     return;
-  TAILQ_FOREACH(dae, &autorec_entries, dae_link)
-    if(dvr_autorec_cmp(dae, e))
-      dvr_entry_create_by_autorec(1, e, dae);
+
+  if (autorec_index_dirty || epg_index_count() / 2 > autorec_index_epg)
+    autorec_index_build();
+  if (++autorec_index_mark == 0) {
+    TAILQ_FOREACH(dae, &autorec_entries, dae_link)
+      dae->dae_index_mark = 0;
+    autorec_index_mark = 1;
+  }
+  autorec_index_cand_count = 0;
+
+  LIST_FOREACH(dae, &e->channel->ch_autorecs, dae_channel_link)
+    autorec_index_add(dae);
+  LIST_FOREACH(ilm, &e->channel->ch_ctms, ilm_in2_link)
+    LIST_FOREACH(dae, &((channel_tag_t *)ilm->ilm_in1)->ct_autorecs, dae_channel_tag_link)
+      autorec_index_add(dae);
+  for (i = 0; i < autorec_index_any_count; i++)
+    autorec_index_add(autorec_index_any[i]);
+
+  if (autorec_index_rules[AUTOREC_KEY_SERIES] && e->serieslink)
+    autorec_index_lookup(AUTOREC_KEY(AUTOREC_KEY_SERIES,
+                                     autorec_index_str_hash(e->serieslink->uri)));
+  if (autorec_index_rules[AUTOREC_KEY_TITLE] || autorec_index_rules[AUTOREC_KEY_TEXT]) {
+    keys = epg_index_broadcast_keys(e, 0, &count);
+    for (i = 0; i < count; i++) {
+      if (autorec_index_rules[AUTOREC_KEY_TITLE])
+        autorec_index_lookup(AUTOREC_KEY(AUTOREC_KEY_TITLE, keys[i]));
+      if (autorec_index_rules[AUTOREC_KEY_TEXT])
+        autorec_index_lookup(AUTOREC_KEY(AUTOREC_KEY_TEXT, keys[i]));
+    }
+  }
+  if (autorec_index_rules[AUTOREC_KEY_TEXT]) {
+    keys = epg_index_broadcast_keys(e, 1, &count);
+    for (i = 0; i < count; i++)
+      autorec_index_lookup(AUTOREC_KEY(AUTOREC_KEY_TEXT, keys[i]));
+  }
+  if (autorec_index_rules[AUTOREC_KEY_GENRE])
+    LIST_FOREACH(g, &e->genre, link)
+      autorec_index_lookup(AUTOREC_KEY(AUTOREC_KEY_GENRE, g->code & 0xf0));
+  if (autorec_index_rules[AUTOREC_KEY_SLOT]) {
+    localtime_r(&e->start, &tm);
+    autorec_index_lookup(AUTOREC_KEY(AUTOREC_KEY_SLOT,
+                                     ((tm.tm_wday ?: 7) - 1) * 24 + tm.tm_hour));
+  }
+
+  /* keep the rule order (duplicate detection, schedule limits) */
+  cand = autorec_index_cand;
+  count = autorec_index_cand_count;
+  if (count > 1)
+    qsort(cand, count, sizeof(dae), autorec_index_seq_cmp);
+
+  autorec_stats.events++;
+  autorec_stats.compared += count;
+  if (autorec_index_total > count)
+    autorec_stats.skipped += autorec_index_total - count;
+
+  for (i = 0; i < count; i++)
+    if(dvr_autorec_cmp(cand[i], e)) {
+      autorec_stats.matched++;
+      dvr_entry_create_by_autorec(1, e, cand[i]);
+    }
   // Note: no longer updating event here as it will be done from EPG
   //       anyway
 }
 
+static int
+autorec_id_cmp(const void *a, const void *b)
+{
+  uint32_t x = *(uint32_t *)a, y = *(uint32_t *)b;
+  return x < y ? -1 : (x > y);
+}
+
+static int
+autorec_channel_tagged(channel_t *ch, channel_tag_t *ct)
+{
+  idnode_list_mapping_t *ilm;
+
+  LIST_FOREACH(ilm, &ch->ch_ctms, ilm_in2_link)
+    if ((channel_tag_t *)ilm->ilm_in1 == ct)
+      return 1;
+  return 0;
+}
+
 /**
  *
  */
@@ -1537,14 +1877,39 @@ dvr_autorec_changed(dvr_autorec_entry_t *dae, int purge)
 {
   channel_t *ch;
   epg_broadcast_t *e, **disabled = NULL, **p;
-  int enabled;
+  uint32_t *ids = NULL, count = 0;
+  uint64_t compared = 0, skipped = 0;
+  int64_t mono;
+  int enabled, use_ids = 0;
+
+  autorec_index_dirty = 1;
 
   if (purge)
     disabled = dvr_autorec_purge_spawns(dae, 1, 1);
 
+  /* nothing can match */
+  if (dae->dae_enabled == 0 || dae->dae_weekdays == 0)
+    goto end;
+
+  mono = getmonoclock();
+
+  /* the EPG index is complete when the EPG is not loaded */
+  if (!epg_in_load &&
+      (dae->dae_serieslink_uri == NULL || dae->dae_serieslink_uri[0] == '\0') &&
+      dae->dae_title != NULL && dae->dae_title[0] != '\0')
+    use_ids = !epg_index_regex(dae->dae_title, dae->dae_fulltext, &ids, &count);
+
   CHANNEL_FOREACH(ch) {
     if (!ch->ch_enabled) continue;
+    if (dae->dae_channel && dae->dae_channel != ch) continue;
+    if (dae->dae_channel_tag && !autorec_channel_tagged(ch, dae->dae_channel_tag))
+      continue;
     RB_FOREACH(e, &ch->ch_epg_schedule, sched_link) {
+      if (use_ids && !bsearch(&e->id, ids, count, sizeof(uint32_t), autorec_id_cmp)) {
+        skipped++;
+        continue;
+      }
+      compared++;
       if(dvr_autorec_cmp(dae, e)) {
         enabled = 1;
         if (disabled) {
@@ -1556,9 +1921,53 @@ dvr_autorec_changed(dvr_autorec_entry_t *dae, int purge)
     }
   }
 
+  free(ids);
+
+  mono = getmonoclock() - mono;
+  autorec_stats.rescans++;
+  autorec_stats.rescan_compared += compared;
+  autorec_stats.rescan_skipped += skipped;
+  autorec_stats.rescan_time += mono;
+  tvhtrace(LS_DVR, "autorec \"%s\": %"PRIu64" broadcasts compared, %"PRIu64" skipped (%"PRId64"ms)",
+           dae->dae_title ?: "", compared, skipped, mono2ms(mono));
+
+end:
   free(disabled);
 }
 
+/**
+ * Match statistics
+ */
+htsmsg_t *
+dvr_autorec_stats(void)
+{
+  htsmsg_t *m = htsmsg_create_map(), *r = htsmsg_create_map();
+
+  lock_assert(&global_lock);
+
+  if (autorec_index_dirty)
+    autorec_index_build();
+  htsmsg_add_u32(r, "channel", autorec_stats.channel);
+  htsmsg_add_u32(r, "tag", autorec_stats.tag);
+  htsmsg_add_u32(r, "serieslink", autorec_index_rules[AUTOREC_KEY_SERIES]);
+  htsmsg_add_u32(r, "title", autorec_index_rules[AUTOREC_KEY_TITLE]);
+  htsmsg_add_u32(r, "fulltext", autorec_index_rules[AUTOREC_KEY_TEXT]);
+  htsmsg_add_u32(r, "genre", autorec_index_rules[AUTOREC_KEY_GENRE]);
+  htsmsg_add_u32(r, "time", autorec_index_rules[AUTOREC_KEY_SLOT]);
+  htsmsg_add_u32(r, "any", autorec_index_rules[0]);
+  htsmsg_add_u32(r, "disabled", autorec_stats.disabled);
+  htsmsg_add_msg(m, "rules", r);
+  htsmsg_add_s64(m, "events", autorec_stats.events);
+  htsmsg_add_s64(m, "compared", autorec_stats.compared);
+  htsmsg_add_s64(m, "skipped", autorec_stats.skipped);
+  htsmsg_add_s64(m, "matched", autorec_stats.matched);
+  htsmsg_add_s64(m, "rescans", autorec_stats.rescans);
+  htsmsg_add_s64(m, "rescan_compared", autorec_stats.rescan_compared);
+  htsmsg_add_s64(m, "rescan_skipped", autorec_stats.rescan_skipped);
+  htsmsg_add_s64(m, "rescan_ms", mono2ms(autorec_stats.rescan_time));
+  return m;
+}
+
 
 /**
  *
@@ -1583,6 +1992,7 @@ autorec_destroy_by_channel_tag(channel_tag_t *ct, int delconf)
   while((dae = LIST_FIRST(&ct->ct_autorecs)) != NULL) {
     LIST_REMOVE(dae, dae_channel_tag_link);
     dae->dae_channel_tag = NULL;
+    autorec_index_dirty = 1;
     idnode_notify_changed(&dae->dae_id);
     if (delconf)
       idnode_changed(&dae->dae_id);
@@ -541,6 +541,8 @@ dvr_config_delete(const char *name)
 void
 dvr_config_changed(dvr_config_t *cfg)
 {
+  dvr_entry_t *de;
+
   if (dvr_config_is_default(cfg))
     cfg->dvr_enabled = 1;
   cfg->dvr_valid = 1;
@@ -559,6 +561,9 @@ dvr_config_changed(dvr_config_t *cfg)
     cfg->dvr_retention_days = DVR_RET_REM_FOREVER;
   if (cfg->dvr_profile && !strcmp(profile_get_name(cfg->dvr_profile), "htsp")) // htsp is for streaming only
     cfg->dvr_profile = profile_find_by_name("pass", NULL);
+  /* the removal days may be changed */
+  LIST_FOREACH(de, &cfg->dvr_entries, de_config_link)
+    dvr_vfs_entry_update(de);
 }
 
 
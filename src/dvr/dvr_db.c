@@ -213,6 +213,7 @@ dvr_entry_set_state(dvr_entry_t *de, dvr_entry_sched_state_t state,
                     dvr_rs_state_t rec_state, int error_code)
 {
   char id[16];
+  int sched;
   if (de->de_sched_state != state ||
       de->de_rec_state != rec_state ||
       de->de_last_error != error_code) {
@@ -224,9 +225,13 @@ dvr_entry_set_state(dvr_entry_t *de, dvr_entry_sched_state_t state,
       snprintf(id, sizeof(id), "%u", de->de_bcast->id);
       notify_delayed(id, "epg", "dvr_update");
     }
+    sched = de->de_sched_state != state;
     de->de_sched_state = state;
     de->de_rec_state = rec_state;
     de->de_last_error = error_code;
+    /* the recorder thread changes only rec_state (without global_lock) */
+    if (sched)
+      dvr_vfs_entry_update(de);
     idnode_notify_changed(&de->de_id);
     htsp_dvr_entry_update(de);
     return 1;
@@ -2161,6 +2166,7 @@ dvr_entry_destroy(dvr_entry_t *de, int delconf)
 #if ENABLE_INOTIFY
   dvr_inotify_del(de);
 #endif
+  dvr_vfs_entry_unlink(de);
 
   gtimer_disarm(&de->de_timer);
   mtimer_disarm(&de->de_deferred_timer);
@@ -2224,6 +2230,7 @@ dvr_entry_destroy_by_config(dvr_config_t *cfg, int delconf)
     de->de_config = def;
     if (def)
       LIST_INSERT_HEAD(&def->dvr_entries, de, de_config_link);
+    dvr_vfs_entry_update(de);
     if (delconf)
       idnode_changed(&de->de_id);
   }
@@ -3049,6 +3056,7 @@ dvr_entry_class_changed(idnode_t *self)
     return;
   if (dvr_entry_is_valid(de))
     dvr_entry_set_timer(de);
+  dvr_vfs_entry_update(de);
   htsp_dvr_entry_update(de);
 }
 
@@ -78,6 +78,156 @@ dvr_vfs_find1(dvr_vfs_t *old, htsmsg_t *m)
   return NULL;
 }
 
+/*
+ * Heap of the "Maintained space" recordings per file system (the oldest
+ * stop time on the top), used by the disk space cleanup
+ */
+static inline void
+dvr_vfs_heap_set(dvr_vfs_t *vfs, int i, dvr_entry_t *de)
+{
+  vfs->rem_heap[i] = de;
+  de->de_vfs_index = i;
+}
+
+static void
+dvr_vfs_heap_up(dvr_vfs_t *vfs, int i)
+{
+  dvr_entry_t *de = vfs->rem_heap[i], *p;
+
+  while (i > 0) {
+    p = vfs->rem_heap[(i - 1) / 2];
+    if (p->de_vfs_stop <= de->de_vfs_stop)
+      break;
+    dvr_vfs_heap_set(vfs, i, p);
+    i = (i - 1) / 2;
+  }
+  dvr_vfs_heap_set(vfs, i, de);
+}
+
+static void
+dvr_vfs_heap_down(dvr_vfs_t *vfs, int i)
+{
+  dvr_entry_t *de = vfs->rem_heap[i], *c;
+  int j;
+
+  while ((j = 2 * i + 1) < vfs->rem_count) {
+    if (j + 1 < vfs->rem_count &&
+        vfs->rem_heap[j + 1]->de_vfs_stop < vfs->rem_heap[j]->de_vfs_stop)
+      j++;
+    c = vfs->rem_heap[j];
+    if (de->de_vfs_stop <= c->de_vfs_stop)
+      break;
+    dvr_vfs_heap_set(vfs, i, c);
+    i = j;
+  }
+  dvr_vfs_heap_set(vfs, i, de);
+}
+
+static void
+dvr_vfs_heap_insert(dvr_vfs_t *vfs, dvr_entry_t *de)
+{
+  if (vfs->rem_count == vfs->rem_size) {
+    vfs->rem_size = MAX(64, vfs->rem_size * 2);
+    vfs->rem_heap = realloc(vfs->rem_heap, vfs->rem_size * sizeof(dvr_entry_t *));
+  }
+  de->de_vfs = vfs;
+  dvr_vfs_heap_set(vfs, vfs->rem_count++, de);
+  dvr_vfs_heap_up(vfs, de->de_vfs_index);
+}
+
+void
+dvr_vfs_entry_unlink(dvr_entry_t *de)
+{
+  dvr_vfs_t *vfs = de->de_vfs;
+  dvr_entry_t *last;
+  int i;
+
+  if (vfs == NULL)
+    return;
+  i = de->de_vfs_index;
+  last = vfs->rem_heap[--vfs->rem_count];
+  if (i < vfs->rem_count) {
+    dvr_vfs_heap_set(vfs, i, last);
+    dvr_vfs_heap_down(vfs, i);
+    dvr_vfs_heap_up(vfs, last->de_vfs_index);
+  }
+  de->de_vfs = NULL;
+}
+
+/*
+ * Returns the file system when the recording can be removed
+ * to get more disk space
+ */
+static dvr_vfs_t *
+dvr_vfs_entry_removable(dvr_entry_t *de)
+{
+  htsmsg_field_t *f;
+  htsmsg_t *m;
+
+  if (de->de_sched_state != DVR_COMPLETED &&
+      de->de_sched_state != DVR_MISSED_TIME)
+    return NULL;
+  if (de->de_config == NULL ||
+      dvr_entry_get_removal_days(de) != DVR_REM_SPACE) // only remove the allowed ones
+    return NULL;
+  if (dvr_get_filename(de) == NULL || dvr_get_filesize(de, DVR_FILESIZE_TOTAL) <= 0)
+    return NULL;
+  /* Checking for the same config is useless as it's storage path might be changed meanwhile */
+  /* Use the file system of the last file (updated in dvr_vfs_refresh_entry) */
+  if ((f = htsmsg_field_last(de->de_files)) == NULL ||
+      (m = htsmsg_field_get_map(f)) == NULL)
+    return NULL;
+  return dvr_vfs_find1(NULL, m);
+}
+
+/*
+ * Update the cleanup heap position after a change of the recording
+ */
+void
+dvr_vfs_entry_update(dvr_entry_t *de)
+{
+  dvr_vfs_t *vfs;
+  time_t stop;
+
+  lock_assert(&global_lock);
+  vfs = dvr_vfs_entry_removable(de);
+  if (vfs != de->de_vfs)
+    dvr_vfs_entry_unlink(de);
+  if (vfs == NULL)
+    return;
+  stop = dvr_entry_get_stop_time(de);
+  if (de->de_vfs == NULL) {
+    de->de_vfs_stop = stop;
+    dvr_vfs_heap_insert(vfs, de);
+  } else if (de->de_vfs_stop != stop) {
+    de->de_vfs_stop = stop;
+    dvr_vfs_heap_up(vfs, de->de_vfs_index);
+    dvr_vfs_heap_down(vfs, de->de_vfs_index);
+  }
+}
+
+/*
+ * The oldest finished recording which can be removed, the stop time
+ * might be changed without a notification (channel or config extra
+ * times), so the top entry is validated here
+ */
+static dvr_entry_t *
+dvr_vfs_oldest(dvr_vfs_t *vfs)
+{
+  dvr_entry_t *de;
+
+  while (vfs->rem_count > 0) {
+    de = vfs->rem_heap[0];
+    if (dvr_vfs_entry_removable(de) != vfs ||
+        dvr_entry_get_stop_time(de) != de->de_vfs_stop) {
+      dvr_vfs_entry_update(de);
+      continue;
+    }
+    return de->de_vfs_stop <= gclk() ? de : NULL;
+  }
+  return NULL;
+}
+
 /*
  *
  */
@@ -123,6 +273,7 @@ rem:
         htsmsg_delete_field(m, "size");
       }
     }
+  dvr_vfs_entry_update(de);
 }
 
 /*
@@ -137,6 +288,7 @@ dvr_vfs_remove_entry(dvr_entry_t *de)
   uint64_t size;
 
   lock_assert(&global_lock);
+  dvr_vfs_entry_unlink(de);
   HTSMSG_FOREACH(f, de->de_files)
     if ((m = htsmsg_field_get_map(f)) != NULL) {
       vfs = dvr_vfs_find1(vfs, m);
@@ -194,7 +346,7 @@ dvr_disk_space_cleanup(dvr_config_t *cfg, int include_active)
   char tbuf[64];
   const char *configName;
   dvr_vfs_t *dvfs;
-  tvh_fsid_t fsid, fsid2;
+  tvh_fsid_t fsid;
 
   if (!cfg || !cfg->dvr_enabled)
     return -1;
@@ -230,36 +382,10 @@ dvr_disk_space_cleanup(dvr_config_t *cfg, int include_active)
            configName, TOMIB(requiredBytes), TOMIB(availBytes), TOMIB(maximalBytes), TOMIB(usedBytes));
 
   while (availBytes < requiredBytes || ((maximalBytes < usedBytes) && cfg->dvr_cleanup_threshold_used)) {
-    oldest = NULL;
-    stoptime = gclk();
-
-    LIST_FOREACH(de, &dvrentries, de_global_link) {
-      if (de->de_sched_state != DVR_COMPLETED &&
-          de->de_sched_state != DVR_MISSED_TIME)
-        continue;
-
-      if (dvr_entry_get_stop_time(de) > stoptime)
-        continue;
-
-      if (dvr_entry_get_removal_days(de) != DVR_REM_SPACE) // only remove the allowed ones
-        continue;
-
-      if (dvr_get_filename(de) == NULL || dvr_get_filesize(de, DVR_FILESIZE_TOTAL) <= 0)
-        continue;
-
-      if (tvh_vfs_fsid_build(dvr_get_filename(de), NULL, &fsid2))
-        continue;
-
-      /* Checking for the same config is useless as it's storage path might be changed meanwhile */
-      /* Check for the same file system instead */
-      if (tvh_vfs_fsid_match(&fsid, &fsid2) == 0)
-        continue;
-
-      oldest = de; // the oldest one until now
-      stoptime = dvr_entry_get_stop_time(de);
-    }
+    oldest = dvr_vfs_oldest(dvfs);
 
     if (oldest) {
+      stoptime = oldest->de_vfs_stop;
       fileSize = dvr_get_filesize(oldest, DVR_FILESIZE_TOTAL);
       availBytes += fileSize;
       clearedBytes += fileSize;
@@ -272,13 +398,14 @@ dvr_disk_space_cleanup(dvr_config_t *cfg, int include_active)
               lang_str_get(oldest->de_title, NULL), tbuf, TOMIB(fileSize));
 
       dvr_disk_space_config_lastdelete = mclk();
+      dvr_vfs_entry_unlink(oldest);
       dvr_entry_cancel_remove(oldest, 0); /* Remove stored files and mark as "removed" */
     } else {
       /* Stop active recordings if cleanup is not possible */
       if (loops == 0 && include_active) {
         tvhwarn(LS_DVR, "No \"until space needed\" recordings found for config \"%s\", aborting active recordings now!", configName);
-        LIST_FOREACH(de, &dvrentries, de_global_link) {
-          if (de->de_sched_state != DVR_RECORDING || !de->de_config || de->de_config != cfg)
+        LIST_FOREACH(de, &cfg->dvr_entries, de_config_link) {
+          if (de->de_sched_state != DVR_RECORDING)
             continue;
           dvr_stop_recording(de, SM_CODE_NO_SPACE, 1, 0);
         }
@@ -341,10 +468,10 @@ dvr_disk_space_check()
     maximalBytes = MIB(cfg->dvr_cleanup_threshold_used);
 
     if (availBytes < requiredBytes || ((maximalBytes < usedBytes) && cfg->dvr_cleanup_threshold_used)) {
-      LIST_FOREACH(de, &dvrentries, de_global_link) {
+      LIST_FOREACH(de, &cfg->dvr_entries, de_config_link) {
 
         /* only start cleanup if we are actually writing files right now */
-        if (de->de_sched_state != DVR_RECORDING || !de->de_config || de->de_config != cfg)
+        if (de->de_sched_state != DVR_RECORDING)
           continue;
 
         if (availBytes < requiredBytes) {
@@ -518,6 +645,9 @@ dvr_disk_space_done(void)
   mtimer_disarm(&dvr_disk_space_timer);
   while ((vfs = LIST_FIRST(&dvrvfs_list)) != NULL) {
     LIST_REMOVE(vfs, link);
+    while (vfs->rem_count > 0)
+      dvr_vfs_entry_unlink(vfs->rem_heap[0]);
+    free(vfs->rem_heap);
     free(vfs);
   }
   tvh_mutex_unlock(&global_lock);
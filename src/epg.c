@@ -103,6 +103,8 @@ void epg_updated ( void )
     eo->_updated = 0;
     eo->_created = 1;
   }
+
+  epg_index_check();
 }
 
 /* **************************************************************************
@@ -848,6 +850,8 @@ static void _epg_broadcast_destroy ( void *eo )
     snprintf(id, sizeof(id), "%u", ebc->id);
     notify_delayed(id, "epg", "delete");
   }
+  epg_index_remove(ebc);
+  epgdb_journal_remove(ebc);
   if (ebc->title)       lang_str_destroy(ebc->title);
   if (ebc->subtitle)    lang_str_destroy(ebc->subtitle);
   if (ebc->summary)     lang_str_destroy(ebc->summary);
@@ -909,6 +913,8 @@ static void _epg_broadcast_updated ( void *eo )
     htsp_event_add(eo);
     notify_delayed(id, "epg", "create");
   }
+  epg_index_update(ebc);
+  epgdb_journal_update(ebc);
   if (ebc->channel) {
     dvr_event_updated(eo);
     if (ebc->update_running != EPG_RUNNING_NOTSET)
@@ -2249,6 +2255,39 @@ _eq_add_channel ( epg_query_t *eq, channel_t *ch )
     _eq_add(eq, ebc);
 }
 
+static int
+_eq_channel_tagged ( channel_t *ch, channel_tag_t *tag )
+{
+  idnode_list_mapping_t *ilm;
+  LIST_FOREACH(ilm, &ch->ch_ctms, ilm_in2_link)
+    if ((channel_tag_t *)ilm->ilm_in1 == tag)
+      return 1;
+  return 0;
+}
+
+static void
+_eq_add_candidates ( epg_query_t *eq, uint32_t *ids, uint32_t count,
+                     channel_t *channel, channel_tag_t *tag, access_t *perm )
+{
+  epg_broadcast_t *ebc;
+  channel_t *ch, *last = NULL;
+  uint32_t i;
+  int ok = 0;
+
+  for (i = 0; i < count; i++) {
+    ebc = epg_broadcast_find_by_id(ids[i]);
+    if (ebc == NULL || (ch = ebc->channel) == NULL) continue;
+    if (ch != last) {
+      last = ch;
+      ok = (channel == NULL || ch == channel) &&
+           (tag == NULL || _eq_channel_tagged(ch, tag)) &&
+           channel_access(ch, perm, 0);
+    }
+    if (ok)
+      _eq_add(eq, ebc);
+  }
+}
+
 static int
 _eq_init_str( epg_filter_str_t *f )
 {
@@ -2463,6 +2502,7 @@ epg_query ( epg_query_t *eq, access_t *perm )
 {
   channel_t *channel;
   channel_tag_t *tag;
+  uint32_t *ids, count;
   int (*fcn)(const void *, const void *, void *) = NULL;
 
   /* Setup exp */
@@ -2483,11 +2523,18 @@ epg_query ( epg_query_t *eq, access_t *perm )
   tag = channel_tag_find_by_uuid(eq->channel_tag) ?:
         channel_tag_find_by_name(eq->channel_tag, 0);
 
+  epg_index_check();
+
   /* Single channel */
   if (channel && tag == NULL) {
     if (channel_access(channel, perm, 0))
       _eq_add_channel(eq, channel);
-  
+
+  /* Candidates from the index */
+  } else if (!epg_index_query(eq, &ids, &count)) {
+    _eq_add_candidates(eq, ids, count, channel, tag, perm);
+    free(ids);
+
   /* Tag based */
   } else if (tag) {
     idnode_list_mapping_t *ilm;
@@ -301,6 +301,11 @@ struct epg_broadcast
   epg_set_t                 *serieslink;       ///< Series Link
   epg_set_t                 *episodelink;      ///< Episode Link
 
+  uint32_t                   index_hash;       ///< Query index content hash
+  uint32_t                   index_cnt;        ///< Query index entries
+  LIST_ENTRY(epg_broadcast)  journal_link;     ///< Database journal (changed)
+  uint8_t                    journal_dirty;    ///< Queued to the database journal
+
   time_t                     first_aired;      ///< Original airdate
   uint16_t                   copyright_year;   ///< xmltv DTD gives a tag "date" (separate to previously-shown/first aired).
                                                ///< This is the date programme was "finished...probably the copyright date."
@@ -557,10 +562,33 @@ typedef struct epg_query {
 epg_broadcast_t  **epg_query(epg_query_t *eq, access_t *perm);
 void epg_query_free(epg_query_t *eq);
 
+/* ************************************************************************
+ * Query index (candidate broadcasts for epg_query)
+ * ***********************************************************************/
+
+void epg_index_init   ( void );
+void epg_index_done   ( void );
+void epg_index_update ( epg_broadcast_t *b );
+void epg_index_remove ( epg_broadcast_t *b );
+void epg_index_check  ( void );
+int  epg_index_query  ( epg_query_t *eq, uint32_t **ids, uint32_t *count );
+int  epg_index_regex  ( const char *re, int fulltext, uint32_t **ids, uint32_t *count );
+int  epg_index_regex_key ( const char *re, int fulltext, uint32_t *key );
+const uint32_t *epg_index_broadcast_keys ( epg_broadcast_t *b, int text, uint32_t *count );
+uint32_t epg_index_count ( void );
+
+/* ************************************************************************
+ * Database journal
+ * ***********************************************************************/
+
+void epgdb_journal_update ( epg_broadcast_t *b );
+void epgdb_journal_remove ( epg_broadcast_t *b );
+
 /* ************************************************************************
  * Setup/Shutdown
  * ***********************************************************************/
 
+void epg_preload (void);
 void epg_init    (void);
 void epg_done    (void);
 void epg_skel_done (void);
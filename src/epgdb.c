@@ -17,18 +17,16 @@
  */
 
 #include <string.h>
-#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
-#include <signal.h>
-#include <setjmp.h>
 
 #include "tvheadend.h"
 #include "sbuf.h"
 #include "htsmsg_binary.h"
 #include "htsmsg_binary2.h"
 #include "settings.h"
+#include "file.h"
 #include "channels.h"
 #include "epg.h"
 #include "epggrab.h"
@@ -40,18 +38,288 @@
 
 extern epg_object_tree_t epg_episodes;
 
+/*
+ * The database is kept as a snapshot (epgdb.v3) and a journal
+ * (epgdb.v3.journal). The journal has the snapshot format, but it contains
+ * only the changed broadcasts and the ids of the removed broadcasts. Each
+ * appended batch is terminated with the commit section. The journal is
+ * merged to the snapshot in the tasklet thread when it grows too much.
+ */
+typedef struct epgdb_jentry {
+  uint32_t       id;
+  uint32_t       seq;
+  htsmsg_t      *m;         /* NULL = removed */
+  const uint8_t *data;
+  size_t         len;
+  int            used;
+} epgdb_jentry_t;
+
+typedef struct epgdb_journal {
+  char          *buf;
+  size_t         size;
+  size_t         valid;     /* size of the committed batches */
+  epgdb_jentry_t *entries;
+  size_t         count;
+  size_t         alloc;
+  htsmsg_t      *config;
+  const uint8_t *config_data;
+  size_t         config_len;
+} epgdb_journal_t;
+
+#define EPGDB_SECT_NONE       0
+#define EPGDB_SECT_CONFIG     1
+#define EPGDB_SECT_BROADCASTS 2
+#define EPGDB_SECT_REMOVED    3
+
+static LIST_HEAD(, epg_broadcast) epgdb_changed;
+static uint32_t *epgdb_removed;
+static size_t    epgdb_removed_count;
+static size_t    epgdb_removed_alloc;
+
+/* tasklet thread (or the init) only */
+static size_t    epgdb_snapshot_size;
+static size_t    epgdb_journal_size;
+
+/* **************************************************************************
+ * Journal
+ * *************************************************************************/
+
+static void epgdb_removed_add ( uint32_t id )
+{
+  if (epgdb_removed_count == epgdb_removed_alloc) {
+    epgdb_removed_alloc = MAX(1024, epgdb_removed_alloc * 2);
+    epgdb_removed = realloc(epgdb_removed,
+                            epgdb_removed_alloc * sizeof(uint32_t));
+  }
+  epgdb_removed[epgdb_removed_count++] = id;
+}
+
+void epgdb_journal_update ( epg_broadcast_t *ebc )
+{
+  lock_assert(&global_lock);
+
+  /* the loaded broadcasts are already stored */
+  if (epg_in_load || ebc->journal_dirty)
+    return;
+  ebc->journal_dirty = 1;
+  LIST_INSERT_HEAD(&epgdb_changed, ebc, journal_link);
+}
+
+void epgdb_journal_remove ( epg_broadcast_t *ebc )
+{
+  lock_assert(&global_lock);
+
+  if (ebc->journal_dirty) {
+    LIST_REMOVE(ebc, journal_link);
+    ebc->journal_dirty = 0;
+  }
+  if (ebc->id)
+    epgdb_removed_add(ebc->id);
+}
+
+static void epgdb_journal_truncate ( size_t size )
+{
+  char path[PATH_MAX];
+
+  if (hts_settings_buildpath(path, sizeof(path), "epgdb.v%d.journal",
+                             EPG_DB_VERSION))
+    return;
+  if (size == 0) {
+    if (unlink(path) && errno != ENOENT)
+      tvherror(LS_EPGDB, "unable to remove file %s", path);
+    return;
+  }
+  if (truncate(path, size))
+    tvherror(LS_EPGDB, "unable to truncate file %s", path);
+}
+
+static int epgdb_jentry_cmp ( const void *a, const void *b )
+{
+  const epgdb_jentry_t *e1 = a, *e2 = b;
+  if (e1->id != e2->id)
+    return e1->id < e2->id ? -1 : 1;
+  return e1->seq < e2->seq ? -1 : (e1->seq > e2->seq);
+}
+
+static int epgdb_jentry_id_cmp ( const void *a, const void *b )
+{
+  uint32_t id1 = ((const epgdb_jentry_t *)a)->id;
+  uint32_t id2 = ((const epgdb_jentry_t *)b)->id;
+  return id1 < id2 ? -1 : (id1 > id2);
+}
+
+static epgdb_jentry_t *
+epgdb_journal_find ( epgdb_journal_t *jn, uint32_t id )
+{
+  epgdb_jentry_t skel = { .id = id };
+  if (jn == NULL || jn->count == 0)
+    return NULL;
+  return bsearch(&skel, jn->entries, jn->count, sizeof(skel),
+                 epgdb_jentry_id_cmp);
+}
+
+static void
+epgdb_journal_add
+  ( epgdb_journal_t *jn, uint32_t id, htsmsg_t *m,
+    const uint8_t *data, size_t len )
+{
+  epgdb_jentry_t *e;
+
+  if (jn->count == jn->alloc) {
+    jn->alloc = MAX(1024, jn->alloc * 2);
+    jn->entries = realloc(jn->entries, jn->alloc * sizeof(*e));
+  }
+  e = &jn->entries[jn->count];
+  e->id = id;
+  e->seq = jn->count++;
+  e->m = m;
+  e->data = data;
+  e->len = len;
+  e->used = 0;
+}
+
+static void epgdb_journal_free ( epgdb_journal_t *jn )
+{
+  size_t i;
+
+  for (i = 0; i < jn->count; i++)
+    if (jn->entries[i].m)
+      htsmsg_destroy(jn->entries[i].m);
+  if (jn->config)
+    htsmsg_destroy(jn->config);
+  free(jn->entries);
+  free(jn->buf);
+  memset(jn, 0, sizeof(*jn));
+}
+
+/*
+ * Read the journal, only the last version of each broadcast is kept
+ * (sorted by id). The uncommitted (partially written) batch is ignored.
+ */
+static void epgdb_journal_read ( epgdb_journal_t *jn )
+{
+  const uint8_t *rp, *data, *config_data = NULL;
+  size_t remain, msglen, committed = 0, config_len = 0, i, j;
+  htsmsg_t *m, *config = NULL;
+  const char *s;
+  uint32_t id;
+  int fd, sect = EPGDB_SECT_NONE;
+
+  memset(jn, 0, sizeof(*jn));
+  fd = hts_settings_open_file(0, "epgdb.v%d.journal", EPG_DB_VERSION);
+  if (fd < 0)
+    return;
+  jn->size = file_readall(fd, &jn->buf);
+  close(fd);
+  if (jn->buf == NULL)
+    jn->size = 0;
+
+  rp = (uint8_t *)jn->buf;
+  remain = jn->size;
+  while (remain > 4) {
+    msglen = remain;
+    if (htsmsg_binary2_deserialize(&m, rp, &msglen, NULL))
+      break;
+    data = rp;
+    rp     += msglen;
+    remain -= msglen;
+    if (!m) continue;
+    if ((s = htsmsg_get_str(m, "__section__"))) {
+      if (!strcmp(s, "commit")) {
+        committed = jn->count;
+        jn->valid = jn->size - remain;
+        if (config) {
+          if (jn->config)
+            htsmsg_destroy(jn->config);
+          jn->config = config;
+          jn->config_data = config_data;
+          jn->config_len = config_len;
+          config = NULL;
+        }
+        sect = EPGDB_SECT_NONE;
+      } else if (!strcmp(s, "config")) {
+        sect = EPGDB_SECT_CONFIG;
+      } else if (!strcmp(s, "broadcasts")) {
+        sect = EPGDB_SECT_BROADCASTS;
+      } else if (!strcmp(s, "removed")) {
+        sect = EPGDB_SECT_REMOVED;
+      } else {
+        sect = EPGDB_SECT_NONE;
+      }
+      htsmsg_destroy(m);
+    } else if (sect == EPGDB_SECT_CONFIG) {
+      if (config)
+        htsmsg_destroy(config);
+      config = m;
+      config_data = data;
+      config_len = msglen;
+    } else if (sect != EPGDB_SECT_NONE && !htsmsg_get_u32(m, "id", &id)) {
+      if (sect == EPGDB_SECT_REMOVED) {
+        htsmsg_destroy(m);
+        m = NULL;
+      }
+      epgdb_journal_add(jn, id, m, data, msglen);
+    } else {
+      htsmsg_destroy(m);
+    }
+  }
+  if (config)
+    htsmsg_destroy(config);
+
+  /* Drop the uncommitted batch */
+  for (i = committed; i < jn->count; i++)
+    if (jn->entries[i].m)
+      htsmsg_destroy(jn->entries[i].m);
+  jn->count = committed;
+
+  /* Keep the last version */
+  qsort(jn->entries, jn->count, sizeof(epgdb_jentry_t), epgdb_jentry_cmp);
+  for (i = j = 0; i < jn->count; i++) {
+    if (i + 1 < jn->count && jn->entries[i].id == jn->entries[i+1].id) {
+      if (jn->entries[i].m)
+        htsmsg_destroy(jn->entries[i].m);
+      continue;
+    }
+    jn->entries[j++] = jn->entries[i];
+  }
+  jn->count = j;
+
+  if (jn->valid < jn->size)
+    tvhwarn(LS_EPGDB, "journal - uncommitted data (%zd bytes) ignored",
+            jn->size - jn->valid);
+}
+
 /* **************************************************************************
  * Load
  * *************************************************************************/
 
 /*
- * Process v3 data
+ * Load broadcast
  */
 static void
-_epgdb_v3_process( char **sect, htsmsg_t *m, epggrab_stats_t *stats )
+_epgdb_load_broadcast( htsmsg_t *m, epggrab_stats_t *stats )
 {
   int save = 0;
+  uint32_t id;
+
+  if (epg_broadcast_deserialize(m, 1, &save)) {
+    stats->broadcasts.total++;
+  } else if (!htsmsg_get_u32(m, "id", &id)) {
+    /* expired or unknown channel, remove from the database */
+    epgdb_removed_add(id);
+  }
+}
+
+/*
+ * Process v3 data
+ */
+static void
+_epgdb_v3_process( char **sect, htsmsg_t *m, epggrab_stats_t *stats,
+                   epgdb_journal_t *jn )
+{
   const char *s;
+  epgdb_jentry_t *e;
+  uint32_t id;
 
   /* New section */
   if ( (s = htsmsg_get_str(m, "__section__")) ) {
@@ -60,7 +328,14 @@ _epgdb_v3_process( char **sect, htsmsg_t *m, epggrab_stats_t *stats )
   
   /* Broadcasts */
   } else if ( !strcmp(*sect, "broadcasts") ) {
-    if (epg_broadcast_deserialize(m, 1, &save)) stats->broadcasts.total++;
+    if (!htsmsg_get_u32(m, "id", &id) &&
+        (e = epgdb_journal_find(jn, id)) != NULL) {
+      e->used = 1;
+      if (e->m == NULL)
+        return;
+      m = e->m;
+    }
+    _epgdb_load_broadcast(m, stats);
 
   /* Global config */
   } else if ( !strcmp(*sect, "config") ) {
@@ -105,30 +380,96 @@ static memoryinfo_t epg_memoryinfo_broadcasts = {
 };
 
 /*
- * Recovery
+ * Preload, the snapshot is read and decoded to messages in the background
+ * threads (split to chunks), epg_init() only creates the broadcasts
  */
-static sigjmp_buf epg_mmap_env;
+#define EPGDB_CHUNK_RECORDS 1024
+#define EPGDB_CHUNK_AHEAD   64
+#define EPGDB_MAX_THREADS   4
+
+typedef struct epgdb_chunk {
+  const uint8_t *data;
+  size_t         len;
+  htsmsg_t     **msgs;
+  int            count;
+  int            done;      /* 1 = decoded, -1 = corrupted */
+} epgdb_chunk_t;
+
+typedef struct epgdb_preload {
+  tvh_mutex_t    lock;
+  tvh_cond_t     cond;
+  int            started;
+  int            ready;
+  int            ver;
+  char          *buf;
+  uint8_t       *zlib_mem;
+  size_t         size;
+  epgdb_chunk_t *chunks;
+  int            nchunks;
+  int            next;      /* next chunk to decode */
+  int            consumed;  /* chunks processed by epg_init */
+  int            nthreads;
+  pthread_t      tid[EPGDB_MAX_THREADS];
+} epgdb_preload_t;
+
+static epgdb_preload_t epgdb_preload;
+
+static void epgdb_preload_chunk ( epgdb_chunk_t *c )
+{
+  const uint8_t *rp = c->data;
+  size_t remain = c->len, msglen;
+  int i;
+
+  c->msgs = calloc(EPGDB_CHUNK_RECORDS, sizeof(htsmsg_t *));
+  for (i = 0; remain > 4 && i < EPGDB_CHUNK_RECORDS; i++) {
+    msglen = remain;
+    if (htsmsg_binary2_deserialize(&c->msgs[i], rp, &msglen, NULL)) {
+      c->count = i;
+      c->done = -1;
+      return;
+    }
+    rp     += msglen;
+    remain -= msglen;
+  }
+  c->count = i;
+  c->done = 1;
+}
+
+static void epgdb_preload_decode ( void )
+{
+  epgdb_preload_t *ep = &epgdb_preload;
+  epgdb_chunk_t *c;
+
+  tvh_mutex_lock(&ep->lock);
+  while (ep->next < ep->nchunks) {
+    /* limit the memory used by the decoded messages */
+    if (ep->next >= ep->consumed + EPGDB_CHUNK_AHEAD) {
+      tvh_cond_wait(&ep->cond, &ep->lock);
+      continue;
+    }
+    c = &ep->chunks[ep->next++];
+    tvh_mutex_unlock(&ep->lock);
+    epgdb_preload_chunk(c);
+    tvh_mutex_lock(&ep->lock);
+    tvh_cond_signal(&ep->cond, 1);
+  }
+  tvh_mutex_unlock(&ep->lock);
+}
 
-static void epg_mmap_sigbus (int sig, siginfo_t *siginfo, void *ptr)
+static void *epgdb_preload_worker ( void *aux )
 {
-  siglongjmp(epg_mmap_env, 1);
+  epgdb_preload_decode();
+  return NULL;
 }
 
 /*
- * Load data
+ * Read the file, split it to chunks (record boundaries)
  */
-void epg_init ( void )
+static void epgdb_preload_read ( epgdb_preload_t *ep )
 {
-  int fd = -1, r;
-  struct stat st;
-  size_t remain;
-  uint8_t *mem, *rp, *zlib_mem = NULL;
-  epggrab_stats_t stats;
-  int ver = EPG_DB_VERSION;
-  struct sigaction act, oldact;
-  char *sect = NULL;
-
-  memoryinfo_register(&epg_memoryinfo_broadcasts);
+  int fd = -1, ver = EPG_DB_VERSION, n;
+  const uint8_t *rp;
+  size_t remain, size, msglen;
 
   /* Find the right file (and version) */
   while (fd < 0 && ver > 0) {
@@ -142,38 +483,19 @@ void epg_init ( void )
     tvhdebug(LS_EPGDB, "database does not exist");
     return;
   }
+  ep->ver = ver;
 
-  memset (&act, 0, sizeof(act));
-  act.sa_sigaction = epg_mmap_sigbus;
-  act.sa_flags = SA_SIGINFO;
-  if (sigaction(SIGBUS, &act, &oldact)) {
-    tvherror(LS_EPGDB, "failed to install SIGBUS handler");
-    close(fd);
+  remain = file_readall(fd, &ep->buf);
+  close(fd);
+  if (ep->buf == NULL) {
+    tvherror(LS_EPGDB, "failed to read database");
     return;
   }
-  
-  /* Map file to memory */
-  if ( fstat(fd, &st) != 0 ) {
-    tvherror(LS_EPGDB, "failed to detect database size");
-    goto end;
-  }
-  if ( !st.st_size ) {
+  if (remain == 0) {
     tvhdebug(LS_EPGDB, "database is empty");
-    goto end;
-  }
-  remain   = st.st_size;
-  rp = mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
-  if ( mem == MAP_FAILED ) {
-    tvherror(LS_EPGDB, "failed to mmap database");
-    goto end;
-  }
-
-  if (sigsetjmp(epg_mmap_env, 1)) {
-    tvherror(LS_EPGDB, "failed to read from mapped file");
-    if (mem)
-      munmap(mem, st.st_size);
-    goto end;
+    return;
   }
+  rp = (uint8_t *)ep->buf;
 
 #if ENABLE_ZLIB
   if (remain > 12 && memcmp(rp, "\xff\xffGZIP01", 8) == 0 &&
@@ -181,50 +503,188 @@ void epg_init ( void )
     uint32_t orig = (rp[8] << 24) | (rp[9] << 16) | (rp[10] << 8) | rp[11];
     tvhinfo(LS_EPGDB, "gzip format detected, inflating (ratio %.1f%% deflated size %zd)",
            (float)((remain * 100.0) / orig), remain);
-    rp = zlib_mem = tvh_gzip_inflate(rp + 12, remain - 12, orig);
+    rp = ep->zlib_mem = tvh_gzip_inflate(rp + 12, remain - 12, orig);
     remain = rp ? orig : 0;
+    free(ep->buf);
+    ep->buf = NULL;
   }
 #endif
 
   tvhinfo(LS_EPGDB, "parsing %zd bytes", remain);
+  ep->size = remain;
 
-  /* Process */
-  memset(&stats, 0, sizeof(stats));
-  while ( remain > 4 ) {
+  size = 0;
+  while (remain > 4) {
+    if (ep->nchunks == size) {
+      size = MAX(64, size * 2);
+      ep->chunks = realloc(ep->chunks, size * sizeof(epgdb_chunk_t));
+    }
+    ep->chunks[ep->nchunks].data = rp;
+    for (n = 0; remain > 4 && n < EPGDB_CHUNK_RECORDS; n++) {
+      /* the decoder reports the error */
+      if ((msglen = htsmsg_binary2_length(rp, remain)) == 0)
+        msglen = remain;
+      rp     += msglen;
+      remain -= msglen;
+    }
+    ep->chunks[ep->nchunks].len = rp - ep->chunks[ep->nchunks].data;
+    ep->chunks[ep->nchunks].msgs = NULL;
+    ep->chunks[ep->nchunks].count = 0;
+    ep->chunks[ep->nchunks].done = 0;
+    ep->nchunks++;
+  }
+}
 
-    /* Get message length */
-    size_t msglen = remain;
-    htsmsg_t *m;
-    r = htsmsg_binary2_deserialize(&m, rp, &msglen, NULL);
+static void *epgdb_preload_thread ( void *aux )
+{
+  epgdb_preload_t *ep = &epgdb_preload;
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int i, nthreads;
 
-    /* Safety check */
-    if (r) {
-      tvherror(LS_EPGDB, "corruption detected, some/all data lost");
-      break;
-    }
+  epgdb_preload_read(ep);
 
-    /* Next */
-    rp     += msglen;
-    remain -= msglen;
+  nthreads = MAX(1, MIN(EPGDB_MAX_THREADS, MIN(cpus, ep->nchunks / 4)));
 
-    /* Skip */
-    if (!m) continue;
+  tvh_mutex_lock(&ep->lock);
+  ep->ready = 1;
+  for (i = 1; i < nthreads; i++)
+    if (!tvh_thread_create(&ep->tid[ep->nthreads], NULL,
+                           epgdb_preload_worker, NULL, "epgdb-load"))
+      ep->nthreads++;
+  tvh_cond_signal(&ep->cond, 1);
+  tvh_mutex_unlock(&ep->lock);
+
+  epgdb_preload_decode();
+  return NULL;
+}
+
+/*
+ * Start the database reading (called early in the startup)
+ */
+void epg_preload ( void )
+{
+  epgdb_preload_t *ep = &epgdb_preload;
+
+  if (ep->started)
+    return;
+  ep->started = 1;
+  tvh_mutex_init(&ep->lock, NULL);
+  tvh_cond_init(&ep->cond, 1);
+  tvh_mutex_lock(&ep->lock);
+  ep->nthreads = 1;
+  if (tvh_thread_create(&ep->tid[0], NULL, epgdb_preload_thread,
+                        NULL, "epgdb-load")) {
+    /* epg_init() decodes the chunks */
+    ep->nthreads = 0;
+    tvh_mutex_unlock(&ep->lock);
+    epgdb_preload_read(ep);
+    ep->ready = 1;
+    return;
+  }
+  tvh_mutex_unlock(&ep->lock);
+}
+
+/*
+ * Load data
+ */
+void epg_init ( void )
+{
+  epgdb_preload_t *ep = &epgdb_preload;
+  epgdb_chunk_t *c;
+  size_t i;
+  int j, k;
+  epggrab_stats_t stats;
+  char *sect = NULL;
+  epgdb_journal_t jn;
+  epgdb_jentry_t *e;
+
+  memoryinfo_register(&epg_memoryinfo_broadcasts);
+  epg_index_init();
+
+  memset(&stats, 0, sizeof(stats));
+  epgdb_journal_read(&jn);
+
+  /* Snapshot */
+  epg_preload();
+  tvh_mutex_lock(&ep->lock);
+  while (!ep->ready)
+    tvh_cond_wait(&ep->cond, &ep->lock);
+  epgdb_snapshot_size = ep->size;
+  for (j = 0; j < ep->nchunks; j++) {
+    c = &ep->chunks[j];
+    while (c->done == 0 && ep->nthreads)
+      tvh_cond_wait(&ep->cond, &ep->lock);
+    tvh_mutex_unlock(&ep->lock);
+    if (c->done == 0)
+      epgdb_preload_chunk(c);
 
     /* Process */
-    switch (ver) {
-      case 3:
-        _epgdb_v3_process(&sect, m, &stats);
-        break;
-      default:
-        break;
+    for (k = 0; k < c->count; k++) {
+      if (c->msgs[k] == NULL) continue;
+      switch (ep->ver) {
+        case 3:
+          _epgdb_v3_process(&sect, c->msgs[k], &stats, &jn);
+          break;
+        default:
+          break;
+      }
+      htsmsg_destroy(c->msgs[k]);
     }
+    free(c->msgs);
+    c->msgs = NULL;
 
-    /* Cleanup */
-    htsmsg_destroy(m);
+    tvh_mutex_lock(&ep->lock);
+    ep->consumed++;
+    tvh_cond_signal(&ep->cond, 1);
+    if (c->done < 0) {
+      tvherror(LS_EPGDB, "corruption detected, some/all data lost");
+      /* stop the decoders */
+      ep->next = ep->nchunks;
+      break;
+    }
   }
-
+  tvh_mutex_unlock(&ep->lock);
+
+  for (j = 0; j < ep->nthreads; j++)
+    pthread_join(ep->tid[j], NULL);
+  for (j = 0; j < ep->nchunks; j++) {
+    c = &ep->chunks[j];
+    for (k = 0; c->msgs && k < c->count; k++)
+      if (c->msgs[k])
+        htsmsg_destroy(c->msgs[k]);
+    free(c->msgs);
+  }
+  free(ep->chunks);
+  free(ep->zlib_mem);
+  free(ep->buf);
   free(sect);
 
+  if (ep->size) {
+    /* Stats */
+    tvhinfo(LS_EPGDB, "loaded v%d (%d threads)", ep->ver, ep->nthreads);
+    tvhinfo(LS_EPGDB, "  config     %d", stats.config.total);
+    tvhinfo(LS_EPGDB, "  broadcasts %d", stats.broadcasts.total);
+  }
+  tvh_cond_destroy(&ep->cond);
+  tvh_mutex_destroy(&ep->lock);
+  memset(ep, 0, sizeof(*ep));
+
+  /* Journal (the broadcasts not in the snapshot) */
+  if (jn.config && epg_config_deserialize(jn.config))
+    stats.config.total++;
+  for (i = 0, e = jn.entries; i < jn.count; i++, e++)
+    if (!e->used && e->m)
+      _epgdb_load_broadcast(e->m, &stats);
+  if (jn.size) {
+    tvhinfo(LS_EPGDB, "journal applied (size %zd, entries %zd)",
+            jn.valid, jn.count);
+    tvhinfo(LS_EPGDB, "  broadcasts %d", stats.broadcasts.total);
+  }
+  epgdb_journal_size = jn.valid;
+  if (jn.valid < jn.size)
+    epgdb_journal_truncate(jn.valid);
+  epgdb_journal_free(&jn);
+
   if (!stats.config.total) {
     htsmsg_t *m = htsmsg_create_map();
     /* it's not correct, but at least something */
@@ -233,18 +693,6 @@ void epg_init ( void )
       assert(0);
     htsmsg_destroy(m);
   }
-
-  /* Stats */
-  tvhinfo(LS_EPGDB, "loaded v%d", ver);
-  tvhinfo(LS_EPGDB, "  config     %d", stats.config.total);
-  tvhinfo(LS_EPGDB, "  broadcasts %d", stats.broadcasts.total);
-
-  /* Close file */
-  munmap(mem, st.st_size);
-  free(zlib_mem);
-end:
-  sigaction(SIGBUS, &oldact, NULL);
-  close(fd);
 }
 
 void epg_done ( void )
@@ -254,7 +702,11 @@ void epg_done ( void )
   tvh_mutex_lock(&global_lock);
   CHANNEL_FOREACH(ch)
     epg_channel_unlink(ch);
+  free(epgdb_removed);
+  epgdb_removed = NULL;
+  epgdb_removed_count = epgdb_removed_alloc = 0;
   epg_skel_done();
+  epg_index_done();
   memoryinfo_unregister(&epg_memoryinfo_broadcasts);
   tvh_mutex_unlock(&global_lock);
 }
@@ -293,12 +745,11 @@ static int _epg_write_sect ( sbuf_t *sb, const char *sect )
   return _epg_write(sb, m);
 }
 
-static void epg_save_tsk_callback ( void *p, int dearmed )
+static int epgdb_write_snapshot ( const uint8_t *data, size_t size )
 {
   char tmppath[PATH_MAX+4];
   char path[PATH_MAX];
-  sbuf_t *sb = p;
-  size_t size = sb->sb_ptr, orig;
+  size_t orig;
   int fd, r;
 
   tvhinfo(LS_EPGDB, "save start");
@@ -313,10 +764,10 @@ static void epg_save_tsk_callback ( void *p, int dearmed )
   if (fd >= 0) {
 #if ENABLE_ZLIB
     if (config.epg_compress) {
-      r = tvh_gzip_deflate_fd_header(fd, sb->sb_data, size, &orig, 3, "01") < 0;
+      r = tvh_gzip_deflate_fd_header(fd, data, size, &orig, 3, "01") < 0;
    } else
 #endif
-      r = tvh_write(fd, sb->sb_data, orig = size);
+      r = tvh_write(fd, data, orig = size);
     close(fd);
     if (r) {
       tvherror(LS_EPGDB, "write error (size %zd)", orig);
@@ -326,11 +777,163 @@ static void epg_save_tsk_callback ( void *p, int dearmed )
       tvhinfo(LS_EPGDB, "stored (size %zd)", orig);
       if (rename(tmppath, path))
         tvherror(LS_EPGDB, "unable to rename file %s to %s", tmppath, path);
+      else
+        return 0;
     }
   } else
     tvherror(LS_EPGDB, "unable to open epgdb file");
+  return -1;
+}
+
+static void epgdb_compact_head
+  ( sbuf_t *sb, const uint8_t *config_data, size_t config_len )
+{
+  if (config_data) {
+    _epg_write_sect(sb, "config");
+    sbuf_append(sb, config_data, config_len);
+  }
+  _epg_write_sect(sb, "broadcasts");
+}
+
+/*
+ * Merge the journal to the snapshot, the expired broadcasts are dropped
+ * (tasklet thread, only the files are used)
+ */
+static void epgdb_compact ( void )
+{
+  epgdb_journal_t jn;
+  epgdb_jentry_t *e;
+  char *buf = NULL;
+  uint8_t *zlib_mem = NULL;
+  const uint8_t *rp, *data, *config_data;
+  size_t remain = 0, msglen, config_len, i;
+  htsmsg_t *m, *b;
+  const char *s;
+  sbuf_t sb;
+  int fd, sect = EPGDB_SECT_NONE, head = 0, count = 0;
+  int64_t stop, now = gclk();
+  uint32_t id;
+
+  tvhinfo(LS_EPGDB, "compact start");
+  epgdb_journal_read(&jn);
+  config_data = jn.config_data;
+  config_len = jn.config_len;
+
+  fd = hts_settings_open_file(0, "epgdb.v%d", EPG_DB_VERSION);
+  if (fd >= 0) {
+    remain = file_readall(fd, &buf);
+    close(fd);
+    if (buf == NULL)
+      remain = 0;
+  }
+  rp = (uint8_t *)buf;
+
+#if ENABLE_ZLIB
+  if (remain > 12 && memcmp(rp, "\xff\xffGZIP01", 8) == 0 &&
+      (rp[7] == '0' || rp[7] == '1')) {
+    uint32_t orig = (rp[8] << 24) | (rp[9] << 16) | (rp[10] << 8) | rp[11];
+    rp = zlib_mem = tvh_gzip_inflate(rp + 12, remain - 12, orig);
+    remain = rp ? orig : 0;
+  }
+#endif
+
+  sbuf_init_fixed(&sb, MAX(EPG_DB_ALLOC_STEP, remain + jn.valid));
+
+  while (remain > 4) {
+    msglen = remain;
+    if (htsmsg_binary2_deserialize(&m, rp, &msglen, NULL)) {
+      tvherror(LS_EPGDB, "compact - corruption detected, some/all data lost");
+      break;
+    }
+    data = rp;
+    rp     += msglen;
+    remain -= msglen;
+    if (!m) continue;
+    if ((s = htsmsg_get_str(m, "__section__"))) {
+      if (!strcmp(s, "config"))
+        sect = EPGDB_SECT_CONFIG;
+      else if (!strcmp(s, "broadcasts"))
+        sect = EPGDB_SECT_BROADCASTS;
+      else
+        sect = EPGDB_SECT_NONE;
+    } else if (sect == EPGDB_SECT_CONFIG) {
+      if (jn.config == NULL) {
+        config_data = data;
+        config_len = msglen;
+      }
+    } else if (sect == EPGDB_SECT_BROADCASTS) {
+      b = m;
+      if (!htsmsg_get_u32(m, "id", &id) &&
+          (e = epgdb_journal_find(&jn, id)) != NULL) {
+        e->used = 1;
+        b = e->m;
+        data = e->data;
+        msglen = e->len;
+      }
+      if (b && !htsmsg_get_s64(b, "stop", &stop) && stop > now) {
+        if (!head++)
+          epgdb_compact_head(&sb, config_data, config_len);
+        sbuf_append(&sb, data, msglen);
+        count++;
+      }
+    }
+    htsmsg_destroy(m);
+  }
+  free(zlib_mem);
+  free(buf);
+
+  /* New broadcasts */
+  if (!head++)
+    epgdb_compact_head(&sb, config_data, config_len);
+  for (i = 0, e = jn.entries; i < jn.count; i++, e++) {
+    if (e->used || e->m == NULL) continue;
+    if (htsmsg_get_s64(e->m, "stop", &stop) || stop <= now) continue;
+    sbuf_append(&sb, e->data, e->len);
+    count++;
+  }
+
+  if (!epgdb_write_snapshot(sb.sb_data, sb.sb_ptr)) {
+    epgdb_journal_truncate(0);
+    epgdb_snapshot_size = sb.sb_ptr;
+    epgdb_journal_size = 0;
+    tvhinfo(LS_EPGDB, "compacted (broadcasts %d)", count);
+  }
+
+  sbuf_free(&sb);
+  epgdb_journal_free(&jn);
+}
+
+static void epgdb_journal_tsk_callback ( void *p, int dearmed )
+{
+  char path[PATH_MAX];
+  sbuf_t *sb = p;
+  int fd;
+
+  if (hts_settings_buildpath(path, sizeof(path), "epgdb.v%d.journal",
+                             EPG_DB_VERSION) ||
+      hts_settings_makedirs(path))
+    fd = -1;
+  else
+    fd = tvh_open(path, O_CREAT | O_APPEND | O_WRONLY, S_IRUSR | S_IWUSR);
+  if (fd >= 0) {
+    if (tvh_write(fd, sb->sb_data, sb->sb_ptr)) {
+      tvherror(LS_EPGDB, "journal write error (size %d)", sb->sb_ptr);
+      /* do not leave a partial batch behind */
+      close(fd);
+      epgdb_journal_truncate(epgdb_journal_size);
+    } else {
+      close(fd);
+      epgdb_journal_size += sb->sb_ptr;
+      tvhinfo(LS_EPGDB, "journal stored (size %d, total %zd)",
+              sb->sb_ptr, epgdb_journal_size);
+    }
+  } else
+    tvherror(LS_EPGDB, "unable to open epgdb journal file");
   sbuf_free(sb);
   free(sb);
+
+  if (epgdb_journal_size > epgdb_snapshot_size / 2 + EPG_DB_ALLOC_STEP)
+    epgdb_compact();
 }
 
 void epg_save_callback ( void *p )
@@ -338,48 +941,64 @@ void epg_save_callback ( void *p )
   epg_save();
 }
 
+/*
+ * Only the changed and removed broadcasts are serialized here, the snapshot
+ * is rewritten by the tasklet (epgdb_compact)
+ */
 void epg_save ( void )
 {
-  sbuf_t *sb = malloc(sizeof(*sb));
+  sbuf_t *sb;
   epg_broadcast_t *ebc;
-  channel_t *ch;
-  epggrab_stats_t stats;
+  htsmsg_t *m;
+  size_t i, removed;
+  int changed = 0, size;
   extern gtimer_t epggrab_save_timer;
 
-  if (!sb)
-    return;
-
-  tvhinfo(LS_EPGDB, "snapshot start");
-
-  sbuf_init_fixed(sb, EPG_DB_ALLOC_STEP);
+  lock_assert(&global_lock);
 
   if (epggrab_conf.epgdb_periodicsave)
     gtimer_arm_rel(&epggrab_save_timer, epg_save_callback, NULL,
                    epggrab_conf.epgdb_periodicsave * 3600);
 
-  memset(&stats, 0, sizeof(stats));
-  if ( _epg_write_sect(sb, "config") ) goto error;
-  if (_epg_write(sb, epg_config_serialize())) goto error;
-  if ( _epg_write_sect(sb, "broadcasts") ) goto error;
-  CHANNEL_FOREACH(ch) {
-    if (ch->ch_epg_parent) continue;
-    RB_FOREACH(ebc, &ch->ch_epg_schedule, sched_link) {
-      if (_epg_write(sb, epg_broadcast_serialize(ebc))) goto error;
-      stats.broadcasts.total++;
-    }
+  if (LIST_EMPTY(&epgdb_changed) && epgdb_removed_count == 0) {
+    tvhdebug(LS_EPGDB, "no changes to save");
+    return;
   }
 
-  tasklet_arm_alloc(epg_save_tsk_callback, sb);
+  if ((sb = malloc(sizeof(*sb))) == NULL)
+    return;
 
-  /* Stats */
-  tvhinfo(LS_EPGDB, "queued to save (size %d)", sb->sb_ptr);
-  tvhinfo(LS_EPGDB, "  broadcasts %d", stats.broadcasts.total);
+  tvhinfo(LS_EPGDB, "journal start");
 
-  return;
+  sbuf_init_fixed(sb, EPG_DB_ALLOC_STEP);
 
-error:
-  tvherror(LS_EPGDB, "failed to store epg to disk");
-  hts_settings_remove("epgdb.v%d", EPG_DB_VERSION);
-  sbuf_free(sb);
-  free(sb);
+  _epg_write_sect(sb, "config");
+  _epg_write(sb, epg_config_serialize());
+  _epg_write_sect(sb, "broadcasts");
+  while ((ebc = LIST_FIRST(&epgdb_changed)) != NULL) {
+    LIST_REMOVE(ebc, journal_link);
+    ebc->journal_dirty = 0;
+    if (_epg_write(sb, epg_broadcast_serialize(ebc)))
+      tvherror(LS_EPGDB, "unable to store broadcast %u", ebc->id);
+    else
+      changed++;
+  }
+  if ((removed = epgdb_removed_count) > 0) {
+    _epg_write_sect(sb, "removed");
+    for (i = 0; i < removed; i++) {
+      m = htsmsg_create_map();
+      htsmsg_add_u32(m, "id", epgdb_removed[i]);
+      _epg_write(sb, m);
+    }
+    epgdb_removed_count = 0;
+  }
+  _epg_write_sect(sb, "commit");
+  size = sb->sb_ptr;
+
+  tasklet_arm_alloc(epgdb_journal_tsk_callback, sb);
+
+  /* Stats */
+  tvhinfo(LS_EPGDB, "queued to save (size %d)", size);
+  tvhinfo(LS_EPGDB, "  broadcasts %d", changed);
+  tvhinfo(LS_EPGDB, "  removed    %zd", removed);
 }
@@ -47,9 +47,38 @@ static tvh_mutex_t     epggrab_data_mutex;
 static tvh_cond_t      epggrab_data_cond;
 int                    epggrab_running;
 
-static TAILQ_HEAD(, epggrab_module) epggrab_data_modules;
+/*
+ * Data queue lanes - the queued data for one module and source (mux)
+ */
+#define EPGGRAB_DATA_MAX_THREADS 4
+#define EPGGRAB_DATA_BATCH       16
+#define EPGGRAB_DATA_DUP_SLOTS   16384  /* must be power of two */
+#define EPGGRAB_DATA_DUP_WINDOW  sec2mono(15 * 60)
+
+typedef struct epggrab_data_lane {
+  RB_ENTRY(epggrab_data_lane)      edl_link;
+  TAILQ_ENTRY(epggrab_data_lane)   edl_ready_link;
+  epggrab_module_t                *edl_mod;
+  void                            *edl_key;
+  TAILQ_HEAD(, epggrab_queued_data) edl_queue;
+  int                              edl_busy;
+  int                              edl_ready;
+} epggrab_data_lane_t;
+
+typedef struct epggrab_data_dup {
+  uint64_t hash;
+  int64_t  mono;
+} epggrab_data_dup_t;
+
+static RB_HEAD(, epggrab_data_lane) epggrab_data_lanes;
+static TAILQ_HEAD(, epggrab_data_lane) epggrab_data_ready;
+static epggrab_data_dup_t *epggrab_data_dups;
+static pthread_t epggrab_data_tid[EPGGRAB_DATA_MAX_THREADS];
+static int epggrab_data_nthreads;
 
 static memoryinfo_t epggrab_data_memoryinfo = { .my_name = "EPG grabber data queue" };
+static uint64_t epggrab_data_dup_count;
+static uint64_t epggrab_data_dup_bytes;
 
 /* Config */
 epggrab_module_list_t  epggrab_modules;
@@ -69,10 +98,20 @@ static void _epggrab_module_grab ( epggrab_module_int_t *mod )
 {
   int64_t tm1, tm2;
   htsmsg_t *data;
+  int rd;
 
   if (!mod->enabled)
     return;
 
+  /* Incremental parse of the grabber output */
+  if (mod->stream && mod->grab == epggrab_module_grab_spawn) {
+    if ((rd = epggrab_module_spawn(mod)) >= 0) {
+      epggrab_module_stream(mod, rd);
+      close(rd);
+    }
+    return;
+  }
+
   /* Grab */
   tm1 = getfastmonoclock();
   data = mod->trans(mod, mod->grab(mod));
@@ -159,57 +198,135 @@ epggrab_rerun_internal(void)
 /*
  * Thread (for data queue processing)
  */
+static inline void _epggrab_data_free ( epggrab_queued_data_t *eq )
+{
+  memoryinfo_free(&epggrab_data_memoryinfo, sizeof(*eq) + eq->eq_len);
+  free(eq);
+}
+
+static void _epggrab_data_lane_destroy ( epggrab_data_lane_t *lane )
+{
+  epggrab_queued_data_t *eq;
+
+  while ((eq = TAILQ_FIRST(&lane->edl_queue)) != NULL) {
+    TAILQ_REMOVE(&lane->edl_queue, eq, eq_link);
+    _epggrab_data_free(eq);
+  }
+  if (lane->edl_ready)
+    TAILQ_REMOVE(&epggrab_data_ready, lane, edl_ready_link);
+  RB_REMOVE(&epggrab_data_lanes, lane, edl_link);
+  free(lane);
+}
+
 static void *_epggrab_data_thread( void *aux )
 {
   epggrab_module_t *mod;
+  epggrab_data_lane_t *lane;
   epggrab_queued_data_t *eq;
+  TAILQ_HEAD(, epggrab_queued_data) batch;
+  int i;
 
+  tvh_mutex_lock(&epggrab_data_mutex);
   while (atomic_get(&epggrab_running)) {
-    tvh_mutex_lock(&epggrab_data_mutex);
-    do {
-      eq = NULL;
-      mod = TAILQ_FIRST(&epggrab_data_modules);
-      if (mod) {
-        eq = TAILQ_FIRST(&mod->data_queue);
-        if (eq) {
-          TAILQ_REMOVE(&mod->data_queue, eq, eq_link);
-          if (TAILQ_EMPTY(&mod->data_queue))
-            TAILQ_REMOVE(&epggrab_data_modules, mod, qlink);
-        }
-      }
-      if (eq == NULL)
-        tvh_cond_wait(&epggrab_data_cond, &epggrab_data_mutex);
-    } while (eq == NULL && atomic_get(&epggrab_running));
+    lane = TAILQ_FIRST(&epggrab_data_ready);
+    if (lane == NULL) {
+      tvh_cond_wait(&epggrab_data_cond, &epggrab_data_mutex);
+      continue;
+    }
+    /* take a few chunks, the lane is owned by this thread until done */
+    TAILQ_REMOVE(&epggrab_data_ready, lane, edl_ready_link);
+    lane->edl_ready = 0;
+    lane->edl_busy = 1;
+    TAILQ_INIT(&batch);
+    for (i = 0; i < EPGGRAB_DATA_BATCH; i++) {
+      if ((eq = TAILQ_FIRST(&lane->edl_queue)) == NULL)
+        break;
+      TAILQ_REMOVE(&lane->edl_queue, eq, eq_link);
+      TAILQ_INSERT_TAIL(&batch, eq, eq_link);
+    }
+    mod = lane->edl_mod;
     tvh_mutex_unlock(&epggrab_data_mutex);
-    if (eq) {
-      mod->process_data(mod, eq->eq_data, eq->eq_len);
-      memoryinfo_free(&epggrab_data_memoryinfo, sizeof(*eq) + eq->eq_len);
-      free(eq);
+    while ((eq = TAILQ_FIRST(&batch)) != NULL) {
+      TAILQ_REMOVE(&batch, eq, eq_link);
+      if (atomic_get(&epggrab_running))
+        mod->process_data(mod, eq->eq_data, eq->eq_len);
+      _epggrab_data_free(eq);
     }
-  }
-  tvh_mutex_lock(&epggrab_data_mutex);
-  while ((mod = TAILQ_FIRST(&epggrab_data_modules)) != NULL) {
-    while ((eq = TAILQ_FIRST(&mod->data_queue)) != NULL) {
-      TAILQ_REMOVE(&mod->data_queue, eq, eq_link);
-      memoryinfo_free(&epggrab_data_memoryinfo, sizeof(*eq) + eq->eq_len);
-      free(eq);
+    tvh_mutex_lock(&epggrab_data_mutex);
+    lane->edl_busy = 0;
+    if (TAILQ_EMPTY(&lane->edl_queue)) {
+      _epggrab_data_lane_destroy(lane);
+    } else {
+      /* round robin between the lanes */
+      TAILQ_INSERT_TAIL(&epggrab_data_ready, lane, edl_ready_link);
+      lane->edl_ready = 1;
+      tvh_cond_signal(&epggrab_data_cond, 0);
     }
-    TAILQ_REMOVE(&epggrab_data_modules, mod, qlink);
   }
   tvh_mutex_unlock(&epggrab_data_mutex);
   return NULL;
 }
 
-void epggrab_queue_data(epggrab_module_t *mod,
+static int _epggrab_data_lane_cmp ( epggrab_data_lane_t *a, epggrab_data_lane_t *b )
+{
+  if (a->edl_mod != b->edl_mod)
+    return a->edl_mod < b->edl_mod ? -1 : 1;
+  if (a->edl_key != b->edl_key)
+    return a->edl_key < b->edl_key ? -1 : 1;
+  return 0;
+}
+
+/*
+ * The same sections are received repeatedly (e.g. the EIT 'other' tables
+ * are carried on all muxes of the network), skip recently queued data
+ */
+static uint64_t _epggrab_data_hash ( uint64_t h, const uint8_t *data, uint32_t len )
+{
+  while (len--) {
+    h ^= *data++;
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+static int _epggrab_data_duplicate ( uint64_t h )
+{
+  epggrab_data_dup_t *dup;
+  int64_t now = mclk();
+
+  dup = &epggrab_data_dups[h & (EPGGRAB_DATA_DUP_SLOTS - 1)];
+  if (dup->hash == h && dup->mono + EPGGRAB_DATA_DUP_WINDOW > now)
+    return 1;
+  dup->hash = h;
+  dup->mono = now;
+  return 0;
+}
+
+void epggrab_queue_data(epggrab_module_t *mod, void *key,
                         const void *data1, uint32_t len1,
-                        const void *data2, uint32_t len2)
+                        const void *data2, uint32_t len2, int dedup)
 {
+  epggrab_data_lane_t *lane, skel;
   epggrab_queued_data_t *eq;
+  uint64_t h = 0xcbf29ce484222325ULL;
   size_t len;
 
   if (!atomic_get(&epggrab_running))
     return;
   len = sizeof(*eq) + len1 + len2;
+  if (dedup) {
+    h = _epggrab_data_hash(h, (uint8_t *)&mod, sizeof(mod));
+    h = _epggrab_data_hash(h, data1, len1);
+    h = _epggrab_data_hash(h, data2, len2);
+    tvh_mutex_lock(&epggrab_data_mutex);
+    if (_epggrab_data_duplicate(h)) {
+      tvh_mutex_unlock(&epggrab_data_mutex);
+      atomic_add_u64(&epggrab_data_dup_count, 1);
+      atomic_add_u64(&epggrab_data_dup_bytes, len1 + len2);
+      return;
+    }
+    tvh_mutex_unlock(&epggrab_data_mutex);
+  }
   eq = malloc(len);
   if (eq == NULL)
     return;
@@ -220,11 +337,22 @@ void epggrab_queue_data(epggrab_module_t *mod,
     memcpy(eq->eq_data + len1, data2, len2);
   memoryinfo_alloc(&epggrab_data_memoryinfo, len);
   tvh_mutex_lock(&epggrab_data_mutex);
-  if (TAILQ_EMPTY(&mod->data_queue)) {
+  skel.edl_mod = mod;
+  skel.edl_key = key;
+  lane = RB_FIND(&epggrab_data_lanes, &skel, edl_link, _epggrab_data_lane_cmp);
+  if (lane == NULL) {
+    lane = calloc(1, sizeof(*lane));
+    lane->edl_mod = mod;
+    lane->edl_key = key;
+    TAILQ_INIT(&lane->edl_queue);
+    RB_INSERT_SORTED(&epggrab_data_lanes, lane, edl_link, _epggrab_data_lane_cmp);
+  }
+  TAILQ_INSERT_TAIL(&lane->edl_queue, eq, eq_link);
+  if (!lane->edl_busy && !lane->edl_ready) {
+    TAILQ_INSERT_TAIL(&epggrab_data_ready, lane, edl_ready_link);
+    lane->edl_ready = 1;
     tvh_cond_signal(&epggrab_data_cond, 0);
-    TAILQ_INSERT_TAIL(&epggrab_data_modules, mod, qlink);
   }
-  TAILQ_INSERT_TAIL(&mod->data_queue, eq, eq_link);
   tvh_mutex_unlock(&epggrab_data_mutex);
 }
 
@@ -496,10 +624,12 @@ int epggrab_activate_module ( epggrab_module_t *mod, int a )
  * Initialise
  */
 pthread_t      epggrab_tid;
-pthread_t      epggrab_data_tid;
 
 void epggrab_init ( void )
 {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int i;
+
   memoryinfo_register(&epggrab_data_memoryinfo);
 
   /* Defaults */
@@ -518,7 +648,9 @@ void epggrab_init ( void )
   tvh_cond_init(&epggrab_cond, 0);
   tvh_cond_init(&epggrab_data_cond, 0);
 
-  TAILQ_INIT(&epggrab_data_modules);
+  RB_INIT(&epggrab_data_lanes);
+  TAILQ_INIT(&epggrab_data_ready);
+  epggrab_data_dups = calloc(EPGGRAB_DATA_DUP_SLOTS, sizeof(*epggrab_data_dups));
 
   idclass_register(&epggrab_class);
   idclass_register(&epggrab_mod_class);
@@ -550,7 +682,9 @@ void epggrab_init ( void )
   /* Start internal and data queue grab thread */
   atomic_set(&epggrab_running, 1);
   tvh_thread_create(&epggrab_tid, NULL, _epggrab_internal_thread, NULL, "epggrabi");
-  tvh_thread_create(&epggrab_data_tid, NULL, _epggrab_data_thread, NULL, "epgdata");
+  epggrab_data_nthreads = MAX(1, MIN(EPGGRAB_DATA_MAX_THREADS, cpus));
+  for (i = 0; i < epggrab_data_nthreads; i++)
+    tvh_thread_create(&epggrab_data_tid[i], NULL, _epggrab_data_thread, NULL, "epgdata");
 }
 
 /*
@@ -559,12 +693,25 @@ void epggrab_init ( void )
 void epggrab_done ( void )
 {
   epggrab_module_t *mod;
+  epggrab_data_lane_t *lane;
+  int i;
 
   atomic_set(&epggrab_running, 0);
   tvh_cond_signal(&epggrab_cond, 0);
   tvh_cond_signal(&epggrab_data_cond, 0);
   pthread_join(epggrab_tid, NULL);
-  pthread_join(epggrab_data_tid, NULL);
+  tvh_mutex_lock(&epggrab_data_mutex);
+  tvh_cond_signal(&epggrab_data_cond, 1);
+  tvh_mutex_unlock(&epggrab_data_mutex);
+  for (i = 0; i < epggrab_data_nthreads; i++)
+    pthread_join(epggrab_data_tid[i], NULL);
+  epggrab_data_nthreads = 0;
+  tvh_mutex_lock(&epggrab_data_mutex);
+  while ((lane = RB_FIRST(&epggrab_data_lanes)) != NULL)
+    _epggrab_data_lane_destroy(lane);
+  tvh_mutex_unlock(&epggrab_data_mutex);
+  free(epggrab_data_dups);
+  epggrab_data_dups = NULL;
 
   tvh_mutex_lock(&global_lock);
   while ((mod = LIST_FIRST(&epggrab_modules)) != NULL) {
@@ -593,5 +740,8 @@ void epggrab_done ( void )
   epggrab_conf.ota_cron = NULL;
   epggrab_channel_done();
   memoryinfo_unregister(&epggrab_data_memoryinfo);
+  tvhdebug(LS_EPGGRAB, "skipped %"PRIu64" duplicate data chunks (%"PRIu64" bytes)",
+           atomic_get_u64(&epggrab_data_dup_count),
+           atomic_get_u64(&epggrab_data_dup_bytes));
   tvh_mutex_unlock(&global_lock);
 }
@@ -156,7 +156,6 @@ struct epggrab_module
 {
   idnode_t                     idnode;
   LIST_ENTRY(epggrab_module)   link;      ///< Global list link
-  TAILQ_ENTRY(epggrab_module)  qlink;     ///< Queued data link
 
   enum {
     EPGGRAB_OTA,
@@ -172,8 +171,6 @@ struct epggrab_module
   int                          priority;  ///< Priority of the module
   epggrab_channel_tree_t       channels;  ///< Channel list
 
-  TAILQ_HEAD(, epggrab_queued_data) data_queue;
-
   /* Activate */
   int       (*activate)( void *m, int activate );
 
@@ -204,6 +201,9 @@ struct epggrab_module_int
   char*     (*grab)   ( void *mod );
   htsmsg_t* (*trans)  ( void *mod, char *data );
   int       (*parse)  ( void *mod, htsmsg_t *data, epggrab_stats_t *stat );
+  /* Optional incremental parse of the data read from fd (replaces
+   * trans and parse for the spawned grabbers and the socket input) */
+  int       (*stream) ( void *mod, int fd, epggrab_stats_t *stat );
 };
 
 /*
@@ -345,10 +345,15 @@ const char * epggrab_module_get_status(epggrab_module_t *mod);
 
 /*
  * Data queue
+ *
+ * The data with the same module and lane (e.g. the EIT service) are
+ * processed in order, the different lanes are processed in parallel.
+ * With dedup set, the data equal to recently queued ones are dropped
+ * (all bytes are compared, including the struct padding).
  */
-void epggrab_queue_data(epggrab_module_t *mod,
+void epggrab_queue_data(epggrab_module_t *mod, void *lane,
                         const void *data1, uint32_t len1,
-                        const void *data2, uint32_t len2);
+                        const void *data2, uint32_t len2, int dedup);
 
 /* **************************************************************************
  * Setup/Configuration
@@ -357,7 +357,6 @@ epggrab_module_t *epggrab_module_create
   skel->name     = strdup(name);
   skel->priority = priority;
   RB_INIT(&skel->channels);
-  TAILQ_INIT(&skel->data_queue);
 
   /* Insert */
   assert(!epggrab_module_find_by_id(id));
@@ -370,39 +369,28 @@ epggrab_module_t *epggrab_module_create
 }
 
 /*
- * Run the parse
+ * Report the parse results
  */
-void epggrab_module_parse( void *m, htsmsg_t *data )
+static void epggrab_module_parse_done
+  ( epggrab_module_int_t *mod, int save, epggrab_stats_t *stats, int64_t tm )
 {
-  int64_t tm1, tm2;
-  int save = 0;
-  epggrab_stats_t stats;
-  epggrab_module_int_t *mod = m;
-
-  /* Parse */
-  memset(&stats, 0, sizeof(stats));
-  tm1 = getfastmonoclock();
-  save |= mod->parse(mod, data, &stats);
-  tm2 = getfastmonoclock();
-  htsmsg_destroy(data);
-
   /* Debug stats */
-  tvhinfo(mod->subsys, "%s: parse took %"PRId64" seconds", mod->id, mono2sec(tm2 - tm1));
+  tvhinfo(mod->subsys, "%s: parse took %"PRId64" seconds", mod->id, mono2sec(tm));
   tvhinfo(mod->subsys, "%s:  channels   tot=%5d new=%5d mod=%5d",
-          mod->id, stats.channels.total, stats.channels.created,
-          stats.channels.modified);
+          mod->id, stats->channels.total, stats->channels.created,
+          stats->channels.modified);
   tvhinfo(mod->subsys, "%s:  brands     tot=%5d new=%5d mod=%5d",
-          mod->id, stats.brands.total, stats.brands.created,
-          stats.brands.modified);
+          mod->id, stats->brands.total, stats->brands.created,
+          stats->brands.modified);
   tvhinfo(mod->subsys, "%s:  seasons    tot=%5d new=%5d mod=%5d",
-          mod->id, stats.seasons.total, stats.seasons.created,
-          stats.seasons.modified);
+          mod->id, stats->seasons.total, stats->seasons.created,
+          stats->seasons.modified);
   tvhinfo(mod->subsys, "%s:  episodes   tot=%5d new=%5d mod=%5d",
-          mod->id, stats.episodes.total, stats.episodes.created,
-          stats.episodes.modified);
+          mod->id, stats->episodes.total, stats->episodes.created,
+          stats->episodes.modified);
   tvhinfo(mod->subsys, "%s:  broadcasts tot=%5d new=%5d mod=%5d",
-          mod->id, stats.broadcasts.total, stats.broadcasts.created,
-          stats.broadcasts.modified);
+          mod->id, stats->broadcasts.total, stats->broadcasts.created,
+          stats->broadcasts.modified);
 
   /* Now we've parsed, do we need to save? */
   if (save && epggrab_conf.epgdb_saveafterimport) {
@@ -424,6 +412,48 @@ void epggrab_module_parse( void *m, htsmsg_t *data )
   }
 }
 
+/*
+ * Run the parse
+ */
+void epggrab_module_parse( void *m, htsmsg_t *data )
+{
+  int64_t tm1, tm2;
+  int save = 0;
+  epggrab_stats_t stats;
+  epggrab_module_int_t *mod = m;
+
+  /* Parse */
+  memset(&stats, 0, sizeof(stats));
+  tm1 = getfastmonoclock();
+  save |= mod->parse(mod, data, &stats);
+  tm2 = getfastmonoclock();
+  htsmsg_destroy(data);
+
+  epggrab_module_parse_done(mod, save, &stats, tm2 - tm1);
+}
+
+/*
+ * Run the incremental parse (the data are read from fd)
+ */
+void epggrab_module_stream( void *m, int fd )
+{
+  int64_t tm1, tm2;
+  int save;
+  epggrab_stats_t stats;
+  epggrab_module_int_t *mod = m;
+
+  memset(&stats, 0, sizeof(stats));
+  tm1 = getfastmonoclock();
+  save = mod->stream(mod, fd, &stats);
+  tm2 = getfastmonoclock();
+
+  if (save < 0) {
+    tvherror(mod->subsys, "%s: failed to read data", mod->id);
+    save = 0;
+  }
+  epggrab_module_parse_done(mod, save, &stats, tm2 - tm1);
+}
+
 /* **************************************************************************
  * Module channel routines
  * *************************************************************************/
@@ -493,10 +523,9 @@ epggrab_module_int_t *epggrab_module_int_create
   return skel;
 }
 
-char *epggrab_module_grab_spawn ( void *m )
+int epggrab_module_spawn ( void *m )
 {
   int        rd = -1, outlen;
-  char       *outbuf;
   epggrab_module_int_t *mod = m;
   char      **argv = NULL;
   char       *path;
@@ -517,7 +546,7 @@ char *epggrab_module_grab_spawn ( void *m )
   /* Arguments */
   if (spawn_parse_args(&argv, 64, path, NULL)) {
     tvherror(mod->subsys, "%s: unable to parse arguments", mod->id);
-    return NULL;
+    return -1;
   }
 
   /* Grab */
@@ -525,26 +554,35 @@ char *epggrab_module_grab_spawn ( void *m )
 
   spawn_free_args(argv);
 
-  if (outlen < 0)
-    goto error;
+  if (outlen < 0) {
+    if (rd >= 0)
+      close(rd);
+    tvherror(mod->subsys, "%s: no output detected", mod->id);
+    return -1;
+  }
 
-  outlen = file_readall(rd, &outbuf);
-  if (outlen < 1)
-    goto error;
+  return rd;
+}
+
+char *epggrab_module_grab_spawn ( void *m )
+{
+  int        rd, outlen;
+  char       *outbuf;
+  epggrab_module_int_t *mod = m;
+
+  if ((rd = epggrab_module_spawn(mod)) < 0)
+    return NULL;
 
+  outlen = file_readall(rd, &outbuf);
   close(rd);
+  if (outlen < 1) {
+    tvherror(mod->subsys, "%s: no output detected", mod->id);
+    return NULL;
+  }
 
   return outbuf;
-
-error:
-  if (rd >= 0)
-    close(rd);
-  tvherror(mod->subsys, "%s: no output detected", mod->id);
-  return NULL;
 }
 
-
-
 htsmsg_t *epggrab_module_trans_xml ( void *m,  char *c )
 {
   htsmsg_t *ret;
@@ -560,6 +598,47 @@ htsmsg_t *epggrab_module_trans_xml ( void *m,  char *c )
   return ret;
 }
 
+static ssize_t epggrab_module_xml_read ( void *aux, char *buf, size_t len )
+{
+#if ENABLE_ZLIB
+  return tvh_gzip_reader_read(aux, buf, len);
+#else
+  ssize_t r;
+
+  do {
+    r = read(*(int *)aux, buf, len);
+  } while (r < 0 && ERRNO_AGAIN(errno));
+  return r;
+#endif
+}
+
+/*
+ * Incremental XML parse, the data are passed to cb element by element
+ * (gzip compressed data are detected)
+ */
+int epggrab_module_stream_xml
+  ( void *m, int fd, htsmsg_xml_stream_cb_t *cb, void *aux )
+{
+  epggrab_module_t *mod = m;
+  char errbuf[100];
+  void *raux;
+  int r;
+
+#if ENABLE_ZLIB
+  raux = tvh_gzip_reader_create(fd);
+#else
+  raux = &fd;
+#endif
+  r = htsmsg_xml_deserialize_stream(epggrab_module_xml_read, raux,
+                                    cb, aux, errbuf, sizeof(errbuf));
+#if ENABLE_ZLIB
+  tvh_gzip_reader_destroy(raux);
+#endif
+  if (r < 0)
+    tvherror(mod->subsys, "%s: htsmsg_xml_deserialize error %s", mod->id, errbuf);
+  return r;
+}
+
 /* **************************************************************************
  * External module routines
  * *************************************************************************/
@@ -574,6 +653,12 @@ static void _epggrab_socket_handler ( epggrab_module_ext_t *mod, int s )
   time_t tm1, tm2;
   htsmsg_t *data = NULL;
 
+  /* Incremental parse */
+  if (mod->stream) {
+    epggrab_module_stream(mod, s);
+    return;
+  }
+
   /* Grab/Translate */
   time(&tm1);
   outlen = file_readall(s, &outbuf);
@@ -81,6 +81,7 @@ typedef struct eit_data
   tvh_uuid_t svc_uuid;
   uint16_t   onid;
   int        tableid;
+  int        version;
   int        sect;
   int        local_time;
   uint16_t   charset_len;
@@ -101,6 +102,7 @@ typedef struct eit_module_t
   eit_pattern_list_t p_scrape_subtitle;///< Scrape subtitle from summary data
   eit_pattern_list_t p_scrape_summary; ///< Scrape summary from summary data
   eit_pattern_list_t p_is_new;         ///< Is programme new to air
+  tvh_mutex_t scrape_lock;             ///< Protects the patterns (shared by data lanes)
 } eit_module_t;
 
 static TAILQ_HEAD(, eit_private) eit_private_list;
@@ -835,6 +837,7 @@ static int _eit_process_event
    * EIT has episode in title and a different one in the description
    * then we use the one from the description.
    */
+  tvh_mutex_lock(&eit_mod->scrape_lock);
   if (eit_mod->scrape_episode) {
     if (ev.title)
       _eit_scrape_episode(ev.title, eit_mod, &ev);
@@ -845,6 +848,7 @@ static int _eit_process_event
   }
 
   _eit_scrape_text(eit_mod, &ev);
+  tvh_mutex_unlock(&eit_mod->scrape_lock);
 
   if (lock)
     tvh_mutex_lock(&global_lock);
@@ -1066,7 +1070,9 @@ svc_ok:
     charset_len = charset ? strlen(charset) + 1 : 0;
     data_len = sizeof(*data) + cridauth_len + charset_len;
     data = alloca(data_len);
+    memset(data, 0, data_len); /* hashed as a whole for dedup */
     data->tableid = tableid;
+    data->version = ver;
     data->sect = sect;
     data->svc_uuid = svc->s_id.in_uuid;
     data->onid = onid;
@@ -1088,7 +1094,11 @@ svc_ok:
       _eit_process_immediate(mod, ptr, len, data);
     } else {
       /* handle those data later */
-      epggrab_queue_data(mod, data, data_len, ptr, len);
+      /* never drop the present/following sections (running state) */
+      /* keep one lane per service, the other/shared tables for a service
+         are received on several muxes and must not be reordered */
+      epggrab_queue_data(mod, svc, data, data_len, ptr, len,
+                         tableid != 0x4e);
     }
   }
 
@@ -1214,6 +1224,7 @@ static int _eit_activate(void *m, int e)
    * activated. This allows user to modify the config files and get
    * them re-read easily.
    */
+  tvh_mutex_lock(&mod->scrape_lock);
   _eit_scrape_clear(mod);
 
   mod->active = e;
@@ -1221,6 +1232,7 @@ static int _eit_activate(void *m, int e)
   if (e) {
     _eit_module_load_config(mod);
   }
+  tvh_mutex_unlock(&mod->scrape_lock);
 
   /* Return save if value has changed */
   return e != original_status;
@@ -1470,6 +1482,7 @@ void _eit_done ( void *m )
   eit_module_t *mod = m;
   eit_private_t *priv = mod->opaque;
   _eit_scrape_clear(mod);
+  tvh_mutex_destroy(&mod->scrape_lock);
   mod->opaque = NULL;
   TAILQ_REMOVE(&eit_private_list, priv, link);
   _eit_done0(priv);
@@ -1525,6 +1538,7 @@ static eit_module_t *eit_module_ota_create
     epggrab_module_ota_create(calloc(1, sizeof(eit_module_t)),
                               id, subsys, saveid, name, priority,
                               &epggrab_mod_eit_class, ops);
+  tvh_mutex_init(&mod->scrape_lock, NULL);
   return mod;
 }
 
@@ -694,7 +694,8 @@ opentv_table_callback
   if (r != 1) goto done;
 
   /* Process */
-  epggrab_queue_data((epggrab_module_t *)mod, &od, sizeof(od), buf, len);
+  epggrab_queue_data((epggrab_module_t *)mod, mt->mt_mux,
+                     &od, sizeof(od), buf, len, 1);
 
   /* End */
   r = dvb_table_end((mpegts_psi_table_t *)mt, st, sect);
@@ -1034,6 +1034,58 @@ static int _xmltv_parse
   return _xmltv_parse_tv(mod, tv, stats);
 }
 
+/**
+ * Incremental parse, the top level elements are processed one by one
+ */
+typedef struct xmltv_stream {
+  epggrab_module_t *mod;
+  epggrab_stats_t  *stats;
+  int               scan;
+  int               save;
+} xmltv_stream_t;
+
+static int _xmltv_stream_element
+  ( void *aux, const char *root, const char *name, htsmsg_t *body )
+{
+  xmltv_stream_t *xs = aux;
+  int save = 0;
+
+  if (strcmp(root, "tv"))
+    return -1;
+
+  tvh_mutex_lock(&global_lock);
+  if (!xs->scan) {
+    epggrab_channel_begin_scan(xs->mod);
+    xs->scan = 1;
+  }
+  if (!strcmp(name, "channel")) {
+    save = _xmltv_parse_channel(xs->mod, body, xs->stats);
+  } else if (!strcmp(name, "programme")) {
+    save = _xmltv_parse_programme(xs->mod, body, xs->stats);
+    if (save) epg_updated();
+  }
+  tvh_mutex_unlock(&global_lock);
+  xs->save |= save;
+  return 0;
+}
+
+static int _xmltv_stream
+  ( void *mod, int fd, epggrab_stats_t *stats )
+{
+  xmltv_stream_t xs = { .mod = mod, .stats = stats };
+  int r;
+
+  r = epggrab_module_stream_xml(mod, fd, _xmltv_stream_element, &xs);
+
+  if (xs.scan) {
+    tvh_mutex_lock(&global_lock);
+    epggrab_channel_end_scan(mod);
+    tvh_mutex_unlock(&global_lock);
+  }
+
+  return r < 0 && !xs.save ? -1 : xs.save;
+}
+
 /* ************************************************************************
  * Module Setup
  * ***********************************************************************/
@@ -1194,10 +1246,12 @@ static void _xmltv_load_grabbers ( void )
       if ( outbuf[i] == '\n' || outbuf[i] == '\0' ) {
         outbuf[i] = '\0';
         sprintf(name, "XMLTV: %s", &outbuf[n]);
-        epggrab_module_int_create(NULL, &epggrab_mod_int_xmltv_class,
-                                  &outbuf[p], LS_XMLTV, "xmltv",
-                                  name, 3, &outbuf[p],
-                                  NULL, _xmltv_parse, NULL);
+        mod = (epggrab_module_t *)
+          epggrab_module_int_create(NULL, &epggrab_mod_int_xmltv_class,
+                                    &outbuf[p], LS_XMLTV, "xmltv",
+                                    name, 3, &outbuf[p],
+                                    NULL, _xmltv_parse, NULL);
+        ((epggrab_module_int_t *)mod)->stream = _xmltv_stream;
         p = n = i + 1;
       } else if ( outbuf[i] == '\\') {
         memmove(outbuf, outbuf + 1, strlen(outbuf));
@@ -1246,9 +1300,11 @@ static void _xmltv_load_grabbers ( void )
               free((void *)mod->name);
               mod->name = strdup(outbuf);
             } else {
-              epggrab_module_int_create(NULL, &epggrab_mod_int_xmltv_class,
-                                        bin, LS_XMLTV, "xmltv", name, 3, bin,
-                                        NULL, _xmltv_parse, NULL);
+              mod = (epggrab_module_t *)
+                epggrab_module_int_create(NULL, &epggrab_mod_int_xmltv_class,
+                                          bin, LS_XMLTV, "xmltv", name, 3, bin,
+                                          NULL, _xmltv_parse, NULL);
+              ((epggrab_module_int_t *)mod)->stream = _xmltv_stream;
             }
             free(outbuf);
           } else {
@@ -1266,10 +1322,13 @@ static void _xmltv_load_grabbers ( void )
 
 void xmltv_init ( void )
 {
+  epggrab_module_ext_t *mod;
+
   /* External module */
-  epggrab_module_ext_create(NULL, &epggrab_mod_ext_xmltv_class,
-                            "xmltv", LS_XMLTV, "xmltv", "XMLTV", 3, "xmltv",
-                            _xmltv_parse, NULL);
+  mod = epggrab_module_ext_create(NULL, &epggrab_mod_ext_xmltv_class,
+                                  "xmltv", LS_XMLTV, "xmltv", "XMLTV", 3,
+                                  "xmltv", _xmltv_parse, NULL);
+  mod->stream = _xmltv_stream;
 
   /* Standard modules */
   _xmltv_load_grabbers();
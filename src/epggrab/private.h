@@ -19,6 +19,8 @@
 #ifndef __EPGGRAB_PRIVATE_H__
 #define __EPGGRAB_PRIVATE_H__
 
+#include "htsmsg_xml.h"
+
 struct mpegts_mux;
 
 /* **************************************************************************
@@ -30,8 +32,11 @@ epggrab_module_t *epggrab_module_create
     const char *id, int subsys, const char *saveid,
     const char *name, int priority );
 
+int       epggrab_module_spawn      ( void *m );
 char     *epggrab_module_grab_spawn ( void *m );
 htsmsg_t *epggrab_module_trans_xml  ( void *m, char *data );
+int       epggrab_module_stream_xml
+  ( void *m, int fd, htsmsg_xml_stream_cb_t *cb, void *aux );
 
 void      epggrab_module_ch_add  ( void *m, struct channel *ch );
 void      epggrab_module_ch_rem  ( void *m, struct channel *ch );
@@ -39,6 +44,7 @@ void      epggrab_module_ch_mod  ( void *m, struct channel *ch );
 void      epggrab_module_ch_save ( void *m, epggrab_channel_t *ec );
 
 void      epggrab_module_parse ( void *m, htsmsg_t *data );
+void      epggrab_module_stream ( void *m, int fd );
 
 void      epggrab_module_channels_load ( const char *modid );
 
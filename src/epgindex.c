@@ -0,0 +1,836 @@
+/*
+ *  Electronic Program Guide - Query index
+ *  Copyright (C) 2026 Tvheadend Foundation CIC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The index returns only candidates (a superset of the matching broadcasts),
+ * epg_query() applies the full filter to them:
+ *
+ * - text: hashed trigrams (ASCII, lower case) of the title and of the other
+ *   text fields, used for the title / fulltext regex search
+ * - genre: the genre codes (the minor codes are also stored as major)
+ * - time: start time in hour buckets
+ *
+ * The posting lists store the broadcast IDs (delta + varint encoded).
+ * Entries are never removed, changed or destroyed broadcasts leave stale
+ * entries behind and the whole index is rebuilt when there are too many.
+ */
+
+#include <ctype.h>
+
+#include "tvheadend.h"
+#include "channels.h"
+#include "epg.h"
+#include "memoryinfo.h"
+
+#define EPG_INDEX_TEXT_BITS   16
+#define EPG_INDEX_TEXT_SIZE   (1 << EPG_INDEX_TEXT_BITS)
+#define EPG_INDEX_TIME_SIZE   4096  /* hour buckets (~170 days) */
+#define EPG_INDEX_GENRE_SIZE  256
+
+typedef struct epg_index_list {
+  uint8_t  *data;
+  uint32_t  len;
+  uint32_t  size;
+  uint32_t  last;   /* last ID (delta encoding) */
+  uint32_t  count;  /* number of entries */
+} epg_index_list_t;
+
+typedef struct epg_index_vec {
+  uint32_t *v;
+  uint32_t  count;
+  uint32_t  size;
+} epg_index_vec_t;
+
+static epg_index_list_t *epg_index_title;
+static epg_index_list_t *epg_index_text;
+static epg_index_list_t *epg_index_genre;
+static epg_index_list_t *epg_index_time;
+
+static int64_t  epg_index_hour_min;
+static int64_t  epg_index_hour_max;
+static time_t   epg_index_max_duration;
+static uint32_t epg_index_broadcasts;
+static uint64_t epg_index_entries;
+static uint64_t epg_index_stale;
+static int64_t  epg_index_bytes;
+
+/* **************************************************************************
+ * Lists and vectors
+ * *************************************************************************/
+
+static void
+epg_index_list_add ( epg_index_list_t *l, uint32_t id )
+{
+  int32_t d = (int32_t)(id - l->last);
+  uint32_t z = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+  uint32_t size;
+
+  if (l->len + 5 > l->size) {
+    size = MAX(16, l->size + l->size / 2);
+    l->data = realloc(l->data, size);
+    epg_index_bytes += size - l->size;
+    l->size = size;
+  }
+  do {
+    l->data[l->len++] = (z & 0x7f) | (z > 0x7f ? 0x80 : 0);
+    z >>= 7;
+  } while (z);
+  l->last = id;
+  l->count++;
+}
+
+static void
+epg_index_list_free ( epg_index_list_t *l )
+{
+  epg_index_bytes -= l->size;
+  free(l->data);
+  memset(l, 0, sizeof(*l));
+}
+
+static void
+epg_index_vec_add ( epg_index_vec_t *v, uint32_t x )
+{
+  if (v->count == v->size) {
+    v->size = MAX(64, v->size * 2);
+    v->v = realloc(v->v, v->size * sizeof(uint32_t));
+  }
+  v->v[v->count++] = x;
+}
+
+static void
+epg_index_list_decode ( epg_index_list_t *l, epg_index_vec_t *v )
+{
+  const uint8_t *p = l->data, *end = p + l->len;
+  uint32_t id = 0, z;
+  int shift;
+
+  while (p < end) {
+    z = shift = 0;
+    do {
+      z |= (uint32_t)(*p & 0x7f) << shift;
+      shift += 7;
+    } while (*p++ & 0x80);
+    id += (z >> 1) ^ -(z & 1);
+    epg_index_vec_add(v, id);
+  }
+}
+
+static int
+epg_index_u32_cmp ( const void *a, const void *b )
+{
+  uint32_t x = *(uint32_t *)a, y = *(uint32_t *)b;
+  return x < y ? -1 : (x > y);
+}
+
+static void
+epg_index_vec_uniq ( epg_index_vec_t *v )
+{
+  uint32_t i, j;
+
+  if (v->count < 2)
+    return;
+  qsort(v->v, v->count, sizeof(uint32_t), epg_index_u32_cmp);
+  for (i = j = 1; i < v->count; i++)
+    if (v->v[i] != v->v[j-1])
+      v->v[j++] = v->v[i];
+  v->count = j;
+}
+
+/* both vectors must be sorted, the result is stored to a */
+static void
+epg_index_vec_intersect ( epg_index_vec_t *a, epg_index_vec_t *b )
+{
+  uint32_t i = 0, j = 0, k = 0;
+
+  while (i < a->count && j < b->count) {
+    if (a->v[i] < b->v[j]) {
+      i++;
+    } else if (a->v[i] > b->v[j]) {
+      j++;
+    } else {
+      a->v[k++] = a->v[i++];
+      j++;
+    }
+  }
+  a->count = k;
+}
+
+/* **************************************************************************
+ * Keys
+ * *************************************************************************/
+
+static inline uint32_t
+epg_index_trigram_hash ( uint32_t t )
+{
+  return (t * 2654435761U) >> (32 - EPG_INDEX_TEXT_BITS);
+}
+
+/*
+ * Add the trigram hashes of the string. Only ASCII characters are used,
+ * they are folded to lower case like the caseless regex matching does
+ * (including the Kelvin and long s signs which match 'k' and 's').
+ */
+static void
+epg_index_trigrams ( epg_index_vec_t *v, const char *s, size_t len )
+{
+  const uint8_t *p = (const uint8_t *)s, *end = p + len;
+  uint32_t t = 0;
+  uint8_t c;
+  int n = 0;
+
+  while (p < end) {
+    c = *p++;
+    if (c >= 0x80) {
+      if (c == 0xe2 && end - p >= 2 && p[0] == 0x84 && p[1] == 0xaa) {
+        c = 'k'; p += 2;
+      } else if (c == 0xc5 && end - p >= 1 && p[0] == 0xbf) {
+        c = 's'; p++;
+      } else {
+        n = 0;
+        continue;
+      }
+    } else if (c >= 'A' && c <= 'Z') {
+      c += 'a' - 'A';
+    }
+    t = (t << 8) | c;
+    if (++n >= 3)
+      epg_index_vec_add(v, epg_index_trigram_hash(t & 0xffffff));
+  }
+}
+
+static void
+epg_index_lang_str ( epg_index_vec_t *v, lang_str_t *ls )
+{
+  lang_str_ele_t *e;
+
+  if (ls)
+    RB_FOREACH(e, ls, link)
+      epg_index_trigrams(v, e->str, strlen(e->str));
+}
+
+static inline int64_t
+epg_index_hour ( time_t t )
+{
+  return t >= 0 ? t / 3600 : -((-t + 3599) / 3600);
+}
+
+static inline epg_index_list_t *
+epg_index_time_list ( int64_t hour )
+{
+  return &epg_index_time[hour & (EPG_INDEX_TIME_SIZE - 1)];
+}
+
+/* **************************************************************************
+ * Regex literals
+ * *************************************************************************/
+
+static const char *
+epg_index_re_skip_class ( const char *p )
+{
+  /* p points after '[' */
+  if (*p == '^') p++;
+  if (*p == ']') p++;
+  while (*p && *p != ']') {
+    if (*p == '\\' && p[1]) {
+      p += 2;
+    } else if (*p == '[' && p[1] == ':') {
+      p = strstr(p + 2, ":]");
+      if (p == NULL) return NULL;
+      p += 2;
+    } else {
+      p++;
+    }
+  }
+  return *p ? p + 1 : NULL;
+}
+
+static const char *
+epg_index_re_skip_group ( const char *p )
+{
+  int depth = 1;
+
+  /* p points after '(' */
+  while (*p && depth > 0) {
+    if (*p == '\\') {
+      if (!p[1]) return NULL;
+      p += 2;
+    } else if (*p == '[') {
+      if ((p = epg_index_re_skip_class(p + 1)) == NULL) return NULL;
+    } else {
+      if (*p == '(') depth++;
+      else if (*p == ')') depth--;
+      p++;
+    }
+  }
+  return depth ? NULL : p;
+}
+
+static const char *
+epg_index_re_skip_quantifier ( const char *p )
+{
+  if (*p == '?' || *p == '*' || *p == '+') {
+    p++;
+  } else if (*p == '{') {
+    if ((p = strchr(p, '}')) == NULL) return NULL;
+    p++;
+  } else {
+    return p;
+  }
+  /* lazy or possessive */
+  if (*p == '?' || *p == '+') p++;
+  return p;
+}
+
+/*
+ * Collect the trigrams of the literal runs which must be present
+ * in any matching string. Returns -1 when the expression is not
+ * understood (the index cannot be used).
+ */
+static int
+epg_index_regex_trigrams ( const char *re, epg_index_vec_t *v )
+{
+  char run[256];
+  const char *p = re, *q;
+  size_t len = 0, last = 0, l;
+
+  if (strstr(re, "(?") || strstr(re, "(*"))
+    return -1; /* inline options may change the syntax */
+
+#define RUN_FLUSH() do { \
+  epg_index_trigrams(v, run, len); len = last = 0; \
+} while (0)
+
+  while (*p) {
+    switch (*p) {
+    case '|':
+      return -1;
+    case '(':
+      RUN_FLUSH();
+      if ((p = epg_index_re_skip_group(p + 1)) == NULL) return -1;
+      if ((p = epg_index_re_skip_quantifier(p)) == NULL) return -1;
+      continue;
+    case '[':
+      RUN_FLUSH();
+      if ((p = epg_index_re_skip_class(p + 1)) == NULL) return -1;
+      if ((p = epg_index_re_skip_quantifier(p)) == NULL) return -1;
+      continue;
+    case '.':
+    case '^':
+    case '$':
+      RUN_FLUSH();
+      if ((p = epg_index_re_skip_quantifier(p + 1)) == NULL) return -1;
+      continue;
+    case '?':
+    case '*':
+    case '{':
+      /* the previous character is optional */
+      len = last;
+      RUN_FLUSH();
+      if ((p = epg_index_re_skip_quantifier(p)) == NULL) return -1;
+      continue;
+    case '+':
+      RUN_FLUSH();
+      if ((p = epg_index_re_skip_quantifier(p)) == NULL) return -1;
+      continue;
+    case '\\':
+      if (p[1] == '\0')
+        return -1;
+      if (isalnum((uint8_t)p[1])) {
+        /* only the escapes without arguments are known */
+        if (strchr("bBdDsSwWhHvVRXAzZG", p[1]) == NULL)
+          return -1;
+        RUN_FLUSH();
+        if ((p = epg_index_re_skip_quantifier(p + 2)) == NULL) return -1;
+        continue;
+      }
+      p++;
+      l = 1;
+      break;
+    default:
+      /* whole UTF-8 character */
+      for (q = p + 1; ((uint8_t)*q & 0xc0) == 0x80; q++);
+      l = q - p;
+      break;
+    }
+    if (len + l > sizeof(run))
+      RUN_FLUSH();
+    last = len;
+    memcpy(run + len, p, l);
+    len += l;
+    p += l;
+  }
+  RUN_FLUSH();
+#undef RUN_FLUSH
+  return 0;
+}
+
+/* **************************************************************************
+ * Update
+ * *************************************************************************/
+
+static void
+epg_index_alloc ( void )
+{
+  if (epg_index_title)
+    return;
+  epg_index_title = calloc(EPG_INDEX_TEXT_SIZE, sizeof(epg_index_list_t));
+  epg_index_text  = calloc(EPG_INDEX_TEXT_SIZE, sizeof(epg_index_list_t));
+  epg_index_genre = calloc(EPG_INDEX_GENRE_SIZE, sizeof(epg_index_list_t));
+  epg_index_time  = calloc(EPG_INDEX_TIME_SIZE, sizeof(epg_index_list_t));
+  epg_index_hour_min = INT64_MAX;
+  epg_index_hour_max = INT64_MIN;
+}
+
+static uint32_t
+epg_index_vec_hash ( uint32_t h, epg_index_vec_t *v )
+{
+  uint32_t i;
+
+  h = (h ^ v->count) * 16777619U;
+  for (i = 0; i < v->count; i++)
+    h = (h ^ v->v[i]) * 16777619U;
+  return h;
+}
+
+void
+epg_index_update ( epg_broadcast_t *ebc )
+{
+  static epg_index_vec_t title, text, genre;
+  epg_genre_t *g;
+  int64_t hour;
+  uint32_t i, h;
+
+  lock_assert(&global_lock);
+
+  if (ebc->channel == NULL) {
+    epg_index_remove(ebc);
+    return;
+  }
+
+  epg_index_alloc();
+
+  title.count = text.count = genre.count = 0;
+  epg_index_lang_str(&title, ebc->title);
+  epg_index_lang_str(&text, ebc->subtitle);
+  epg_index_lang_str(&text, ebc->summary);
+  epg_index_lang_str(&text, ebc->description);
+  epg_index_lang_str(&text, ebc->credits_cached);
+  epg_index_lang_str(&text, ebc->keyword_cached);
+  LIST_FOREACH(g, &ebc->genre, link) {
+    epg_index_vec_add(&genre, g->code);
+    if (g->code & 0x0f)
+      epg_index_vec_add(&genre, g->code & 0xf0);
+  }
+  epg_index_vec_uniq(&title);
+  epg_index_vec_uniq(&text);
+  epg_index_vec_uniq(&genre);
+  hour = epg_index_hour(ebc->start);
+
+  h = epg_index_vec_hash(2166136261U, &title);
+  h = epg_index_vec_hash(h, &text);
+  h = epg_index_vec_hash(h, &genre);
+  h = (h ^ (uint32_t)hour) * 16777619U;
+  h = (h ^ (uint32_t)(ebc->stop - ebc->start)) * 16777619U;
+
+  if (ebc->index_cnt) {
+    if (ebc->index_hash == h)
+      return;
+    epg_index_remove(ebc);
+  }
+
+  for (i = 0; i < title.count; i++)
+    epg_index_list_add(&epg_index_title[title.v[i]], ebc->id);
+  for (i = 0; i < text.count; i++)
+    epg_index_list_add(&epg_index_text[text.v[i]], ebc->id);
+  for (i = 0; i < genre.count; i++)
+    epg_index_list_add(&epg_index_genre[genre.v[i]], ebc->id);
+  epg_index_list_add(epg_index_time_list(hour), ebc->id);
+
+  ebc->index_hash = h;
+  ebc->index_cnt  = title.count + text.count + genre.count + 1;
+  epg_index_entries += ebc->index_cnt;
+  epg_index_broadcasts++;
+
+  if (hour < epg_index_hour_min) epg_index_hour_min = hour;
+  if (hour > epg_index_hour_max) epg_index_hour_max = hour;
+  if (ebc->stop - ebc->start > epg_index_max_duration)
+    epg_index_max_duration = ebc->stop - ebc->start;
+}
+
+void
+epg_index_remove ( epg_broadcast_t *ebc )
+{
+  if (ebc->index_cnt == 0)
+    return;
+  epg_index_stale += ebc->index_cnt;
+  epg_index_broadcasts--;
+  ebc->index_cnt = 0;
+}
+
+static void
+epg_index_clear ( void )
+{
+  int i;
+
+  if (epg_index_title == NULL)
+    return;
+  for (i = 0; i < EPG_INDEX_TEXT_SIZE; i++) {
+    epg_index_list_free(&epg_index_title[i]);
+    epg_index_list_free(&epg_index_text[i]);
+  }
+  for (i = 0; i < EPG_INDEX_GENRE_SIZE; i++)
+    epg_index_list_free(&epg_index_genre[i]);
+  for (i = 0; i < EPG_INDEX_TIME_SIZE; i++)
+    epg_index_list_free(&epg_index_time[i]);
+  epg_index_hour_min = INT64_MAX;
+  epg_index_hour_max = INT64_MIN;
+  epg_index_max_duration = 0;
+  epg_index_broadcasts = 0;
+  epg_index_entries = 0;
+  epg_index_stale = 0;
+}
+
+void
+epg_index_check ( void )
+{
+  channel_t *ch;
+  epg_broadcast_t *ebc;
+  int64_t mono;
+
+  lock_assert(&global_lock);
+
+  if (epg_index_stale < 65536 || epg_index_stale < epg_index_entries / 2)
+    return;
+
+  mono = getmonoclock();
+  epg_index_clear();
+  CHANNEL_FOREACH(ch)
+    RB_FOREACH(ebc, &ch->ch_epg_schedule, sched_link) {
+      ebc->index_cnt = 0;
+      epg_index_update(ebc);
+    }
+  tvhdebug(LS_EPG, "query index rebuilt (%u broadcasts, %"PRIu64" entries, %"PRId64"ms)",
+           epg_index_broadcasts, epg_index_entries,
+           mono2ms(getmonoclock() - mono));
+}
+
+/* **************************************************************************
+ * Query
+ * *************************************************************************/
+
+typedef struct epg_index_source {
+  epg_index_list_t *list[2];
+  int               time;
+  int64_t           hour_lo;
+  int64_t           hour_hi;
+  uint64_t          estimate;
+} epg_index_source_t;
+
+static void
+epg_index_source_decode ( epg_index_source_t *s, epg_index_vec_t *v )
+{
+  int64_t hour;
+
+  v->count = 0;
+  if (s->time) {
+    for (hour = s->hour_lo; hour <= s->hour_hi; hour++)
+      epg_index_list_decode(epg_index_time_list(hour), v);
+  } else {
+    if (s->list[0]) epg_index_list_decode(s->list[0], v);
+    if (s->list[1]) epg_index_list_decode(s->list[1], v);
+  }
+  epg_index_vec_uniq(v);
+}
+
+static int
+epg_index_source_cmp ( const void *a, const void *b )
+{
+  const epg_index_source_t *x = a, *y = b;
+  return x->estimate < y->estimate ? -1 : (x->estimate > y->estimate);
+}
+
+static int
+epg_index_regex_sources
+  ( const char *re, int fulltext, epg_index_source_t *src, int max )
+{
+  static epg_index_vec_t tri;
+  epg_index_source_t *s;
+  uint32_t i;
+  int nsrc = 0;
+
+  tri.count = 0;
+  if (epg_index_regex_trigrams(re, &tri))
+    return 0;
+  epg_index_vec_uniq(&tri);
+  for (i = 0; i < tri.count && nsrc < max; i++) {
+    s = &src[nsrc++];
+    memset(s, 0, sizeof(*s));
+    s->list[0] = &epg_index_title[tri.v[i]];
+    if (fulltext)
+      s->list[1] = &epg_index_text[tri.v[i]];
+    s->estimate = s->list[0]->count + (s->list[1] ? s->list[1]->count : 0);
+  }
+  return nsrc;
+}
+
+/* the sources must be sorted by the estimate */
+static void
+epg_index_sources_run
+  ( epg_index_source_t *src, int nsrc, uint32_t **ids, uint32_t *count )
+{
+  static epg_index_vec_t tmp;
+  epg_index_vec_t res = { NULL, 0, 0 };
+  int i;
+
+  epg_index_source_decode(&src[0], &res);
+  for (i = 1; i < nsrc && res.count > 32; i++) {
+    if (src[i].estimate > 2 * (uint64_t)res.count)
+      break;
+    epg_index_source_decode(&src[i], &tmp);
+    epg_index_vec_intersect(&res, &tmp);
+  }
+
+  *ids = res.v;
+  *count = res.count;
+}
+
+static void
+epg_index_time_bounds ( epg_filter_num_t *f, int64_t *lo, int64_t *hi, int64_t margin )
+{
+  switch (f->comp) {
+  case EC_EQ:
+    *lo = MAX(*lo, f->val1 - margin);
+    *hi = MIN(*hi, f->val1);
+    break;
+  case EC_LT:
+    *hi = MIN(*hi, f->val1);
+    break;
+  case EC_GT:
+    *lo = MAX(*lo, f->val1 - margin);
+    break;
+  case EC_RG:
+    *lo = MAX(*lo, f->val1 - margin);
+    *hi = MIN(*hi, f->val2);
+    break;
+  default:
+    break;
+  }
+}
+
+/*
+ * Return the sorted IDs of the candidate broadcasts for the query.
+ * Returns -1 when the index would not help (all broadcasts should
+ * be checked).
+ */
+int
+epg_index_query ( epg_query_t *eq, uint32_t **ids, uint32_t *count )
+{
+  epg_index_source_t src[32], *s;
+  int64_t lo, hi, hour;
+  uint64_t est;
+  uint32_t i, j;
+  int nsrc = 0;
+
+  lock_assert(&global_lock);
+
+  if (epg_index_title == NULL || epg_index_broadcasts == 0)
+    return -1;
+
+  /* text */
+  if (eq->stitle)
+    nsrc = epg_index_regex_sources(eq->stitle, eq->fulltext,
+                                   src, ARRAY_SIZE(src) - 2);
+
+  /* genre */
+  if (eq->genre_count) {
+    s = &src[nsrc];
+    memset(s, 0, sizeof(*s));
+    est = 0;
+    for (i = j = 0; i < eq->genre_count; i++) {
+      if (eq->genre[i] == 0) continue;
+      est += epg_index_genre[eq->genre[i]].count;
+      j++;
+    }
+    /* more than two genres are rare, no candidates are taken from them */
+    if (j > 0 && j <= ARRAY_SIZE(s->list)) {
+      for (i = j = 0; i < eq->genre_count; i++)
+        if (eq->genre[i])
+          s->list[j++] = &epg_index_genre[eq->genre[i]];
+      s->estimate = est;
+      nsrc++;
+    } else if (j == 0) {
+      /* nothing can match */
+      *ids = NULL;
+      *count = 0;
+      return 0;
+    }
+  }
+
+  /* start time */
+  lo = gclk() - epg_index_max_duration;
+  hi = INT64_MAX;
+  epg_index_time_bounds(&eq->start, &lo, &hi, 0);
+  if (eq->stop.comp == EC_GT || eq->stop.comp == EC_RG || eq->stop.comp == EC_EQ) {
+    int64_t lo2 = INT64_MIN, hi2 = INT64_MAX;
+    epg_index_time_bounds(&eq->stop, &lo2, &hi2, epg_index_max_duration);
+    lo = MAX(lo, lo2);
+  }
+  lo = MAX(epg_index_hour(lo), epg_index_hour_min);
+  hi = hi == INT64_MAX ? epg_index_hour_max :
+                         MIN(epg_index_hour(hi), epg_index_hour_max);
+  if (hi < lo) {
+    *ids = NULL;
+    *count = 0;
+    return 0;
+  }
+  if (hi - lo < EPG_INDEX_TIME_SIZE) {
+    s = &src[nsrc++];
+    memset(s, 0, sizeof(*s));
+    s->time = 1;
+    s->hour_lo = lo;
+    s->hour_hi = hi;
+    for (hour = lo; hour <= hi; hour++)
+      s->estimate += epg_index_time_list(hour)->count;
+  }
+
+  if (nsrc == 0)
+    return -1;
+
+  qsort(src, nsrc, sizeof(src[0]), epg_index_source_cmp);
+
+  /* not selective, a full scan is cheaper (the ID lookups cost more) */
+  if (src[0].estimate >= epg_index_broadcasts / 4)
+    return -1;
+
+  epg_index_sources_run(src, nsrc, ids, count);
+  return 0;
+}
+
+/*
+ * Return the sorted IDs of the broadcasts which may match the title
+ * (or fulltext) regex. Returns -1 when the expression cannot be used.
+ */
+int
+epg_index_regex ( const char *re, int fulltext, uint32_t **ids, uint32_t *count )
+{
+  epg_index_source_t src[32];
+  int nsrc;
+
+  lock_assert(&global_lock);
+
+  if (epg_index_title == NULL)
+    return -1;
+  nsrc = epg_index_regex_sources(re, fulltext, src, ARRAY_SIZE(src));
+  if (nsrc == 0)
+    return -1;
+  qsort(src, nsrc, sizeof(src[0]), epg_index_source_cmp);
+  epg_index_sources_run(src, nsrc, ids, count);
+  return 0;
+}
+
+/*
+ * Pick the least frequent trigram which must be present in a title
+ * (or fulltext) matching the regex. Returns -1 when there is none.
+ */
+int
+epg_index_regex_key ( const char *re, int fulltext, uint32_t *key )
+{
+  epg_index_source_t src[32];
+  int i, nsrc;
+
+  lock_assert(&global_lock);
+
+  epg_index_alloc();
+  nsrc = epg_index_regex_sources(re, fulltext, src, ARRAY_SIZE(src));
+  if (nsrc == 0)
+    return -1;
+  for (i = 1; i < nsrc; i++)
+    if (src[i].estimate < src[0].estimate)
+      src[0] = src[i];
+  *key = src[0].list[0] - epg_index_title;
+  return 0;
+}
+
+/*
+ * The sorted trigram keys of the title (text == 0) or of the other
+ * text fields (text != 0). The array is valid until the next call.
+ */
+const uint32_t *
+epg_index_broadcast_keys ( epg_broadcast_t *ebc, int text, uint32_t *count )
+{
+  static epg_index_vec_t title, other;
+  epg_index_vec_t *v = text ? &other : &title;
+
+  v->count = 0;
+  if (text) {
+    epg_index_lang_str(v, ebc->subtitle);
+    epg_index_lang_str(v, ebc->summary);
+    epg_index_lang_str(v, ebc->description);
+    epg_index_lang_str(v, ebc->credits_cached);
+    epg_index_lang_str(v, ebc->keyword_cached);
+  } else {
+    epg_index_lang_str(v, ebc->title);
+  }
+  epg_index_vec_uniq(v);
+  *count = v->count;
+  return v->v;
+}
+
+uint32_t
+epg_index_count ( void )
+{
+  return epg_index_broadcasts;
+}
+
+/* **************************************************************************
+ * Setup
+ * *************************************************************************/
+
+static void epg_memoryinfo_index_update(memoryinfo_t *my)
+{
+  int64_t size = epg_index_bytes;
+
+  if (epg_index_title)
+    size += (2 * EPG_INDEX_TEXT_SIZE + EPG_INDEX_GENRE_SIZE +
+             EPG_INDEX_TIME_SIZE) * sizeof(epg_index_list_t);
+  memoryinfo_update(my, size, epg_index_entries);
+}
+
+static memoryinfo_t epg_memoryinfo_index = {
+  .my_name = "EPG Query Index",
+  .my_update = epg_memoryinfo_index_update
+};
+
+void
+epg_index_init ( void )
+{
+  memoryinfo_register(&epg_memoryinfo_index);
+}
+
+void
+epg_index_done ( void )
+{
+  memoryinfo_unregister(&epg_memoryinfo_index);
+  epg_index_clear();
+  free(epg_index_title);
+  free(epg_index_text);
+  free(epg_index_genre);
+  free(epg_index_time);
+  epg_index_title = epg_index_text = NULL;
+  epg_index_genre = epg_index_time = NULL;
+}
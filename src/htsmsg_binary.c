@@ -257,11 +257,56 @@ htsmsg_binary_count(htsmsg_t *msg)
   return len;
 }
 
+/*
+ * Vectored output state, binary fields with at least minbin bytes
+ * are referenced from the iovec array rather than copied
+ */
+typedef struct htsmsg_binary_vec {
+  struct iovec *iov;
+  int iovcnt;
+  int refs;          /* remaining field references */
+  size_t minbin;
+  uint8_t *last;     /* start of the unreferenced output */
+} htsmsg_binary_vec_t;
+
+static inline int
+htsmsg_binary_vec_ref(htsmsg_binary_vec_t *vec, htsmsg_field_t *f)
+{
+  if (vec == NULL || vec->refs <= 0 || f->hmf_binsize < vec->minbin)
+    return 0;
+  vec->refs--;
+  return 1;
+}
+
+/*
+ * Bytes of the output which will be referenced (not copied)
+ */
+static size_t
+htsmsg_binary_vec_count(htsmsg_t *msg, htsmsg_binary_vec_t *vec)
+{
+  htsmsg_field_t *f;
+  size_t len = 0;
+
+  TAILQ_FOREACH(f, &msg->hm_fields, hmf_link) {
+    switch(f->hmf_type) {
+    case HMF_MAP:
+    case HMF_LIST:
+      len += htsmsg_binary_vec_count(f->hmf_msg, vec);
+      break;
+    case HMF_BIN:
+      if (htsmsg_binary_vec_ref(vec, f))
+        len += f->hmf_binsize;
+      break;
+    }
+  }
+  return len;
+}
+
 /*
  *
  */
-static void
-htsmsg_binary_write(htsmsg_t *msg, uint8_t *ptr)
+static uint8_t *
+htsmsg_binary_write(htsmsg_t *msg, uint8_t *ptr, htsmsg_binary_vec_t *vec)
 {
   htsmsg_field_t *f;
   uint64_t u64;
@@ -321,14 +366,22 @@ htsmsg_binary_write(htsmsg_t *msg, uint8_t *ptr)
     switch(f->hmf_type) {
     case HMF_MAP:
     case HMF_LIST:
-      htsmsg_binary_write(f->hmf_msg, ptr);
-      break;
+      ptr = htsmsg_binary_write(f->hmf_msg, ptr, vec);
+      continue;
 
     case HMF_STR:
       memcpy(ptr, f->hmf_str, l);
       break;
 
     case HMF_BIN:
+      if (htsmsg_binary_vec_ref(vec, f)) {
+        vec->iov[vec->iovcnt].iov_base = vec->last;
+        vec->iov[vec->iovcnt++].iov_len = ptr - vec->last;
+        vec->iov[vec->iovcnt].iov_base = (void *)f->hmf_bin;
+        vec->iov[vec->iovcnt++].iov_len = l;
+        vec->last = ptr;
+        continue;
+      }
       memcpy(ptr, f->hmf_bin, l);
       break;
 
@@ -351,6 +404,7 @@ htsmsg_binary_write(htsmsg_t *msg, uint8_t *ptr)
     }
     ptr += l;
   }
+  return ptr;
 }
 
 /*
@@ -368,7 +422,7 @@ htsmsg_binary_serialize0(htsmsg_t *msg, void **datap, size_t *lenp, int maxlen)
 
   data = malloc(len);
 
-  htsmsg_binary_write(msg, data);
+  htsmsg_binary_write(msg, data, NULL);
   *datap = data;
   *lenp  = len;
   return 0;
@@ -394,8 +448,56 @@ htsmsg_binary_serialize(htsmsg_t *msg, void **datap, size_t *lenp, int maxlen)
   data[2] = len >> 8;
   data[3] = len;
 
-  htsmsg_binary_write(msg, data + 4);
+  htsmsg_binary_write(msg, data + 4, NULL);
   *datap = data;
   *lenp  = len + 4;
   return 0;
 }
+
+/*
+ * Serialize the length prefix and the message header to one allocated
+ * buffer (*datap), large binary fields are only referenced. The
+ * caller must keep the message until the iovecs are written. Returns
+ * the number of used iovecs.
+ */
+int
+htsmsg_binary_serialize_vec(htsmsg_t *msg, void **datap,
+                            struct iovec *iov, int iovmax,
+                            size_t minbin, int maxlen)
+{
+  htsmsg_binary_vec_t vec;
+  size_t len, rlen;
+  uint8_t *data, *ptr;
+  int refs;
+
+  if (iovmax < 1)
+    return -1;
+
+  len = htsmsg_binary_count(msg);
+  if(len + 4 > maxlen)
+    return -1;
+
+  /* each reference needs one iovec for the field and one for the rest */
+  refs = (iovmax - 1) / 2;
+  vec.refs = refs;
+  vec.minbin = minbin;
+  rlen = htsmsg_binary_vec_count(msg, &vec);
+
+  data = malloc(len + 4 - rlen);
+
+  data[0] = len >> 24;
+  data[1] = len >> 16;
+  data[2] = len >> 8;
+  data[3] = len;
+
+  vec.iov = iov;
+  vec.iovcnt = 0;
+  vec.refs = refs;
+  vec.last = data;
+  ptr = htsmsg_binary_write(msg, data + 4, &vec);
+  iov[vec.iovcnt].iov_base = vec.last;
+  iov[vec.iovcnt++].iov_len = ptr - vec.last;
+
+  *datap = data;
+  return vec.iovcnt;
+}
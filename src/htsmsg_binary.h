@@ -19,6 +19,7 @@
 #ifndef HTSMSG_BINARY_H_
 #define HTSMSG_BINARY_H_
 
+#include <sys/uio.h>
 #include "htsmsg.h"
 
 /**
@@ -36,4 +37,8 @@ int htsmsg_binary_serialize0(htsmsg_t *msg, void **datap, size_t *lenp,
 int htsmsg_binary_serialize(htsmsg_t *msg, void **datap, size_t *lenp,
 			    int maxlen);
 
+int htsmsg_binary_serialize_vec(htsmsg_t *msg, void **datap,
+                                struct iovec *iov, int iovmax,
+                                size_t minbin, int maxlen);
+
 #endif /* HTSMSG_BINARY_H_ */
@@ -274,6 +274,24 @@ htsmsg_binary2_deserialize
   return 0;
 }
 
+/*
+ * Size of the serialized message including the length header
+ * (zero when the data are truncated)
+ */
+size_t
+htsmsg_binary2_length(const void *data, size_t len)
+{
+  const uint8_t *p = data;
+  uint32_t l;
+  size_t l2;
+
+  if (len == 0)
+    return 0;
+  l = htsmsg_binary2_get_length(&p, data + len);
+  l2 = l + (p - (uint8_t *)data);
+  return l2 > len ? 0 : l2;
+}
+
 /*
  *
  */
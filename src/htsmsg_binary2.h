@@ -27,6 +27,8 @@ htsmsg_t *htsmsg_binary2_deserialize0(const void *data, size_t len,
 int htsmsg_binary2_deserialize(htsmsg_t **msg, const void *data, size_t *len,
                                const void *buf);
 
+size_t htsmsg_binary2_length(const void *data, size_t len);
+
 int htsmsg_binary2_serialize0(htsmsg_t *msg, void **datap, size_t *lenp,
 			      size_t maxlen);
 
@@ -306,6 +306,34 @@ htsmsg_xml_parse_attrib
   return src;
 }
 
+/*
+ * Expand the namespace prefix of the name, NULL when there is none
+ */
+static char *
+htsmsg_xml_ns_name(xmlparser_t *xp, const char *name, int len)
+{
+  xmlns_t *ns;
+  char *n;
+  int i, llen;
+
+  for(i = 0; i < len - 1; i++) {
+    if(name[i] != ':')
+      continue;
+    LIST_FOREACH(ns, &xp->xp_namespaces, xmlns_global_link) {
+      if(ns->xmlns_prefix_len == i &&
+         !memcmp(ns->xmlns_prefix, name, ns->xmlns_prefix_len)) {
+        llen = len - i - 1;
+        n = malloc(ns->xmlns_norm_len + llen + 1);
+        n[ns->xmlns_norm_len + llen] = 0;
+        memcpy(n, ns->xmlns_norm, ns->xmlns_norm_len);
+        memcpy(n + ns->xmlns_norm_len, name + i + 1, llen);
+        return n;
+      }
+    }
+  }
+  return NULL;
+}
+
 /**
  *
  */
@@ -314,8 +342,8 @@ htsmsg_xml_parse_tag(xmlparser_t *xp, htsmsg_t *parent, char *src)
 {
   htsmsg_t *m, *attrs;
   struct xmlns_list nslist;
-  char *tagname;
-  int taglen, empty = 0, i;
+  char *tagname, *n;
+  int taglen, empty = 0;
   xmlns_t *ns;
 
   tagname = src;
@@ -379,32 +407,15 @@ htsmsg_xml_parse_tag(xmlparser_t *xp, htsmsg_t *parent, char *src)
   if(!empty)
     src = htsmsg_xml_parse_cd(xp, m, src);
 
-  for(i = 0; i < taglen - 1; i++) {
-    if(tagname[i] == ':') {
-
-      LIST_FOREACH(ns, &xp->xp_namespaces, xmlns_global_link) {
-	if(ns->xmlns_prefix_len == i && 
-	   !memcmp(ns->xmlns_prefix, tagname, ns->xmlns_prefix_len)) {
-
-	  int llen = taglen - i - 1;
-	  char *n = malloc(ns->xmlns_norm_len + llen + 1);
-
-	  n[ns->xmlns_norm_len + llen] = 0;
-	  memcpy(n, ns->xmlns_norm, ns->xmlns_norm_len);
-	  memcpy(n + ns->xmlns_norm_len, tagname + i + 1, llen);
-	  htsmsg_add_msg(parent, n, m);
-	  free(n);
-	  goto done;
-	}
-      }
-    }
+  if((n = htsmsg_xml_ns_name(xp, tagname, taglen)) != NULL) {
+    htsmsg_add_msg(parent, n, m);
+    free(n);
+  } else {
+    xp->xp_srcdataused = 1;
+    tagname[taglen] = 0;
+    htsmsg_add_msg_extname(parent, tagname, m);
   }
 
-  xp->xp_srcdataused = 1;
-  tagname[taglen] = 0;
-  htsmsg_add_msg_extname(parent, tagname, m);
-
- done:
   while((ns = LIST_FIRST(&nslist)) != NULL)
     xmlns_destroy(ns);
   return src;
@@ -753,6 +764,38 @@ htsmsg_xml_parse_cd(xmlparser_t *xp, htsmsg_t *parent, char *src)
   return src;
 }
 
+/*
+ * Skip the DOCTYPE declaration including the internal subset [ ... ]
+ */
+static char *
+xml_skip_doctype(char *src)
+{
+  char *end, quote = 0;
+  int depth = 0;
+
+  while(*src != 0) {
+    if(quote) {
+      if(*src == quote)
+        quote = 0;
+    } else if(*src == '"' || *src == '\'') {
+      quote = *src;
+    } else if(*src == '[') {
+      depth++;
+    } else if(*src == ']') {
+      if(depth > 0)
+        depth--;
+    } else if(depth > 0 && !strncmp(src, "<!--", 4)) {
+      if((end = strstr(src + 4, "-->")) == NULL)
+        return src + strlen(src);
+      src = end + 2;
+    } else if(*src == '>' && depth == 0) {
+      return src + 1;
+    }
+    src++;
+  }
+  return src;
+}
+
 /**
  *
  */
@@ -780,13 +823,7 @@ htsmsg_parse_prolog(xmlparser_t *xp, char *src)
     }
 
     if(!strncmp(src, "<!DOCTYPE", 9)) {
-      while(*src != 0) {
-	if(*src == '>') {
-	  src++;
-	  break;
-	}
-	src++;
-      }
+      src = xml_skip_doctype(src + 9);
       continue;
     }
     break;
@@ -858,6 +895,369 @@ htsmsg_xml_deserialize(char *src, char *errbuf, size_t errbufsize)
   return NULL;
 }
 
+/* **************************************************************************
+ * Incremental parser
+ * *************************************************************************/
+
+/*
+ * Only the element boundaries are tracked while the data are read,
+ * each complete child of the root element is then parsed using the
+ * code above. The memory use is bounded by the largest child element.
+ */
+
+#define XML_STREAM_CHUNK (64 * 1024)
+
+enum {
+  XS_TEXT,
+  XS_TAG,
+  XS_ENDTAG,
+  XS_COMMENT,
+  XS_CDATA,
+  XS_PI,
+  XS_DECL,
+};
+
+enum {
+  XS_EV_NONE,
+  XS_EV_ROOT,
+  XS_EV_ELEMENT,
+  XS_EV_END,
+};
+
+typedef struct xmlstream {
+  char   *xs_buf;
+  size_t  xs_len;
+  size_t  xs_size;
+  size_t  xs_pos;    /* scan position */
+  size_t  xs_start;  /* start of the current element */
+  int     xs_state;
+  int     xs_depth;  /* -1 = prolog, 0 = root element content */
+  int     xs_eof;
+  int     xs_match;  /* '-' or ']' count */
+  int     xs_decl;   /* DOCTYPE internal subset [ ] depth */
+  char    xs_quote;
+  char    xs_last;
+} xmlstream_t;
+
+static int
+xml_stream_scan(xmlstream_t *xs)
+{
+  char *p = xs->xs_buf, c;
+  size_t l;
+
+  while(xs->xs_pos < xs->xs_len) {
+    c = p[xs->xs_pos];
+    switch(xs->xs_state) {
+    case XS_TEXT:
+      if(c != '<') {
+        xs->xs_pos++;
+        break;
+      }
+      l = xs->xs_len - xs->xs_pos;
+      if(l < 9 && !xs->xs_eof)
+        return XS_EV_NONE; /* lookahead */
+      p += xs->xs_pos;
+      if(l >= 2 && p[1] == '/') {
+        xs->xs_state = XS_ENDTAG;
+        xs->xs_pos += 2;
+      } else if(l >= 4 && !strncmp(p, "<!--", 4)) {
+        xs->xs_state = XS_COMMENT;
+        xs->xs_match = 0;
+        xs->xs_pos += 4;
+      } else if(l >= 9 && !strncmp(p, "<![CDATA[", 9)) {
+        xs->xs_state = XS_CDATA;
+        xs->xs_match = 0;
+        xs->xs_pos += 9;
+      } else if(l >= 2 && p[1] == '?') {
+        xs->xs_state = XS_PI;
+        xs->xs_last = 0;
+        xs->xs_pos += 2;
+      } else if(l >= 2 && p[1] == '!') {
+        xs->xs_state = XS_DECL;
+        xs->xs_quote = 0;
+        xs->xs_decl = 0;
+        xs->xs_pos += 2;
+      } else {
+        if(xs->xs_depth <= 0)
+          xs->xs_start = xs->xs_pos;
+        xs->xs_state = XS_TAG;
+        xs->xs_quote = xs->xs_last = 0;
+        xs->xs_pos++;
+      }
+      p = xs->xs_buf;
+      break;
+    case XS_TAG:
+      xs->xs_pos++;
+      if(xs->xs_quote) {
+        if(c == xs->xs_quote)
+          xs->xs_quote = 0;
+      } else if(c == '"' || c == '\'') {
+        xs->xs_quote = c;
+      } else if(c != '>') {
+        xs->xs_last = c;
+      } else {
+        xs->xs_state = XS_TEXT;
+        if(xs->xs_last == '/') { /* empty element */
+          if(xs->xs_depth == 0)
+            return XS_EV_ELEMENT;
+          if(xs->xs_depth < 0)
+            return XS_EV_ROOT;
+        } else if(++xs->xs_depth == 0) {
+          return XS_EV_ROOT;
+        }
+      }
+      break;
+    case XS_ENDTAG:
+      xs->xs_pos++;
+      if(c == '>') {
+        xs->xs_state = XS_TEXT;
+        if(--xs->xs_depth == 0)
+          return XS_EV_ELEMENT;
+        if(xs->xs_depth < 0)
+          return XS_EV_END;
+      }
+      break;
+    case XS_COMMENT:
+    case XS_CDATA:
+      xs->xs_pos++;
+      if(c == (xs->xs_state == XS_COMMENT ? '-' : ']')) {
+        xs->xs_match++;
+      } else {
+        if(c == '>' && xs->xs_match >= 2)
+          xs->xs_state = xs->xs_decl > 0 ? XS_DECL : XS_TEXT;
+        xs->xs_match = 0;
+      }
+      break;
+    case XS_PI:
+      xs->xs_pos++;
+      if(c == '>' && xs->xs_last == '?')
+        xs->xs_state = XS_TEXT;
+      xs->xs_last = c;
+      break;
+    case XS_DECL:
+      if(xs->xs_quote) {
+        if(c == xs->xs_quote)
+          xs->xs_quote = 0;
+      } else if(c == '"' || c == '\'') {
+        xs->xs_quote = c;
+      } else if(c == '[') {
+        xs->xs_decl++;
+      } else if(c == ']') {
+        if(xs->xs_decl > 0)
+          xs->xs_decl--;
+      } else if(c == '<' && xs->xs_decl > 0) {
+        l = xs->xs_len - xs->xs_pos;
+        if(l < 4 && !xs->xs_eof)
+          return XS_EV_NONE; /* lookahead */
+        if(l >= 4 && !strncmp(p + xs->xs_pos, "<!--", 4)) {
+          xs->xs_state = XS_COMMENT;
+          xs->xs_match = 0;
+          xs->xs_pos += 4;
+          break;
+        }
+      } else if(c == '>' && xs->xs_decl == 0) {
+        xs->xs_state = XS_TEXT;
+      }
+      xs->xs_pos++;
+      break;
+    }
+  }
+  return XS_EV_NONE;
+}
+
+static int
+xml_stream_fill(xmlstream_t *xs, htsmsg_xml_read_t *rd, void *raux)
+{
+  size_t keep;
+  ssize_t r;
+
+  /* drop the processed data */
+  if(xs->xs_depth < 0)
+    keep = 0;
+  else if(xs->xs_depth > 0 || xs->xs_state == XS_TAG)
+    keep = xs->xs_start;
+  else
+    keep = xs->xs_pos;
+  if(keep > 0) {
+    memmove(xs->xs_buf, xs->xs_buf + keep, xs->xs_len - keep);
+    xs->xs_len -= keep;
+    xs->xs_pos -= keep;
+    xs->xs_start -= keep;
+  }
+
+  if(xs->xs_size - xs->xs_len < XML_STREAM_CHUNK) {
+    xs->xs_size = xs->xs_len + XML_STREAM_CHUNK;
+    xs->xs_buf = realloc(xs->xs_buf, xs->xs_size + 1);
+  }
+
+  r = rd(raux, xs->xs_buf + xs->xs_len, xs->xs_size - xs->xs_len);
+  if(r < 0)
+    return -1;
+  if(r == 0)
+    xs->xs_eof = 1;
+  xs->xs_len += r;
+
+  /* check for UTF-8 BOM */
+  if(xs->xs_depth < 0 && xs->xs_pos == 0 && xs->xs_len >= 3 &&
+     !memcmp(xs->xs_buf, "\xef\xbb\xbf", 3)) {
+    memmove(xs->xs_buf, xs->xs_buf + 3, xs->xs_len - 3);
+    xs->xs_len -= 3;
+  }
+  return 0;
+}
+
+static char *
+xml_stream_root(xmlparser_t *xp, xmlstream_t *xs, struct xmlns_list *nslist)
+{
+  htsmsg_t *attrs;
+  char *src0, *src, *name, *ret = NULL;
+  int len;
+
+  src0 = malloc(xs->xs_pos + 1);
+  memcpy(src0, xs->xs_buf, xs->xs_pos);
+  src0[xs->xs_pos] = 0;
+
+  if((src = htsmsg_parse_prolog(xp, src0)) == NULL)
+    goto end;
+  if(*src != '<') {
+    xmlerr(xp, "Invalid root element");
+    goto end;
+  }
+  name = ++src;
+  while(*src && !is_xmlws(*src) && *src != '>' && *src != '/')
+    src++;
+  if(src == name) {
+    xmlerr(xp, "Invalid tag name");
+    goto end;
+  }
+  len = src - name;
+
+  /* namespace declarations */
+  attrs = htsmsg_create_map();
+  while(1) {
+    while(is_xmlws(*src))
+      src++;
+    if(*src == 0 || *src == '/' || *src == '>')
+      break;
+    if((src = htsmsg_xml_parse_attrib(xp, attrs, src, nslist)) == NULL)
+      break;
+  }
+  htsmsg_destroy(attrs);
+
+  /* the same name as htsmsg_xml_deserialize() gives the root */
+  if((ret = htsmsg_xml_ns_name(xp, name, len)) == NULL)
+    ret = strndup(name, len);
+
+end:
+  free(src0);
+  return ret;
+}
+
+/**
+ * Parse the XML data read by rd. The children of the root element are
+ * passed to cb one by one (the same way as htsmsg_xml_deserialize()
+ * stores them to the "tags" map of the root element). The callback may
+ * stop the parsing by returning a negative value.
+ */
+int
+htsmsg_xml_deserialize_stream
+  (htsmsg_xml_read_t *rd, void *raux, htsmsg_xml_stream_cb_t *cb, void *aux,
+   char *errbuf, size_t errbufsize)
+{
+  xmlparser_t xp;
+  xmlstream_t xs;
+  struct xmlns_list nslist;
+  htsmsg_t *m, *body;
+  htsmsg_field_t *f;
+  xmlns_t *ns;
+  char *root = NULL, *src;
+  size_t l;
+  int ev, r = 0;
+
+  memset(&xp, 0, sizeof(xp));
+  xp.xp_encoding = XML_ENCODING_UTF8;
+  LIST_INIT(&xp.xp_namespaces);
+  LIST_INIT(&nslist);
+
+  memset(&xs, 0, sizeof(xs));
+  xs.xs_depth = -1;
+
+  while(1) {
+    ev = xml_stream_scan(&xs);
+
+    if(ev == XS_EV_NONE) {
+      if(xs.xs_eof) {
+        xmlerr(&xp, "Unexpected end of file");
+        r = -1;
+        break;
+      }
+      if(xml_stream_fill(&xs, rd, raux)) {
+        xmlerr(&xp, "Read error: %s", strerror(errno));
+        r = -1;
+        break;
+      }
+      continue;
+    }
+
+    if(ev == XS_EV_ROOT) {
+      if((root = xml_stream_root(&xp, &xs, &nslist)) == NULL) {
+        r = -1;
+        break;
+      }
+      if(xs.xs_depth < 0) /* empty root element */
+        break;
+      continue;
+    }
+
+    if(ev == XS_EV_END)
+      break;
+
+    /* complete child element */
+    l = xs.xs_pos - xs.xs_start;
+    src = malloc(l + 1);
+    memcpy(src, xs.xs_buf + xs.xs_start, l);
+    src[l] = 0;
+
+    m = htsmsg_create_map();
+    xp.xp_srcdataused = 0;
+    if(htsmsg_xml_parse_tag(&xp, m, src + 1) == NULL) {
+      htsmsg_destroy(m);
+      free(src);
+      r = -1;
+      break;
+    }
+    if(xp.xp_srcdataused) {
+      m->hm_data = src;
+      m->hm_data_size = l + 1;
+    } else {
+      free(src);
+    }
+
+    f = TAILQ_FIRST(&m->hm_fields);
+    if(f && (body = htsmsg_field_get_map(f)) != NULL)
+      r = cb(aux, root, htsmsg_field_name(f), body);
+    htsmsg_destroy(m);
+    if(r < 0) {
+      r = 0;
+      break;
+    }
+  }
+
+  while((ns = LIST_FIRST(&nslist)) != NULL)
+    xmlns_destroy(ns);
+  free(root);
+  free(xs.xs_buf);
+
+  if(r < 0) {
+    snprintf(errbuf, errbufsize, "%s", xp.xp_errmsg);
+    /* Remove any odd chars inside of errmsg */
+    for ( ; *errbuf; errbuf++)
+      if (*errbuf < ' ')
+        *errbuf = ' ';
+  }
+  return r;
+}
+
 /*
  * Get cdata string field
  */
@@ -23,6 +23,14 @@
 #include "htsbuf.h"
 
 htsmsg_t *htsmsg_xml_deserialize(char *src, char *errbuf, size_t errbufsize);
+
+typedef ssize_t (htsmsg_xml_read_t)(void *aux, char *buf, size_t len);
+typedef int (htsmsg_xml_stream_cb_t)
+  (void *aux, const char *root, const char *name, htsmsg_t *body);
+
+int htsmsg_xml_deserialize_stream
+  (htsmsg_xml_read_t *rd, void *raux, htsmsg_xml_stream_cb_t *cb, void *aux,
+   char *errbuf, size_t errbufsize);
 const char *htsmsg_xml_get_cdata_str (htsmsg_t *tags, const char *tag);
 int htsmsg_xml_get_cdata_u32 (htsmsg_t *tags, const char *tag, uint32_t *u32);
 const char *htsmsg_xml_get_attr_str(htsmsg_t *tag, const char *attr);
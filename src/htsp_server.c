@@ -58,6 +58,10 @@ static void *htsp_server, *htsp_server_2;
 
 #define HTSP_ASYNC_EPG_INTERVAL 30
 
+#define HTSP_WRITE_BATCH  16   /* messages per one write syscall */
+#define HTSP_WRITE_IOV    3    /* iovecs per message (one payload) */
+#define HTSP_WRITE_MINBIN 256  /* smaller binary fields are copied */
+
 #define HTSP_PRIV_MASK (ACCESS_HTSP_STREAMING)
 
 extern char *dvr_storage;
@@ -3363,10 +3367,10 @@ htsp_write_scheduler(void *aux)
 {
   htsp_connection_t *htsp = aux;
   htsp_msg_q_t *hmq;
-  htsp_msg_t *hm;
-  void *dptr;
-  size_t dlen;
-  int r;
+  htsp_msg_t *hm, *batch[HTSP_WRITE_BATCH];
+  void *dptr[HTSP_WRITE_BATCH];
+  struct iovec iov[HTSP_WRITE_BATCH * HTSP_WRITE_IOV];
+  int i, cnt, iovcnt, r;
 
   tvh_mutex_lock(&htsp->htsp_out_mutex);
 
@@ -3378,34 +3382,48 @@ htsp_write_scheduler(void *aux)
       continue;
     }
 
-    hm = TAILQ_FIRST(&hmq->hmq_q);
-    TAILQ_REMOVE(&hmq->hmq_q, hm, hm_link);
-    hmq->hmq_length--;
-    hmq->hmq_payload -= hm->hm_payloadsize;
-
-    TAILQ_REMOVE(&htsp->htsp_active_output_queues, hmq, hmq_link);
-    if(hmq->hmq_length) {
-      /* Still messages to be sent, put back in active queues */
-      if(hmq->hmq_strict_prio) {
-        TAILQ_INSERT_HEAD(&htsp->htsp_active_output_queues, hmq, hmq_link);
-      } else {
-        TAILQ_INSERT_TAIL(&htsp->htsp_active_output_queues, hmq, hmq_link);
+    /* Take more queued messages at once, in the queue priority order */
+    for (cnt = 0; cnt < HTSP_WRITE_BATCH && hmq; cnt++) {
+      hm = TAILQ_FIRST(&hmq->hmq_q);
+      TAILQ_REMOVE(&hmq->hmq_q, hm, hm_link);
+      hmq->hmq_length--;
+      hmq->hmq_payload -= hm->hm_payloadsize;
+
+      TAILQ_REMOVE(&htsp->htsp_active_output_queues, hmq, hmq_link);
+      if(hmq->hmq_length) {
+        /* Still messages to be sent, put back in active queues */
+        if(hmq->hmq_strict_prio) {
+          TAILQ_INSERT_HEAD(&htsp->htsp_active_output_queues, hmq, hmq_link);
+        } else {
+          TAILQ_INSERT_TAIL(&htsp->htsp_active_output_queues, hmq, hmq_link);
+        }
       }
+
+      batch[cnt] = hm;
+      hmq = TAILQ_FIRST(&htsp->htsp_active_output_queues);
     }
 
     tvh_mutex_unlock(&htsp->htsp_out_mutex);
 
-    if (htsmsg_binary_serialize(hm->hm_msg, &dptr, &dlen, INT32_MAX) != 0) {
-      tvhwarn(LS_HTSP, "%s: failed to serialize data", htsp->htsp_logname);
-      htsp_msg_destroy(hm);
-      tvh_mutex_lock(&htsp->htsp_out_mutex);
-      continue;
+    /* The packet payloads are referenced (held by hm_pb), not copied */
+    for (i = iovcnt = 0; i < cnt; i++) {
+      r = htsmsg_binary_serialize_vec(batch[i]->hm_msg, &dptr[i],
+                                      iov + iovcnt, HTSP_WRITE_IOV,
+                                      HTSP_WRITE_MINBIN, INT32_MAX);
+      if (r < 0) {
+        tvhwarn(LS_HTSP, "%s: failed to serialize data", htsp->htsp_logname);
+        dptr[i] = NULL;
+        continue;
+      }
+      iovcnt += r;
     }
 
-    htsp_msg_destroy(hm);
+    r = iovcnt ? tvh_writev(htsp->htsp_fd, iov, iovcnt) : 0;
 
-    r = tvh_write(htsp->htsp_fd, dptr, dlen);
-    free(dptr);
+    for (i = 0; i < cnt; i++) {
+      free(dptr[i]);
+      htsp_msg_destroy(batch[i]);
+    }
     tvh_mutex_lock(&htsp->htsp_out_mutex);
     
     if (r) {
@@ -32,6 +32,9 @@
 #include <sys/socket.h>
 #endif
 
+/* worker pool: the request read limit in seconds */
+#define HTTP_REQUEST_TIMEOUT 15
+
 void *http_server;
 static int http_server_running;
 
@@ -1231,6 +1234,9 @@ http_exec(http_connection_t *hc, http_path_t *hp, char *remain)
 {
   int err;
 
+  /* the request is read, no time limit for the processing */
+  tcp_connection_deadline(0);
+
   /* this is a special case when client probably requires authentication */
   if ((hp->hp_accessmask & ACCESS_NO_EMPTY_ARGS) != 0 && TAILQ_EMPTY(&hc->hc_req_args)) {
     err = http_noaccess_code(hc);
@@ -1918,27 +1924,51 @@ http_parse_args(http_arg_list_t *list, char *args)
 /**
  *
  */
-void
-http_serve_requests(http_connection_t *hc)
+static void
+http_serve_init(http_connection_t *hc)
 {
-  htsbuf_queue_t spill;
-  char *argv[3], *c, *s, *cmdline = NULL, *hdrline = NULL;
-  int n, r, delim;
-
   tvh_mutex_init(&hc->hc_extra_lock, NULL);
   http_arg_init(&hc->hc_args);
   http_arg_init(&hc->hc_req_args);
-  htsbuf_queue_init(&spill, 0);
   htsbuf_queue_init(&hc->hc_reply, 0);
   htsbuf_queue_init(&hc->hc_extra, 0);
   atomic_set(&hc->hc_extra_insend, 0);
   atomic_set(&hc->hc_extra_chunks, 0);
+}
+
+static void
+http_serve_done(http_connection_t *hc)
+{
+  htsbuf_queue_flush(&hc->hc_extra);
+
+  free(hc->hc_nonce);
+  hc->hc_nonce = NULL;
+
+  free(hc->hc_proxy_ip);
+  free(hc->hc_local_ip);
+}
+
+/*
+ * Returns 1 when park is set and the connection is idle (keep-alive,
+ * no pending input), the requests continue with the next call.
+ */
+static int
+http_serve_requests0(http_connection_t *hc, int park)
+{
+  htsbuf_queue_t spill;
+  char *argv[3], *c, *s, *cmdline = NULL, *hdrline = NULL;
+  int n, r, delim, parked = 0;
+
+  htsbuf_queue_init(&spill, 0);
 
   do {
     hc->hc_no_output  = 0;
 
     if (cmdline) free(cmdline);
 
+    /* the whole request (header and POST data) must arrive in time */
+    tcp_connection_deadline(HTTP_REQUEST_TIMEOUT);
+
     if ((cmdline = tcp_read_line(hc->hc_fd, &spill)) == NULL)
       goto error;
 
@@ -2037,19 +2067,30 @@ http_serve_requests(http_connection_t *hc)
     if (r)
       break;
 
+    if (park && TAILQ_EMPTY(&spill.hq_q) && hc->hc_keep_alive &&
+        atomic_get(&http_server_running)) {
+      parked = 1;
+      break;
+    }
+
   } while(hc->hc_keep_alive && atomic_get(&http_server_running));
 
 error:
   free(hdrline);
   free(cmdline);
   htsbuf_queue_flush(&spill);
-  htsbuf_queue_flush(&hc->hc_extra);
-
-  free(hc->hc_nonce);
-  hc->hc_nonce = NULL;
+  return parked;
+}
 
-  free(hc->hc_proxy_ip);
-  free(hc->hc_local_ip);
+/**
+ *
+ */
+void
+http_serve_requests(http_connection_t *hc)
+{
+  http_serve_init(hc);
+  http_serve_requests0(hc, 0);
+  http_serve_done(hc);
 }
 
 
@@ -2084,6 +2125,44 @@ http_serve(int fd, void **opaque, struct sockaddr_storage *peer,
   *opaque = NULL;
 }
 
+/**
+ * Worker pool variant, the connection state is kept between requests
+ */
+static int
+http_serve_pool(int fd, void **opaque, struct sockaddr_storage *peer,
+                struct sockaddr_storage *self)
+{
+  http_connection_t *hc = *opaque;
+  int r;
+
+  /* Note: global_lock held on entry */
+  if (hc == NULL) {
+    hc = calloc(1, sizeof(http_connection_t));
+    hc->hc_subsys  = LS_HTTP;
+    hc->hc_fd      = fd;
+    hc->hc_peer    = peer;
+    hc->hc_self    = self;
+    hc->hc_paths   = &http_paths;
+    hc->hc_paths_mutex = &http_paths_mutex;
+    hc->hc_process = http_process_request;
+    http_serve_init(hc);
+    *opaque = hc;
+  }
+  tvh_mutex_unlock(&global_lock);
+
+  r = http_serve_requests0(hc, 1);
+  if (!r)
+    http_serve_done(hc);
+
+  // Note: leave global_lock held for parent
+  tvh_mutex_lock(&global_lock);
+  if (!r) {
+    *opaque = NULL;
+    free(hc);
+  }
+  return r;
+}
+
 void
 http_cancel( void *opaque )
 {
@@ -2104,7 +2183,8 @@ http_server_init(const char *bindaddr)
   static tcp_server_ops_t ops = {
     .start  = http_serve,
     .stop   = NULL,
-    .cancel = http_cancel
+    .cancel = http_cancel,
+    .serve  = http_serve_pool
   };
   RB_INIT(&http_nonces);
   if (tvheadend_webui_port > 0) {
@@ -1936,15 +1936,52 @@ idnode_notify_title_changed_lang (void *in, const char *lang)
  * Save thread
  * *************************************************************************/
 
+#define IDNODE_SAVE_BATCH 256
+
+/*
+ * Save the queued nodes (all or the expired ones), the records are
+ * written outside the global lock as one batch (group commit)
+ */
+static void
+idnode_save_flush ( int all )
+{
+  idnode_save_t *ise;
+  htsmsg_t *m[IDNODE_SAVE_BATCH];
+  char *filename[IDNODE_SAVE_BATCH];
+  char buf[PATH_MAX];
+  int i, n = 0;
+
+  while (n < IDNODE_SAVE_BATCH && (ise = TAILQ_FIRST(&idnodes_save)) != NULL) {
+    if (!all && ise->ise_reqtime + IDNODE_SAVE_DELAY > mclk())
+      break;
+    m[n] = idnode_savefn(ise->ise_node, buf, sizeof(buf));
+    ise->ise_node->in_save = NULL;
+    TAILQ_REMOVE(&idnodes_save, ise, ise_link);
+    free(ise);
+    if (m[n])
+      filename[n++] = strdup(buf);
+  }
+  if (n == 0)
+    return;
+
+  tvh_mutex_unlock(&global_lock);
+  hts_settings_batch_begin();
+  for (i = 0; i < n; i++) {
+    hts_settings_save(m[i], "%s", filename[i]);
+    htsmsg_destroy(m[i]);
+    free(filename[i]);
+  }
+  hts_settings_batch_commit();
+  tvh_mutex_lock(&global_lock);
+}
+
 static void *
 save_thread ( void *aux )
 {
   idnode_save_t *ise;
   idnode_t *in;
-  htsmsg_t *m;
   uint32_t u32;
   tvh_uuid_t *uuid;
-  char filename[PATH_MAX];
   tvh_uuid_set_t set, tset;
   int lnotify;
 
@@ -1970,18 +2007,8 @@ save_thread ( void *aux )
       tvh_cond_wait(&save_cond, &global_lock);
       continue;
     }
-    if (ise) {
-      m = idnode_savefn(ise->ise_node, filename, sizeof(filename));
-      ise->ise_node->in_save = NULL;
-      TAILQ_REMOVE(&idnodes_save, ise, ise_link);
-      tvh_mutex_unlock(&global_lock);
-      free(ise);
-      if (m) {
-        hts_settings_save(m, "%s", filename);
-        htsmsg_destroy(m);
-      }
-      tvh_mutex_lock(&global_lock);
-    }
+    if (ise)
+      idnode_save_flush(0);
 lnotifygo:
     tvh_mutex_lock(&idnode_lnotify_mutex);
     if (!uuid_set_empty(&idnode_lnotify_set)) {
@@ -2013,18 +2040,8 @@ lnotifygo:
 
   mtimer_disarm(&save_timer);
 
-  while ((ise = TAILQ_FIRST(&idnodes_save)) != NULL) {
-    m = idnode_savefn(ise->ise_node, filename, sizeof(filename));
-    ise->ise_node->in_save = NULL;
-    TAILQ_REMOVE(&idnodes_save, ise, ise_link);
-    tvh_mutex_unlock(&global_lock);
-    free(ise);
-    if (m) {
-      hts_settings_save(m, "%s", filename);
-      htsmsg_destroy(m);
-    }
-    tvh_mutex_lock(&global_lock);
-  }
+  while (TAILQ_FIRST(&idnodes_save))
+    idnode_save_flush(1);
 
   tvh_mutex_unlock(&global_lock);
   return NULL;
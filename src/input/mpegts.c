@@ -24,6 +24,7 @@ struct mpegts_listeners mpegts_listeners;
 
 extern memoryinfo_t mpegts_input_queue_memoryinfo;
 extern memoryinfo_t mpegts_input_table_memoryinfo;
+extern memoryinfo_t mpegts_input_demux_memoryinfo;
 
 void
 mpegts_init ( int linuxdvb_mask, int nosatip, str_list_t *satip_client,
@@ -39,6 +40,7 @@ mpegts_init ( int linuxdvb_mask, int nosatip, str_list_t *satip_client,
   /* Memory info */
   memoryinfo_register(&mpegts_input_queue_memoryinfo);
   memoryinfo_register(&mpegts_input_table_memoryinfo);
+  memoryinfo_register(&mpegts_input_demux_memoryinfo);
 
   /* FastScan init */
   dvb_fastscan_init();
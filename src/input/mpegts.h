@@ -124,15 +124,49 @@ int mpegts_pid_dump ( mpegts_apids_t *pids, char *buf, int len, int wflag, int r
  * Data / SI processing
  * *************************************************************************/
 
+/*
+ * Input queue ring
+ *
+ * Each input owns a preallocated ring of TS data (sized in whole TS
+ * packets) plus a fixed array of packet descriptors. The frontend copies
+ * the data straight into a reserved region, the input thread processes
+ * it in place. When the ring is exhausted, data overflows to malloc'ed
+ * packets on mi_input_queue (the queue limit is shared).
+ *
+ * Only the reservation takes mi_input_lock. The packet is published by
+ * an atomic state change, the input thread is woken only when it sleeps.
+ * A packet still being filled does not hold back the published packets
+ * of other muxes (the order is kept per mux).
+ */
+#define MPEGTS_INPUT_RING_SIZE  ((4*1024*1024 / 188) * 188)
+#define MPEGTS_INPUT_RING_SLOTS 1024
+#define MPEGTS_INPUT_QUEUE_MAX  (50*1024*1024)
+
+/*
+ * Service demux workers
+ */
+#define MPEGTS_DEMUX_THREADS_MAX 16
+#define MPEGTS_DEMUX_QUEUE_MAX   (16*1024*1024)
+
+typedef struct mpegts_demux_worker mpegts_demux_worker_t;
+
 struct mpegts_packet
 {
   TAILQ_ENTRY(mpegts_packet)  mp_link;
   size_t                      mp_len;
   mpegts_mux_t               *mp_mux;
+  mpegts_mux_t               *mp_owner;   /* mp_mux at reserve, for ordering */
   uint8_t                     mp_cc_restart;
-  uint8_t                     mp_data[0];
+  uint8_t                     mp_ring;
+  int                         mp_state;   /* MPEGTS_PACKET_* */
+  uint8_t                    *mp_data;
 };
 
+#define MPEGTS_PACKET_RESERVED  0  /* the producer fills the data */
+#define MPEGTS_PACKET_READY     1  /* published */
+#define MPEGTS_PACKET_TAKEN     2  /* processed by the input thread */
+#define MPEGTS_PACKET_DONE      3  /* processed, the ring space is freed in order */
+
 struct mpegts_pcr {
   int64_t  pcr_first;
   int64_t  pcr_last;
@@ -496,9 +530,8 @@ struct mpegts_mux
 
   uint64_t                    mm_input_pos;
   RB_HEAD(, mpegts_pid)       mm_pids;
+  mpegts_pid_t              **mm_pids_table;  /* direct index, allocated when mm_pids is not empty */
   LIST_HEAD(, mpegts_pid_sub) mm_all_subs;
-  int                         mm_last_pid;
-  mpegts_pid_t               *mm_last_mp;
 
   int                         mm_num_tables;
   LIST_HEAD(, mpegts_table)   mm_tables;
@@ -708,10 +741,24 @@ struct mpegts_input
   tvh_mutex_t                     mi_input_lock;
   tvh_cond_t                      mi_input_cond;
   TAILQ_HEAD(,mpegts_packet)      mi_input_queue;
+  uint8_t                        *mi_input_ring;
+  mpegts_packet_t                *mi_input_slots;
+  uint32_t                        mi_input_ring_rd;
+  uint32_t                        mi_input_ring_wr;
+  uint32_t                        mi_input_ring_fill;
+  uint32_t                        mi_input_slot_rd;
+  uint32_t                        mi_input_slot_wr;
+  int                             mi_input_waiting;
   uint64_t                        mi_input_queue_size;
   tvhlog_limit_t                  mi_input_queue_loglimit;
   qprofile_t                      mi_qprofile;
   int                             mi_remove_scrambled_bits;
+  int                             mi_demux_threads;
+
+  /* Service demux workers */
+  // Note: managed by the input thread only
+  int                             mi_demux_count;
+  mpegts_demux_worker_t          *mi_demux_workers;
 
   /* Data processing/output */
   // Note: this lock (mi_output_lock) protects all the remaining
@@ -972,14 +1019,14 @@ static inline int mpegts_mux_scan_state_set ( mpegts_mux_t *m, int state )
   { return mpegts_mux_class_scan_state_set ( m, &state ); }
 
 mpegts_pid_t *mpegts_mux_find_pid_(mpegts_mux_t *mm, int pid, int create);
+void mpegts_mux_remove_pid(mpegts_mux_t *mm, mpegts_pid_t *mp);
 
 static inline mpegts_pid_t *
 mpegts_mux_find_pid(mpegts_mux_t *mm, int pid, int create)
 {
-  if (mm->mm_last_pid != pid)
-    return mpegts_mux_find_pid_(mm, pid, create);
-  else
-    return mm->mm_last_mp;
+  if (!create && (unsigned int)pid <= MPEGTS_TABLES_PID)
+    return mm->mm_pids_table ? mm->mm_pids_table[pid] : NULL;
+  return mpegts_mux_find_pid_(mm, pid, create);
 }
 
 void mpegts_mux_update_pids ( mpegts_mux_t *mm );
@@ -22,6 +22,8 @@
 
 void iptv_bouquet_trigger_by_uuid(const char *uuid);
 
+htsmsg_t *iptv_input_thread_stats ( void );
+
 void iptv_init ( void );
 void iptv_done ( void );
 
@@ -32,8 +32,11 @@
  * IPTV state
  * *************************************************************************/
 
-tvh_mutex_t iptv_lock;
-
+/*
+ * Each pool thread serves the muxes started on its input. The mux state
+ * is protected by the mux lock (im_lock), so the threads do not wait
+ * for each other.
+ */
 typedef struct iptv_thread_pool {
   TAILQ_ENTRY(iptv_thread_pool) link;
   pthread_t thread;
@@ -41,6 +44,14 @@ typedef struct iptv_thread_pool {
   tvhpoll_t *poll;
   th_pipe_t pipe;
   uint32_t streams;
+  /* load statistics (updated by the pool thread) */
+  uint64_t reads;
+  uint64_t bytes;
+  int64_t busy;
+  /* values from the last status query */
+  int64_t stats_clock;
+  uint64_t stats_bytes;
+  int64_t stats_busy;
 } iptv_thread_pool_t;
 
 TAILQ_HEAD(, iptv_thread_pool) iptv_tpool;
@@ -179,7 +190,7 @@ iptv_input_is_free ( mpegts_input_t *mi, mpegts_mux_t *mm,
       return rmmi;
   
   /* Bandwidth reached */
-  if (in->in_bw_limited && l == 0)
+  if (atomic_get(&in->in_bw_limited) && l == 0)
     if (rmmi->mmi_mux != mm)
       return rmmi;
 
@@ -398,7 +409,7 @@ iptv_input_start_mux ( mpegts_input_t *mi, mpegts_mux_instance_t *mmi, int weigh
   }
 
   /* Start */
-  tvh_mutex_lock(&iptv_lock);
+  tvh_mutex_lock(&im->im_lock);
   s = im->mm_iptv_url_raw;
   im->mm_iptv_url_raw = raw ? strdup(raw) : NULL;
   if (im->mm_iptv_url_raw) {
@@ -412,7 +423,7 @@ iptv_input_start_mux ( mpegts_input_t *mi, mpegts_mux_instance_t *mmi, int weigh
       im->mm_active  = NULL;
     }
   }
-  tvh_mutex_unlock(&iptv_lock);
+  tvh_mutex_unlock(&im->im_lock);
 
   urlreset(&url);
   free(s);
@@ -458,7 +469,7 @@ iptv_input_stop_mux ( mpegts_input_t *mi, mpegts_mux_instance_t *mmi )
   iptv_thread_pool_t *pool = ((iptv_input_t *)mi)->mi_tpool;
   uint32_t u32;
 
-  tvh_mutex_lock(&iptv_lock);
+  tvh_mutex_lock(&im->im_lock);
 
   mtimer_disarm(&im->im_pause_timer);
 
@@ -472,11 +483,11 @@ iptv_input_stop_mux ( mpegts_input_t *mi, mpegts_mux_instance_t *mmi )
   sbuf_free(&im->mm_iptv_buffer);
 
   /* Clear bw limit */
-  ((iptv_network_t *)im->mm_network)->in_bw_limited = 0;
+  atomic_set(&((iptv_network_t *)im->mm_network)->in_bw_limited, 0);
 
   u32 = --pool->streams;
 
-  tvh_mutex_unlock(&iptv_lock);
+  tvh_mutex_unlock(&im->im_lock);
 
   if (u32 == 0)
     gtimer_arm_rel(&iptv_tpool_manage_timer, iptv_input_thread_manage_cb, NULL, 0);
@@ -519,7 +530,7 @@ iptv_input_unpause ( void *aux )
   iptv_mux_t *im = aux;
   iptv_input_t *mi;
   int pause;
-  tvh_mutex_lock(&iptv_lock);
+  tvh_mutex_lock(&im->im_lock);
   pause = 0;
   if (im->mm_active) {
     mi = (iptv_input_t *)im->mm_active->mmi_input;
@@ -531,7 +542,7 @@ iptv_input_unpause ( void *aux )
       im->im_handler->pause(mi, im, 0);
     }
   }
-  tvh_mutex_unlock(&iptv_lock);
+  tvh_mutex_unlock(&im->im_lock);
   if (pause)
     mtimer_arm_rel(&im->im_pause_timer, iptv_input_unpause, im, sec2mono(1));
 }
@@ -542,6 +553,7 @@ iptv_input_thread ( void *aux )
   iptv_thread_pool_t *pool = aux;
   int nfds, r;
   ssize_t n;
+  int64_t mono;
   iptv_mux_t *im;
   iptv_input_t *mi;
   tvhpoll_event_t ev;
@@ -564,8 +576,10 @@ iptv_input_thread ( void *aux )
 
     im = ev.ptr;
     r  = 0;
+    n  = 0;
+    mono = getmonoclock();
 
-    tvh_mutex_lock(&iptv_lock);
+    tvh_mutex_lock(&im->im_lock);
 
     /* Only when active */
     if (im->mm_active) {
@@ -573,15 +587,22 @@ iptv_input_thread ( void *aux )
       /* Get data */
       if ((n = im->im_handler->read(mi, im)) < 0) {
         tvherror(LS_IPTV, "read() error %s", strerror(errno));
-        im->im_handler->stop(mi, im);
-        break;
+        /* stop polling the failed source, the other muxes of this
+           thread continue (the mux stop does the handler cleanup) */
+        tvhpoll_rem1(pool->poll, im->mm_iptv_fd);
+      } else {
+        r = iptv_input_recv_packets(im, n);
+        if (r == 1)
+          im->im_handler->pause(mi, im, 1);
       }
-      r = iptv_input_recv_packets(im, n);
-      if (r == 1)
-        im->im_handler->pause(mi, im, 1);
     }
 
-    tvh_mutex_unlock(&iptv_lock);
+    tvh_mutex_unlock(&im->im_lock);
+
+    atomic_add_u64(&pool->reads, 1);
+    if (n > 0)
+      atomic_add_u64(&pool->bytes, n);
+    atomic_add_s64(&pool->busy, getmonoclock() - mono);
 
     if (r == 1) {
       tvh_mutex_lock(&global_lock);
@@ -623,23 +644,24 @@ iptv_input_recv_packets ( iptv_mux_t *im, ssize_t len )
   mpegts_pcr_t pcr;
   char buf[384];
   int64_t s64;
+  int bps;
 
   pcr.pcr_first = PTS_UNSET;
   pcr.pcr_last  = PTS_UNSET;
   pcr.pcr_pid   = im->im_pcr_pid;
-  in->in_bps += len * 8;
+  /* the network counters are shared with the muxes of other threads */
+  atomic_add(&in->in_bps, len * 8);
   s64 = mclk();
-  if (mono2sec(in->in_bandwidth_clock) != mono2sec(s64)) {
+  if (mono2sec(atomic_get_s64(&in->in_bandwidth_clock)) != mono2sec(s64) &&
+      mono2sec(atomic_exchange_s64(&in->in_bandwidth_clock, s64)) !=
+        mono2sec(s64)) {
+    bps = atomic_exchange(&in->in_bps, 0);
     if (in->in_max_bandwidth &&
-        in->in_bps > in->in_max_bandwidth * 1024) {
-      if (!in->in_bw_limited) {
+        bps > in->in_max_bandwidth * 1024) {
+      if (!atomic_exchange(&in->in_bw_limited, 1))
         tvhinfo(LS_IPTV, "%s bandwidth limited exceeded",
                 idnode_get_title(&in->mn_id, NULL, buf, sizeof(buf)));
-        in->in_bw_limited = 1;
-      }
     }
-    in->in_bps = 0;
-    in->in_bandwidth_clock = s64;
   }
 
   /* Pass on, but with timing */
@@ -1249,6 +1271,7 @@ iptv_input_thread_manage(int count, int force)
   while (iptv_tpool_count < count) {
     pool = calloc(1, sizeof(*pool));
     pool->poll = tvhpoll_create(10);
+    pool->stats_clock = getmonoclock();
     pool->input = iptv_create_input(pool);
     tvh_pipe(O_NONBLOCK, &pool->pipe);
     tvhpoll_add1(pool->poll, pool->pipe.rd, TVHPOLL_IN, &pool->pipe);
@@ -1281,10 +1304,53 @@ iptv_input_thread_manage_cb(void *aux)
   iptv_input_thread_manage(iptv_tpool_safe_count(), 0);
 }
 
+/*
+ * Load of the input threads, the load (percent of the time spent
+ * in the read and dispatch) and the rate are computed from the
+ * previous call
+ */
+htsmsg_t *
+iptv_input_thread_stats ( void )
+{
+  iptv_thread_pool_t *pool;
+  htsmsg_t *l, *e, *m;
+  int64_t mono, busy, delta;
+  uint64_t bytes;
+  char ubuf[UUID_HEX_SIZE];
+  int num = 0;
+
+  lock_assert(&global_lock);
+
+  l = htsmsg_create_list();
+  mono = getmonoclock();
+  TAILQ_FOREACH(pool, &iptv_tpool, link) {
+    busy = atomic_get_s64(&pool->busy);
+    bytes = atomic_get_u64(&pool->bytes);
+    delta = MAX(1, mono - pool->stats_clock);
+    e = htsmsg_create_map();
+    htsmsg_add_u32(e, "thread", ++num);
+    htsmsg_add_str(e, "uuid", idnode_uuid_as_str(&pool->input->ti_id, ubuf));
+    htsmsg_add_u32(e, "streams", pool->streams);
+    htsmsg_add_s64(e, "reads", atomic_get_u64(&pool->reads));
+    htsmsg_add_s64(e, "bytes", bytes);
+    htsmsg_add_s64(e, "busy_ms", mono2ms(busy));
+    htsmsg_add_u32(e, "load", (busy - pool->stats_busy) * 100 / delta);
+    htsmsg_add_s64(e, "bps", (bytes - pool->stats_bytes) * 8 *
+                             MONOCLOCK_RESOLUTION / delta);
+    htsmsg_add_msg(l, NULL, e);
+    pool->stats_clock = mono;
+    pool->stats_busy = busy;
+    pool->stats_bytes = bytes;
+  }
+  m = htsmsg_create_map();
+  htsmsg_add_msg(m, "entries", l);
+  htsmsg_add_u32(m, "totalCount", num);
+  return m;
+}
+
 void iptv_init ( void )
 {
   TAILQ_INIT(&iptv_tpool);
-  tvh_mutex_init(&iptv_lock, NULL);
 
   /* Register handlers */
   iptv_http_init();
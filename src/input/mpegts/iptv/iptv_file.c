@@ -52,12 +52,12 @@ iptv_file_thread ( void *aux )
 #if defined(PLATFORM_DARWIN)
   fcntl(fd, F_NOCACHE, 1);
 #endif
-  tvh_mutex_lock(&iptv_lock);
+  tvh_mutex_lock(&im->im_lock);
   while (!fp->shutdown && fd > 0) {
     while (!fp->shutdown && pause) {
       mono = mclk() + sec2mono(1);
       do {
-        e = tvh_cond_timedwait(&fp->cond, &iptv_lock, mono);
+        e = tvh_cond_timedwait(&fp->cond, &im->im_lock, mono);
         if (e == ETIMEDOUT)
           break;
       } while (ERRNO_AGAIN(e));
@@ -65,9 +65,9 @@ iptv_file_thread ( void *aux )
     if (fp->shutdown)
       break;
     pause = 0;
-    tvh_mutex_unlock(&iptv_lock);
+    tvh_mutex_unlock(&im->im_lock);
     r = read(fd, buf, sizeof(buf));
-    tvh_mutex_lock(&iptv_lock);
+    tvh_mutex_lock(&im->im_lock);
     if (r == 0)
       break;
     if (r < 0) {
@@ -85,7 +85,7 @@ iptv_file_thread ( void *aux )
 #endif
     off += r;
   }
-  tvh_mutex_unlock(&iptv_lock);
+  tvh_mutex_unlock(&im->im_lock);
   return NULL;
 }
 
@@ -123,10 +123,10 @@ iptv_file_stop
     close(rd);
   fp->shutdown = 1;
   tvh_cond_signal(&fp->cond, 0);
-  tvh_mutex_unlock(&iptv_lock);
+  tvh_mutex_unlock(&im->im_lock);
   pthread_join(fp->tid, NULL);
   tvh_cond_destroy(&fp->cond);
-  tvh_mutex_lock(&iptv_lock);
+  tvh_mutex_lock(&im->im_lock);
   free(im->im_data);
   im->im_data = NULL;
 }
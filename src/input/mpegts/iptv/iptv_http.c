@@ -244,9 +244,9 @@ iptv_http_header ( http_client_t *hc )
 
   hp->m3u_header = 0;
   hp->off = 0;
-  tvh_mutex_lock(&iptv_lock);
+  tvh_mutex_lock(&im->im_lock);
   iptv_input_recv_flush(im);
-  tvh_mutex_unlock(&iptv_lock);
+  tvh_mutex_unlock(&im->im_lock);
 
   return 0;
 }
@@ -278,7 +278,7 @@ iptv_http_data
     return 0;
   }
 
-  tvh_mutex_lock(&iptv_lock);
+  tvh_mutex_lock(&im->im_lock);
 
   sb = &im->mm_iptv_buffer;
   if (hp->hls_encrypted) {
@@ -300,7 +300,7 @@ iptv_http_data
     memcpy(hp->hls_aes128.tmp + hp->hls_aes128.tmp_len, buf, len);
     hp->hls_aes128.tmp_len += len;
     if (off == sb->sb_ptr) {
-      tvh_mutex_unlock(&iptv_lock);
+      tvh_mutex_unlock(&im->im_lock);
       return 0;
     }
     buf = sb->sb_data + sb->sb_ptr;
@@ -317,7 +317,7 @@ iptv_http_data
       pause = hc->hc_pause = 1;
 
   if (pause) hp->unpause = 1;
-  tvh_mutex_unlock(&iptv_lock);
+  tvh_mutex_unlock(&im->im_lock);
 
   if (pause)
     gtimer_arm_rel(&hp->kick_timer, iptv_http_kick_cb, hc, 0);
@@ -551,9 +551,9 @@ iptv_http_stop
 
   hp->shutdown = 1;
   gtimer_disarm(&hp->kick_timer);
-  tvh_mutex_unlock(&iptv_lock);
+  tvh_mutex_unlock(&im->im_lock);
   http_client_close(hp->hc);
-  tvh_mutex_lock(&iptv_lock);
+  tvh_mutex_lock(&im->im_lock);
   hp->hc = NULL;
   im->im_data = NULL;
   iptv_http_free(hp);
@@ -342,6 +342,7 @@ iptv_mux_free ( mpegts_mux_t *mm )
   free(im->mm_iptv_tags);
   free(im->mm_iptv_icon);
   free(im->mm_iptv_epgid);
+  tvh_mutex_destroy(&im->im_lock);
   mpegts_mux_free(mm);
 }
 
@@ -398,6 +399,7 @@ iptv_mux_create0 ( iptv_network_t *in, const char *uuid, htsmsg_t *conf )
   if (!im->mm_iptv_kill_timeout)
     im->mm_iptv_kill_timeout = 5;
 
+  tvh_mutex_init(&im->im_lock, NULL);
   sbuf_init(&im->mm_iptv_buffer);
 
   /* Services */
@@ -177,6 +177,7 @@ struct iptv_mux
 
   uint32_t              mm_iptv_buffer_limit;
 
+  tvh_mutex_t           im_lock;  /* handler state, buffer and PCR pacing */
   iptv_handler_t       *im_handler;
   mtimer_t              im_pause_timer;
 
@@ -218,8 +219,6 @@ extern const idclass_t iptv_mux_class;
 
 extern iptv_network_t *iptv_network;
 
-extern tvh_mutex_t iptv_lock;
-
 int iptv_url_set ( char **url, char **sane_url, const char *str, int allow_file, int allow_pipe );
 
 void iptv_mux_load_all ( void );
@@ -326,7 +326,7 @@ iptv_rtsp_stop
   rp->hc->hc_aux = NULL;
   if (play)
     rtsp_teardown(rp->hc, rp->path, "");
-  tvh_mutex_unlock(&iptv_lock);
+  tvh_mutex_unlock(&im->im_lock);
   mtimer_disarm(&rp->alive_timer);
   udp_multirecv_free(&im->im_um);
   udp_multirecv_free(&im->im_rtcp_info.um);
@@ -336,7 +336,7 @@ iptv_rtsp_stop
   free(rp->query);
   rtcp_destroy(&im->im_rtcp_info);
   free(rp);
-  tvh_mutex_lock(&iptv_lock);
+  tvh_mutex_lock(&im->im_lock);
 }
 
 static void
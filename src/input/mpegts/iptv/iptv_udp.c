@@ -71,11 +71,11 @@ iptv_udp_stop
   ( iptv_input_t *mi, iptv_mux_t *im )
 {
   im->im_data = NULL;
-  tvh_mutex_unlock(&iptv_lock);
+  tvh_mutex_unlock(&im->im_lock);
   udp_multirecv_free(&im->im_um);
   udp_multirecv_free(&im->im_rtcp_info.um);
   sbuf_free(&im->im_temp_buffer);
-  tvh_mutex_lock(&iptv_lock);
+  tvh_mutex_lock(&im->im_lock);
 }
 
 static ssize_t
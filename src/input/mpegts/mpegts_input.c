@@ -26,6 +26,7 @@
 
 memoryinfo_t mpegts_input_queue_memoryinfo = { .my_name = "MPEG-TS input queue" };
 memoryinfo_t mpegts_input_table_memoryinfo = { .my_name = "MPEG-TS table queue" };
+memoryinfo_t mpegts_input_demux_memoryinfo = { .my_name = "MPEG-TS demux queue" };
 
 static void
 mpegts_input_del_network ( mpegts_network_link_t *mnl );
@@ -331,6 +332,20 @@ const idclass_t mpegts_input_class =
       .def.i    = 1,
       .opts     = PO_EXPERT,
     },
+    {
+      .type     = PT_INT,
+      .id       = "demux_threads",
+      .name     = N_("Demux threads"),
+      .desc     = N_("Number of threads used to demultiplex, parse and "
+                     "descramble the subscribed services (0 = disabled, "
+                     "everything is processed in the input thread). "
+                     "Each service is always handled by one thread. "
+                     "It may help when many services from one multiplex "
+                     "are subscribed."),
+      .off      = offsetof(mpegts_input_t, mi_demux_threads),
+      .def.i    = 0,
+      .opts     = PO_EXPERT,
+    },
     {
       .type     = PT_STR,
       .id       = "networks",
@@ -592,10 +607,6 @@ mpegts_input_close_pid
     skel.mps_weight = -1;
     skel.mps_owner  = owner;
     mps = RB_FIND(&mp->mp_subs, &skel, mps_link, mpegts_mps_cmp);
-    if (pid == mm->mm_last_pid) {
-      mm->mm_last_pid = -1;
-      mm->mm_last_mp = NULL;
-    }
     if (mps) {
       tvhdebug(LS_MPEGTS, "%s - close PID %04X (%d) [%d/%p]",
                mm->mm_nicename, mp->mp_pid, mp->mp_pid, type, owner);
@@ -609,12 +620,7 @@ mpegts_input_close_pid
     }
   }
   if (!RB_FIRST(&mp->mp_subs)) {
-    if (mm->mm_last_pid == mp->mp_pid) {
-      mm->mm_last_pid = -1;
-      mm->mm_last_mp = NULL;
-    }
-    RB_REMOVE(&mm->mm_pids, mp, mp_link);
-    free(mp);
+    mpegts_mux_remove_pid(mm, mp);
     return 1;
   } else {
     type = 0;
@@ -1145,57 +1151,273 @@ get_pcr ( const uint8_t *tsb, int64_t *rpcr )
   return 1;
 }
 
-static inline int
-ts_sync_count ( const uint8_t *tsb, int len )
-{
-  const uint8_t *start = tsb;
-  while (len >= 188) {
-    if (len >= 1880 &&
-        tsb[0*188] == 0x47 && tsb[1*188] == 0x47 &&
-        tsb[2*188] == 0x47 && tsb[3*188] == 0x47 &&
-        tsb[4*188] == 0x47 && tsb[5*188] == 0x47 &&
-        tsb[6*188] == 0x47 && tsb[7*188] == 0x47 &&
-        tsb[8*188] == 0x47 && tsb[9*188] == 0x47) {
-      len -= 1880;
-      tsb += 1880;
-    } else if (*tsb == 0x47) {
-      len -= 188;
-      tsb += 188;
-    } else {
+/*
+ * Input ring
+ *
+ * Note: all functions here must be called with mi_input_lock held
+ */
+
+static mpegts_packet_t *
+mpegts_input_ring_alloc ( mpegts_input_t *mi, uint32_t len )
+{
+  mpegts_packet_t *mp;
+  uint32_t off, rd, wr;
+
+  if (mi->mi_input_ring == NULL) {
+    if (!atomic_get(&mi->mi_running))
+      return NULL;
+    mi->mi_input_ring  = malloc(MPEGTS_INPUT_RING_SIZE);
+    mi->mi_input_slots = calloc(MPEGTS_INPUT_RING_SLOTS, sizeof(mpegts_packet_t));
+    mi->mi_input_ring_rd = mi->mi_input_ring_wr = 0;
+  }
+
+  /* Keep the order - overflowed data must be processed first */
+  if (!TAILQ_EMPTY(&mi->mi_input_queue))
+    return NULL;
+  if (mi->mi_input_slot_wr - mi->mi_input_slot_rd >= MPEGTS_INPUT_RING_SLOTS)
+    return NULL;
+
+  if (mi->mi_input_ring_fill == 0)
+    mi->mi_input_ring_rd = mi->mi_input_ring_wr = 0;
+
+  rd = mi->mi_input_ring_rd;
+  wr = mi->mi_input_ring_wr;
+  if (mi->mi_input_ring_fill == 0 || wr > rd) {
+    if (MPEGTS_INPUT_RING_SIZE - wr >= len)
+      off = wr;
+    else if (rd > len)
+      off = 0;
+    else
+      return NULL;
+  } else if (wr < rd && rd - wr > len) {
+    off = wr;
+  } else {
+    return NULL;
+  }
+
+  mp = &mi->mi_input_slots[mi->mi_input_slot_wr % MPEGTS_INPUT_RING_SLOTS];
+  mp->mp_data = mi->mi_input_ring + off;
+  mp->mp_ring = 1;
+  mi->mi_input_ring_wr = off + len;
+  mi->mi_input_ring_fill++;
+  mi->mi_input_slot_wr++;
+  return mp;
+}
+
+static inline mpegts_packet_t *
+mpegts_input_ring_slot ( mpegts_input_t *mi, uint32_t idx )
+{
+  return &mi->mi_input_slots[idx % MPEGTS_INPUT_RING_SLOTS];
+}
+
+/*
+ * Free the ring space of the processed packets (in the ring order)
+ */
+static void
+mpegts_input_ring_release ( mpegts_input_t *mi )
+{
+  mpegts_packet_t *mp;
+
+  while (mi->mi_input_slot_rd != mi->mi_input_slot_wr) {
+    mp = mpegts_input_ring_slot(mi, mi->mi_input_slot_rd);
+    if (atomic_get(&mp->mp_state) != MPEGTS_PACKET_DONE)
+      break;
+    mi->mi_input_slot_rd++;
+    assert(mi->mi_input_ring_fill > 0);
+    mi->mi_input_ring_fill--;
+  }
+  if (mi->mi_input_ring_fill == 0) {
+    mi->mi_input_ring_rd = mi->mi_input_ring_wr = 0;
+  } else {
+    mp = mpegts_input_ring_slot(mi, mi->mi_input_slot_rd);
+    mi->mi_input_ring_rd = mp->mp_data - mi->mi_input_ring;
+  }
+}
+
+/*
+ * Find the oldest published ring packet, the packets of a mux which
+ * has an older packet still being filled are skipped
+ */
+#define MPEGTS_INPUT_BLOCKED_MAX 16
+
+static mpegts_packet_t *
+mpegts_input_ring_take ( mpegts_input_t *mi )
+{
+  mpegts_packet_t *mp;
+  mpegts_mux_t *blocked[MPEGTS_INPUT_BLOCKED_MAX];
+  uint32_t idx;
+  int i, nblocked = 0;
+
+  for (idx = mi->mi_input_slot_rd; idx != mi->mi_input_slot_wr; idx++) {
+    mp = mpegts_input_ring_slot(mi, idx);
+    switch (atomic_get(&mp->mp_state)) {
+    case MPEGTS_PACKET_RESERVED:
+      for (i = 0; i < nblocked; i++)
+        if (blocked[i] == mp->mp_owner)
+          break;
+      if (i < nblocked)
+        break;
+      if (nblocked == MPEGTS_INPUT_BLOCKED_MAX)
+        return NULL;
+      blocked[nblocked++] = mp->mp_owner;
+      break;
+    case MPEGTS_PACKET_READY:
+      for (i = 0; i < nblocked; i++)
+        if (blocked[i] == mp->mp_owner)
+          break;
+      if (i < nblocked)
+        break;
+      mp->mp_state = MPEGTS_PACKET_TAKEN;
+      return mp;
+    default:
       break;
     }
   }
-  return tsb - start;
+  return NULL;
+}
+
+/*
+ * Take the oldest published packet from the queue, returns NULL when
+ * nothing is ready. Ring packets remain valid until
+ * mpegts_input_queue_done() is called.
+ */
+static mpegts_packet_t *
+mpegts_input_queue_take ( mpegts_input_t *mi )
+{
+  mpegts_packet_t *mp;
+
+  if (mi->mi_input_slot_rd != mi->mi_input_slot_wr) {
+    if ((mp = mpegts_input_ring_take(mi)) == NULL)
+      return NULL;
+  } else {
+    if ((mp = TAILQ_FIRST(&mi->mi_input_queue)) == NULL ||
+        atomic_get(&mp->mp_state) != MPEGTS_PACKET_READY)
+      return NULL;
+    TAILQ_REMOVE(&mi->mi_input_queue, mp, mp_link);
+  }
+  mi->mi_input_queue_size -= mp->mp_len;
+  memoryinfo_free(&mpegts_input_queue_memoryinfo, sizeof(mpegts_packet_t) + mp->mp_len);
+  return mp;
 }
 
 static void
-mpegts_input_queue_packets
-  ( mpegts_mux_instance_t *mmi, mpegts_packet_t *mp )
+mpegts_input_queue_done ( mpegts_input_t *mi, mpegts_packet_t *mp )
+{
+  if (mp->mp_ring) {
+    mp->mp_state = MPEGTS_PACKET_DONE;
+    mpegts_input_ring_release(mi);
+  } else {
+    free(mp);
+  }
+}
+
+/*
+ * Drop all queued packets (the input thread finished), the packets
+ * still being filled are waited for when wait is set
+ */
+static void
+mpegts_input_queue_flush ( mpegts_input_t *mi, int wait )
+{
+  mpegts_packet_t *mp, *mp_next;
+  uint32_t idx;
+  int reserved;
+
+  atomic_add(&mi->mi_input_waiting, 1);
+  do {
+    reserved = 0;
+    for (idx = mi->mi_input_slot_rd; idx != mi->mi_input_slot_wr; idx++) {
+      mp = mpegts_input_ring_slot(mi, idx);
+      if (atomic_get(&mp->mp_state) == MPEGTS_PACKET_RESERVED)
+        reserved = 1;
+      if (atomic_get(&mp->mp_state) != MPEGTS_PACKET_READY)
+        continue;
+      mi->mi_input_queue_size -= mp->mp_len;
+      memoryinfo_free(&mpegts_input_queue_memoryinfo, sizeof(mpegts_packet_t) + mp->mp_len);
+      if (mp->mp_mux)
+        mpegts_mux_release(mp->mp_mux);
+      mp->mp_state = MPEGTS_PACKET_DONE;
+    }
+    mpegts_input_ring_release(mi);
+    for (mp = TAILQ_FIRST(&mi->mi_input_queue); mp; mp = mp_next) {
+      mp_next = TAILQ_NEXT(mp, mp_link);
+      if (atomic_get(&mp->mp_state) != MPEGTS_PACKET_READY) {
+        reserved = 1;
+        continue;
+      }
+      TAILQ_REMOVE(&mi->mi_input_queue, mp, mp_link);
+      mi->mi_input_queue_size -= mp->mp_len;
+      memoryinfo_free(&mpegts_input_queue_memoryinfo, sizeof(mpegts_packet_t) + mp->mp_len);
+      if (mp->mp_mux)
+        mpegts_mux_release(mp->mp_mux);
+      free(mp);
+    }
+    if (reserved && wait)
+      tvh_cond_timedwait(&mi->mi_input_cond, &mi->mi_input_lock,
+                         mclk() + ms2mono(10));
+  } while (reserved && wait);
+  atomic_dec(&mi->mi_input_waiting, 1);
+}
+
+static mpegts_packet_t *
+mpegts_input_queue_reserve
+  ( mpegts_mux_instance_t *mmi, int len, int cc_restart )
 {
   mpegts_input_t *mi = mmi->mmi_input;
+  mpegts_packet_t *mp = NULL;
   const char *id = SRCLINEID();
-  int len = mp->mp_len;
 
   tvh_mutex_lock(&mi->mi_input_lock);
   if (mmi->mmi_mux->mm_active == mmi) {
-    if (mi->mi_input_queue_size < 50*1024*1024) {
+    if (mi->mi_input_queue_size < MPEGTS_INPUT_QUEUE_MAX) {
+      if ((mp = mpegts_input_ring_alloc(mi, len)) == NULL) {
+        mp = malloc(sizeof(mpegts_packet_t) + len);
+        mp->mp_data = (uint8_t *)(mp + 1);
+        mp->mp_ring = 0;
+        TAILQ_INSERT_TAIL(&mi->mi_input_queue, mp, mp_link);
+      }
+      mp->mp_len        = len;
+      mp->mp_mux        = mmi->mmi_mux;
+      mp->mp_owner      = mmi->mmi_mux;
+      mp->mp_cc_restart = cc_restart;
+      mp->mp_state      = MPEGTS_PACKET_RESERVED;
       mi->mi_input_queue_size += len;
       memoryinfo_alloc(&mpegts_input_queue_memoryinfo, sizeof(mpegts_packet_t) + len);
       mpegts_mux_grab(mp->mp_mux);
-      TAILQ_INSERT_TAIL(&mi->mi_input_queue, mp, mp_link);
       tprofile_queue_add(&mi->mi_qprofile, id, len);
       tprofile_queue_set(&mi->mi_qprofile, id, mi->mi_input_queue_size);
-      tvh_cond_signal(&mi->mi_input_cond, 0);
     } else {
       if (tvhlog_limit(&mi->mi_input_queue_loglimit, 10))
         tvhwarn(LS_MPEGTS, "too much queued input data (over 50MB) for %s, discarding new", mi->mi_name);
       tprofile_queue_drop(&mi->mi_qprofile, id, len);
-      free(mp);
     }
-  } else {
-    free(mp);
   }
   tvh_mutex_unlock(&mi->mi_input_lock);
+  return mp;
+}
+
+static void
+mpegts_input_queue_commit
+  ( mpegts_input_t *mi, mpegts_packet_t *mp, int drop )
+{
+  /* mp_mux may be cleared by mpegts_input_flush_mux() */
+  if (drop) {
+    tvh_mutex_lock(&mi->mi_input_lock);
+    if (mp->mp_mux) {
+      mpegts_mux_release(mp->mp_mux);
+      mp->mp_mux = NULL;
+    }
+    atomic_add(&mp->mp_state, MPEGTS_PACKET_READY);
+    tvh_cond_signal(&mi->mi_input_cond, 0);
+    tvh_mutex_unlock(&mi->mi_input_lock);
+    return;
+  }
+  /* full barriers: pairs with the mi_input_waiting check in the input thread */
+  atomic_add(&mp->mp_state, MPEGTS_PACKET_READY);
+  if (atomic_get(&mi->mi_input_waiting)) {
+    tvh_mutex_lock(&mi->mi_input_lock);
+    tvh_cond_signal(&mi->mi_input_cond, 0);
+    tvh_mutex_unlock(&mi->mi_input_lock);
+  }
 }
 
 void
@@ -1204,9 +1426,9 @@ mpegts_input_recv_packets
     int flags, mpegts_pcr_t *pcr )
 {
   mpegts_input_t *mi = mmi->mmi_input;
-  int len, len2, off;
+  int len, len2, off, skip;
   mpegts_packet_t *mp;
-  uint8_t *tsb;
+  uint8_t *tsb, *sync;
 #define MIN_TS_PKT 100
 #define MIN_TS_SYN (5*188)
 
@@ -1226,11 +1448,14 @@ retry:
 
   /* Check for sync */
   while ( (len >= MIN_TS_SYN) &&
-          ((len2 = ts_sync_count(tsb, len)) < MIN_TS_SYN) ) {
-    atomic_add(&mmi->tii_stats.unc, 1);
-    --len;
-    ++tsb;
-    ++off;
+          ((len2 = mpegts_sync_count(tsb, len)) < MIN_TS_SYN) ) {
+    /* skip to the next sync byte candidate (memchr is vectorized) */
+    sync = memchr(tsb + 1, 0x47, len - 1);
+    skip = sync ? sync - tsb : len;
+    atomic_add(&mmi->tii_stats.unc, skip);
+    len -= skip;
+    tsb += skip;
+    off += skip;
   }
 
   // Note: we check for sync here so that the buffer can always be
@@ -1266,31 +1491,21 @@ retry:
 
   /* Pass */
   if (len2 >= MIN_TS_SYN || (flags & MPEGTS_DATA_CC_RESTART)) {
-    mp = malloc(sizeof(mpegts_packet_t) + len2);
-    mp->mp_mux        = mmi->mmi_mux;
-    mp->mp_len        = len2;
-    mp->mp_cc_restart = (flags & MPEGTS_DATA_CC_RESTART) ? 1 : 0;
-
-    memcpy(mp->mp_data, tsb, len2);
-    if (mi->mi_remove_scrambled_bits || (flags & MPEGTS_DATA_REMOVE_SCRAMBLED) != 0) {
-      uint8_t *tmp, *end;
-      for (tmp = mp->mp_data, end = mp->mp_data + len2; tmp < end; tmp += 188)
-        tmp[3] &= ~0xc0;
+    mp = mpegts_input_queue_reserve(mmi, len2,
+                                    (flags & MPEGTS_DATA_CC_RESTART) ? 1 : 0);
+    if (mp) {
+      memcpy(mp->mp_data, tsb, len2);
+      if (mi->mi_remove_scrambled_bits || (flags & MPEGTS_DATA_REMOVE_SCRAMBLED) != 0)
+        mpegts_clear_scrambled(mp->mp_data, len2);
+      mpegts_input_queue_commit(mi, mp,
+        (flags & MPEGTS_DATA_CC_RESTART) == 0 && data_noise(mp));
     }
 
     len -= len2;
     off += len2;
-
-    if ((flags & MPEGTS_DATA_CC_RESTART) == 0 && data_noise(mp)) {
-      free(mp);
-      goto end;
-    }
-
-    mpegts_input_queue_packets(mmi, mp);
   }
 
   /* Adjust buffer */
-end:
   if (len && (flags & MPEGTS_DATA_CC_RESTART) == 0) {
     sbuf_cut(sb, off); // cut off the bottom
     if (sb->sb_ptr >= MIN_TS_PKT * 188)
@@ -1415,6 +1630,200 @@ mpegts_input_table_waiting ( mpegts_input_t *mi, mpegts_mux_t *mm )
   tvh_mutex_unlock(&mm->mm_tables_lock);
 }
 
+/*
+ * Service demux workers
+ *
+ * The input thread appends the service packets to a per-worker batch
+ * (the service determines the worker, so the order is preserved for
+ * each service) and the batches are queued when the input chunk is
+ * processed. The table processing stays in the input thread.
+ */
+
+typedef struct mpegts_demux_item {
+  mpegts_service_t *mdi_service;
+  uint64_t          mdi_tspos;
+  uint32_t          mdi_len;
+  uint16_t          mdi_pid;
+  uint8_t           mdi_table;
+} mpegts_demux_item_t;
+
+typedef struct mpegts_demux_batch {
+  TAILQ_ENTRY(mpegts_demux_batch) mdb_link;
+  uint8_t                        *mdb_data;
+  int                             mdb_len;
+} mpegts_demux_batch_t;
+
+struct mpegts_demux_worker {
+  pthread_t                          mdw_tid;
+  tvh_mutex_t                        mdw_lock;
+  tvh_cond_t                         mdw_cond;
+  TAILQ_HEAD(,mpegts_demux_batch)    mdw_queue;
+  uint64_t                           mdw_queue_size;
+  int                                mdw_running;
+  tvhlog_limit_t                     mdw_loglimit;
+  sbuf_t                             mdw_sb;    /* used by the input thread */
+  mpegts_input_t                    *mdw_input;
+};
+
+static void
+mpegts_input_demux_batch_process ( mpegts_demux_batch_t *mdb, int deliver )
+{
+  mpegts_demux_item_t mdi;
+  uint8_t *p = mdb->mdb_data, *end = p + mdb->mdb_len;
+
+  while (p < end) {
+    memcpy(&mdi, p, sizeof(mdi));
+    p += sizeof(mdi);
+    if (deliver)
+      ts_recv_packet1(mdi.mdi_service, mdi.mdi_tspos, mdi.mdi_pid,
+                      p, mdi.mdi_len, mdi.mdi_table);
+    service_unref((service_t *)mdi.mdi_service);
+    p += mdi.mdi_len;
+  }
+  free(mdb->mdb_data);
+  free(mdb);
+}
+
+static void *
+mpegts_input_demux_thread ( void *aux )
+{
+  mpegts_demux_worker_t *mdw = aux;
+  mpegts_demux_batch_t *mdb;
+
+  tvh_mutex_lock(&mdw->mdw_lock);
+  while (1) {
+    if ((mdb = TAILQ_FIRST(&mdw->mdw_queue)) == NULL) {
+      if (!mdw->mdw_running)
+        break;
+      tvh_cond_wait(&mdw->mdw_cond, &mdw->mdw_lock);
+      continue;
+    }
+    TAILQ_REMOVE(&mdw->mdw_queue, mdb, mdb_link);
+    mdw->mdw_queue_size -= mdb->mdb_len;
+    memoryinfo_free(&mpegts_input_demux_memoryinfo, sizeof(*mdb) + mdb->mdb_len);
+    tvh_mutex_unlock(&mdw->mdw_lock);
+    mpegts_input_demux_batch_process(mdb, 1);
+    tvh_mutex_lock(&mdw->mdw_lock);
+  }
+  tvh_mutex_unlock(&mdw->mdw_lock);
+  return NULL;
+}
+
+static void
+mpegts_input_demux_stop ( mpegts_input_t *mi )
+{
+  mpegts_demux_worker_t *mdw;
+  int i;
+
+  for (i = 0; i < mi->mi_demux_count; i++) {
+    mdw = &mi->mi_demux_workers[i];
+    tvh_mutex_lock(&mdw->mdw_lock);
+    mdw->mdw_running = 0;
+    tvh_cond_signal(&mdw->mdw_cond, 0);
+    tvh_mutex_unlock(&mdw->mdw_lock);
+  }
+  for (i = 0; i < mi->mi_demux_count; i++) {
+    mdw = &mi->mi_demux_workers[i];
+    pthread_join(mdw->mdw_tid, NULL);
+    sbuf_free(&mdw->mdw_sb);
+    tvh_cond_destroy(&mdw->mdw_cond);
+    tvh_mutex_destroy(&mdw->mdw_lock);
+  }
+  free(mi->mi_demux_workers);
+  mi->mi_demux_workers = NULL;
+  mi->mi_demux_count = 0;
+}
+
+static void
+mpegts_input_demux_check ( mpegts_input_t *mi, const char *name )
+{
+  mpegts_demux_worker_t *mdw;
+  int i, count = MINMAX(atomic_get(&mi->mi_demux_threads), 0, MPEGTS_DEMUX_THREADS_MAX);
+
+  if (count == mi->mi_demux_count)
+    return;
+  mpegts_input_demux_stop(mi);
+  if (count == 0)
+    return;
+  tvhdebug(LS_MPEGTS, "input %s using %d demux threads", name, count);
+  mi->mi_demux_workers = calloc(count, sizeof(mpegts_demux_worker_t));
+  mi->mi_demux_count = count;
+  for (i = 0; i < count; i++) {
+    mdw = &mi->mi_demux_workers[i];
+    mdw->mdw_input = mi;
+    mdw->mdw_running = 1;
+    tvh_mutex_init(&mdw->mdw_lock, NULL);
+    tvh_cond_init(&mdw->mdw_cond, 1);
+    TAILQ_INIT(&mdw->mdw_queue);
+    sbuf_init(&mdw->mdw_sb);
+    tvh_thread_create(&mdw->mdw_tid, NULL, mpegts_input_demux_thread,
+                      mdw, "mi-demux");
+  }
+}
+
+static inline void
+mpegts_input_demux_queue
+  ( mpegts_input_t *mi, mpegts_service_t *t, uint64_t tspos, uint16_t pid,
+    const uint8_t *tsb, int len, int table )
+{
+  mpegts_demux_worker_t *mdw;
+  mpegts_demux_item_t mdi;
+  uint32_t h = (uint32_t)((uintptr_t)t >> 4) * 2654435761U;
+
+  mdw = &mi->mi_demux_workers[(h >> 16) % mi->mi_demux_count];
+  mdi.mdi_service = t;
+  mdi.mdi_tspos   = tspos;
+  mdi.mdi_len     = len;
+  mdi.mdi_pid     = pid;
+  mdi.mdi_table   = table;
+  service_ref((service_t *)t);
+  sbuf_append(&mdw->mdw_sb, &mdi, sizeof(mdi));
+  sbuf_append(&mdw->mdw_sb, tsb, len);
+}
+
+static void
+mpegts_input_demux_flush ( mpegts_input_t *mi )
+{
+  mpegts_demux_worker_t *mdw;
+  mpegts_demux_batch_t *mdb;
+  int i;
+
+  for (i = 0; i < mi->mi_demux_count; i++) {
+    mdw = &mi->mi_demux_workers[i];
+    if (mdw->mdw_sb.sb_ptr == 0)
+      continue;
+    mdb = malloc(sizeof(*mdb));
+    mdb->mdb_data = mdw->mdw_sb.sb_data;
+    mdb->mdb_len  = mdw->mdw_sb.sb_ptr;
+    sbuf_steal_data(&mdw->mdw_sb);
+    tvh_mutex_lock(&mdw->mdw_lock);
+    if (mdw->mdw_queue_size < MPEGTS_DEMUX_QUEUE_MAX) {
+      TAILQ_INSERT_TAIL(&mdw->mdw_queue, mdb, mdb_link);
+      mdw->mdw_queue_size += mdb->mdb_len;
+      memoryinfo_alloc(&mpegts_input_demux_memoryinfo, sizeof(*mdb) + mdb->mdb_len);
+      tvh_cond_signal(&mdw->mdw_cond, 0);
+      mdb = NULL;
+    } else if (tvhlog_limit(&mdw->mdw_loglimit, 10)) {
+      tvhwarn(LS_MPEGTS, "too much queued demux data for %s (thread %d), discarding new",
+              mi->mi_name, i);
+    }
+    tvh_mutex_unlock(&mdw->mdw_lock);
+    if (mdb)
+      mpegts_input_demux_batch_process(mdb, 0);
+  }
+}
+
+static inline void
+mpegts_input_deliver
+  ( mpegts_input_t *mi, mpegts_service_t *t, uint64_t tspos, uint16_t pid,
+    const uint8_t *tsb, int len, int table )
+{
+  if (mi->mi_demux_count)
+    mpegts_input_demux_queue(mi, t, tspos, pid, tsb, len, table);
+  else
+    ts_recv_packet1(t, tspos, pid, tsb, len, table);
+}
+
 static int
 mpegts_input_process
   ( mpegts_input_t *mi, mpegts_packet_t *mpkt )
@@ -1440,9 +1849,12 @@ mpegts_input_process
   assert(mm == mmi->mmi_mux);
 
   if (mpkt->mp_cc_restart) {
-    LIST_FOREACH(s, &mm->mm_transports, s_active_link)
+    LIST_FOREACH(s, &mm->mm_transports, s_active_link) {
+      tvh_mutex_lock(&s->s_stream_mutex);
       TAILQ_FOREACH(st, &s->s_components.set_all, es_link)
         st->es_cc = -1;
+      tvh_mutex_unlock(&s->s_stream_mutex);
+    }
     RB_FOREACH(mp, &mm->mm_pids, mp_link) {
       mp->mp_cc = 0xff;
       if (mp->mp_type & MPS_FTABLE) {
@@ -1524,7 +1936,7 @@ mpegts_input_process
           f = (type & (MPS_TABLE|MPS_FTABLE)) ||
               (pid == s->s_components.set_pmt_pid) ||
               (pid == s->s_components.set_pcr_pid);
-          ts_recv_packet1((mpegts_service_t*)s, tspos, pid, tsb, llen, f);
+          mpegts_input_deliver(mi, (mpegts_service_t*)s, tspos, pid, tsb, llen, f);
         }
       } else
       /* Stream table data */
@@ -1534,7 +1946,7 @@ mpegts_input_process
           f = (type & (MPS_TABLE|MPS_FTABLE)) ||
               (pid == s->s_components.set_pmt_pid) ||
               (pid == s->s_components.set_pcr_pid);
-          ts_recv_packet1((mpegts_service_t*)s, tspos, pid, tsb, llen, f);
+          mpegts_input_deliver(mi, (mpegts_service_t*)s, tspos, pid, tsb, llen, f);
         }
       }
 
@@ -1590,6 +2002,10 @@ done:
     tspos += llen;
   }
 
+  /* Queue the service data */
+  if (mi->mi_demux_count)
+    mpegts_input_demux_flush(mi);
+
   /* Raw stream */
   if (tsb != mpkt->mp_data &&
       LIST_FIRST(&mmi->mmi_streaming_pad.sp_targets) != NULL) {
@@ -1717,18 +2133,23 @@ mpegts_input_thread ( void * p )
   while (atomic_get(&mi->mi_running)) {
 
     /* Wait for a packet */
-    if (!(mp = TAILQ_FIRST(&mi->mi_input_queue))) {
+    if (!(mp = mpegts_input_queue_take(mi))) {
       if (bytes) {
         tvhtrace(LS_MPEGTS, "input %s got %zu bytes", buf, bytes);
         bytes = 0;
       }
-      tvh_cond_wait(&mi->mi_input_cond, &mi->mi_input_lock);
-      continue;
+      atomic_add(&mi->mi_input_waiting, 1);
+      if (!(mp = mpegts_input_queue_take(mi))) {
+        tvh_cond_wait(&mi->mi_input_cond, &mi->mi_input_lock);
+        atomic_dec(&mi->mi_input_waiting, 1);
+        continue;
+      }
+      atomic_dec(&mi->mi_input_waiting, 1);
     }
-    mi->mi_input_queue_size -= mp->mp_len;
-    memoryinfo_free(&mpegts_input_queue_memoryinfo, sizeof(mpegts_packet_t) + mp->mp_len);
-    TAILQ_REMOVE(&mi->mi_input_queue, mp, mp_link);
     tvh_mutex_unlock(&mi->mi_input_lock);
+
+    /* Demux threads */
+    mpegts_input_demux_check(mi, buf);
       
     /* Process */
     tvh_mutex_lock(&mi->mi_output_lock);
@@ -1754,7 +2175,6 @@ mpegts_input_thread ( void * p )
     /* Cleanup */
     if (mp->mp_mux)
       mpegts_mux_release(mp->mp_mux);
-    free(mp);
 
 #if ENABLE_TSDEBUG
     {
@@ -1764,19 +2184,18 @@ mpegts_input_thread ( void * p )
 #endif
 
     tvh_mutex_lock(&mi->mi_input_lock);
+    mpegts_input_queue_done(mi, mp);
   }
 
   tvhtrace(LS_MPEGTS, "input %s got %zu bytes (finish)", buf, bytes);
 
-  /* Flush */
-  while ((mp = TAILQ_FIRST(&mi->mi_input_queue))) {
-    memoryinfo_free(&mpegts_input_queue_memoryinfo, sizeof(mpegts_packet_t) + mp->mp_len);
-    TAILQ_REMOVE(&mi->mi_input_queue, mp, mp_link);
-    if (mp->mp_mux)
-      mpegts_mux_release(mp->mp_mux);
-    free(mp);
-  }
-  mi->mi_input_queue_size = 0;
+  /* Stop demux threads */
+  tvh_mutex_unlock(&mi->mi_input_lock);
+  mpegts_input_demux_stop(mi);
+  tvh_mutex_lock(&mi->mi_input_lock);
+
+  /* Flush (the rest is dropped in mpegts_input_thread_stop) */
+  mpegts_input_queue_flush(mi, 0);
   tvh_mutex_unlock(&mi->mi_input_lock);
 
   tprofile_done(&tprofile);
@@ -1839,6 +2258,7 @@ mpegts_input_flush_mux
 {
   mpegts_table_feed_t *mtf;
   mpegts_packet_t *mp;
+  uint32_t u32;
 
   lock_assert(&global_lock);
 
@@ -1848,6 +2268,15 @@ mpegts_input_flush_mux
 
   /* Flush input Q */
   tvh_mutex_lock(&mi->mi_input_lock);
+  for (u32 = mi->mi_input_slot_rd; u32 != mi->mi_input_slot_wr; u32++) {
+    mp = &mi->mi_input_slots[u32 % MPEGTS_INPUT_RING_SLOTS];
+    if (atomic_get(&mp->mp_state) >= MPEGTS_PACKET_TAKEN)
+      continue;
+    if (mp->mp_mux == mm) {
+      mpegts_mux_release(mm);
+      mp->mp_mux = NULL;
+    }
+  }
   TAILQ_FOREACH(mp, &mi->mi_input_queue, mp_link) {
     if (mp->mp_mux == mm) {
       mpegts_mux_release(mm);
@@ -2024,6 +2453,11 @@ mpegts_input_thread_stop ( mpegts_input_t *mi )
   if (mi->mi_table_tid)
     pthread_join(mi->mi_table_tid, NULL);
   tvh_mutex_lock(&global_lock);
+
+  /* Drop the packets queued meanwhile (no mux instances are left) */
+  tvh_mutex_lock(&mi->mi_input_lock);
+  mpegts_input_queue_flush(mi, 1);
+  tvh_mutex_unlock(&mi->mi_input_lock);
 }
 
 /* **************************************************************************
@@ -2169,6 +2603,8 @@ mpegts_input_delete ( mpegts_input_t *mi, int delconf )
   mpegts_input_thread_stop(mi);
 
   tprofile_queue_done(&mi->mi_qprofile);
+  free(mi->mi_input_ring);
+  free(mi->mi_input_slots);
   tvh_mutex_destroy(&mi->mi_output_lock);
   tvh_cond_destroy(&mi->mi_table_cond);
   free(mi->mi_name);
@@ -895,8 +895,6 @@ mpegts_mux_stop ( mpegts_mux_t *mm, int force, int reason )
 
   /* Ensure PIDs are cleared */
   tvh_mutex_lock(&mi->mi_output_lock);
-  mm->mm_last_pid = -1;
-  mm->mm_last_mp = NULL;
   while ((mp = RB_FIRST(&mm->mm_pids))) {
     assert(mi);
     if (mp->mp_pid == MPEGTS_FULLMUX_PID ||
@@ -922,8 +920,7 @@ mpegts_mux_stop ( mpegts_mux_t *mm, int force, int reason )
         free(mps);
       }
     }
-    RB_REMOVE(&mm->mm_pids, mp, mp_link);
-    free(mp);
+    mpegts_mux_remove_pid(mm, mp);
   }
   tvh_mutex_unlock(&mi->mi_output_lock);
 
@@ -1255,7 +1252,6 @@ mpegts_mux_create0
   TAILQ_INIT(&mm->mm_descrambler_emms);
   tvh_mutex_init(&mm->mm_descrambler_lock, NULL);
 
-  mm->mm_last_pid            = -1;
   mm->mm_created             = gclk();
 
   /* Configuration */
@@ -1513,34 +1509,47 @@ static int mp_cmp ( mpegts_pid_t *a, mpegts_pid_t *b )
   return a->mp_pid - b->mp_pid;
 }
 
+/*
+ * Note: mm_pids_table mirrors mm_pids (the tree is kept for the ordered
+ *       traversal), the table is used for the lookups
+ */
 mpegts_pid_t *
 mpegts_mux_find_pid_ ( mpegts_mux_t *mm, int pid, int create )
 {
-  mpegts_pid_t skel, *mp;
+  mpegts_pid_t *mp;
 
   if (pid < 0 || pid > MPEGTS_TABLES_PID) return NULL;
 
-  skel.mp_pid = pid;
-  mp = RB_FIND(&mm->mm_pids, &skel, mp_link, mp_cmp);
-  if (mp == NULL) {
-    if (create) {
-      mp = calloc(1, sizeof(*mp));
-      mp->mp_pid = pid;
-      if (!RB_INSERT_SORTED(&mm->mm_pids, mp, mp_link, mp_cmp)) {
-        mp->mp_cc = -1;
-      } else {
-        free(mp);
-        mp = NULL;
-      }
+  mp = mm->mm_pids_table ? mm->mm_pids_table[pid] : NULL;
+  if (mp == NULL && create) {
+    if (mm->mm_pids_table == NULL)
+      mm->mm_pids_table = calloc(MPEGTS_TABLES_PID + 1, sizeof(mpegts_pid_t *));
+    mp = calloc(1, sizeof(*mp));
+    mp->mp_pid = pid;
+    if (!RB_INSERT_SORTED(&mm->mm_pids, mp, mp_link, mp_cmp)) {
+      mp->mp_cc = -1;
+      mm->mm_pids_table[pid] = mp;
+    } else {
+      free(mp);
+      mp = NULL;
     }
   }
-  if (mp) {
-    mm->mm_last_pid = pid;
-    mm->mm_last_mp = mp;
-  }
   return mp;
 }
 
+void
+mpegts_mux_remove_pid ( mpegts_mux_t *mm, mpegts_pid_t *mp )
+{
+  assert(mm->mm_pids_table && mm->mm_pids_table[mp->mp_pid] == mp);
+  mm->mm_pids_table[mp->mp_pid] = NULL;
+  RB_REMOVE(&mm->mm_pids, mp, mp_link);
+  free(mp);
+  if (RB_FIRST(&mm->mm_pids) == NULL) {
+    free(mm->mm_pids_table);
+    mm->mm_pids_table = NULL;
+  }
+}
+
 /* **************************************************************************
  * Misc
  * *************************************************************************/
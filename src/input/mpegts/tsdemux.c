@@ -24,6 +24,8 @@
 #include "tsdemux.h"
 
 #define TS_REMUX_BUFSIZE (188 * 100)
+/* room for the packets appended past the flush limit */
+#define TS_REMUX_ALLOCSIZE (TS_REMUX_BUFSIZE + 188 * 8)
 
 static void ts_remux(mpegts_service_t *t, const uint8_t *tsb, int len, int errors);
 static void ts_skip(mpegts_service_t *t, const uint8_t *tsb, int len);
@@ -296,7 +298,14 @@ ts_flush(mpegts_service_t *t, sbuf_t *sb)
 
   t->s_tsbuf_last = mclk();
 
-  pb = pktbuf_alloc(sb->sb_data, sb->sb_ptr);
+  /* hand the remux buffer over, the next one is allocated on demand */
+  if (sb->sb_ptr > 0) {
+    if (sb->sb_ptr < sb->sb_size / 2)
+      sbuf_realloc(sb, sb->sb_ptr);
+    pb = pktbuf_make(sb->sb_data, sb->sb_ptr);
+  } else {
+    pb = pktbuf_alloc(NULL, 0);
+  }
   pb->pb_err = sb->sb_err;
 
   memset(&sm, 0, sizeof(sm));
@@ -309,7 +318,10 @@ ts_flush(mpegts_service_t *t, sbuf_t *sb)
   service_set_streaming_status_flags((service_t *)t, TSS_PACKETS);
   t->s_streaming_live |= TSS_LIVE;
 
-  sbuf_reset(sb, 2*TS_REMUX_BUFSIZE);
+  if (sb->sb_ptr > 0)
+    sbuf_steal_data(sb);
+  else
+    sb->sb_err = 0;
 }
 
 /**
@@ -321,7 +333,7 @@ ts_remux(mpegts_service_t *t, const uint8_t *src, int len, int errors)
   sbuf_t *sb = &t->s_tsbuf;
 
   if (sb->sb_data == NULL)
-    sbuf_init_fixed(sb, TS_REMUX_BUFSIZE);
+    sbuf_init_fixed(sb, TS_REMUX_ALLOCSIZE);
 
   sbuf_append(sb, src, len);
   sb->sb_err += errors;
@@ -344,7 +356,7 @@ ts_skip(mpegts_service_t *t, const uint8_t *src, int len)
     return;
 
   if (sb->sb_data == NULL)
-    sbuf_init_fixed(sb, TS_REMUX_BUFSIZE);
+    sbuf_init_fixed(sb, TS_REMUX_ALLOCSIZE);
 
   sb->sb_err += len / 188;
 
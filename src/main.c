@@ -75,6 +75,7 @@
 #include "packet.h"
 #include "streaming.h"
 #include "memoryinfo.h"
+#include "mempool.h"
 #include "watchdog.h"
 #include "tprofile.h"
 #if CONFIG_LINUXDVB_CA
@@ -791,7 +792,7 @@ main(int argc, char **argv)
 #endif
   int  log_level   = LOG_INFO;
   int  log_options = TVHLOG_OPT_MILLIS | TVHLOG_OPT_STDERR | TVHLOG_OPT_SYSLOG;
-  const char *log_debug = NULL, *log_trace = NULL;
+  const char *log_debug = NULL, *log_trace = NULL, *tsscan;
   gid_t gid = -1;
   uid_t uid = -1;
   char buf[512];
@@ -852,6 +853,7 @@ main(int argc, char **argv)
               opt_dbus         = 0,
               opt_dbus_session = 0,
               opt_nobackup     = 0,
+              opt_settingsdb   = 0,
               opt_nobat        = 0,
               opt_subsystems   = 0,
               opt_tprofile     = 0,
@@ -869,6 +871,7 @@ main(int argc, char **argv)
              *opt_bindaddr     = NULL,
              *opt_subscribe    = NULL,
              *opt_user_agent   = NULL,
+             *opt_tsscan       = NULL,
              *opt_satip_bindaddr = NULL;
   static char *__opt_satip_xml[10];
   str_list_t  opt_satip_xml    = { .max = 10, .num = 0, .str = __opt_satip_xml };
@@ -882,6 +885,8 @@ main(int argc, char **argv)
     {   0, NULL,        N_("Service configuration"),   OPT_BOOL, NULL         },
     { 'c', "config",    N_("Alternate configuration path"), OPT_STR,  &opt_config  },
     { 'B', "nobackup",  N_("Don't backup configuration tree at upgrade"), OPT_BOOL, &opt_nobackup },
+    {   0, "settingsdb", N_("Convert the configuration tree to the single-file\n"
+                            "settings store (settings.db)"), OPT_BOOL, &opt_settingsdb },
     { 'f', "fork",      N_("Fork and run as daemon"),  OPT_BOOL, &opt_fork    },
     { 'u', "user",      N_("Run as user"),             OPT_STR,  &opt_user    },
     { 'g', "group",     N_("Run as group"),            OPT_STR,  &opt_group   },
@@ -965,6 +970,8 @@ main(int argc, char **argv)
 #endif
 
     { 0, "tprofile", N_("Gather timing statistics for the code"), OPT_BOOL, &opt_tprofile },
+    { 0, "tsscan", N_("TS scan implementation (auto, scalar, sse2, avx2, neon)"),
+      OPT_STR, &opt_tsscan },
 #if ENABLE_TRACE
     { 0, "thrdebug", N_("Thread debugging"), OPT_INT, &opt_thread_debug },
 #endif
@@ -1152,6 +1159,11 @@ main(int argc, char **argv)
   tprofile_module_init(opt_tprofile);
   tprofile_init(&gtimer_profile, "gtimer");
   tprofile_init(&mtimer_profile, "mtimer");
+  if ((tsscan = tsscan_init(opt_tsscan)) == NULL) {
+    tvhwarn(LS_START, "TS scan implementation '%s' is not supported", opt_tsscan);
+    tsscan = tsscan_init(NULL);
+  }
+  tvhdebug(LS_START, "TS scan implementation: %s", tsscan);
   uuid_init();
   idnode_boot();
   config_boot(opt_config, gid, uid, opt_user_agent);
@@ -1249,10 +1261,11 @@ main(int argc, char **argv)
   RAND_seed(&randseed, sizeof(randseed));
 
   /* Initialise configuration */
+  tvhftrace(LS_MAIN, mempool_init);
   tvhftrace(LS_MAIN, notify_init);
   tvhftrace(LS_MAIN, spawn_init);
   tvhftrace(LS_MAIN, idnode_init);
-  tvhftrace(LS_MAIN, config_init, opt_nobackup == 0);
+  tvhftrace(LS_MAIN, config_init, opt_nobackup == 0, opt_settingsdb);
 
   /* Memoryinfo */
   idclass_register(&memoryinfo_class);
@@ -1264,6 +1277,9 @@ main(int argc, char **argv)
   memoryinfo_register(&pkt_memoryinfo);
   memoryinfo_register(&pktbuf_memoryinfo);
   memoryinfo_register(&pktref_memoryinfo);
+#if ENABLE_MEMPOOL
+  memoryinfo_register(&mempool_memoryinfo);
+#endif
 
   /**
    * Initialize subsystems
@@ -1275,6 +1291,8 @@ main(int argc, char **argv)
   tvh_thread_create(&mtimer_tid, NULL, mtimer_thread, NULL, "mtimer");
   tvh_thread_create(&tasklet_tid, NULL, tasklet_thread, NULL, "tasklet");
 
+  tvhftrace(LS_MAIN, epg_preload);
+
 #if CONFIG_LINUXDVB_CA
   en50221_register_apps();
 #endif
@@ -1428,6 +1446,7 @@ main(int argc, char **argv)
   tvhftrace(LS_MAIN, intlconv_done);
   tvhftrace(LS_MAIN, urlparse_done);
   tvhftrace(LS_MAIN, streaming_done);
+  tvhftrace(LS_MAIN, mempool_done);
   tvhftrace(LS_MAIN, idnode_done);
   tvhftrace(LS_MAIN, notify_done);
   tvhftrace(LS_MAIN, spawn_done);
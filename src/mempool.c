@@ -0,0 +1,278 @@
+/*
+ *  Tvheadend - small object memory pools
+ *  Copyright (C) 2026 Tvheadend Foundation CIC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Each thread keeps a small cache of free blocks per size class, so the
+ * common alloc/free pair does not touch any lock. When a thread cache
+ * overflows (the consumer threads free what the producer allocated),
+ * a batch of blocks is moved to the shared depot, and an empty thread
+ * cache is refilled from it. The blocks are allocated by malloc() with
+ * the class size, so they can be released with free() at any time.
+ */
+
+#include <pthread.h>
+
+#include "tvheadend.h"
+#include "memoryinfo.h"
+#include "mempool.h"
+
+#define MEMPOOL_BATCH     64  /* blocks moved between a thread cache and the depot */
+#define MEMPOOL_DEPOT_MAX 64  /* batches per class kept in the depot */
+
+typedef struct mempool_block {
+  struct mempool_block *next;
+  struct mempool_block *batch_next; /* valid for the batch head in the depot */
+} mempool_block_t;
+
+static const uint16_t mempool_sizes[] = {
+  32, 48, 64, 96, 128, 160, 192, 256, 384, 512, 768, 1024, 1536, 2048
+};
+
+#define MEMPOOL_CLASSES ARRAY_SIZE(mempool_sizes)
+
+typedef struct mempool_tcache {
+  struct {
+    mempool_block_t *head;
+    int count;
+  } c[MEMPOOL_CLASSES];
+} mempool_tcache_t;
+
+static uint8_t mempool_index[MEMPOOL_MAX_SIZE / 16 + 1];
+
+static struct {
+  mempool_block_t *batches;
+  int count;
+} mempool_depot[MEMPOOL_CLASSES];
+
+static tvh_mutex_t mempool_lock = TVH_THREAD_MUTEX_INITIALIZER;
+static int64_t mempool_depot_size;
+static int64_t mempool_depot_count;
+static pthread_key_t mempool_key;
+static int mempool_running;
+static __thread mempool_tcache_t *mempool_tcache;
+
+memoryinfo_t mempool_memoryinfo = { .my_name = "Memory pools (idle)" };
+
+/*
+ *
+ */
+static inline int
+mempool_class(size_t size)
+{
+  return mempool_index[(size + 15) / 16];
+}
+
+static void
+mempool_free_list(mempool_block_t *b)
+{
+  mempool_block_t *n;
+
+  for ( ; b; b = n) {
+    n = b->next;
+    free(b);
+  }
+}
+
+/*
+ * Move count blocks from the head of the thread cache to the depot
+ */
+static void
+mempool_depot_put(mempool_tcache_t *tc, int cls, int count)
+{
+  mempool_block_t *head = tc->c[cls].head, *b = head;
+  int i;
+
+  for (i = 1; i < count; i++)
+    b = b->next;
+  tc->c[cls].head = b->next;
+  tc->c[cls].count -= count;
+  b->next = NULL;
+
+  tvh_mutex_lock(&mempool_lock);
+  if (atomic_get(&mempool_running) &&
+      mempool_depot[cls].count < MEMPOOL_DEPOT_MAX) {
+    head->batch_next = mempool_depot[cls].batches;
+    mempool_depot[cls].batches = head;
+    mempool_depot[cls].count++;
+    mempool_depot_size += (int64_t)count * mempool_sizes[cls];
+    mempool_depot_count++;
+    memoryinfo_update(&mempool_memoryinfo, mempool_depot_size, mempool_depot_count);
+    head = NULL;
+  }
+  tvh_mutex_unlock(&mempool_lock);
+
+  mempool_free_list(head);
+}
+
+/*
+ * Refill the empty thread cache from the depot
+ */
+static int
+mempool_depot_get(mempool_tcache_t *tc, int cls)
+{
+  mempool_block_t *head;
+
+  tvh_mutex_lock(&mempool_lock);
+  head = mempool_depot[cls].batches;
+  if (head) {
+    mempool_depot[cls].batches = head->batch_next;
+    mempool_depot[cls].count--;
+    mempool_depot_size -= (int64_t)MEMPOOL_BATCH * mempool_sizes[cls];
+    mempool_depot_count--;
+    memoryinfo_update(&mempool_memoryinfo, mempool_depot_size, mempool_depot_count);
+  }
+  tvh_mutex_unlock(&mempool_lock);
+
+  if (head == NULL)
+    return 0;
+  tc->c[cls].head = head;
+  tc->c[cls].count = MEMPOOL_BATCH;
+  return 1;
+}
+
+/*
+ * Thread exit
+ */
+static void
+mempool_tcache_destroy(void *aux)
+{
+  mempool_tcache_t *tc = aux;
+  int cls;
+
+  for (cls = 0; cls < MEMPOOL_CLASSES; cls++) {
+    while (tc->c[cls].count >= MEMPOOL_BATCH)
+      mempool_depot_put(tc, cls, MEMPOOL_BATCH);
+    mempool_free_list(tc->c[cls].head);
+  }
+  free(tc);
+  mempool_tcache = NULL;
+}
+
+static mempool_tcache_t *
+mempool_tcache_create(void)
+{
+  mempool_tcache_t *tc;
+
+  tc = calloc(1, sizeof(*tc));
+  if (tc == NULL)
+    return NULL;
+  if (pthread_setspecific(mempool_key, tc)) {
+    free(tc);
+    return NULL;
+  }
+  mempool_tcache = tc;
+  return tc;
+}
+
+/*
+ *
+ */
+void *
+mempool_alloc(size_t size)
+{
+  mempool_tcache_t *tc;
+  mempool_block_t *b;
+  int cls;
+
+  if (size > MEMPOOL_MAX_SIZE)
+    return malloc(size);
+  cls = mempool_class(size);
+  if (!atomic_get(&mempool_running))
+    return malloc(mempool_sizes[cls]);
+  tc = mempool_tcache ?: mempool_tcache_create();
+  if (tc == NULL)
+    return malloc(mempool_sizes[cls]);
+  if (tc->c[cls].head == NULL && !mempool_depot_get(tc, cls))
+    return malloc(mempool_sizes[cls]);
+  b = tc->c[cls].head;
+  tc->c[cls].head = b->next;
+  tc->c[cls].count--;
+  return b;
+}
+
+void
+mempool_free(void *ptr, size_t size)
+{
+  mempool_tcache_t *tc;
+  mempool_block_t *b = ptr;
+  int cls;
+
+  if (ptr == NULL)
+    return;
+  if (size > MEMPOOL_MAX_SIZE || !atomic_get(&mempool_running)) {
+    free(ptr);
+    return;
+  }
+  tc = mempool_tcache ?: mempool_tcache_create();
+  if (tc == NULL) {
+    free(ptr);
+    return;
+  }
+  cls = mempool_class(size);
+  b->next = tc->c[cls].head;
+  tc->c[cls].head = b;
+  if (++tc->c[cls].count >= 2 * MEMPOOL_BATCH)
+    mempool_depot_put(tc, cls, MEMPOOL_BATCH);
+}
+
+/*
+ *
+ */
+void
+mempool_init(void)
+{
+  int i, cls = 0;
+
+  for (i = 0; i < ARRAY_SIZE(mempool_index); i++) {
+    while (i * 16 > mempool_sizes[cls])
+      cls++;
+    mempool_index[i] = cls;
+  }
+  if (pthread_key_create(&mempool_key, mempool_tcache_destroy)) {
+    tvherror(LS_MAIN, "unable to create the memory pool key");
+    return;
+  }
+  atomic_set(&mempool_running, 1);
+}
+
+void
+mempool_done(void)
+{
+  mempool_tcache_t *tc = mempool_tcache;
+  int cls;
+
+  if (!atomic_get(&mempool_running))
+    return;
+  tvh_mutex_lock(&mempool_lock);
+  atomic_set(&mempool_running, 0);
+  for (cls = 0; cls < MEMPOOL_CLASSES; cls++) {
+    while (mempool_depot[cls].batches) {
+      mempool_block_t *b = mempool_depot[cls].batches;
+      mempool_depot[cls].batches = b->batch_next;
+      mempool_free_list(b);
+    }
+    mempool_depot[cls].count = 0;
+  }
+  mempool_depot_size = mempool_depot_count = 0;
+  memoryinfo_update(&mempool_memoryinfo, 0, 0);
+  tvh_mutex_unlock(&mempool_lock);
+  if (tc) {
+    pthread_setspecific(mempool_key, NULL);
+    mempool_tcache_destroy(tc);
+  }
+}
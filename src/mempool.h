@@ -0,0 +1,63 @@
+/*
+ *  Tvheadend - small object memory pools
+ *  Copyright (C) 2026 Tvheadend Foundation CIC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TVHEADEND_MEMPOOL_H
+#define TVHEADEND_MEMPOOL_H
+
+#include <stdlib.h>
+#include "build.h"
+
+/*
+ * Size classed pools for the small, short living objects of the
+ * streaming path (packets, packet buffers, references, messages).
+ *
+ * The caller must pass the same size to mempool_free() which was used
+ * for mempool_alloc(). Blocks larger than MEMPOOL_MAX_SIZE are passed
+ * to malloc()/free() directly.
+ *
+ * Configure with --disable-mempool to use plain malloc()/free() (e.g.
+ * for valgrind).
+ */
+
+#define MEMPOOL_MAX_SIZE 2048
+
+#if ENABLE_MEMPOOL
+
+struct memoryinfo;
+extern struct memoryinfo mempool_memoryinfo;
+
+void *mempool_alloc(size_t size);
+void mempool_free(void *ptr, size_t size);
+
+void mempool_init(void);
+void mempool_done(void);
+
+#else
+
+static inline void *mempool_alloc(size_t size) { return malloc(size); }
+static inline void mempool_free(void *ptr, size_t size) { free(ptr); }
+
+static inline void mempool_init(void) { }
+static inline void mempool_done(void) { }
+
+#endif
+
+static inline int mempool_fits(size_t size)
+  { return size <= MEMPOOL_MAX_SIZE; }
+
+#endif /* TVHEADEND_MEMPOOL_H */
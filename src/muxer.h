@@ -66,6 +66,7 @@ typedef struct muxer_config {
   int                  m_file_permissions;
   int                  m_directory_permissions; 
   int                  m_output_chunk; /* > 0 if muxer output needs writing in chunks */   
+  int                  m_write_size;   /* > 0 to gather stream output up to this size */
 
   /*
    * type specific section
@@ -121,6 +122,7 @@ typedef struct muxer {
 			       streaming_message_type_t,
 			       void *);
   int         (*m_add_marker) (struct muxer *);                         /* Add a marker (or chapter) */
+  int         (*m_flush)      (struct muxer *);                         /* Write the gathered output */
 
   int                    m_eos;        /* End of stream */
   int                    m_errors;     /* Number of errors */
@@ -167,6 +169,9 @@ static inline int muxer_reconfigure (muxer_t *m, const struct streaming_start *s
 static inline int muxer_add_marker (muxer_t *m)
   { if (m && m->m_add_marker) return m->m_add_marker(m); return -1; }
 
+static inline int muxer_flush (muxer_t *m)
+  { if (m && m->m_flush) return m->m_flush(m); return 0; }
+
 static inline int muxer_close (muxer_t *m)
   { if (m) return m->m_close(m); return -1; }
 
@@ -114,6 +114,9 @@ typedef struct mk_muxer {
   int64_t cluster_last_close;
   int64_t cluster_maxsize;
 
+  htsbuf_queue_t pending; // Gathered output (socket streaming)
+  size_t pending_size;
+
   off_t segment_header_pos;
 
   off_t segment_pos;
@@ -553,7 +556,7 @@ mk_write_to_fd(mk_muxer_t *mk, htsbuf_queue_t *hq)
  *
  */
 static void
-mk_write_queue(mk_muxer_t *mk, htsbuf_queue_t *q)
+mk_write_queue0(mk_muxer_t *mk, htsbuf_queue_t *q)
 {
   if(!mk->error && mk_write_to_fd(mk, q) && !MC_IS_EOS_ERROR(mk->error))
     tvherror(LS_MKV, "%s: Write failed -- %s", mk->filename, strerror(errno));
@@ -562,6 +565,46 @@ mk_write_queue(mk_muxer_t *mk, htsbuf_queue_t *q)
 }
 
 
+/**
+ *
+ */
+static int
+mk_flush(mk_muxer_t *mk)
+{
+  off_t fdpos = mk->fdpos;
+
+  if(TAILQ_EMPTY(&mk->pending.hq_q))
+    return mk->error;
+
+  /* the position was already advanced in mk_write_queue() */
+  mk->fdpos -= mk->pending_size;
+  mk_write_queue0(mk, &mk->pending);
+  mk->fdpos = fdpos;
+  mk->pending_size = 0;
+  return mk->error;
+}
+
+
+/**
+ *
+ */
+static void
+mk_write_queue(mk_muxer_t *mk, htsbuf_queue_t *q)
+{
+  if(mk->seekable || mk->m_config.m_write_size <= 0) {
+    mk_write_queue0(mk, q);
+    return;
+  }
+
+  /* gather the stream output to bigger writev() calls */
+  mk->fdpos += q->hq_size;
+  mk->pending_size += q->hq_size;
+  htsbuf_appendq(&mk->pending, q);
+  if(mk->pending_size >= (size_t)mk->m_config.m_write_size)
+    mk_flush(mk);
+}
+
+
 /**
  *
  */
@@ -896,7 +939,7 @@ mk_write_metaseek(mk_muxer_t *mk, int first)
   ebml_append_pad(&q, 500 - q.hq_size);
 
   if(first) {
-    mk_write_to_fd(mk, &q);
+    mk_write_queue(mk, &q);
   } else if(mk->seekable) {
     off_t prev = mk->fdpos;
     mk->fdpos = mk->segment_pos;
@@ -1495,6 +1538,16 @@ mkv_muxer_write_meta(muxer_t *m, struct epg_broadcast *eb,
 }
 
 
+/**
+ * Write the gathered output
+ */
+static int
+mkv_muxer_flush(muxer_t *m)
+{
+  return mk_flush((mk_muxer_t*)m);
+}
+
+
 /**
  * Close the muxer and append trailer to output
  */
@@ -1503,7 +1556,7 @@ mkv_muxer_close(muxer_t *m)
 {
   mk_muxer_t *mk = (mk_muxer_t*)m;
 
-  if(mk_mux_close(mk)) {
+  if(mk_mux_close(mk) || mk_flush(mk)) {
     mk->m_errors++;
     return -1;
   }
@@ -1524,6 +1577,7 @@ mkv_muxer_destroy(muxer_t *m)
   mk_chapter_t *ch;
 
   pktref_clear_queue(&mk->holdq);
+  htsbuf_queue_flush(&mk->pending);
 
   while((ch = TAILQ_FIRST(&mk->chapters)) != NULL) {
     TAILQ_REMOVE(&mk->chapters, ch, link);
@@ -1560,6 +1614,7 @@ mkv_muxer_create(const muxer_config_t *m_cfg,
   mk->m_add_marker   = mkv_muxer_add_marker;
   mk->m_write_meta   = mkv_muxer_write_meta;
   mk->m_write_pkt    = mkv_muxer_write_pkt;
+  mk->m_flush        = mkv_muxer_flush;
   mk->m_close        = mkv_muxer_close;
   mk->m_destroy      = mkv_muxer_destroy;
   mk->webm           = m_cfg->m_type == MC_WEBM;
@@ -1573,6 +1628,7 @@ mkv_muxer_create(const muxer_config_t *m_cfg,
     mk->dvbsub_skip  = strstr(agent, "LibVLC/") != NULL;
 
   TAILQ_INIT(&mk->holdq);
+  htsbuf_queue_init(&mk->pending, 0);
 
   return (muxer_t*)mk;
 }
@@ -21,6 +21,7 @@
 #include <fcntl.h>
 #include <assert.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 
 #include "tvheadend.h"
 #include "streaming.h"
@@ -30,6 +31,8 @@
 #include "muxer_pass.h"
 #include "spawn.h"
 
+#define PASS_MUXER_IOV 128
+
 typedef struct pass_muxer {
   muxer_t;
 
@@ -47,6 +50,12 @@ typedef struct pass_muxer {
   /* Streaming components */
   streaming_start_t *pm_ss;
 
+  /* Gathered output (socket streaming) */
+  struct iovec pm_iov[PASS_MUXER_IOV];
+  pktbuf_t    *pm_iovpb[PASS_MUXER_IOV]; /* NULL = allocated copy */
+  int          pm_iovcnt;
+  size_t       pm_iovlen;
+
   /* TS muxing */
   uint8_t  pm_rewrite_sdt;
   uint8_t  pm_rewrite_nit;
@@ -70,7 +79,7 @@ typedef struct pass_muxer {
 
 
 static void
-pass_muxer_write(muxer_t *m, const void *data, size_t size);
+pass_muxer_write(muxer_t *m, pktbuf_t *pb, const void *data, size_t size);
 
 /*
  * Rewrite a PAT packet to only include the service included in the transport stream.
@@ -103,7 +112,7 @@ pass_muxer_pat_cb(mpegts_psi_table_t *mt, const uint8_t *buf, int len)
   ol = dvb_table_append_crc32(out, 12, sizeof(out));
 
   if (ol > 0 && (l = dvb_table_remux(mt, out, ol, &ob)) > 0) {
-    pass_muxer_write((muxer_t *)pm, ob, l);
+    pass_muxer_write((muxer_t *)pm, NULL, ob, l);
     free(ob);
   }
 }
@@ -179,7 +188,7 @@ pass_muxer_pmt_cb(mpegts_psi_table_t *mt, const uint8_t *buf, int len)
   ol = dvb_table_append_crc32(out, ol, sizeof(out));
 
   if (ol > 0 && (l = dvb_table_remux(mt, out, ol, &ob)) > 0) {
-    pass_muxer_write((muxer_t *)pm, ob, l);
+    pass_muxer_write((muxer_t *)pm, NULL, ob, l);
     free(ob);
   }
 }
@@ -240,7 +249,7 @@ pass_muxer_sdt_cb(mpegts_psi_table_t *mt, const uint8_t *buf, int len)
   ol = dvb_table_append_crc32(out, ol, sizeof(out));
 
   if (ol > 0 && (l = dvb_table_remux(mt, out, ol, &ob)) > 0) {
-    pass_muxer_write((muxer_t *)pm, ob, l);
+    pass_muxer_write((muxer_t *)pm, NULL, ob, l);
     free(ob);
   }
 }
@@ -327,7 +336,7 @@ pass_muxer_nit_cb(mpegts_psi_table_t *mt, const uint8_t *buf, int len)
   ol = dvb_table_append_crc32(out, ol, sizeof(out));
 
   if (ol > 0 && (l = dvb_table_remux(mt, out, ol, &ob)) > 0) {
-    pass_muxer_write((muxer_t *)pm, ob, l);
+    pass_muxer_write((muxer_t *)pm, NULL, ob, l);
     free(ob);
   }
 }
@@ -370,7 +379,7 @@ pass_muxer_eit_cb(mpegts_psi_table_t *mt, const uint8_t *buf, int len)
 
   len = dvb_table_append_crc32(sbuf, len, len + 4);
   if (len > 0 && (olen = dvb_table_remux(mt, sbuf, len, &out)) > 0) {
-    pass_muxer_write((muxer_t *)pm, out, olen);
+    pass_muxer_write((muxer_t *)pm, NULL, out, olen);
     free(out);
   }
 
@@ -577,24 +586,12 @@ pass_muxer_open_file(muxer_t *m, const char *filename)
 
 
 /**
- * Write data to the file descriptor
+ * Handle the write result
  */
 static void
-pass_muxer_write(muxer_t *m, const void *data, size_t size)
+pass_muxer_write_result(pass_muxer_t *pm, int ret, size_t size)
 {
-  pass_muxer_t *pm = (pass_muxer_t*)m;
-  int ret;
-
-  if(pm->pm_error) {
-    pm->m_errors++;
-    return;
-  } 
-  
-  if (pm->m_config.m_output_chunk > 0) {
-    ret = tvh_write_in_chunks(pm->pm_fd, data, size, pm->m_config.m_output_chunk);
-  } else {
-    ret = tvh_write(pm->pm_fd, data, size);
-  }
+  muxer_t *m = (muxer_t *)pm;
 
   if(ret) {
     pm->pm_error = errno;
@@ -617,6 +614,115 @@ pass_muxer_write(muxer_t *m, const void *data, size_t size)
 }
 
 
+/**
+ * Release the gathered data
+ */
+static void
+pass_muxer_iov_clear(pass_muxer_t *pm)
+{
+  int i;
+
+  for (i = 0; i < pm->pm_iovcnt; i++) {
+    if (pm->pm_iovpb[i])
+      pktbuf_ref_dec(pm->pm_iovpb[i]);
+    else
+      free(pm->pm_iov[i].iov_base);
+  }
+  pm->pm_iovcnt = 0;
+  pm->pm_iovlen = 0;
+}
+
+
+/**
+ * Write the gathered data using one writev() call
+ */
+static int
+pass_muxer_flush(muxer_t *m)
+{
+  pass_muxer_t *pm = (pass_muxer_t*)m;
+  struct iovec iov[PASS_MUXER_IOV];
+  int ret;
+
+  if (pm->pm_iovcnt == 0)
+    return pm->pm_error;
+
+  if (!pm->pm_error) {
+    /* tvh_writev() modifies the array on partial writes */
+    memcpy(iov, pm->pm_iov, pm->pm_iovcnt * sizeof(iov[0]));
+    ret = tvh_writev(pm->pm_fd, iov, pm->pm_iovcnt);
+    pass_muxer_write_result(pm, ret, pm->pm_iovlen);
+  }
+
+  pass_muxer_iov_clear(pm);
+  return pm->pm_error;
+}
+
+
+/**
+ * Queue data for the gathered write, the packet buffer is referenced
+ * (no copy), other data (rewritten tables) are copied
+ */
+static void
+pass_muxer_gather(pass_muxer_t *pm, pktbuf_t *pb, const void *data, size_t size)
+{
+  struct iovec *iov;
+  int i = pm->pm_iovcnt;
+
+  if (i > 0 && pb && pm->pm_iovpb[i-1] == pb) {
+    iov = &pm->pm_iov[i-1];
+    if ((uint8_t *)iov->iov_base + iov->iov_len == data) {
+      iov->iov_len += size;
+      goto out;
+    }
+  }
+
+  iov = &pm->pm_iov[i];
+  if (pb) {
+    pktbuf_ref_inc(pb);
+    iov->iov_base = (void *)data;
+  } else {
+    iov->iov_base = malloc(size);
+    memcpy(iov->iov_base, data, size);
+  }
+  iov->iov_len = size;
+  pm->pm_iovpb[i] = pb;
+  pm->pm_iovcnt++;
+
+out:
+  pm->pm_iovlen += size;
+  if (pm->pm_iovlen >= (size_t)pm->m_config.m_write_size ||
+      pm->pm_iovcnt >= PASS_MUXER_IOV)
+    pass_muxer_flush((muxer_t *)pm);
+}
+
+
+/**
+ * Write data to the file descriptor
+ */
+static void
+pass_muxer_write(muxer_t *m, pktbuf_t *pb, const void *data, size_t size)
+{
+  pass_muxer_t *pm = (pass_muxer_t*)m;
+  int ret;
+
+  if(pm->pm_error) {
+    pm->m_errors++;
+    return;
+  } 
+  
+  if (pm->m_config.m_output_chunk > 0) {
+    ret = tvh_write_in_chunks(pm->pm_fd, data, size, pm->m_config.m_output_chunk);
+  } else if (pm->m_config.m_write_size > 0 && !pm->pm_seekable) {
+    pass_muxer_gather(pm, pb, data, size);
+    return;
+  } else {
+    ret = tvh_write(pm->pm_fd, data, size);
+  }
+
+  pass_muxer_write_result(pm, ret, size);
+}
+
+
 /**
  * Write TS packets to the file descriptor
  */
@@ -647,7 +753,7 @@ pass_muxer_write_ts(muxer_t *m, pktbuf_t *pb)
 
         /* Flush */
         if (len)
-          pass_muxer_write(m, pkt, len);
+          pass_muxer_write(m, pb, pkt, len);
 
         /* Store new start point (after these packets) */
         pkt = tsb + l;
@@ -689,7 +795,7 @@ pass_muxer_write_ts(muxer_t *m, pktbuf_t *pb)
   }
 
   if (len)
-    pass_muxer_write(m, pkt, len);
+    pass_muxer_write(m, pb, pkt, len);
 }
 
 
@@ -737,6 +843,8 @@ pass_muxer_close(muxer_t *m)
 {
   pass_muxer_t *pm = (pass_muxer_t*)m;
 
+  pass_muxer_flush(m);
+
   if(pm->pm_spawn_pid > 0)
     spawn_kill(pm->pm_spawn_pid, tvh_kill_to_sig(pm->m_config.u.pass.m_killsig),
                pm->m_config.u.pass.m_killtimeout);
@@ -760,6 +868,8 @@ pass_muxer_destroy(muxer_t *m)
 {
   pass_muxer_t *pm = (pass_muxer_t*)m;
 
+  pass_muxer_iov_clear(pm);
+
   if(pm->pm_filename)
     free(pm->pm_filename);
 
@@ -798,6 +908,7 @@ pass_muxer_create(const muxer_config_t *m_cfg,
   pm->m_mime         = pass_muxer_mime;
   pm->m_write_meta   = pass_muxer_write_meta;
   pm->m_write_pkt    = pass_muxer_write_pkt;
+  pm->m_flush        = pass_muxer_flush;
   pm->m_close        = pass_muxer_close;
   pm->m_destroy      = pass_muxer_destroy;
   pm->pm_fd          = -1;
@@ -23,6 +23,7 @@
 #include "string.h"
 #include "atomic.h"
 #include "memoryinfo.h"
+#include "mempool.h"
 
 #ifndef PKTBUF_DATA_ALIGN
 #define PKTBUF_DATA_ALIGN 64
@@ -42,7 +43,7 @@ pkt_destroy(th_pkt_t *pkt)
     pktbuf_ref_dec(pkt->pkt_payload);
     pktbuf_ref_dec(pkt->pkt_meta);
 
-    free(pkt);
+    mempool_free(pkt, sizeof(*pkt));
     memoryinfo_free(&pkt_memoryinfo, sizeof(*pkt));
   }
 }
@@ -67,8 +68,9 @@ pkt_alloc(streaming_component_type_t type, const uint8_t *data, size_t datalen,
     payload = NULL;
   }
 
-  pkt = calloc(1, sizeof(th_pkt_t));
+  pkt = mempool_alloc(sizeof(th_pkt_t));
   if (pkt) {
+    memset(pkt, 0, sizeof(*pkt));
     pkt->pkt_type = type;
     pkt->pkt_payload = payload;
     pkt->pkt_dts = dts;
@@ -90,7 +92,7 @@ pkt_alloc(streaming_component_type_t type, const uint8_t *data, size_t datalen,
 th_pkt_t *
 pkt_copy_shallow(th_pkt_t *pkt)
 {
-  th_pkt_t *n = malloc(sizeof(th_pkt_t));
+  th_pkt_t *n = mempool_alloc(sizeof(th_pkt_t));
 
   if (n) {
     blacklisted_memcpy(n, pkt, sizeof(*pkt));
@@ -113,7 +115,7 @@ pkt_copy_shallow(th_pkt_t *pkt)
 th_pkt_t *
 pkt_copy_nodata(th_pkt_t *pkt)
 {
-  th_pkt_t *n = malloc(sizeof(th_pkt_t));
+  th_pkt_t *n = mempool_alloc(sizeof(th_pkt_t));
 
   if (n) {
     blacklisted_memcpy(n, pkt, sizeof(*pkt));
@@ -212,7 +214,7 @@ pktref_clear_queue(struct th_pktref_queue *q)
     while((pr = TAILQ_FIRST(q)) != NULL) {
       TAILQ_REMOVE(q, pr, pr_link);
       pkt_ref_dec(pr->pr_pkt);
-      free(pr);
+      mempool_free(pr, sizeof(*pr));
       memoryinfo_free(&pktref_memoryinfo, sizeof(*pr));
     }
   }
@@ -225,7 +227,7 @@ pktref_clear_queue(struct th_pktref_queue *q)
 void
 pktref_enqueue(struct th_pktref_queue *q, th_pkt_t *pkt)
 {
-  th_pktref_t *pr = malloc(sizeof(th_pktref_t));
+  th_pktref_t *pr = mempool_alloc(sizeof(th_pktref_t));
   if (pr) {
     pr->pr_pkt = pkt;
     TAILQ_INSERT_TAIL(q, pr, pr_link);
@@ -241,7 +243,7 @@ void
 pktref_enqueue_sorted(struct th_pktref_queue *q, th_pkt_t *pkt,
                       int (*cmp)(const void *, const void *))
 {
-  th_pktref_t *pr = malloc(sizeof(th_pktref_t));
+  th_pktref_t *pr = mempool_alloc(sizeof(th_pktref_t));
   if (pr) {
     pr->pr_pkt = pkt;
     TAILQ_INSERT_SORTED(q, pr, pr_link, cmp);
@@ -260,7 +262,7 @@ pktref_remove(struct th_pktref_queue *q, th_pktref_t *pr)
     if (q)
       TAILQ_REMOVE(q, pr, pr_link);
     pkt_ref_dec(pr->pr_pkt);
-    free(pr);
+    mempool_free(pr, sizeof(*pr));
     memoryinfo_free(&pktref_memoryinfo, sizeof(*pr));
   }
 }
@@ -292,7 +294,7 @@ pktref_get_first(struct th_pktref_queue *q)
   if (pr) {
     pkt = pr->pr_pkt;
     TAILQ_REMOVE(q, pr, pr_link);
-    free(pr);
+    mempool_free(pr, sizeof(*pr));
     memoryinfo_free(&pktref_memoryinfo, sizeof(*pr));
     return pkt;
   }
@@ -317,7 +319,7 @@ pktref_insert_head(struct th_pktref_queue *q, th_pkt_t *pkt)
 th_pktref_t *
 pktref_create(th_pkt_t *pkt)
 {
-  th_pktref_t *pr = malloc(sizeof(th_pktref_t));
+  th_pktref_t *pr = mempool_alloc(sizeof(th_pktref_t));
   if (pr) {
     pr->pr_pkt = pkt;
     memoryinfo_alloc(&pktref_memoryinfo, sizeof(*pr));
@@ -329,25 +331,31 @@ pktref_create(th_pkt_t *pkt)
  *
  */
 
-void
-pktbuf_destroy(pktbuf_t *pb)
+static void
+pktbuf_free(pktbuf_t *pb)
 {
-  if (pb) {
-    memoryinfo_free(&pktbuf_memoryinfo, sizeof(*pb) + pb->pb_size);
+  memoryinfo_free(&pktbuf_memoryinfo, sizeof(*pb) + pb->pb_size);
+  if (pb->pb_inline) {
+    mempool_free(pb, sizeof(*pb) + pb->pb_size);
+  } else {
     free(pb->pb_data);
-    free(pb);
+    mempool_free(pb, sizeof(*pb));
   }
 }
 
+void
+pktbuf_destroy(pktbuf_t *pb)
+{
+  if (pb)
+    pktbuf_free(pb);
+}
+
 void
 pktbuf_ref_dec(pktbuf_t *pb)
 {
   if (pb) {
-    if((atomic_add(&pb->pb_refcount, -1)) == 1) {
-      memoryinfo_free(&pktbuf_memoryinfo, sizeof(*pb) + pb->pb_size);
-      free(pb->pb_data);
-      free(pb);
-    }
+    if((atomic_add(&pb->pb_refcount, -1)) == 1)
+      pktbuf_free(pb);
   }
 }
 
@@ -361,23 +369,37 @@ pktbuf_ref_inc(pktbuf_t *pb)
   return NULL;
 }
 
+/*
+ * Small buffers share the pool block with the header
+ */
 pktbuf_t *
 pktbuf_alloc(const uint8_t *data, size_t size)
 {
   pktbuf_t *pb;
   uint8_t *buffer;
 
-  buffer = size > 0 ? malloc(size) : NULL;
-  if (buffer) {\
+  if (size > 0 && mempool_fits(sizeof(*pb) + size)) {
+    pb = mempool_alloc(sizeof(*pb) + size);
+    if (pb == NULL)
+      return NULL;
+    buffer = (uint8_t *)(pb + 1);
     if (data != NULL)
       memcpy(buffer, data, size);
-  } else if (size > 0) {
-    return NULL;
-  }
-  pb = malloc(sizeof(pktbuf_t));
-  if (pb == NULL) {
-    free(buffer);
-    return NULL;
+    pb->pb_inline = 1;
+  } else {
+    buffer = size > 0 ? malloc(size) : NULL;
+    if (buffer) {
+      if (data != NULL)
+        memcpy(buffer, data, size);
+    } else if (size > 0) {
+      return NULL;
+    }
+    pb = mempool_alloc(sizeof(pktbuf_t));
+    if (pb == NULL) {
+      free(buffer);
+      return NULL;
+    }
+    pb->pb_inline = 0;
   }
   pb->pb_refcount = 1;
   pb->pb_data = buffer;
@@ -390,11 +412,13 @@ pktbuf_alloc(const uint8_t *data, size_t size)
 pktbuf_t *
 pktbuf_make(void *data, size_t size)
 {
-  pktbuf_t *pb = malloc(sizeof(pktbuf_t));
+  pktbuf_t *pb = mempool_alloc(sizeof(pktbuf_t));
   if (pb) {
     pb->pb_refcount = 1;
     pb->pb_size = size;
     pb->pb_data = data;
+    pb->pb_err = 0;
+    pb->pb_inline = 0;
     memoryinfo_alloc(&pktbuf_memoryinfo, sizeof(*pb) + pb->pb_size);
   }
   return pb;
@@ -403,9 +427,22 @@ pktbuf_make(void *data, size_t size)
 pktbuf_t *
 pktbuf_append(pktbuf_t *pb, const void *data, size_t size)
 {
+  pktbuf_t *npb;
   void *ndata;
   if (pb == NULL)
     return pktbuf_alloc(data, size);
+  if (pb->pb_inline) {
+    /* the pool block cannot be resized, a new buffer is returned */
+    npb = pktbuf_alloc(NULL, pb->pb_size + size);
+    if (npb) {
+      memcpy(npb->pb_data, pb->pb_data, pb->pb_size);
+      memcpy(npb->pb_data + pb->pb_size, data, size);
+      npb->pb_err = pb->pb_err;
+      pktbuf_ref_dec(pb);
+      return npb;
+    }
+    return pb;
+  }
   ndata = realloc(pb->pb_data, pb->pb_size + size);
   if (ndata) {
     pb->pb_data = ndata;
@@ -31,6 +31,7 @@ typedef struct pktbuf {
   int pb_err;
   uint8_t *pb_data;
   size_t pb_size;
+  int pb_inline;     /* pb_data follows the header in the same block */
 } pktbuf_t;
 
 /**
@@ -1227,7 +1227,8 @@ profile_htsp_work(profile_chain_t *prch,
   else
 #endif
     if (timeshift_period > 0)
-      dst = prch->prch_timeshift = timeshift_create(dst, timeshift_period);
+      dst = prch->prch_timeshift = timeshift_create(dst, timeshift_period,
+                                                    prch->prch_id, prch->prch_pro);
 #endif
 
   dst = prch->prch_gh = globalheaders_create(dst);
@@ -2600,7 +2601,8 @@ profile_transcode_work(profile_chain_t *prch,
 
 #if ENABLE_TIMESHIFT
   if (timeshift_period > 0)
-    dst = prch->prch_timeshift = timeshift_create(dst, timeshift_period);
+    dst = prch->prch_timeshift = timeshift_create(dst, timeshift_period,
+                                                  prch->prch_id, prch->prch_pro);
 #endif
   if (profile_sharer_create(prsh, prch, dst))
     goto fail;
@@ -19,6 +19,7 @@
 
 #include <signal.h>
 #include <ctype.h>
+#include <poll.h>
 #include "tvheadend.h"
 #include "config.h"
 #include "input.h"
@@ -40,6 +41,8 @@
 #define RTP_TCP_BUFFER_SIZE (64*1024*1024)
 #define RTP_TCP_BUFFER_ROOM (2048)
 
+#define RTP_PID_MAP_SIZE (8192/8)
+
 typedef struct satip_rtp_table {
   TAILQ_ENTRY(satip_rtp_table) link;
   mpegts_psi_table_t tbl;
@@ -63,9 +66,19 @@ typedef struct satip_rtp_session {
   int disable_rtcp;
   dvb_mux_conf_t dmc;
   mpegts_apids_t pids;
+  uint8_t pid_map[RTP_PID_MAP_SIZE];
+  uint8_t pmt_map[RTP_PID_MAP_SIZE];
   TAILQ_HEAD(, satip_rtp_table) pmt_tables;
   udp_multisend_t um;
   struct iovec *um_iovec;
+  int um_failed;
+  int um_sent;   /* packets of the full batch sent to the own peer */
+  int um_fsent;  /* the full batch was sent to the followers */
+  int um_wait;   /* the thread waits for the own peer (unlocked) */
+  int stopped;
+  struct satip_rtp_session *share_leader;
+  TAILQ_HEAD(, satip_rtp_session) share_followers;
+  TAILQ_ENTRY(satip_rtp_session) share_link;
   struct iovec tcp_data;
   uint32_t tcp_payload;
   uint32_t tcp_buffer_size;
@@ -77,6 +90,7 @@ typedef struct satip_rtp_session {
   http_connection_t *hc;
   sbuf_t table_data;
   void (*no_data_cb)(void *opaque);
+  void (*failed_cb)(void *opaque, void *rtp);
   void *no_data_opaque;
 } satip_rtp_session_t;
 
@@ -85,6 +99,41 @@ static pthread_t satip_rtcp_tid;
 static int satip_rtcp_run;
 static TAILQ_HEAD(, satip_rtp_session) satip_rtp_sessions;
 
+/*
+ * PID bitmaps, rebuilt on the PID list changes
+ */
+static inline int
+satip_rtp_pid_test(const uint8_t *map, int pid)
+{
+  return map[pid >> 3] & (1 << (pid & 7));
+}
+
+static void
+satip_rtp_pid_map(uint8_t *map, mpegts_apids_t *pids)
+{
+  int i, pid;
+
+  memset(map, 0, RTP_PID_MAP_SIZE);
+  for (i = 0; i < pids->count; i++) {
+    pid = pids->pids[i].pid;
+    if (pid < 8192)
+      map[pid >> 3] |= 1 << (pid & 7);
+  }
+}
+
+static inline satip_rtp_table_t *
+satip_rtp_pmt_table(satip_rtp_session_t *rtp, int pid)
+{
+  satip_rtp_table_t *tbl;
+
+  if (!satip_rtp_pid_test(rtp->pmt_map, pid))
+    return NULL;
+  TAILQ_FOREACH(tbl, &rtp->pmt_tables, link)
+    if (tbl->pid == pid)
+      break;
+  return tbl;
+}
+
 static void
 satip_rtp_pmt_cb(mpegts_psi_table_t *mt, const uint8_t *buf, int len)
 {
@@ -166,12 +215,101 @@ satip_rtp_header(satip_rtp_session_t *rtp, struct iovec *v, uint32_t off)
   memset(data + off + 8, 0xa5, 4);
 }
 
+/*
+ * Wait until the socket send buffer has room again
+ */
+static int
+satip_rtp_wait(int fd)
+{
+  struct pollfd fds;
+  int r;
+
+  fds.fd = fd;
+  fds.events = POLLOUT;
+  fds.revents = 0;
+  r = poll(&fds, 1, 100);
+  if (r < 0 && !ERRNO_AGAIN(errno))
+    return -1;
+  return tvheadend_is_running() ? 0 : -1;
+}
+
+/*
+ * Send to a follower peer, it is never waited for, returns 1 when
+ * the peer is busy (the rest of the batch is dropped for it)
+ */
 static int
-satip_rtp_send(satip_rtp_session_t *rtp)
+satip_rtp_send_fd(satip_rtp_session_t *rtp, int fd, int packets)
 {
+  int sent, r;
+
+  for (sent = 0; sent < packets; ) {
+    r = udp_multisend_send(&rtp->um, fd, sent, packets - sent);
+    if (r < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return 1;
+      tvhtrace(LS_SATIPS, "rtp udp multisend to follower failed (errno %d)", errno);
+      return r;
+    }
+    sent += r;
+  }
+  return 0;
+}
+
+/*
+ * Send to the own peer, returns 1 when the data are pending
+ *
+ * Only the session thread waits (wait set), the lock is released
+ * meanwhile so the sharing and PID updates do not block.
+ */
+static int
+satip_rtp_send_own(satip_rtp_session_t *rtp, int packets, int wait)
+{
+  int r;
+
+  while (rtp->um_sent < packets) {
+    r = udp_multisend_send(&rtp->um, rtp->fd_rtp, rtp->um_sent,
+                           packets - rtp->um_sent);
+    if (r < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        if (!wait)
+          return 1;
+        rtp->um_wait = 1;
+        tvh_mutex_unlock(&rtp->lock);
+        r = satip_rtp_wait(rtp->fd_rtp);
+        tvh_mutex_lock(&rtp->lock);
+        rtp->um_wait = 0;
+        if (r)
+          return -1;
+        continue;
+      }
+      tvhtrace(LS_SATIPS, "rtp udp multisend failed (errno %d)", errno);
+      return r;
+    }
+    rtp->um_sent += r;
+  }
+  return 0;
+}
+
+/*
+ * Send the full packets to the own peer and to the peers of the sessions
+ * sharing this one, the failed peers are skipped from now
+ *
+ * Must hold rtp->lock
+ */
+static int
+satip_rtp_send(satip_rtp_session_t *rtp, int wait)
+{
+  satip_rtp_session_t *f;
   struct iovec *v = rtp->um_iovec, *v2;
-  int packets, copy, len, r;
+  int packets, copy, len, r, alive;
   if (v->iov_len == RTP_PAYLOAD) {
+    /* the session thread completes this batch */
+    if (rtp->um_wait)
+      return 0;
     packets = rtp->um_packet;
     v2 = v + packets;
     copy = 1;
@@ -179,29 +317,43 @@ satip_rtp_send(satip_rtp_session_t *rtp)
       packets++;
       copy = 0;
     }
-    while (1) {
-      r = udp_multisend_send(&rtp->um, rtp->fd_rtp, packets);
-      if (r < 0) {
-        if (errno == EINTR)
-          continue;
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-          tvh_usleep(100);
+    alive = 0;
+    TAILQ_FOREACH(f, &rtp->share_followers, share_link) {
+      if (f->um_failed)
+        continue;
+      if (!rtp->um_fsent) {
+        r = satip_rtp_send_fd(rtp, f->fd_rtp, packets);
+        if (r < 0) {
+          /* the follower thread ends the session */
+          tvh_mutex_lock(&f->lock);
+          f->um_failed = 1;
+          tvh_mutex_unlock(&f->lock);
           continue;
         }
-        tvhtrace(LS_SATIPS, "rtp udp multisend failed (errno %d)", errno);
-        return r;
+        if (r > 0)
+          tvhtrace(LS_SATIPS, "rtp share %p busy, batch dropped", f);
+        else
+          subscription_add_bytes_out(f->subs, packets * (RTP_PAYLOAD - 12));
       }
-      break;
+      alive++;
     }
-    if (r != packets) {
-      tvhtrace(LS_SATIPS, "rtp udp multisend failed (packets %d written %d)", packets, r);
-      return -1;
+    rtp->um_fsent = 1;
+    if (!rtp->um_failed) {
+      r = satip_rtp_send_own(rtp, packets, wait);
+      if (r > 0)
+        return 0;
+      rtp->um_failed = r < 0;
+      alive += !rtp->um_failed;
     }
+    if (alive == 0)
+      return -1;
     if (copy)
       memcpy(v->iov_base, v2->iov_base, len = v2->iov_len);
     else
       len = 0;
     rtp->um_packet = 0;
+    rtp->um_sent = 0;
+    rtp->um_fsent = 0;
     udp_multisend_clean(&rtp->um);
     v->iov_len = len;
   }
@@ -220,7 +372,7 @@ satip_rtp_append_data(satip_rtp_session_t *rtp, struct iovec **_v, uint8_t *data
   v->iov_len += 188;
   if (v->iov_len == RTP_PAYLOAD) {
     if ((rtp->um_packet + 1) == RTP_PACKETS) {
-      r = satip_rtp_send(rtp);
+      r = satip_rtp_send(rtp, 1);
       if (r < 0)
         return r;
     } else {
@@ -237,8 +389,7 @@ satip_rtp_append_data(satip_rtp_session_t *rtp, struct iovec **_v, uint8_t *data
 static int
 satip_rtp_loop(satip_rtp_session_t *rtp, uint8_t *data, int len)
 {
-  int i, j, pid, last_pid = -1, r;
-  mpegts_apid_t *pids = rtp->pids.pids;
+  int i, pid, last_pid = -1, r;
   struct iovec *v = rtp->um_iovec + rtp->um_packet;
   satip_rtp_table_t *tbl;
 
@@ -246,30 +397,23 @@ satip_rtp_loop(satip_rtp_session_t *rtp, uint8_t *data, int len)
   for ( ; len >= 188 ; data += 188, len -= 188) {
     pid = ((data[1] & 0x1f) << 8) | data[2];
     if (pid != last_pid && !rtp->pids.all) {
-      for (i = 0; i < rtp->pids.count; i++) {
-        j = pids[i].pid;
-        if (pid < j) break;
-        if (j == pid) goto found;
-      }
-      continue;
-found:
-      TAILQ_FOREACH(tbl, &rtp->pmt_tables, link)
-        if (tbl->pid == pid) {
-          dvb_table_parse(&tbl->tbl, "-", data, 188, 1, 0, satip_rtp_pmt_cb);
-          if (rtp->table_data.sb_ptr > 0) {
-            for (i = r = 0; i < rtp->table_data.sb_ptr; i += 188) {
-              r = satip_rtp_append_data(rtp, &v, rtp->table_data.sb_data + i);
-              if (r)
-                break;
-            }
-            sbuf_reset(&rtp->table_data, 10*188);
+      if (!satip_rtp_pid_test(rtp->pid_map, pid))
+        continue;
+      tbl = satip_rtp_pmt_table(rtp, pid);
+      if (tbl) {
+        dvb_table_parse(&tbl->tbl, "-", data, 188, 1, 0, satip_rtp_pmt_cb);
+        if (rtp->table_data.sb_ptr > 0) {
+          for (i = r = 0; i < rtp->table_data.sb_ptr; i += 188) {
+            r = satip_rtp_append_data(rtp, &v, rtp->table_data.sb_data + i);
             if (r)
-              return r;
+              break;
           }
-          break;
+          sbuf_reset(&rtp->table_data, 10*188);
+          if (r)
+            return r;
         }
-      if (tbl)
         continue;
+      }
       last_pid = pid;
     }
     r = satip_rtp_append_data(rtp, &v, data);
@@ -327,34 +471,26 @@ satip_rtp_append_tcp_data(satip_rtp_session_t *rtp, uint8_t *data, size_t len)
 static int
 satip_rtp_tcp_loop(satip_rtp_session_t *rtp, uint8_t *data, int len)
 {
-  int i, j, pid, last_pid = -1, r;
-  mpegts_apid_t *pids = rtp->pids.pids;
+  int pid, last_pid = -1, r;
   satip_rtp_table_t *tbl;
 
   assert((len % 188) == 0);
   for ( ; len >= 188 ; data += 188, len -= 188) {
     pid = ((data[1] & 0x1f) << 8) | data[2];
     if (pid != last_pid && !rtp->pids.all) {
-      for (i = 0; i < rtp->pids.count; i++) {
-        j = pids[i].pid;
-        if (pid < j) break;
-        if (j == pid) goto found;
-      }
-      continue;
-found:
-      TAILQ_FOREACH(tbl, &rtp->pmt_tables, link)
-        if (tbl->pid == pid) {
-          dvb_table_parse(&tbl->tbl, "-", data, 188, 1, 0, satip_rtp_pmt_cb);
-          if (rtp->table_data.sb_ptr) {
-            r = satip_rtp_append_tcp_data(rtp, rtp->table_data.sb_data, rtp->table_data.sb_ptr);
-            sbuf_reset(&rtp->table_data, 10*188);
-            if (r)
-              return -1;
-          }
-          break;
+      if (!satip_rtp_pid_test(rtp->pid_map, pid))
+        continue;
+      tbl = satip_rtp_pmt_table(rtp, pid);
+      if (tbl) {
+        dvb_table_parse(&tbl->tbl, "-", data, 188, 1, 0, satip_rtp_pmt_cb);
+        if (rtp->table_data.sb_ptr) {
+          r = satip_rtp_append_tcp_data(rtp, rtp->table_data.sb_data, rtp->table_data.sb_ptr);
+          sbuf_reset(&rtp->table_data, 10*188);
+          if (r)
+            return -1;
         }
-      if (tbl)
         continue;
+      }
       last_pid = pid;
     }
     r = satip_rtp_append_tcp_data(rtp, data, 188);
@@ -395,7 +531,9 @@ satip_rtp_thread(void *aux)
       if (tcp) {
         r = satip_rtp_flush_tcp_data(rtp);
       } else {
-        r = satip_rtp_send(rtp);
+        tvh_mutex_lock(&rtp->lock);
+        r = satip_rtp_send(rtp, 1) || rtp->um_failed;
+        tvh_mutex_unlock(&rtp->lock);
       }
       if (r) {
         fatal = 1;
@@ -418,8 +556,12 @@ satip_rtp_thread(void *aux)
         tvh_mutex_lock(&rtp->lock);
         if (tcp)
           r = satip_rtp_tcp_loop(rtp, pktbuf_ptr(pb), r);
-        else
+        else if (rtp->share_leader == NULL)
           r = satip_rtp_loop(rtp, pktbuf_ptr(pb), r);
+        else
+          r = 0; /* the leader sends the data */
+        /* the own peer failed, the followers are served by a new leader */
+        r = r || rtp->um_failed;
         tvh_mutex_unlock(&rtp->lock);
         if (r) fatal = 1;
       }
@@ -451,6 +593,11 @@ satip_rtp_thread(void *aux)
     tvh_mutex_lock(&sq->sq_mutex);
   }
   tvh_mutex_unlock(&sq->sq_mutex);
+  atomic_set(&rtp->stopped, 1);
+
+  /* the data connection is handled by the RTSP connection itself */
+  if (fatal && !tcp && rtp->failed_cb)
+    rtp->failed_cb(rtp->no_data_opaque, rtp);
 
   tvhdebug(LS_SATIPS, "RTP streaming to %s:%d closed (%s request)%s",
            peername,
@@ -472,6 +619,7 @@ void *satip_rtp_queue(th_subscription_t *subs,
                       int frontend, int source, dvb_mux_conf_t *dmc,
                       mpegts_apids_t *pids, int allow_data, int perm_lock,
                       void (*no_data_cb)(void *opaque),
+                      void (*failed_cb)(void *opaque, void *rtp),
                       void *no_data_opaque)
 {
   satip_rtp_session_t *rtp = calloc(1, sizeof(*rtp));
@@ -496,13 +644,18 @@ void *satip_rtp_queue(th_subscription_t *subs,
   rtp->tcp_payload = MINMAX(payload, RTP_TCP_MIN_PAYLOAD, RTP_TCP_MAX_PAYLOAD);
   rtp->tcp_buffer_size = 16*1024*1024;
   rtp->no_data_cb = no_data_cb;
+  rtp->failed_cb = failed_cb;
   rtp->no_data_opaque = no_data_opaque;
   atomic_set(&rtp->allow_data, allow_data);
   mpegts_pid_init(&rtp->pids);
   mpegts_pid_copy(&rtp->pids, pids);
+  satip_rtp_pid_map(rtp->pid_map, &rtp->pids);
   TAILQ_INIT(&rtp->pmt_tables);
+  TAILQ_INIT(&rtp->share_followers);
   if (port != RTSP_TCP_DATA) {
     udp_multisend_init(&rtp->um, RTP_PACKETS, RTP_PAYLOAD, &rtp->um_iovec);
+    if (udp_multisend_gso(&rtp->um, fd_rtp) == 0)
+      tvhtrace(LS_SATIPS, "rtp queue %p uses UDP GSO", rtp);
     satip_rtp_header(rtp, rtp->um_iovec, 0);
   } else {
     socklen = sizeof(len);
@@ -568,6 +721,7 @@ void satip_rtp_update_pids(void *_rtp, mpegts_apids_t *pids)
   tvh_mutex_lock(&satip_rtp_lock);
   tvh_mutex_lock(&rtp->lock);
   mpegts_pid_copy(&rtp->pids, pids);
+  satip_rtp_pid_map(rtp->pid_map, &rtp->pids);
   tvh_mutex_unlock(&rtp->lock);
   tvh_mutex_unlock(&satip_rtp_lock);
 }
@@ -598,17 +752,155 @@ void satip_rtp_update_pmt_pids(void *_rtp, mpegts_apids_t *pmt_pids)
       TAILQ_INSERT_TAIL(&rtp->pmt_tables, tbl, link);
     }
   }
+  memset(rtp->pmt_map, 0, RTP_PID_MAP_SIZE);
   for (tbl = TAILQ_FIRST(&rtp->pmt_tables); tbl; tbl = tbl_next){
     tbl_next = TAILQ_NEXT(tbl, link);
     if (tbl->remove_mark) {
       TAILQ_REMOVE(&rtp->pmt_tables, tbl, link);
       free(tbl);
+    } else if (tbl->pid < 8192) {
+      rtp->pmt_map[tbl->pid >> 3] |= 1 << (tbl->pid & 7);
     }
   }
   tvh_mutex_unlock(&rtp->lock);
   tvh_mutex_unlock(&satip_rtp_lock);
 }
 
+/*
+ * Stream sharing
+ *
+ * The sessions streaming the same PIDs from the same mux may share one
+ * RTP packetizer. The leader thread sends the packets also to the peers
+ * of its followers, the followers drop their own data. The RTP sequence
+ * continues when a session leaves the group (lock order: satip_rtp_lock,
+ * leader lock, follower lock).
+ */
+static void
+satip_rtp_share_continue(satip_rtp_session_t *rtp, satip_rtp_session_t *from)
+{
+  struct iovec *v = from->um_iovec + from->um_packet;
+
+  udp_multisend_clean(&rtp->um);
+  rtp->um_packet = 0;
+  rtp->um_sent = 0;
+  rtp->um_fsent = 0;
+  memcpy(rtp->um_iovec->iov_base, v->iov_base, v->iov_len);
+  rtp->um_iovec->iov_len = v->iov_len;
+  rtp->seq = from->seq;
+}
+
+static satip_rtp_session_t *
+satip_rtp_share_leave(satip_rtp_session_t *rtp)
+{
+  satip_rtp_session_t *leader = rtp->share_leader, *f, *g;
+
+  if (leader) {
+    tvh_mutex_lock(&leader->lock);
+    tvh_mutex_lock(&rtp->lock);
+    TAILQ_REMOVE(&leader->share_followers, rtp, share_link);
+    rtp->share_leader = NULL;
+    satip_rtp_share_continue(rtp, leader);
+    tvh_mutex_unlock(&rtp->lock);
+    tvh_mutex_unlock(&leader->lock);
+    tvhtrace(LS_SATIPS, "rtp share %p left leader %p", rtp, leader);
+    return NULL;
+  }
+  if ((f = TAILQ_FIRST(&rtp->share_followers)) == NULL)
+    return NULL;
+  tvh_mutex_lock(&rtp->lock);
+  satip_rtp_send(rtp, 0);
+  TAILQ_REMOVE(&rtp->share_followers, f, share_link);
+  tvh_mutex_lock(&f->lock);
+  f->share_leader = NULL;
+  satip_rtp_share_continue(f, rtp);
+  while ((g = TAILQ_FIRST(&rtp->share_followers)) != NULL) {
+    TAILQ_REMOVE(&rtp->share_followers, g, share_link);
+    tvh_mutex_lock(&g->lock);
+    g->share_leader = f;
+    tvh_mutex_unlock(&g->lock);
+    TAILQ_INSERT_TAIL(&f->share_followers, g, share_link);
+  }
+  tvh_mutex_unlock(&f->lock);
+  tvh_mutex_unlock(&rtp->lock);
+  tvhtrace(LS_SATIPS, "rtp share %p promoted to leader (was %p)", f, rtp);
+  return f;
+}
+
+int satip_rtp_share(void *_rtp, void *_leader)
+{
+  satip_rtp_session_t *rtp = _rtp, *leader = _leader;
+  int r = -1;
+
+  if (rtp == NULL || leader == NULL)
+    return -1;
+  tvh_mutex_lock(&satip_rtp_lock);
+  if (leader->share_leader)
+    leader = leader->share_leader;
+  if (rtp == leader || rtp->share_leader == leader) {
+    r = 0;
+    goto end;
+  }
+  if (rtp->port == RTSP_TCP_DATA || leader->port == RTSP_TCP_DATA ||
+      rtp->share_leader || !TAILQ_EMPTY(&rtp->share_followers) ||
+      atomic_get(&leader->stopped) || leader->um_failed)
+    goto end;
+  tvh_mutex_lock(&leader->lock);
+  tvh_mutex_lock(&rtp->lock);
+  /* the own data are still being sent */
+  if (rtp->um_wait) {
+    tvh_mutex_unlock(&rtp->lock);
+    tvh_mutex_unlock(&leader->lock);
+    goto end;
+  }
+  satip_rtp_send(rtp, 0);
+  rtp->share_leader = leader;
+  TAILQ_INSERT_TAIL(&leader->share_followers, rtp, share_link);
+  tvh_mutex_unlock(&rtp->lock);
+  tvh_mutex_unlock(&leader->lock);
+  tvhtrace(LS_SATIPS, "rtp share %p joined leader %p", rtp, leader);
+  r = 0;
+end:
+  tvh_mutex_unlock(&satip_rtp_lock);
+  return r;
+}
+
+void *satip_rtp_unshare(void *_rtp)
+{
+  satip_rtp_session_t *rtp = _rtp;
+
+  if (rtp == NULL)
+    return NULL;
+  tvh_mutex_lock(&satip_rtp_lock);
+  rtp = satip_rtp_share_leave(rtp);
+  tvh_mutex_unlock(&satip_rtp_lock);
+  return rtp;
+}
+
+void *satip_rtp_share_peer(void *_rtp)
+{
+  satip_rtp_session_t *rtp = _rtp, *r = NULL;
+
+  if (rtp == NULL)
+    return NULL;
+  tvh_mutex_lock(&satip_rtp_lock);
+  r = rtp->share_leader ?: TAILQ_FIRST(&rtp->share_followers);
+  tvh_mutex_unlock(&satip_rtp_lock);
+  return r;
+}
+
+int satip_rtp_share_follower(void *_rtp)
+{
+  satip_rtp_session_t *rtp = _rtp;
+  int r;
+
+  if (rtp == NULL)
+    return 0;
+  tvh_mutex_lock(&satip_rtp_lock);
+  r = rtp->share_leader != NULL;
+  tvh_mutex_unlock(&satip_rtp_lock);
+  return r;
+}
+
 void satip_rtp_close(void *_rtp)
 {
   satip_rtp_session_t *rtp = _rtp;
@@ -619,6 +911,7 @@ void satip_rtp_close(void *_rtp)
     return;
   tvh_mutex_lock(&satip_rtp_lock);
   tvhtrace(LS_SATIPS, "rtp close %p", rtp);
+  satip_rtp_share_leave(rtp);
   TAILQ_REMOVE(&satip_rtp_sessions, rtp, link);
   sq = rtp->sq;
   tvh_mutex_lock(&sq->sq_mutex);
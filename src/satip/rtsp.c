@@ -92,6 +92,7 @@ static tvh_mutex_t rtsp_lock;
 
 static void rtsp_close_session(session_t *rs);
 static void rtsp_free_session(session_t *rs);
+static void rtsp_unshare(session_t *rs);
 
 /*
  *
@@ -452,6 +453,7 @@ rtsp_clean(session_t *rs, int clean_mux)
   slave_subscription_t *sub;
 
   if (rs->rtp_handle) {
+    rtsp_unshare(rs);
     satip_rtp_close(rs->rtp_handle);
     rs->rtp_handle = NULL;
   }
@@ -483,6 +485,53 @@ rtsp_no_data(void *opaque)
   rs->no_data = 1;
 }
 
+/*
+ * The peer of the session does not accept the data, the session
+ * is closed from the tasklet (the RTP thread is joined there)
+ */
+typedef struct rtsp_failed {
+  void *rtp;
+  char session[9];
+  int stream;
+} rtsp_failed_t;
+
+static void
+rtsp_peer_failed_cb(void *aux, int disarmed)
+{
+  rtsp_failed_t *f = aux;
+  session_t *rs;
+
+  if (!disarmed) {
+    tvh_mutex_lock(&rtsp_lock);
+    TAILQ_FOREACH(rs, &rtsp_sessions, link)
+      if (rs->rtp_handle == f->rtp && rs->stream == f->stream &&
+          strcmp(rs->session, f->session) == 0)
+        break;
+    if (rs) {
+      tvhwarn(LS_SATIPS, "-/%s/%i: session closed (peer failed)",
+              rs->session, rs->stream);
+      rtsp_close_session(rs);
+      rtsp_free_session(rs);
+    }
+    tvh_mutex_unlock(&rtsp_lock);
+  }
+  free(f);
+}
+
+static void
+rtsp_peer_failed(void *opaque, void *rtp)
+{
+  session_t *rs = opaque;
+  rtsp_failed_t *f = malloc(sizeof(*f));
+
+  if (f == NULL)
+    return;
+  f->rtp = rtp;
+  strlcpy(f->session, rs->session, sizeof(f->session));
+  f->stream = rs->stream;
+  tasklet_arm_alloc(rtsp_peer_failed_cb, f);
+}
+
 /*
  *
  */
@@ -535,7 +584,9 @@ rtsp_manage_descramble(session_t *rs)
 
   master = (mpegts_service_t *)rs->subs->ths_raw_service;
 
-  if (rs->pids.all) {
+  if (satip_rtp_share_follower(rs->rtp_handle)) {
+    /* the leader descrambles the shared stream */
+  } else if (rs->pids.all) {
     LIST_FOREACH(s, &rs->mux->mm_services, s_dvb_mux_link)
       if (rtsp_validate_service(s, NULL))
         idnode_set_add(found, &s->s_id, NULL, NULL);
@@ -588,6 +639,98 @@ end:
   }
 }
 
+/*
+ * Stream sharing
+ *
+ * The UDP sessions playing the same PIDs from the same mux share one RTP
+ * packetizer (see satip_rtp_share()). The followers keep their own
+ * subscription (tuning, weight, signal status) with the PAT only.
+ */
+static session_t *
+rtsp_find_rtp(void *rtp)
+{
+  session_t *rs;
+
+  TAILQ_FOREACH(rs, &rtsp_sessions, link)
+    if (rs->rtp_handle == rtp)
+      return rs;
+  return NULL;
+}
+
+static inline int
+rtsp_share_allowed(session_t *rs)
+{
+  return !satip_server_conf.satip_noshare && rs->rtp_handle && rs->subs &&
+         rs->udp_rtp && rs->playing;
+}
+
+static int
+rtsp_share_match(session_t *rs, session_t *rs2)
+{
+  if (rs2 == rs || !rtsp_share_allowed(rs2) || rs2->mux != rs->mux)
+    return 0;
+  if (rs->pids.all || rs2->pids.all)
+    return rs->pids.all && rs2->pids.all;
+  return mpegts_pid_cmp(&rs->pids, &rs2->pids) == 0;
+}
+
+static void
+rtsp_update_pids(session_t *rs)
+{
+  mpegts_service_t *svc = (mpegts_service_t *)rs->subs->ths_raw_service;
+  mpegts_apids_t pids;
+
+  if (!satip_rtp_share_follower(rs->rtp_handle)) {
+    svc->s_update_pids(svc, &rs->pids);
+    return;
+  }
+  mpegts_pid_init(&pids);
+  mpegts_pid_add(&pids, 0, MPS_WEIGHT_RAW);
+  svc->s_update_pids(svc, &pids);
+  mpegts_pid_done(&pids);
+}
+
+static void
+rtsp_unshare(session_t *rs)
+{
+  session_t *rs2;
+  void *rtp;
+
+  rtp = satip_rtp_unshare(rs->rtp_handle);
+  if (rtp == NULL || (rs2 = rtsp_find_rtp(rtp)) == NULL || rs2->subs == NULL)
+    return;
+  tvhdebug(LS_SATIPS, "%i/%s/%i: leads the shared stream now",
+           rs2->frontend, rs2->session, rs2->stream);
+  rtsp_update_pids(rs2);
+  rtsp_manage_descramble(rs2);
+}
+
+static void
+rtsp_share(session_t *rs)
+{
+  session_t *rs2;
+  void *peer;
+
+  if (rs->rtp_handle == NULL || rs->subs == NULL)
+    return;
+  if ((peer = satip_rtp_share_peer(rs->rtp_handle)) != NULL) {
+    rs2 = rtsp_find_rtp(peer);
+    if (rs2 && rtsp_share_allowed(rs) && rtsp_share_match(rs, rs2))
+      return;
+    rtsp_unshare(rs);
+  }
+  if (rtsp_share_allowed(rs))
+    TAILQ_FOREACH(rs2, &rtsp_sessions, link)
+      if (rtsp_share_match(rs, rs2) &&
+          satip_rtp_share(rs->rtp_handle, rs2->rtp_handle) == 0) {
+        tvhdebug(LS_SATIPS, "%i/%s/%i: shares the stream of %s/%i",
+                 rs->frontend, rs->session, rs->stream,
+                 rs2->session, rs2->stream);
+        break;
+      }
+  rtsp_update_pids(rs);
+}
+
 /*
  *
  */
@@ -599,7 +742,6 @@ rtsp_start
   mpegts_network_t *mn, *mn2;
   dvb_network_t *ln;
   mpegts_mux_t *mux;
-  mpegts_service_t *svc;
   dvb_mux_conf_t dmc;
   slave_subscription_t *sub;
   char buf[384];
@@ -724,8 +866,7 @@ pids:
       goto endclean;
     if (!rs->pids.all && rs->pids.count == 0)
       mpegts_pid_add(&rs->pids, 0, MPS_WEIGHT_RAW);
-    svc = (mpegts_service_t *)rs->subs->ths_raw_service;
-    svc->s_update_pids(svc, &rs->pids);
+    rtsp_update_pids(rs);
     satip_rtp_update_pids(rs->rtp_handle, &rs->pids);
     if (rs->used_weight != weight && weight > 0) {
       subscription_set_weight(rs->subs, rs->used_weight = weight);
@@ -745,7 +886,7 @@ pids:
                       rs->findex, rs->src, &rs->dmc_tuned,
                       &rs->pids,
                       cmd == RTSP_CMD_PLAY || rs->playing,
-                      rs->perm_lock, rtsp_no_data, rs);
+                      rs->perm_lock, rtsp_no_data, rtsp_peer_failed, rs);
     if (rs->rtp_handle == NULL) {
       res = HTTP_STATUS_INTERNAL;
       goto endclean;
@@ -753,8 +894,7 @@ pids:
     rs->tcp_data = rs->udp_rtp ? NULL : hc;
     if (!rs->pids.all && rs->pids.count == 0)
       mpegts_pid_add(&rs->pids, 0, MPS_WEIGHT_RAW);
-    svc = (mpegts_service_t *)rs->subs->ths_raw_service;
-    svc->s_update_pids(svc, &rs->pids);
+    rtsp_update_pids(rs);
     rs->playing = cmd == RTSP_CMD_PLAY || rs->playing;
     rs->state = STATE_PLAY;
   } else if (cmd == RTSP_CMD_PLAY) {
@@ -763,6 +903,7 @@ pids:
       goto endclean;
     satip_rtp_allow_data(rs->rtp_handle);
   }
+  rtsp_share(rs);
   rtsp_manage_descramble(rs);
   tvh_mutex_unlock(&global_lock);
   return 0;
@@ -1804,6 +1945,9 @@ rtsp_serve(int fd, void **opaque, struct sockaddr_storage *peer,
 static void
 rtsp_close_session(session_t *rs)
 {
+  tvh_mutex_lock(&global_lock);
+  rtsp_unshare(rs);
+  tvh_mutex_unlock(&global_lock);
   satip_rtp_close(rs->rtp_handle);
   rs->rtp_handle = NULL;
   rs->playing = 0;
@@ -970,6 +970,17 @@ const idclass_t satip_server_class = {
       .opts   = PO_EXPERT,
       .group  = 5,
     },
+    {
+      .type   = PT_BOOL,
+      .id     = "satip_noshare",
+      .name   = N_("Disable stream sharing"),
+      .desc   = N_("Do not send the same RTP stream to all UDP sessions "
+                   "with the same mux and PIDs (each session gets "
+                   "its own packetizer)."),
+      .off    = offsetof(struct satip_server_conf, satip_noshare),
+      .opts   = PO_EXPERT,
+      .group  = 5,
+    },
     {}
   },
 };
@@ -52,6 +52,7 @@ struct satip_server_conf {
   int satip_anonymize;
   int satip_noupnp;
   int satip_drop_fe;
+  int satip_noshare;
   int satip_restrict_pids_all;
   int satip_iptv_sig_level;
   int satip_force_sig_level;
@@ -86,10 +87,15 @@ void *satip_rtp_queue(th_subscription_t *subs,
                       mpegts_apids_t *pids,
                       int allow_data, int perm_lock,
                       void (*no_data_cb)(void *opaque),
+                      void (*failed_cb)(void *opaque, void *rtp),
                       void *no_data_opaque);
 void satip_rtp_allow_data(void *_rtp);
 void satip_rtp_update_pids(void *_rtp, mpegts_apids_t *pids);
 void satip_rtp_update_pmt_pids(void *_rtp, mpegts_apids_t *pmt_pids);
+int satip_rtp_share(void *_rtp, void *_leader);
+void *satip_rtp_unshare(void *_rtp);
+void *satip_rtp_share_peer(void *_rtp);
+int satip_rtp_share_follower(void *_rtp);
 int satip_rtp_status(void *id, char *buf, int len);
 void satip_rtp_close(void *id);
 
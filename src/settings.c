@@ -34,11 +34,522 @@
 #include "settings.h"
 #include "tvheadend.h"
 #include "filebundle.h"
+#include "sbuf.h"
 
 #include "../vendor/xdg-user-dirs/xdg-user-dir-lookup.c"
 
+/*
+ * Single-file settings store
+ *
+ * When <confdir>/settings.db exists, all records are kept in this one
+ * append-only log instead of one file per record. The log entries are
+ * binary2 messages - { "p": path, "d": record } stores a record,
+ * { "p": path } removes the path including everything below it and
+ * { "c": 1 } commits all preceding entries (an uncommitted tail is
+ * dropped at startup). The live records are held in memory in the
+ * serialized form, the log is rewritten when it grows to twice the
+ * size of the live data.
+ */
+
+#define HTS_SETTINGS_DB          "settings.db"
+#define HTS_SETTINGS_DB_MAGIC    "\xff\xffTVHSDB1"
+#define HTS_SETTINGS_DB_MAGIC_LEN 9
+#define HTS_SETTINGS_DB_COMPACT  (256*1024)
+#define HTS_SETTINGS_DB_MAXREC   (10*1024*1024)
+
+typedef struct hts_settings_rec {
+  RB_ENTRY(hts_settings_rec) link;
+  void   *data;
+  size_t  len;
+  char    path[0];
+} hts_settings_rec_t;
+
+static RB_HEAD(, hts_settings_rec) settings_recs;
+static tvh_mutex_t settings_store_lock = TVH_THREAD_MUTEX_INITIALIZER;
+static int    settings_store_active;
+static int    settings_store_fd = -1;
+static int    settings_store_batch;
+static sbuf_t settings_store_pending;
+static size_t settings_store_size;
+static size_t settings_store_live;
+static void  *settings_store_commit_data;
+static size_t settings_store_commit_len;
+
 static char *settingspath = NULL;
 
+/* Newer platforms such as FreeBSD 11.1 support fdatasync so only alias on older systems */
+#ifndef CONFIG_FDATASYNC
+#if defined(PLATFORM_DARWIN)
+#define fdatasync(fd)       fcntl(fd, F_FULLFSYNC)
+#elif defined(PLATFORM_FREEBSD)
+#define fdatasync(fd)       fsync(fd)
+#endif
+#endif
+
+static htsmsg_t *hts_settings_load_one(const char *filename);
+
+/* **************************************************************************
+ * Settings store
+ * *************************************************************************/
+
+static int
+hts_settings_rec_cmp(const void *a, const void *b)
+{
+  return strcmp(((const hts_settings_rec_t *)a)->path,
+                ((const hts_settings_rec_t *)b)->path);
+}
+
+static hts_settings_rec_t *
+hts_settings_rec_find(const char *path, int ge)
+{
+  size_t l = strlen(path) + 1;
+  hts_settings_rec_t *skel = alloca(sizeof(*skel) + l);
+
+  memcpy(skel->path, path, l);
+  if (ge)
+    return RB_FIND_GE(&settings_recs, skel, link, hts_settings_rec_cmp);
+  return RB_FIND(&settings_recs, skel, link, hts_settings_rec_cmp);
+}
+
+static inline size_t
+hts_settings_rec_size(hts_settings_rec_t *rec)
+{
+  return sizeof(*rec) + strlen(rec->path) + rec->len;
+}
+
+static void
+hts_settings_rec_destroy(hts_settings_rec_t *rec)
+{
+  settings_store_live -= hts_settings_rec_size(rec);
+  RB_REMOVE(&settings_recs, rec, link);
+  free(rec->data);
+  free(rec);
+}
+
+/*
+ * Remove the record and everything below it
+ */
+static int
+hts_settings_store_remove(const char *path, int self)
+{
+  hts_settings_rec_t *rec, *next;
+  size_t l = strlen(path);
+  char *prefix = alloca(l + 2);
+  int r = 0;
+
+  if (self && (rec = hts_settings_rec_find(path, 0)) != NULL) {
+    hts_settings_rec_destroy(rec);
+    r++;
+  }
+  memcpy(prefix, path, l);
+  prefix[l] = '/';
+  prefix[l+1] = '\0';
+  for (rec = hts_settings_rec_find(prefix, 1); rec; rec = next) {
+    if (strncmp(rec->path, prefix, l + 1))
+      break;
+    next = RB_NEXT(rec, link);
+    hts_settings_rec_destroy(rec);
+    r++;
+  }
+  return r;
+}
+
+/*
+ * Store the record (takes the ownership of data)
+ */
+static void
+hts_settings_store_put(const char *path, void *data, size_t len)
+{
+  hts_settings_rec_t *rec;
+  size_t l = strlen(path) + 1;
+
+  hts_settings_store_remove(path, 0);
+  if ((rec = hts_settings_rec_find(path, 0)) != NULL) {
+    settings_store_live -= rec->len;
+    free(rec->data);
+  } else {
+    rec = malloc(sizeof(*rec) + l);
+    memcpy(rec->path, path, l);
+    RB_INSERT_SORTED(&settings_recs, rec, link, hts_settings_rec_cmp);
+    settings_store_live += sizeof(*rec) + l - 1;
+  }
+  rec->data = data;
+  rec->len = len;
+  settings_store_live += len;
+}
+
+/*
+ * Log entries
+ */
+static int
+hts_settings_store_entry
+  (sbuf_t *sb, const char *path, const void *data, size_t len, int put)
+{
+  htsmsg_t *m = htsmsg_create_map();
+  void *buf;
+  size_t l;
+  int r;
+
+  htsmsg_add_str(m, "p", path);
+  if (put)
+    htsmsg_add_bin_ptr(m, "d", data, len);
+  r = htsmsg_binary2_serialize(m, &buf, &l, HTS_SETTINGS_DB_MAXREC + PATH_MAX);
+  htsmsg_destroy(m);
+  if (r == 0) {
+    sbuf_append(sb, buf, l);
+    free(buf);
+  }
+  return r;
+}
+
+static int
+hts_settings_store_write(int fd, sbuf_t *sb)
+{
+  if (sb->sb_ptr == 0)
+    return 0;
+  if (tvh_write(fd, sb->sb_data, sb->sb_ptr))
+    return -1;
+  sbuf_reset(sb, 1024*1024);
+  return 0;
+}
+
+/*
+ * Write the live records to a new log and replace the old one
+ */
+static int
+hts_settings_store_rewrite(void)
+{
+  char path[PATH_MAX], tmppath[PATH_MAX + 4];
+  hts_settings_rec_t *rec;
+  sbuf_t sb;
+  size_t size = 0;
+  int fd, ok = 1;
+
+  snprintf(path, sizeof(path), "%s/" HTS_SETTINGS_DB, settingspath);
+  snprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+  if ((fd = tvh_open(tmppath, O_CREAT | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR)) < 0) {
+    tvhalert(LS_SETTINGS, "Unable to create \"%s\" - %s",
+             tmppath, strerror(errno));
+    return -1;
+  }
+
+  sbuf_init(&sb);
+  sbuf_append(&sb, HTS_SETTINGS_DB_MAGIC, HTS_SETTINGS_DB_MAGIC_LEN);
+  RB_FOREACH(rec, &settings_recs, link) {
+    hts_settings_store_entry(&sb, rec->path, rec->data, rec->len, 1);
+    if (sb.sb_ptr >= 1024*1024) {
+      size += sb.sb_ptr;
+      if (hts_settings_store_write(fd, &sb)) {
+        ok = 0;
+        break;
+      }
+    }
+  }
+  if (ok) {
+    sbuf_append(&sb, settings_store_commit_data, settings_store_commit_len);
+    size += sb.sb_ptr;
+    ok = hts_settings_store_write(fd, &sb) == 0 && fdatasync(fd) == 0;
+  }
+  sbuf_free(&sb);
+  close(fd);
+
+  if (!ok || rename(tmppath, path)) {
+    tvhalert(LS_SETTINGS, "Unable to write \"%s\" - %s", path, strerror(errno));
+    unlink(tmppath);
+    return -1;
+  }
+
+  if (settings_store_fd >= 0)
+    close(settings_store_fd);
+  settings_store_fd = tvh_open(path, O_WRONLY, 0);
+  if (settings_store_fd < 0 || lseek(settings_store_fd, 0, SEEK_END) < 0) {
+    tvhalert(LS_SETTINGS, "Unable to open \"%s\" - %s", path, strerror(errno));
+    return -1;
+  }
+  settings_store_size = size;
+  return 0;
+}
+
+/*
+ * Append the pending entries with the commit mark
+ */
+static void
+hts_settings_store_commit(void)
+{
+  sbuf_t *sb = &settings_store_pending;
+  size_t size;
+
+  if (sb->sb_ptr == 0 || settings_store_fd < 0)
+    return;
+  sbuf_append(sb, settings_store_commit_data, settings_store_commit_len);
+  size = sb->sb_ptr;
+  if (hts_settings_store_write(settings_store_fd, sb) ||
+      fdatasync(settings_store_fd)) {
+    tvhalert(LS_SETTINGS, "Unable to write \"%s/" HTS_SETTINGS_DB "\" - %s",
+             settingspath, strerror(errno));
+    /* do not leave a partial entry in the log, the memory copy is valid */
+    if (ftruncate(settings_store_fd, settings_store_size) == 0)
+      lseek(settings_store_fd, settings_store_size, SEEK_SET);
+    sbuf_reset(sb, 1024*1024);
+    return;
+  }
+  settings_store_size += size;
+  if (settings_store_size > 2 * settings_store_live + HTS_SETTINGS_DB_COMPACT) {
+    tvhdebug(LS_SETTINGS, "compacting " HTS_SETTINGS_DB " (%zu bytes, %zu live)",
+             settings_store_size, settings_store_live);
+    hts_settings_store_rewrite();
+  }
+}
+
+/*
+ * Apply the committed log entries, returns the length of the valid part
+ */
+static size_t
+hts_settings_store_replay(const uint8_t *data, size_t len)
+{
+  htsmsg_t *m;
+  const char *path;
+  const void *bin;
+  size_t binlen, p, l, end;
+  void *copy;
+
+  for (p = end = 0; p < len; p += l) {
+    if ((l = htsmsg_binary2_length(data + p, len - p)) == 0)
+      break;
+    if (l == settings_store_commit_len &&
+        memcmp(data + p, settings_store_commit_data, l) == 0)
+      end = p + l;
+  }
+
+  for (p = 0; p < end; p += l) {
+    l = end - p;
+    if (htsmsg_binary2_deserialize(&m, data + p, &l, NULL))
+      return p;
+    if ((path = htsmsg_get_str(m, "p")) != NULL) {
+      if (!htsmsg_get_bin(m, "d", &bin, &binlen)) {
+        copy = malloc(binlen);
+        memcpy(copy, bin, binlen);
+        hts_settings_store_put(path, copy, binlen);
+      } else {
+        hts_settings_store_remove(path, 1);
+      }
+    }
+    htsmsg_destroy(m);
+  }
+  return end;
+}
+
+/*
+ * Load the settings store, must be called with the configuration
+ * directory locked (the uncommitted tail is truncated)
+ */
+void
+hts_settings_store_open(void)
+{
+  char path[PATH_MAX];
+  struct stat st;
+  htsmsg_t *m;
+  uint8_t *data;
+  size_t end;
+  ssize_t r;
+  off_t off;
+  int fd;
+
+  if (settingspath == NULL)
+    return;
+
+  m = htsmsg_create_map();
+  htsmsg_add_u32(m, "c", 1);
+  htsmsg_binary2_serialize(m, &settings_store_commit_data,
+                           &settings_store_commit_len, 64);
+  htsmsg_destroy(m);
+
+  snprintf(path, sizeof(path), "%s/" HTS_SETTINGS_DB, settingspath);
+  if (stat(path, &st))
+    return;
+
+  if ((fd = tvh_open(path, O_RDWR, 0)) < 0) {
+    tvhalert(LS_SETTINGS, "Unable to open \"%s\" - %s", path, strerror(errno));
+    exit(78); /* config error */
+  }
+  data = malloc(st.st_size + 1);
+  for (off = 0; off < st.st_size; off += r) {
+    r = read(fd, data + off, st.st_size - off);
+    if (r < 0 && ERRNO_AGAIN(errno)) {
+      r = 0;
+      continue;
+    }
+    if (r <= 0)
+      break;
+  }
+  if (off != st.st_size || off < HTS_SETTINGS_DB_MAGIC_LEN ||
+      memcmp(data, HTS_SETTINGS_DB_MAGIC, HTS_SETTINGS_DB_MAGIC_LEN)) {
+    tvhalert(LS_SETTINGS, "Unable to read \"%s\" - invalid file", path);
+    exit(78); /* config error */
+  }
+
+  end = HTS_SETTINGS_DB_MAGIC_LEN +
+        hts_settings_store_replay(data + HTS_SETTINGS_DB_MAGIC_LEN,
+                                  off - HTS_SETTINGS_DB_MAGIC_LEN);
+  free(data);
+  if (end < (size_t)off) {
+    tvhwarn(LS_SETTINGS, "%s: dropping %zd bytes of uncommitted data",
+            path, (size_t)off - end);
+    if (ftruncate(fd, end))
+      tvhalert(LS_SETTINGS, "Unable to truncate \"%s\" - %s", path, strerror(errno));
+  }
+  lseek(fd, end, SEEK_SET);
+
+  settings_store_fd = fd;
+  settings_store_size = end;
+  settings_store_active = 1;
+  tvhinfo(LS_SETTINGS, "loaded %d records from %s",
+          settings_recs.entries, path);
+}
+
+static void
+hts_settings_store_close(void)
+{
+  hts_settings_rec_t *rec;
+
+  tvh_mutex_lock(&settings_store_lock);
+  hts_settings_store_commit();
+  sbuf_free(&settings_store_pending);
+  if (settings_store_fd >= 0) {
+    close(settings_store_fd);
+    settings_store_fd = -1;
+  }
+  while ((rec = RB_FIRST(&settings_recs)) != NULL)
+    hts_settings_rec_destroy(rec);
+  settings_store_active = 0;
+  free(settings_store_commit_data);
+  settings_store_commit_data = NULL;
+  tvh_mutex_unlock(&settings_store_lock);
+}
+
+/*
+ * Data files and directories kept in the configuration directory,
+ * they always stay on the filesystem
+ */
+static int
+hts_settings_store_data(const char *key)
+{
+  static const char *dirs[] = {
+    "backup", "imagecache/data", "timeshift/buffer"
+  };
+  size_t i, l;
+
+  if (strncmp(key, HTS_SETTINGS_DB, strlen(HTS_SETTINGS_DB)) == 0 ||
+      strncmp(key, "epgdb", 5) == 0)
+    return 1;
+  for (i = 0; i < ARRAY_SIZE(dirs); i++) {
+    l = strlen(dirs[i]);
+    if (strncmp(key, dirs[i], l) == 0 && (key[l] == '\0' || key[l] == '/'))
+      return 1;
+  }
+  return 0;
+}
+
+/*
+ * Conversion of the configuration tree
+ */
+static int
+hts_settings_store_import(const char *dir, const char *rel)
+{
+  char path[PATH_MAX], key[PATH_MAX];
+  struct dirent *d;
+  struct stat st;
+  htsmsg_t *m;
+  void *data;
+  size_t len;
+  DIR *dp;
+  int r = 0;
+
+  if ((dp = opendir(dir)) == NULL)
+    return 0;
+  while ((d = readdir(dp)) != NULL) {
+    const char *name = d->d_name;
+    size_t l = strlen(name);
+    if (name[0] == '.' || name[l-1] == '~' ||
+        (l > 4 && strcmp(name + l - 4, ".tmp") == 0))
+      continue;
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    snprintf(key, sizeof(key), "%s%s%s", rel, *rel ? "/" : "", name);
+    if (hts_settings_store_data(key))
+      continue;
+    if (lstat(path, &st))
+      continue;
+    if (S_ISDIR(st.st_mode)) {
+      r += hts_settings_store_import(path, key);
+      continue;
+    }
+    if (!S_ISREG(st.st_mode) || st.st_size > HTS_SETTINGS_DB_MAXREC)
+      continue;
+    if ((m = hts_settings_load_one(path)) == NULL) {
+      tvhdebug(LS_SETTINGS, "convert: skipping %s", path);
+      continue;
+    }
+    if (htsmsg_binary2_serialize0(m, &data, &len, HTS_SETTINGS_DB_MAXREC) == 0) {
+      hts_settings_store_put(key, data, len);
+      r++;
+    }
+    htsmsg_destroy(m);
+  }
+  closedir(dp);
+  return r;
+}
+
+/**
+ * Convert the file tree to the single-file store, the files are left
+ * in place (as a backup) but they are not used anymore
+ */
+int
+hts_settings_convert(void)
+{
+  int r = 0, n;
+
+  if (settingspath == NULL)
+    return -1;
+  tvh_mutex_lock(&settings_store_lock);
+  if (settings_store_active) {
+    tvhinfo(LS_SETTINGS, "configuration is already stored in %s/" HTS_SETTINGS_DB,
+            settingspath);
+  } else {
+    n = hts_settings_store_import(settingspath, "");
+    if ((r = hts_settings_store_rewrite()) == 0) {
+      settings_store_active = 1;
+      tvhinfo(LS_SETTINGS, "converted %d records to %s/" HTS_SETTINGS_DB,
+              n, settingspath);
+    } else {
+      while (RB_FIRST(&settings_recs))
+        hts_settings_rec_destroy(RB_FIRST(&settings_recs));
+    }
+  }
+  tvh_mutex_unlock(&settings_store_lock);
+  return r;
+}
+
+/**
+ * Group the following saves to one commit
+ */
+void
+hts_settings_batch_begin(void)
+{
+  tvh_mutex_lock(&settings_store_lock);
+  settings_store_batch++;
+  tvh_mutex_unlock(&settings_store_lock);
+}
+
+void
+hts_settings_batch_commit(void)
+{
+  tvh_mutex_lock(&settings_store_lock);
+  assert(settings_store_batch > 0);
+  if (--settings_store_batch == 0)
+    hts_settings_store_commit();
+  tvh_mutex_unlock(&settings_store_lock);
+}
+
 /**
  *
  */
@@ -64,6 +575,7 @@ hts_settings_init(const char *confpath)
 void
 hts_settings_done(void)
 {
+  hts_settings_store_close();
   free(settingspath);
 }
 
@@ -125,6 +637,117 @@ hts_settings_buildpath
   return 0;
 }
 
+/*
+ * Returns with settings_store_lock held and the store key in dst
+ * when the path is handled by the settings store
+ */
+static int
+hts_settings_store_lock(char *dst, size_t dstsize, const char *fmt, va_list ap)
+{
+  size_t l;
+
+  tvh_mutex_lock(&settings_store_lock);
+  if (settings_store_active) {
+    _hts_settings_buildpath(dst, dstsize, fmt, ap, NULL);
+    l = strlen(dst);
+    while (l > 0 && dst[l-1] == '/')
+      dst[--l] = '\0';
+    if (l > 0 && *dst != '/' && !hts_settings_store_data(dst))
+      return 1;
+  }
+  tvh_mutex_unlock(&settings_store_lock);
+  return 0;
+}
+
+static hts_settings_rec_t *
+hts_settings_store_first(const char *path, char **prefix)
+{
+  hts_settings_rec_t *rec;
+  size_t l = strlen(path);
+  char *p = malloc(l + 2);
+
+  memcpy(p, path, l);
+  p[l] = '/';
+  p[l+1] = '\0';
+  rec = hts_settings_rec_find(p, 1);
+  if (rec && strncmp(rec->path, p, l + 1))
+    rec = NULL;
+  *prefix = p;
+  return rec;
+}
+
+static htsmsg_t *
+hts_settings_store_decode(hts_settings_rec_t *rec)
+{
+  void *data = malloc(rec->len ?: 1);
+
+  memcpy(data, rec->data, rec->len);
+  return htsmsg_binary2_deserialize0(data, rec->len, data);
+}
+
+/*
+ * Load the record or build the map of the records below the path
+ * (same depth semantics as for the directory tree)
+ */
+static htsmsg_t *
+hts_settings_store_load(const char *path, int depth)
+{
+  hts_settings_rec_t *rec;
+  htsmsg_t *r, *c, *parent, **dirs;
+  const char *name, *s, **dname;
+  char *prefix, buf[PATH_MAX];
+  size_t l, n, *dlen;
+  int i, levels = 0;
+
+  if ((rec = hts_settings_rec_find(path, 0)) != NULL)
+    return hts_settings_store_decode(rec);
+
+  if ((rec = hts_settings_store_first(path, &prefix)) == NULL) {
+    free(prefix);
+    return NULL;
+  }
+  l = strlen(prefix);
+  dirs = alloca((depth + 1) * sizeof(*dirs));
+  dname = alloca((depth + 1) * sizeof(*dname));
+  dlen = alloca((depth + 1) * sizeof(*dlen));
+  r = htsmsg_create_map();
+  for ( ; rec && strncmp(rec->path, prefix, l) == 0; rec = RB_NEXT(rec, link)) {
+    name = rec->path + l;
+    for (i = 0; (s = strchr(name, '/')) != NULL; i++, name = s + 1) {
+      if (i >= depth)
+        break;
+      n = s - name;
+      if (i < levels && dlen[i] == n && memcmp(dname[i], name, n) == 0)
+        continue;
+      parent = i ? dirs[i-1] : r;
+      strlcpy(buf, name, MIN(n + 1, sizeof(buf)));
+      dirs[i] = htsmsg_add_msg(parent, buf, htsmsg_create_map());
+      dname[i] = name;
+      dlen[i] = n;
+      levels = i + 1;
+    }
+    if (s)
+      continue;
+    if ((c = hts_settings_store_decode(rec)) != NULL)
+      htsmsg_add_msg(i ? dirs[i-1] : r, name, c);
+  }
+  free(prefix);
+  /* the subtree exists, an empty map like for a directory */
+  return r;
+}
+
+static int
+hts_settings_store_exists(const char *path)
+{
+  char *prefix = NULL;
+  int r;
+
+  r = hts_settings_rec_find(path, 0) != NULL ||
+      hts_settings_store_first(path, &prefix) != NULL;
+  free(prefix);
+  return r;
+}
+
 /**
  *
  */
@@ -138,10 +761,31 @@ hts_settings_save(htsmsg_t *record, const char *pathfmt, ...)
   htsbuf_queue_t hq;
   htsbuf_data_t *hd;
   int ok, r, pack;
+  void *data = NULL;
+  size_t len;
 
   if(settingspath == NULL)
     return;
 
+  /* Settings store */
+  va_start(ap, pathfmt);
+  r = hts_settings_store_lock(path, sizeof(path), pathfmt, ap);
+  va_end(ap);
+  if (r) {
+    tvhdebug(LS_SETTINGS, "saving %s to " HTS_SETTINGS_DB, path);
+    if (htsmsg_binary2_serialize0(record, &data, &len, HTS_SETTINGS_DB_MAXREC) ||
+        hts_settings_store_entry(&settings_store_pending, path, data, len, 1)) {
+      tvhalert(LS_SETTINGS, "Unable to pack the configuration data \"%s\"", path);
+      free(data);
+    } else {
+      hts_settings_store_put(path, data, len);
+      if (settings_store_batch == 0)
+        hts_settings_store_commit();
+    }
+    tvh_mutex_unlock(&settings_store_lock);
+    return;
+  }
+
   /* Clean the path */
   va_start(ap, pathfmt);
   _hts_settings_buildpath(path, sizeof(path), pathfmt, ap, settingspath);
@@ -327,13 +971,20 @@ hts_settings_vload(const char *pathfmt, va_list ap, int depth)
 {
   htsmsg_t *ret = NULL;
   char fullpath[PATH_MAX];
-  va_list ap2;
+  va_list ap1, ap2;
+  va_copy(ap1, ap);
   va_copy(ap2, ap);
 
-  /* Try normal path */
-  _hts_settings_buildpath(fullpath, sizeof(fullpath), 
-                          pathfmt, ap, settingspath);
-  ret = hts_settings_load_path(fullpath, depth);
+  /* Try settings store or normal path */
+  if (hts_settings_store_lock(fullpath, sizeof(fullpath), pathfmt, ap1)) {
+    ret = hts_settings_store_load(fullpath, depth);
+    tvh_mutex_unlock(&settings_store_lock);
+  } else {
+    _hts_settings_buildpath(fullpath, sizeof(fullpath),
+                            pathfmt, ap, settingspath);
+    ret = hts_settings_load_path(fullpath, depth);
+  }
+  va_end(ap1);
 
   /* Try bundle path */
   if (!ret && *pathfmt != '/') {
@@ -384,6 +1035,21 @@ hts_settings_remove(const char *pathfmt, ...)
   char fullpath[PATH_MAX];
   va_list ap;
   struct stat st;
+  int r;
+
+  va_start(ap, pathfmt);
+  r = hts_settings_store_lock(fullpath, sizeof(fullpath), pathfmt, ap);
+  va_end(ap);
+  if (r) {
+    if (hts_settings_store_remove(fullpath, 1)) {
+      tvhdebug(LS_SETTINGS, "removing %s from " HTS_SETTINGS_DB, fullpath);
+      hts_settings_store_entry(&settings_store_pending, fullpath, NULL, 0, 0);
+      if (settings_store_batch == 0)
+        hts_settings_store_commit();
+    }
+    tvh_mutex_unlock(&settings_store_lock);
+    return;
+  }
 
   va_start(ap, pathfmt);
   _hts_settings_buildpath(fullpath, sizeof(fullpath),
@@ -436,6 +1102,17 @@ hts_settings_exists ( const char *pathfmt, ... )
   va_list ap;
   char path[PATH_MAX];
   struct stat st;
+  int r;
+
+  /* Settings store */
+  va_start(ap, pathfmt);
+  r = hts_settings_store_lock(path, sizeof(path), pathfmt, ap);
+  va_end(ap);
+  if (r) {
+    r = hts_settings_store_exists(path);
+    tvh_mutex_unlock(&settings_store_lock);
+    return r;
+  }
 
   /* Build path */
   va_start(ap, pathfmt);
@@ -28,8 +28,16 @@
 
 void hts_settings_init(const char *confpath);
 
+void hts_settings_store_open(void);
+
 void hts_settings_done(void);
 
+int hts_settings_convert(void);
+
+void hts_settings_batch_begin(void);
+
+void hts_settings_batch_commit(void);
+
 void hts_settings_save(htsmsg_t *record, const char *pathfmt, ...);
 
 htsmsg_t *hts_settings_load(const char *pathfmt, ...);
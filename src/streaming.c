@@ -25,6 +25,7 @@
 #include "atomic.h"
 #include "service.h"
 #include "timeshift.h"
+#include "mempool.h"
 
 static memoryinfo_t streaming_msg_memoryinfo = { .my_name = "Streaming message" };
 
@@ -201,7 +202,7 @@ streaming_target_disconnect(streaming_pad_t *sp, streaming_target_t *st)
 streaming_message_t *
 streaming_msg_create(streaming_message_type_t type)
 {
-  streaming_message_t *sm = malloc(sizeof(streaming_message_t));
+  streaming_message_t *sm = mempool_alloc(sizeof(streaming_message_t));
   memoryinfo_alloc(&streaming_msg_memoryinfo, sizeof(*sm));
   sm->sm_type = type;
 #if ENABLE_TIMESHIFT
@@ -256,7 +257,7 @@ streaming_msg_create_code(streaming_message_type_t type, int code)
 streaming_message_t *
 streaming_msg_clone(streaming_message_t *src)
 {
-  streaming_message_t *dst = malloc(sizeof(streaming_message_t));
+  streaming_message_t *dst = mempool_alloc(sizeof(streaming_message_t));
   streaming_start_t *ss;
 
   memoryinfo_alloc(&streaming_msg_memoryinfo, sizeof(*dst));
@@ -388,7 +389,7 @@ streaming_msg_free(streaming_message_t *sm)
     abort();
   }
   memoryinfo_free(&streaming_msg_memoryinfo, sizeof(*sm));
-  free(sm);
+  mempool_free(sm, sizeof(*sm));
 }
 
 /**
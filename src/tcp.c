@@ -34,6 +34,7 @@
 #include "notify.h"
 #include "access.h"
 #include "dvr/dvr.h"
+#include "config.h"
 #define COMPAT_IPTOS
 #include "compat.h"
 
@@ -517,11 +518,16 @@ typedef struct tcp_server {
   LIST_ENTRY(tcp_server) link;
 } tcp_server_t;
 
+struct tcp_pool_worker;
+
 typedef struct tcp_server_launch {
   pthread_t tid;
   uint32_t id;
   int fd;
   int streaming;
+  int pool;
+  int64_t deadline;
+  struct tcp_pool_worker *worker;
   tcp_server_ops_t ops;
   void *opaque;
   char *representative;
@@ -532,6 +538,8 @@ typedef struct tcp_server_launch {
   LIST_ENTRY(tcp_server_launch) link;
   LIST_ENTRY(tcp_server_launch) alink;
   LIST_ENTRY(tcp_server_launch) jlink;
+  TAILQ_ENTRY(tcp_server_launch) plink;
+  LIST_ENTRY(tcp_server_launch) dlink;
 } tcp_server_launch_t;
 
 static LIST_HEAD(, tcp_server) tcp_server_delete_list = { 0 };
@@ -539,6 +547,86 @@ static LIST_HEAD(, tcp_server_launch) tcp_server_launches = { 0 };
 static LIST_HEAD(, tcp_server_launch) tcp_server_active = { 0 };
 static LIST_HEAD(, tcp_server_launch) tcp_server_join = { 0 };
 
+/*
+ * Worker pool: the connections waiting for input are parked in
+ * tcp_pool_poll and a few worker threads serve the ready ones.
+ * The dispatcher shuts down the connections which passed their
+ * deadline (request read or parked idle time).
+ */
+#define TCP_POOL_IDLE_TIMEOUT 60
+typedef struct tcp_pool_worker {
+  pthread_t tid;
+  int lent;     /* serving a long-lived connection, exit when done */
+  LIST_ENTRY(tcp_pool_worker) link;
+} tcp_pool_worker_t;
+
+static tvhpoll_t *tcp_pool_poll;
+static pthread_t tcp_pool_tid;
+static tvh_mutex_t tcp_pool_lock;
+static tvh_cond_t tcp_pool_cond;
+static int tcp_pool_running;
+static int tcp_pool_started;    /* owned by the tcp-loop thread */
+static int tcp_pool_count;      /* workers in the pool (not lent) */
+static int tcp_pool_idle;
+static TAILQ_HEAD(, tcp_server_launch) tcp_pool_queue;
+static LIST_HEAD(, tcp_pool_worker) tcp_pool_workers = { 0 };
+static LIST_HEAD(, tcp_pool_worker) tcp_pool_join = { 0 };
+static LIST_HEAD(, tcp_server_launch) tcp_pool_conns = { 0 };
+static __thread tcp_server_launch_t *tcp_pool_current;
+
+static void tcp_pool_spawn(void);
+
+/*
+ * The worker is blocked by this connection, replace it in the pool
+ *
+ * Note: tcp_pool_lock must be held
+ */
+static void
+tcp_pool_lend(tcp_server_launch_t *tsl)
+{
+  tsl->deadline = 0;
+  if (tsl->worker && !tsl->worker->lent) {
+    tsl->worker->lent = 1;
+    tcp_pool_count--;
+    if (!TAILQ_EMPTY(&tcp_pool_queue) && tcp_pool_idle == 0)
+      tcp_pool_spawn();
+  }
+}
+
+/*
+ * The pool connection served by this thread is going to block for
+ * a long time (websocket, long poll), so the thread leaves the pool
+ * and serves only this connection. No-op outside the worker pool.
+ */
+void
+tcp_connection_detach(void)
+{
+  tcp_server_launch_t *tsl = tcp_pool_current;
+
+  if (tsl == NULL)
+    return;
+  tvh_mutex_lock(&tcp_pool_lock);
+  tcp_pool_lend(tsl);
+  tvh_mutex_unlock(&tcp_pool_lock);
+}
+
+/*
+ * Shut down the pool connection served by this thread when it is
+ * still busy after sec seconds (0 = no limit). No-op outside the
+ * worker pool.
+ */
+void
+tcp_connection_deadline(int sec)
+{
+  tcp_server_launch_t *tsl = tcp_pool_current;
+
+  if (tsl == NULL)
+    return;
+  tvh_mutex_lock(&tcp_pool_lock);
+  tsl->deadline = sec > 0 ? mclk() + sec2mono(sec) : 0;
+  tvh_mutex_unlock(&tcp_pool_lock);
+}
+
 /**
  *
  */
@@ -622,6 +710,11 @@ try_again:
   res->representative = aa->aa_representative ? strdup(aa->aa_representative) : NULL;
   res->status = status;
   res->streaming = streaming;
+  if (streaming && res->pool) {
+    tvh_mutex_lock(&tcp_pool_lock);
+    tcp_pool_lend(res);
+    tvh_mutex_unlock(&tcp_pool_lock);
+  }
   LIST_INSERT_HEAD(&tcp_server_launches, res, link);
   notify_reload("connections");
   return res;
@@ -683,38 +776,48 @@ tcp_connection_cancel_all(void)
 /*
  *
  */
-static void *
-tcp_server_start(void *aux)
+static void
+tcp_server_sockopts(int fd)
 {
-  tcp_server_launch_t *tsl = aux;
   struct timeval to;
   int val;
-  char c = 'J';
 
   val = 1;
-  setsockopt(tsl->fd, SOL_SOCKET, SO_KEEPALIVE, &val, sizeof(val));
+  setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &val, sizeof(val));
   
 #ifdef TCP_KEEPIDLE
   val = 30;
-  setsockopt(tsl->fd, IPPROTO_TCP, TCP_KEEPIDLE, &val, sizeof(val));
+  setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &val, sizeof(val));
 #endif
 
 #ifdef TCP_KEEPINVL
   val = 15;
-  setsockopt(tsl->fd, IPPROTO_TCP, TCP_KEEPINTVL, &val, sizeof(val));
+  setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &val, sizeof(val));
 #endif
 
 #ifdef TCP_KEEPCNT
   val = 5;
-  setsockopt(tsl->fd, IPPROTO_TCP, TCP_KEEPCNT, &val, sizeof(val));
+  setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &val, sizeof(val));
 #endif
 
   val = 1;
-  setsockopt(tsl->fd, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val));
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val));
 
   to.tv_sec  = 30;
   to.tv_usec =  0;
-  setsockopt(tsl->fd, SOL_SOCKET, SO_SNDTIMEO, &to, sizeof(to));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &to, sizeof(to));
+}
+
+/*
+ *
+ */
+static void *
+tcp_server_start(void *aux)
+{
+  tcp_server_launch_t *tsl = aux;
+  char c = 'J';
+
+  tcp_server_sockopts(tsl->fd);
 
   /* Start */
   time(&tsl->started);
@@ -734,6 +837,213 @@ tcp_server_start(void *aux)
 }
 
 
+/*
+ * Serve one ready connection from the worker pool
+ */
+static void
+tcp_pool_serve(tcp_server_launch_t *tsl)
+{
+  int r;
+
+  tvh_mutex_lock(&global_lock);
+  tcp_pool_current = tsl;
+  r = tsl->ops.serve(tsl->fd, &tsl->opaque, &tsl->peer, &tsl->self);
+  tcp_pool_current = NULL;
+  tvh_mutex_lock(&tcp_pool_lock);
+  tsl->worker = NULL;
+  if (r) {
+    /* park, wait for more input */
+    tsl->deadline = mclk() + sec2mono(TCP_POOL_IDLE_TIMEOUT);
+    tvh_mutex_unlock(&tcp_pool_lock);
+    tvhpoll_add1(tcp_pool_poll, tsl->fd, TVHPOLL_IN, tsl);
+    tvh_mutex_unlock(&global_lock);
+    return;
+  }
+  LIST_REMOVE(tsl, dlink);
+  tvh_mutex_unlock(&tcp_pool_lock);
+  close(tsl->fd);
+  if (tsl->ops.stop) tsl->ops.stop(tsl->opaque);
+  LIST_REMOVE(tsl, alink);
+  tvh_mutex_unlock(&global_lock);
+  free(tsl);
+}
+
+/*
+ *
+ */
+static inline int
+tcp_pool_limit(void)
+{
+  return MAX(config.tcp_workers, 1);
+}
+
+static void *
+tcp_pool_worker(void *aux)
+{
+  tcp_pool_worker_t *w = aux;
+  tcp_server_launch_t *tsl;
+
+  tvh_mutex_lock(&tcp_pool_lock);
+  while (atomic_get(&tcp_pool_running)) {
+    if (tcp_pool_count > tcp_pool_limit())
+      break;
+    tsl = TAILQ_FIRST(&tcp_pool_queue);
+    if (tsl == NULL) {
+      tcp_pool_idle++;
+      tvh_cond_wait(&tcp_pool_cond, &tcp_pool_lock);
+      tcp_pool_idle--;
+      continue;
+    }
+    TAILQ_REMOVE(&tcp_pool_queue, tsl, plink);
+    tsl->worker = w;
+    tsl->deadline = 0;
+    tvh_mutex_unlock(&tcp_pool_lock);
+    tcp_pool_serve(tsl);
+    tvh_mutex_lock(&tcp_pool_lock);
+    if (w->lent)
+      break;
+  }
+  if (!w->lent)
+    tcp_pool_count--;
+  LIST_REMOVE(w, link);
+  LIST_INSERT_HEAD(&tcp_pool_join, w, link);
+  tvh_mutex_unlock(&tcp_pool_lock);
+  return NULL;
+}
+
+/* Note: tcp_pool_lock must be held */
+static void
+tcp_pool_spawn(void)
+{
+  tcp_pool_worker_t *w;
+
+  if (tcp_pool_count >= tcp_pool_limit())
+    return;
+  w = calloc(1, sizeof(*w));
+  LIST_INSERT_HEAD(&tcp_pool_workers, w, link);
+  tcp_pool_count++;
+  tvh_thread_create(&w->tid, NULL, tcp_pool_worker, w, "tcp-worker");
+}
+
+/*
+ *
+ */
+static void
+tcp_pool_reap(void)
+{
+  tcp_pool_worker_t *w;
+
+  tvh_mutex_lock(&tcp_pool_lock);
+  while ((w = LIST_FIRST(&tcp_pool_join)) != NULL) {
+    LIST_REMOVE(w, link);
+    tvh_mutex_unlock(&tcp_pool_lock);
+    pthread_join(w->tid, NULL);
+    free(w);
+    tvh_mutex_lock(&tcp_pool_lock);
+  }
+  tvh_mutex_unlock(&tcp_pool_lock);
+}
+
+/*
+ * Shut down the connections which passed the deadline, the serve
+ * callback sees an error or EOF and closes the connection
+ */
+static void
+tcp_pool_expire(void)
+{
+  tcp_server_launch_t *tsl;
+  int64_t now = mclk();
+  char buf[50];
+
+  tvh_mutex_lock(&tcp_pool_lock);
+  LIST_FOREACH(tsl, &tcp_pool_conns, dlink)
+    if (tsl->deadline && tsl->deadline < now) {
+      tsl->deadline = 0;
+      tcp_get_str_from_ip(&tsl->peer, buf, sizeof(buf));
+      tvhdebug(LS_TCP, "%s: connection %s timeout", buf,
+               tsl->worker ? "request" : "idle");
+      shutdown(tsl->fd, SHUT_RDWR);
+    }
+  tvh_mutex_unlock(&tcp_pool_lock);
+}
+
+/*
+ *
+ */
+static void *
+tcp_pool_loop(void *aux)
+{
+  tvhpoll_event_t ev[16];
+  tcp_server_launch_t *tsl;
+  int64_t expire = 0;
+  int i, r;
+
+  while (atomic_get(&tcp_pool_running)) {
+    if (expire < mclk()) {
+      tcp_pool_expire();
+      expire = mclk() + sec2mono(1);
+    }
+    r = tvhpoll_wait(tcp_pool_poll, ev, ARRAY_SIZE(ev), 1000);
+    if (r < 0) {
+      if (ERRNO_AGAIN(errno))
+        continue;
+      tvherror(LS_TCP, "tcp_pool_loop: tvhpoll_wait: %s", strerror(errno));
+      continue;
+    }
+    tvh_mutex_lock(&tcp_pool_lock);
+    for (i = 0; i < r; i++) {
+      tsl = ev[i].ptr;
+      tvhpoll_rem1(tcp_pool_poll, tsl->fd);
+      TAILQ_INSERT_TAIL(&tcp_pool_queue, tsl, plink);
+      if (tcp_pool_idle == 0)
+        tcp_pool_spawn();
+    }
+    if (r > 0)
+      tvh_cond_signal(&tcp_pool_cond, r > 1);
+    tvh_mutex_unlock(&tcp_pool_lock);
+    tcp_pool_reap();
+  }
+  return NULL;
+}
+
+/*
+ * The pool is started with the first pooled connection, so nothing
+ * is allocated when tcp_workers is zero (the default)
+ */
+static void
+tcp_pool_start(void)
+{
+  if (tcp_pool_started)
+    return;
+  tcp_pool_started = 1;
+  tcp_pool_poll = tvhpoll_create(256);
+  atomic_set(&tcp_pool_running, 1);
+  tvh_thread_create(&tcp_pool_tid, NULL, tcp_pool_loop, NULL, "tcp-pool");
+}
+
+/*
+ *
+ */
+static void
+tcp_pool_add(tcp_server_launch_t *tsl)
+{
+  tcp_pool_start();
+  tcp_server_sockopts(tsl->fd);
+
+  time(&tsl->started);
+  tvh_mutex_lock(&global_lock);
+  tsl->id = ++tcp_server_launch_id;
+  if (!tsl->id) tsl->id = ++tcp_server_launch_id;
+  LIST_INSERT_HEAD(&tcp_server_active, tsl, alink);
+  tvh_mutex_lock(&tcp_pool_lock);
+  tsl->deadline = mclk() + sec2mono(TCP_POOL_IDLE_TIMEOUT);
+  LIST_INSERT_HEAD(&tcp_pool_conns, tsl, dlink);
+  tvh_mutex_unlock(&tcp_pool_lock);
+  /* wait for the request */
+  tvhpoll_add1(tcp_pool_poll, tsl->fd, TVHPOLL_IN, tsl);
+  tvh_mutex_unlock(&global_lock);
+}
+
 /**
  *
  */
@@ -793,6 +1103,10 @@ next:
       tsl->opaque         = ts->opaque;
       tsl->status         = NULL;
       tsl->representative = NULL;
+      tsl->streaming      = 0;
+      tsl->pool           = ts->ops.serve && config.tcp_workers > 0;
+      tsl->worker         = NULL;
+      tsl->opaque         = tsl->pool ? NULL : ts->opaque;
       slen = sizeof(struct sockaddr_storage);
 
       tsl->fd = accept(ts->serverfd, 
@@ -811,6 +1125,11 @@ next:
         continue;
       }
 
+      if (tsl->pool) {
+        tcp_pool_add(tsl);
+        continue;
+      }
+
       tvh_mutex_lock(&global_lock);
       LIST_INSERT_HEAD(&tcp_server_active, tsl, alink);
       tvh_mutex_unlock(&global_lock);
@@ -1178,6 +1497,10 @@ tcp_server_init(void)
 
   atomic_set(&tcp_server_running, 1);
   tvh_thread_create(&tcp_server_tid, NULL, tcp_server_loop, NULL, "tcp-loop");
+
+  tvh_mutex_init(&tcp_pool_lock, NULL);
+  tvh_cond_init(&tcp_pool_cond, 1);
+  TAILQ_INIT(&tcp_pool_queue);
 }
 
 void
@@ -1187,6 +1510,7 @@ tcp_server_done(void)
   tcp_server_launch_t *tsl;  
   char c = 'E';
   int64_t t;
+  int r;
 
   atomic_set(&tcp_server_running, 0);
   tvh_write(tcp_server_pipe.wr, &c, 1);
@@ -1197,7 +1521,8 @@ tcp_server_done(void)
       tsl->ops.cancel(tsl->opaque);
     if (tsl->fd >= 0)
       shutdown(tsl->fd, SHUT_RDWR);
-    tvh_thread_kill(tsl->tid, SIGTERM);
+    if (!tsl->pool)
+      tvh_thread_kill(tsl->tid, SIGTERM);
   }
   tvh_mutex_unlock(&global_lock);
 
@@ -1226,4 +1551,24 @@ tcp_server_done(void)
     free(ts);
   }
   tvh_mutex_unlock(&global_lock);
+
+  /* all connections are closed now, stop the worker pool */
+  if (!tcp_pool_started)
+    return;
+  atomic_set(&tcp_pool_running, 0);
+  pthread_join(tcp_pool_tid, NULL);
+  tvh_mutex_lock(&tcp_pool_lock);
+  tvh_cond_signal(&tcp_pool_cond, 1);
+  tvh_mutex_unlock(&tcp_pool_lock);
+  while (1) {
+    tvh_mutex_lock(&tcp_pool_lock);
+    r = LIST_EMPTY(&tcp_pool_workers);
+    tvh_mutex_unlock(&tcp_pool_lock);
+    if (r)
+      break;
+    tvh_safe_usleep(20000);
+    tcp_pool_reap();
+  }
+  tcp_pool_reap();
+  tvhpoll_destroy(tcp_pool_poll);
 }
@@ -54,6 +54,11 @@ typedef struct tcp_server_ops
                      struct sockaddr_storage *self);
   void (*stop)   (void *opaque);
   void (*cancel) (void *opaque);
+  /* optional, the worker pool mode: serve the pending input and return
+   * 1 to wait for more input or 0 to close the connection */
+  int  (*serve)  (int fd, void **opaque,
+                  struct sockaddr_storage *peer,
+                  struct sockaddr_storage *self);
 } tcp_server_ops_t;
 
 extern int tcp_preferred_address_family;
@@ -160,6 +165,8 @@ void *tcp_connection_launch(int fd, int streaming,
                             void (*status) (void *opaque, htsmsg_t *m),
                             struct access *aa);
 void tcp_connection_land(void *tcp_id);
+void tcp_connection_detach(void);
+void tcp_connection_deadline(int sec);
 void tcp_connection_cancel(uint32_t id);
 void tcp_connection_cancel_all(void);
 
@@ -25,6 +25,7 @@
 #include "atomic.h"
 #include "access.h"
 #include "atomic.h"
+#include "channels.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -35,6 +36,9 @@
 #include <stdio.h>
 
 static int timeshift_index = 0;
+static int timeshift_buffer_index = 0;
+
+static LIST_HEAD(, timeshift_buffer) timeshift_buffers;
 
 struct timeshift_conf timeshift_conf;
 
@@ -46,13 +50,13 @@ memoryinfo_t timeshift_memoryinfo_ram = { .my_name = "Timeshift RAM buffer" };
  */
 void
 timeshift_packet_log0
-  ( const char *source, timeshift_t *ts, streaming_message_t *sm )
+  ( const char *source, int id, streaming_message_t *sm )
 {
   th_pkt_t *pkt = sm->sm_data;
   tvhtrace(LS_TIMESHIFT,
            "ts %d pkt %s - stream %d type %c pts %10"PRId64
            " dts %10"PRId64" dur %10d len %6zu time %14"PRId64,
-           ts->id, source,
+           id, source,
            pkt->pkt_componentindex,
            SCT_ISVIDEO(pkt->pkt_type) ? pkt_frametype_to_char(pkt->v.pkt_frametype) : '-',
            ts_rescale(pkt->pkt_pts, 1000000),
@@ -303,28 +307,305 @@ const idclass_t timeshift_conf_class = {
   }
 };
 
+/*
+ * Convert a buffered message to the subscriber timebase
+ *
+ * Returns NULL when the message is dropped, must hold state mutex
+ */
+streaming_message_t *
+timeshift_adjust ( timeshift_t *ts, streaming_message_t *sm )
+{
+  th_pkt_t *pkt, *n;
+  int64_t delta = timeshift_pts_delta(ts);
+
+  if (sm->sm_type == SMT_PACKET && delta) {
+    pkt = sm->sm_data;
+    if (pkt->pkt_dts != PTS_UNSET && pkt->pkt_dts < delta) {
+      pkt_trace(LS_TIMESHIFT, pkt, "packet drop (delta %"PRId64")", delta);
+      streaming_msg_free(sm);
+      return NULL;
+    }
+    n = pkt_copy_shallow(pkt);
+    pkt_ref_dec(pkt);
+    if (n->pkt_pts != PTS_UNSET) n->pkt_pts -= delta;
+    if (n->pkt_dts != PTS_UNSET) n->pkt_dts -= delta;
+    if (n->pkt_pcr != PTS_UNSET) n->pkt_pcr -= delta;
+    sm->sm_data = n;
+  }
+  return sm;
+}
+
+/*
+ * Deliver a buffered message in the subscriber timebase
+ */
+void
+timeshift_deliver ( timeshift_t *ts, streaming_message_t *sm )
+{
+  if ((sm = timeshift_adjust(ts, sm)) != NULL)
+    streaming_target_deliver2(ts->output, sm);
+}
+
+/*
+ * Timebase offset of the subscribers
+ *
+ * Each subscriber has its own parser and timestamp fixup, so the offset
+ * of a subscriber which does not feed the buffer is found by matching
+ * the content of its packets with the buffered ones. The packets are
+ * delivered to the subscribers and to the writer thread in any order,
+ * so both sides remember the recent packets and the side which comes
+ * second finds the match. The video packets are used when available,
+ * the audio frames might repeat (silence), so the ambiguous matches are
+ * ignored and the offset is accepted after several consistent matches.
+ * It is checked again periodically.
+ */
+static uint32_t
+timeshift_sync_sig ( timeshift_buffer_t *tsb, th_pkt_t *pkt )
+{
+  size_t len = pktbuf_len(pkt->pkt_payload);
+  uint32_t sig;
+
+  if (len == 0 || pkt->pkt_dts == PTS_UNSET)
+    return 0;
+  if (tsb->vididx >= 0 && pkt->pkt_componentindex != tsb->vididx)
+    return 0;
+  sig = tvh_crc32(pktbuf_ptr(pkt->pkt_payload), MIN(len, 1024),
+                  (len << 8) ^ pkt->pkt_componentindex);
+  return sig ?: 1;
+}
+
+static void
+timeshift_sync_add
+  ( timeshift_sync_t *sync, int *idx, uint32_t sig, int64_t dts )
+{
+  sync[*idx].sig = sig;
+  sync[*idx].dts = dts;
+  *idx = (*idx + 1) % TIMESHIFT_SYNC_MAX;
+}
+
+static int64_t
+timeshift_sync_find ( timeshift_sync_t *sync, uint32_t sig )
+{
+  int64_t dts = PTS_UNSET;
+  int i;
+
+  for (i = 0; i < TIMESHIFT_SYNC_MAX; i++)
+    if (sync[i].sig == sig) {
+      if (dts != PTS_UNSET && dts != sync[i].dts)
+        return PTS_UNSET;
+      dts = sync[i].dts;
+    }
+  return dts;
+}
+
+static void
+timeshift_sync_set ( timeshift_t *ts, int64_t delta )
+{
+  if (ts->pts_delta == PTS_UNSET)
+    tvhdebug(LS_TIMESHIFT, "ts %d pts delta %"PRId64, ts->id, delta);
+  else if (ts->pts_delta != delta)
+    tvhwarn(LS_TIMESHIFT, "ts %d pts delta changed %"PRId64" -> %"PRId64,
+            ts->id, ts->pts_delta, delta);
+  ts->pts_delta = delta;
+  ts->sync_count = 0;
+  memset(ts->sync, 0, sizeof(ts->sync));
+  atomic_set(&ts->sync_check, 0);
+}
+
+/*
+ * Must hold state mutex
+ */
+static void
+timeshift_sync_match ( timeshift_t *ts, int64_t delta )
+{
+  if (ts->sync_count == 0 || ts->sync_delta != delta) {
+    ts->sync_delta = delta;
+    ts->sync_count = 0;
+  }
+  if (++ts->sync_count >= TIMESHIFT_SYNC_MATCH)
+    timeshift_sync_set(ts, delta);
+}
+
+static inline int
+timeshift_sync_active ( timeshift_t *ts )
+{
+  return !ts->direct &&
+         (ts->pts_delta == PTS_UNSET || atomic_get(&ts->sync_check));
+}
+
+/*
+ * Subscriber packet (not from the writer)
+ *
+ * Must hold state mutex
+ */
+static void
+timeshift_sync_input ( timeshift_t *ts, th_pkt_t *pkt )
+{
+  timeshift_buffer_t *tsb = ts->buf;
+  uint32_t sig;
+  int64_t dts;
+
+  tvh_mutex_lock(&tsb->wr_mutex);
+  sig = timeshift_sync_sig(tsb, pkt);
+  dts = sig ? timeshift_sync_find(tsb->sync, sig) : PTS_UNSET;
+  tvh_mutex_unlock(&tsb->wr_mutex);
+  if (sig == 0)
+    return;
+  if (dts != PTS_UNSET)
+    timeshift_sync_match(ts, dts - pkt->pkt_dts);
+  else
+    timeshift_sync_add(ts->sync, &ts->sync_idx, sig, pkt->pkt_dts);
+}
+
+/*
+ * Buffered packet (writer thread)
+ *
+ * Must hold buffer lock
+ */
+void
+timeshift_sync ( timeshift_buffer_t *tsb, th_pkt_t *pkt )
+{
+  timeshift_t *ts;
+  uint32_t sig = 0;
+  int64_t dts;
+  int added = 0;
+
+  LIST_FOREACH(ts, &tsb->readers, buf_link) {
+    tvh_mutex_lock(&ts->state_mutex);
+    if (timeshift_sync_active(ts) && !atomic_get(&ts->writer)) {
+      if (!added) {
+        tvh_mutex_lock(&tsb->wr_mutex);
+        if ((sig = timeshift_sync_sig(tsb, pkt)) != 0)
+          timeshift_sync_add(tsb->sync, &tsb->sync_idx, sig, pkt->pkt_dts);
+        tvh_mutex_unlock(&tsb->wr_mutex);
+        added = 1;
+      }
+      if (sig && (dts = timeshift_sync_find(ts->sync, sig)) != PTS_UNSET)
+        timeshift_sync_match(ts, pkt->pkt_dts - dts);
+    }
+    tvh_mutex_unlock(&ts->state_mutex);
+  }
+}
+
+/*
+ * The subscriber packets do not match the buffered ones (e.g. a channel
+ * served from another service), deliver them live without timeshift.
+ *
+ * Must hold state mutex
+ */
+static void
+timeshift_sync_timeout ( timeshift_t *ts )
+{
+  int64_t now = mclk();
+
+  if (ts->sync_start == 0) {
+    ts->sync_start = now;
+  } else if (now - ts->sync_start > sec2mono(TIMESHIFT_SYNC_TIMEOUT)) {
+    ts->direct = 1;
+    tvhwarn(LS_TIMESHIFT, "ts %d not in sync with buf %d, live only",
+            ts->id, ts->buf->id);
+  }
+}
+
+static void
+timeshift_direct ( timeshift_t *ts, streaming_message_t *sm )
+{
+  tvh_mutex_lock(&ts->state_mutex);
+  if (ts->state == TS_LIVE && ts->started)
+    streaming_target_deliver2(ts->output, sm);
+  else
+    streaming_msg_free(sm);
+  tvh_mutex_unlock(&ts->state_mutex);
+}
+
+/*
+ * Queue a message for the buffer writer
+ */
+static void
+timeshift_queue ( timeshift_t *ts, streaming_message_t *sm )
+{
+  timeshift_buffer_t *tsb = ts->buf;
+  timeshift_msg_t *tm = malloc(sizeof(*tm));
+
+  tm->ts = ts;
+  tm->sm = sm;
+  tvh_mutex_lock(&tsb->wr_mutex);
+  TAILQ_INSERT_TAIL(&tsb->wr_queue, tm, link);
+  tvh_cond_signal(&tsb->wr_cond, 0);
+  tvh_mutex_unlock(&tsb->wr_mutex);
+}
+
+/*
+ * Pass the buffer writer role to another subscriber
+ *
+ * The subscribers with the known timebase offset are preferred,
+ * otherwise the buffer timebase cannot continue.
+ *
+ * Must hold buffer lock
+ */
+static void
+timeshift_writer_resign ( timeshift_t *ts )
+{
+  timeshift_buffer_t *tsb = ts->buf;
+  timeshift_t *ts2, *first = NULL;
+
+  if (tsb->writer != ts)
+    return;
+  atomic_set(&ts->writer, 0);
+  tsb->writer = NULL;
+  LIST_FOREACH(ts2, &tsb->readers, buf_link) {
+    if (ts2 == ts || ts2->exit)
+      continue;
+    tvh_mutex_lock(&ts2->state_mutex);
+    if (!ts2->direct) {
+      if (first == NULL)
+        first = ts2;
+      if (ts2->pts_delta != PTS_UNSET)
+        tsb->writer = ts2;
+    }
+    tvh_mutex_unlock(&ts2->state_mutex);
+    if (tsb->writer)
+      break;
+  }
+  if (tsb->writer == NULL)
+    tsb->writer = first;
+  if (tsb->writer) {
+    atomic_set(&tsb->writer->writer, 1);
+    tvhdebug(LS_TIMESHIFT, "buf %d writer ts %d", tsb->id, tsb->writer->id);
+  }
+}
+
 /*
  * Process a packet
  */
 
-static int
+static void
 timeshift_packet( timeshift_t *ts, streaming_message_t *sm )
 {
-  th_pkt_t *pkt = sm->sm_data;
+  timeshift_buffer_t *tsb = ts->buf;
+  th_pkt_t *pkt = sm->sm_data, *pkt2;
   int64_t time;
 
+  /* Store in the source timebase */
+  if (ts->pts_delta) {
+    pkt2 = pkt_copy_shallow(pkt);
+    pkt_ref_dec(pkt);
+    sm->sm_data = pkt = pkt2;
+    if (pkt->pkt_pts != PTS_UNSET) pkt->pkt_pts += ts->pts_delta;
+    if (pkt->pkt_dts != PTS_UNSET) pkt->pkt_dts += ts->pts_delta;
+    if (pkt->pkt_pcr != PTS_UNSET) pkt->pkt_pcr += ts->pts_delta;
+  }
+
   if (pkt->pkt_pts != PTS_UNSET) {
     /* avoid to update last_wr_time for TELETEXT packets */
     if (pkt->pkt_type != SCT_TELETEXT) {
       time = ts_rescale(pkt->pkt_pts, 1000000);
-      if (ts->last_wr_time < time)
-        ts->last_wr_time = time;
+      if (tsb->last_wr_time < time)
+        tsb->last_wr_time = time;
     }
   }
-  sm->sm_time = ts->last_wr_time;
-  timeshift_packet_log("wr ", ts, sm);
-  streaming_target_deliver2(&ts->wr_queue.sq_st, sm);
-  return 0;
+  sm->sm_time = tsb->last_wr_time;
+  timeshift_packet_log("wr ", ts->id, sm);
+  timeshift_queue(ts, sm);
 }
 
 /*
@@ -335,13 +616,20 @@ static void timeshift_input
 {
   int type = sm->sm_type;
   timeshift_t *ts = opaque;
-  th_pkt_t *pkt, *pkt2;
+  timeshift_buffer_t *tsb = ts->buf;
 
-  if (ts->exit)
+  if (ts->exit) {
+    streaming_msg_free(sm);
     return;
+  }
 
-  /* Control */
-  if (type == SMT_SKIP) {
+  /* Control (live only without the sync) */
+  if (type == SMT_SKIP && ts->direct) {
+    ((streaming_skip_t *)sm->sm_data)->type = SMT_SKIP_ERROR;
+    timeshift_direct(ts, sm);
+  } else if (type == SMT_SPEED && ts->direct) {
+    streaming_msg_free(sm);
+  } else if (type == SMT_SKIP) {
     timeshift_write_skip(ts->rd_pipe.wr, sm->sm_data);
     streaming_msg_free(sm);
   } else if (type == SMT_SPEED) {
@@ -349,14 +637,39 @@ static void timeshift_input
     streaming_msg_free(sm);
   } else {
 
-    /* Change PTS/DTS offsets */
-    if (ts->packet_mode && ts->start_pts && type == SMT_PACKET) {
-      pkt = sm->sm_data;
-      pkt2 = pkt_copy_shallow(pkt);
-      pkt_ref_dec(pkt);
-      sm->sm_data = pkt2;
-      if (pkt2->pkt_pts != PTS_UNSET) pkt2->pkt_pts += ts->start_pts;
-      if (pkt2->pkt_dts != PTS_UNSET) pkt2->pkt_dts += ts->start_pts;
+    /* Data - the writer defines the buffer timebase */
+    if (type == SMT_PACKET || type == SMT_MPEGTS) {
+      if (ts->pts_delta == PTS_UNSET) {
+        ts->sync_next = mclk() + sec2mono(TIMESHIFT_SYNC_CHECK);
+      } else if (type == SMT_PACKET && !atomic_get(&ts->writer) &&
+                 !atomic_get(&ts->sync_check) && mclk() >= ts->sync_next) {
+        ts->sync_next = mclk() + sec2mono(TIMESHIFT_SYNC_CHECK);
+        atomic_set(&ts->sync_check, 1);
+      }
+      if (timeshift_sync_active(ts)) {
+        tvh_mutex_lock(&ts->state_mutex);
+        if (type == SMT_MPEGTS || atomic_get(&ts->writer))
+          timeshift_sync_set(ts, ts->pts_delta == PTS_UNSET ? 0 : ts->pts_delta);
+        else
+          timeshift_sync_input(ts, sm->sm_data);
+        if (ts->pts_delta == PTS_UNSET)
+          timeshift_sync_timeout(ts);
+        tvh_mutex_unlock(&ts->state_mutex);
+      }
+      if (type == SMT_MPEGTS)
+        ts->packet_mode = 0;
+      /* the data from other subscribers are delivered by the writer */
+      if (!atomic_get(&ts->writer)) {
+        if (ts->direct)
+          timeshift_direct(ts, sm);
+        else
+          streaming_msg_free(sm);
+        return;
+      }
+      if (ts->packet_mode && type == SMT_PACKET) {
+        timeshift_packet(ts, sm);
+        return;
+      }
     }
 
     /* Check for exit */
@@ -364,28 +677,26 @@ static void timeshift_input
         (type == SMT_STOP && sm->sm_code != SM_CODE_SOURCE_RECONFIGURED))
       ts->exit = 1;
 
-    else if (type == SMT_MPEGTS)
-      ts->packet_mode = 0;
-
     /* Send to the writer thread */
     if (ts->packet_mode) {
-      sm->sm_time = ts->last_wr_time;
-      if ((type == SMT_PACKET) && !timeshift_packet(ts, sm))
-        goto _exit;
+      sm->sm_time = tsb->last_wr_time;
     } else {
-      if (ts->ref_time == 0) {
-        ts->ref_time = getfastmonoclock();
+      if (tsb->ref_time == 0) {
+        tsb->ref_time = getfastmonoclock();
         sm->sm_time = 0;
       } else {
-        sm->sm_time = getfastmonoclock() - ts->ref_time;
+        sm->sm_time = getfastmonoclock() - tsb->ref_time;
       }
     }
-    streaming_target_deliver2(&ts->wr_queue.sq_st, sm);
+    timeshift_queue(ts, sm);
 
     /* Exit/Stop */
-_exit:
-    if (ts->exit)
+    if (ts->exit) {
+      tvh_mutex_lock(&tsb->lock);
+      timeshift_writer_resign(ts);
+      tvh_mutex_unlock(&tsb->lock);
       timeshift_write_exit(ts->rd_pipe.wr);
+    }
   }
 }
 
@@ -402,6 +713,125 @@ static streaming_ops_t timeshift_input_ops = {
 };
 
 
+/**
+ * The buffer is shared only when the service (and so the set of the
+ * elementary streams for the profile) is known in advance
+ */
+static void *
+timeshift_source ( void *id )
+{
+  idnode_list_mapping_t *ilm;
+
+  if (id == NULL || !idnode_is_instance(id, &channel_class))
+    return id;
+  ilm = LIST_FIRST(&((channel_t *)id)->ch_services);
+  if (ilm == NULL || LIST_NEXT(ilm, ilm_in2_link))
+    return NULL;
+  return ilm->ilm_in1;
+}
+
+/**
+ * Find or create the shared buffer
+ */
+static timeshift_buffer_t *
+timeshift_buffer_get ( void *source, void *profile, time_t max_time )
+{
+  timeshift_buffer_t *tsb;
+
+  if (source)
+    LIST_FOREACH(tsb, &timeshift_buffers, link)
+      if (tsb->source == source && tsb->profile == profile) {
+        if (tsb->max_time && (!max_time || max_time > tsb->max_time))
+          tsb->max_time = max_time;
+        tsb->refcount++;
+        return tsb;
+      }
+
+  tsb = calloc(1, sizeof(*tsb));
+  memoryinfo_alloc(&timeshift_memoryinfo, sizeof(*tsb));
+  tsb->source   = source;
+  tsb->profile  = profile;
+  tsb->id       = timeshift_buffer_index++;
+  tsb->refcount = 1;
+  tsb->max_time = max_time;
+  tsb->vididx   = -1;
+  TAILQ_INIT(&tsb->files);
+  LIST_INIT(&tsb->readers);
+  TAILQ_INIT(&tsb->wr_queue);
+  tvh_mutex_init(&tsb->lock, NULL);
+  tvh_mutex_init(&tsb->wr_mutex, NULL);
+  tvh_cond_init(&tsb->wr_cond, 1);
+  tsb->wr_run = 1;
+  tvh_thread_create(&tsb->wr_thread, NULL, timeshift_writer, tsb, "tshift-wr");
+  if (source)
+    LIST_INSERT_HEAD(&timeshift_buffers, tsb, link);
+  return tsb;
+}
+
+/**
+ * Detach the subscriber from the shared buffer
+ */
+static void
+timeshift_buffer_detach ( timeshift_t *ts )
+{
+  timeshift_buffer_t *tsb = ts->buf;
+  timeshift_msg_t *tm, *tm2;
+  int last;
+
+  tvh_mutex_lock(&tsb->lock);
+  tvh_mutex_lock(&tsb->wr_mutex);
+  for (tm = TAILQ_FIRST(&tsb->wr_queue); tm; tm = tm2) {
+    tm2 = TAILQ_NEXT(tm, link);
+    if (tm->ts != ts)
+      continue;
+    /* keep the data already queued for the buffer */
+    if (tm->sm->sm_type == SMT_PACKET || tm->sm->sm_type == SMT_MPEGTS) {
+      tm->ts = NULL;
+      continue;
+    }
+    TAILQ_REMOVE(&tsb->wr_queue, tm, link);
+    streaming_msg_free(tm->sm);
+    free(tm);
+  }
+  tvh_mutex_unlock(&tsb->wr_mutex);
+  timeshift_writer_resign(ts);
+  LIST_REMOVE(ts, buf_link);
+  last = --tsb->refcount == 0;
+  tvh_mutex_unlock(&tsb->lock);
+
+  if (!last)
+    return;
+
+  if (tsb->source)
+    LIST_REMOVE(tsb, link);
+
+  /* Wait for the writer */
+  tvh_mutex_lock(&tsb->wr_mutex);
+  tsb->wr_run = 0;
+  tvh_cond_signal(&tsb->wr_cond, 0);
+  tvh_mutex_unlock(&tsb->wr_mutex);
+  pthread_join(tsb->wr_thread, NULL);
+
+  while ((tm = TAILQ_FIRST(&tsb->wr_queue)) != NULL) {
+    TAILQ_REMOVE(&tsb->wr_queue, tm, link);
+    streaming_msg_free(tm->sm);
+    free(tm);
+  }
+
+  /* Flush files */
+  timeshift_filemgr_flush(tsb, NULL);
+
+  if (tsb->smt_start)
+    streaming_start_unref(tsb->smt_start);
+
+  free(tsb->path);
+  tvh_mutex_destroy(&tsb->lock);
+  tvh_mutex_destroy(&tsb->wr_mutex);
+  tvh_cond_destroy(&tsb->wr_cond);
+  free(tsb);
+  memoryinfo_free(&timeshift_memoryinfo, sizeof(*tsb));
+}
+
 /**
  *
  */
@@ -409,40 +839,26 @@ void
 timeshift_destroy(streaming_target_t *pad)
 {
   timeshift_t *ts = (timeshift_t*)pad;
-  streaming_message_t *sm;
 
   /* Must hold global lock */
   lock_assert(&global_lock);
 
-  /* Ensure the threads exits */
-  // Note: this is a workaround for the fact the Q might have been flushed
-  //       in reader thread (VERY unlikely)
+  /* Ensure the reader exits */
   tvh_mutex_lock(&ts->state_mutex);
-  sm = streaming_msg_create(SMT_EXIT);
-  streaming_target_deliver2(&ts->wr_queue.sq_st, sm);
   if (!ts->exit)
     timeshift_write_exit(ts->rd_pipe.wr);
   tvh_mutex_unlock(&ts->state_mutex);
 
-  /* Wait for all threads */
+  /* Wait for the reader */
   pthread_join(ts->rd_thread, NULL);
-  pthread_join(ts->wr_thread, NULL);
-
-  /* Shut stuff down */
-  streaming_queue_deinit(&ts->wr_queue);
 
   close(ts->rd_pipe.rd);
   close(ts->rd_pipe.wr);
 
-  /* Flush files */
-  timeshift_filemgr_flush(ts, NULL);
-
-  if (ts->smt_start)
-    streaming_start_unref(ts->smt_start);
-
-  if (ts->path)
-    free(ts->path);
+  /* Release the buffer */
+  timeshift_buffer_detach(ts);
 
+  tvh_mutex_destroy(&ts->state_mutex);
   free(ts);
   memoryinfo_free(&timeshift_memoryinfo, sizeof(timeshift_t));
 }
@@ -451,12 +867,15 @@ timeshift_destroy(streaming_target_t *pad)
  * Create timeshift buffer
  *
  * max_period of buffer in seconds (0 = unlimited)
- * max_size   of buffer in bytes   (0 = unlimited)
+ * source     stream source to share the buffer with (NULL = private),
+ *            channels with more services get a private buffer
+ * profile    stream profile of the source
  */
 streaming_target_t *timeshift_create
-  (streaming_target_t *out, time_t max_time)
+  (streaming_target_t *out, time_t max_time, void *source, void *profile)
 {
   timeshift_t *ts = calloc(1, sizeof(timeshift_t));
+  timeshift_buffer_t *tsb;
 
   memoryinfo_alloc(&timeshift_memoryinfo, sizeof(timeshift_t));
 
@@ -464,35 +883,38 @@ streaming_target_t *timeshift_create
   lock_assert(&global_lock);
 
   /* Setup structure */
-  TAILQ_INIT(&ts->files);
   ts->output     = out;
-  ts->path       = NULL;
   ts->max_time   = max_time;
   ts->state      = TS_LIVE;
   ts->exit       = 0;
-  ts->full       = 0;
-  ts->vididx     = -1;
   ts->id         = timeshift_index;
   ts->ondemand   = timeshift_conf.ondemand;
   ts->dobuf      = ts->ondemand ? 0 : 1;
   ts->packet_mode= 1;
-  ts->last_wr_time = 0;
-  ts->buf_time   = 0;
-  ts->start_pts  = 0;
-  ts->ref_time   = 0;
+  ts->pts_delta  = PTS_UNSET;
+  ts->start_time = PTS_UNSET;
   ts->seek.file  = NULL;
   ts->seek.frame = NULL;
-  ts->ram_segments = 0;
-  ts->file_segments = 0;
+  ts->seek.rfd   = -1;
   tvh_mutex_init(&ts->state_mutex, NULL);
 
   /* Initialise output */
   tvh_pipe(O_NONBLOCK, &ts->rd_pipe);
 
+  /* Attach to the shared buffer */
+  tsb = ts->buf = timeshift_buffer_get(timeshift_source(source), profile, max_time);
+  tvh_mutex_lock(&tsb->lock);
+  LIST_INSERT_HEAD(&tsb->readers, ts, buf_link);
+  if (tsb->writer == NULL) {
+    tsb->writer = ts;
+    ts->writer  = 1;
+  }
+  tvh_mutex_unlock(&tsb->lock);
+  tvhdebug(LS_TIMESHIFT, "ts %d attached to buf %d (subscribers %d)",
+           ts->id, tsb->id, tsb->refcount);
+
   /* Initialise input */
-  streaming_queue_init(&ts->wr_queue, 0, 0);
   streaming_target_init(&ts->input, &timeshift_input_ops, ts, 0);
-  tvh_thread_create(&ts->wr_thread, NULL, timeshift_writer, ts, "tshift-wr");
   tvh_thread_create(&ts->rd_thread, NULL, timeshift_reader, ts, "tshift-rd");
 
   /* Update index */
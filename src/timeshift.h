@@ -51,7 +51,7 @@ void timeshift_init ( void );
 void timeshift_term ( void );
 
 streaming_target_t *timeshift_create
-  (streaming_target_t *out, time_t max_period);
+  (streaming_target_t *out, time_t max_period, void *source, void *profile);
 
 void timeshift_destroy(streaming_target_t *pad);
 
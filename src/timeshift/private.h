@@ -22,6 +22,7 @@
 #define TIMESHIFT_PLAY_BUF         1000000 //< us to buffer in TX
 #define TIMESHIFT_FILE_PERIOD      60      //< number of secs in each buffer file
 #define TIMESHIFT_BACKLOG_MAX      16      //< maximum elementary streams
+#define TIMESHIFT_READ_SIZE        (256*1024) //< read-ahead buffer for the files
 
 /**
  * Indexes of import data in the stream
@@ -53,14 +54,12 @@ typedef TAILQ_HEAD(timeshift_index_data_list,timeshift_index_data) timeshift_ind
 typedef struct timeshift_file
 {
   int                           wfd;      ///< Write descriptor
-  int                           rfd;      ///< Read descriptor
   char                          *path;    ///< Full path to file
 
   int64_t                       time;     ///< Files coarse timestamp
   size_t                        size;     ///< Current file size;
   int64_t                       last;     ///< Latest timestamp
   off_t                         woff;     ///< Write offset
-  off_t                         roff;     ///< Read offset
 
   uint8_t                      *ram;      ///< RAM area
   int64_t                       ram_size; ///< RAM area size in bytes
@@ -70,6 +69,9 @@ typedef struct timeshift_file
   int                           refcount; ///< Reader ref count
 
   timeshift_index_iframe_list_t iframes;  ///< I-frame indexing
+  timeshift_index_iframe_t    **iframe_idx;   ///< I-frames in the time order (lookup)
+  int                           iframe_count; ///< Count of I-frames
+  int                           iframe_alloc; ///< Allocated I-frame lookup entries
   timeshift_index_data_list_t   sstart;   ///< Stream start messages
 
   TAILQ_ENTRY(timeshift_file) link;     ///< List entry
@@ -85,8 +87,78 @@ typedef TAILQ_HEAD(timeshift_file_list,timeshift_file) timeshift_file_list_t;
 typedef struct timeshift_seek {
   timeshift_file_t           *file;
   timeshift_index_iframe_t   *frame;
+  off_t                       roff;       ///< Read offset in the file
+  int                         rfd;        ///< Read descriptor
+  uint8_t                    *rbuf;       ///< Read-ahead buffer
+  off_t                       rbuf_off;   ///< File offset of the read-ahead buffer
+  size_t                      rbuf_len;   ///< Valid bytes in the read-ahead buffer
+  off_t                       rend;       ///< Complete data in the file (read unlocked)
 } timeshift_seek_t;
 
+/**
+ * Recent packets used to find the subscriber timebase offset
+ */
+#define TIMESHIFT_SYNC_MAX 32
+#define TIMESHIFT_SYNC_TIMEOUT 5  ///< Seconds to find the offset
+#define TIMESHIFT_SYNC_MATCH 3    ///< Consecutive matches to accept the offset
+#define TIMESHIFT_SYNC_CHECK 60   ///< Seconds between the offset checks
+
+typedef struct timeshift_sync {
+  uint32_t                    sig;        ///< Packet signature (0 = unused)
+  int64_t                     dts;        ///< Packet DTS
+} timeshift_sync_t;
+
+/**
+ * Message queued for the buffer writer
+ */
+typedef struct timeshift_msg {
+  TAILQ_ENTRY(timeshift_msg)  link;       ///< Queue entry
+  struct timeshift            *ts;        ///< Originating subscriber
+  streaming_message_t         *sm;        ///< Message
+} timeshift_msg_t;
+
+/**
+ * Shared buffer (one per stream source)
+ *
+ * All subscribers of the same stream source read the same segments.
+ * Only one subscriber (the writer) feeds the buffer, its packets are
+ * stored in the buffer timebase and delivered live to all others.
+ */
+typedef struct timeshift_buffer {
+  LIST_ENTRY(timeshift_buffer) link;      ///< Global list entry
+  void                        *source;    ///< Stream source (channel/service)
+  void                        *profile;   ///< Stream profile
+  int                         id;         ///< Reference number
+  int                         refcount;   ///< Attached subscribers
+  char                        *path;      ///< Directory containing buffer
+  time_t                      max_time;   ///< Maximum period to shift
+  int64_t                     last_wr_time;///< Last write time in us (PTS conversion)
+  int64_t                     ref_time;   ///< Start time in us (monoclock)
+  int64_t                     buf_time;   ///< Last buffered time in us (PTS conversion)
+  uint8_t                     full;       ///< Buffer is full
+
+  tvh_mutex_t                 lock;       ///< Protect files and subscribers
+  LIST_HEAD(, timeshift)      readers;    ///< Attached subscribers
+  struct timeshift            *writer;    ///< Subscriber feeding the buffer
+
+  tvh_mutex_t                 wr_mutex;   ///< Protect the writer queue
+  tvh_cond_t                  wr_cond;    ///< Writer queue signal
+  TAILQ_HEAD(, timeshift_msg) wr_queue;   ///< Writer queue
+  int                         wr_run;     ///< Writer is running
+  pthread_t                   wr_thread;  ///< Writer thread
+  timeshift_sync_t            sync[TIMESHIFT_SYNC_MAX]; ///< Recent packets (buffer timebase)
+  int                         sync_idx;
+
+  timeshift_file_list_t       files;      ///< List of files
+
+  int                         ram_segments;  ///< Count of segments in RAM
+  int                         file_segments; ///< Count of segments in files
+
+  int                         vididx;     ///< Index of (current) video stream
+
+  streaming_start_t          *smt_start;  ///< Streaming start info
+} timeshift_buffer_t;
+
 /**
  *
  */
@@ -95,17 +167,27 @@ typedef struct timeshift {
   streaming_target_t          input;      ///< Input source
   streaming_target_t          *output;    ///< Output dest
 
+  timeshift_buffer_t          *buf;       ///< Shared buffer
+  LIST_ENTRY(timeshift)       buf_link;   ///< Buffer subscribers link
+
   int                         id;         ///< Reference number
-  char                        *path;      ///< Directory containing buffer
   time_t                      max_time;   ///< Maximum period to shift
   int                         ondemand;   ///< Whether this is an on-demand timeshift
   int                         packet_mode;///< Packet mode (otherwise MPEG-TS data mode)
   int                         dobuf;      ///< Buffer packets (store)
-  int64_t                     last_wr_time;///< Last write time in us (PTS conversion)
-  int64_t                     start_pts;  ///< Start time for packets (PTS)
-  int64_t                     ref_time;   ///< Start time in us (monoclock)
-  int64_t                     buf_time;   ///< Last buffered time in us (PTS conversion)
-  int                         backlog_max;///< Maximum component index in backlog
+  int                         writer;     ///< Feeds the shared buffer
+  int                         started;    ///< Live packets can be delivered
+  int64_t                     pts_delta;  ///< Timebase offset to the buffer (90kHz)
+  int64_t                     start_time; ///< First buffered time for this subscriber
+
+  timeshift_sync_t            sync[TIMESHIFT_SYNC_MAX]; ///< Recent packets (subscriber timebase)
+  int                         sync_idx;
+  int64_t                     sync_start; ///< First packet without the offset (mono)
+  int64_t                     sync_delta; ///< Offset candidate (90kHz)
+  int                         sync_count; ///< Consecutive matches of the candidate
+  int                         sync_check; ///< Offset is checked again (atomic)
+  int64_t                     sync_next;  ///< Next offset check (mono, input only)
+  int                         direct;     ///< Not in sync, own packets delivered live
 
   enum {
     TS_EXIT,
@@ -115,25 +197,12 @@ typedef struct timeshift {
   }                           state;       ///< Play state
   tvh_mutex_t             state_mutex; ///< Protect state changes
   uint8_t                     exit;        ///< Exit from the main input thread
-  uint8_t                     full;        ///< Buffer is full
 
   timeshift_seek_t            seek;       ///< Seek into buffered data
-  
-  streaming_queue_t           wr_queue;   ///< Writer queue
-  pthread_t                   wr_thread;  ///< Writer thread
 
   pthread_t                   rd_thread;  ///< Reader thread
   th_pipe_t                   rd_pipe;    ///< Message passing to reader
 
-  timeshift_file_list_t       files;      ///< List of files
-
-  int                         ram_segments;  ///< Count of segments in RAM
-  int                         file_segments; ///< Count of segments in files
-
-  int                         vididx;     ///< Index of (current) video stream
-
-  streaming_start_t          *smt_start;  ///< Streaming start info
-
 } timeshift_t;
 
 /*
@@ -143,15 +212,25 @@ extern uint64_t timeshift_total_size;
 extern uint64_t timeshift_total_ram_size;
 
 void timeshift_packet_log0
-  ( const char *prefix, timeshift_t *ts, streaming_message_t *sm );
+  ( const char *prefix, int id, streaming_message_t *sm );
 
 static inline void timeshift_packet_log
-  ( const char *prefix, timeshift_t *ts, streaming_message_t *sm )
+  ( const char *prefix, int id, streaming_message_t *sm )
 {
   if (sm->sm_type == SMT_PACKET && tvhtrace_enabled())
-    timeshift_packet_log0(prefix, ts, sm);
+    timeshift_packet_log0(prefix, id, sm);
+}
+
+static inline int64_t timeshift_pts_delta ( timeshift_t *ts )
+{
+  return ts->pts_delta == PTS_UNSET ? 0 : ts->pts_delta;
 }
 
+streaming_message_t *timeshift_adjust ( timeshift_t *ts, streaming_message_t *sm );
+void timeshift_deliver ( timeshift_t *ts, streaming_message_t *sm );
+
+void timeshift_sync ( timeshift_buffer_t *tsb, th_pkt_t *pkt );
+
 /*
  * Write functions
  */
@@ -207,26 +286,26 @@ static inline void timeshift_file_put0 ( timeshift_file_t *tsf )
 })
 
 timeshift_file_t *timeshift_filemgr_get
-  ( timeshift_t *ts, int64_t start_time );
+  ( timeshift_buffer_t *tsb, int64_t start_time );
 timeshift_file_t *timeshift_filemgr_oldest
-  ( timeshift_t *ts );
+  ( timeshift_buffer_t *tsb );
 timeshift_file_t *timeshift_filemgr_newest
-  ( timeshift_t *ts );
+  ( timeshift_buffer_t *tsb );
 timeshift_file_t *timeshift_filemgr_prev
   ( timeshift_file_t *ts, int *end, int keep );
 timeshift_file_t *timeshift_filemgr_next
   ( timeshift_file_t *ts, int *end, int keep );
 void timeshift_filemgr_remove
-  ( timeshift_t *ts, timeshift_file_t *tsf, int force );
-void timeshift_filemgr_flush ( timeshift_t *ts, timeshift_file_t *end );
+  ( timeshift_buffer_t *tsb, timeshift_file_t *tsf, int force );
+void timeshift_filemgr_flush ( timeshift_buffer_t *tsb, timeshift_file_t *end );
 void timeshift_filemgr_close ( timeshift_file_t *tsf );
 
-void timeshift_filemgr_dump0 ( timeshift_t *ts );
+void timeshift_filemgr_dump0 ( timeshift_buffer_t *tsb );
 
-static inline void timeshift_filemgr_dump ( timeshift_t *ts )
+static inline void timeshift_filemgr_dump ( timeshift_buffer_t *tsb )
 {
   if (tvhtrace_enabled())
-    timeshift_filemgr_dump0(ts);
+    timeshift_filemgr_dump0(tsb);
 }
 
 #endif /* __TVH_TIMESHIFT_PRIVATE_H__ */
@@ -78,6 +78,8 @@ static void* timeshift_reaper_callback ( void *p )
       memoryinfo_free(&timeshift_memoryinfo, sizeof(*ti));
       free(ti);
     }
+    memoryinfo_free(&timeshift_memoryinfo, tsf->iframe_alloc * sizeof(*tsf->iframe_idx));
+    free(tsf->iframe_idx);
     while ((tid = TAILQ_FIRST(&tsf->sstart))) {
       TAILQ_REMOVE(&tsf->sstart, tid, link);
       sm = tid->data;
@@ -117,17 +119,17 @@ static void timeshift_reaper_remove ( timeshift_file_t *tsf )
  * *************************************************************************/
 
 void
-timeshift_filemgr_dump0 ( timeshift_t *ts )
+timeshift_filemgr_dump0 ( timeshift_buffer_t *tsb )
 {
   timeshift_file_t *tsf;
 
-  if (TAILQ_EMPTY(&ts->files)) {
-    tvhtrace(LS_TIMESHIFT, "ts %d file dump - EMPTY", ts->id);
+  if (TAILQ_EMPTY(&tsb->files)) {
+    tvhtrace(LS_TIMESHIFT, "buf %d file dump - EMPTY", tsb->id);
     return;
   }
-  TAILQ_FOREACH(tsf, &ts->files, link) {
-    tvhtrace(LS_TIMESHIFT, "ts %d (full=%d) file dump tsf %p time %4"PRId64" last %10"PRId64" bad %d refcnt %d",
-             ts->id, ts->full, tsf, tsf->time, tsf->last, tsf->bad, tsf->refcount);
+  TAILQ_FOREACH(tsf, &tsb->files, link) {
+    tvhtrace(LS_TIMESHIFT, "buf %d (full=%d) file dump tsf %p time %4"PRId64" last %10"PRId64" bad %d refcnt %d",
+             tsb->id, tsb->full, tsf, tsf->time, tsf->last, tsf->bad, tsf->refcount);
   }
 }
 
@@ -173,13 +175,15 @@ void timeshift_filemgr_close ( timeshift_file_t *tsf )
       atomic_add_u64(&timeshift_total_ram_size, r);
   }
   if (tsf->ram) {
-    /* maintain unused memory block */
+    /* maintain unused memory block (the readers hold only ram_lock) */
+    tvh_mutex_lock(&tsf->ram_lock);
     ram = realloc(tsf->ram, tsf->woff);
     if (ram) {
       memoryinfo_append(&timeshift_memoryinfo_ram, tsf->ram_size - tsf->woff);
       tsf->ram = ram;
       tsf->ram_size = tsf->woff;
     }
+    tvh_mutex_unlock(&tsf->ram_lock);
   }
   if (tsf->wfd >= 0)
     close(tsf->wfd);
@@ -190,25 +194,24 @@ void timeshift_filemgr_close ( timeshift_file_t *tsf )
  * Remove file
  */
 void timeshift_filemgr_remove
-  ( timeshift_t *ts, timeshift_file_t *tsf, int force )
+  ( timeshift_buffer_t *tsb, timeshift_file_t *tsf, int force )
 {
   if (tsf->wfd >= 0)
     close(tsf->wfd);
-  assert(tsf->rfd < 0);
   if (tvhtrace_enabled()) {
     if (tsf->path)
-      tvhdebug(LS_TIMESHIFT, "ts %d remove %s (size %"PRId64")", ts->id, tsf->path, (int64_t)tsf->size);
+      tvhdebug(LS_TIMESHIFT, "buf %d remove %s (size %"PRId64")", tsb->id, tsf->path, (int64_t)tsf->size);
     else
-      tvhdebug(LS_TIMESHIFT, "ts %d RAM segment remove time %"PRId64" (size %"PRId64", alloc size %"PRId64")",
-               ts->id, tsf->time, (int64_t)tsf->size, (int64_t)tsf->ram_size);
+      tvhdebug(LS_TIMESHIFT, "buf %d RAM segment remove time %"PRId64" (size %"PRId64", alloc size %"PRId64")",
+               tsb->id, tsf->time, (int64_t)tsf->size, (int64_t)tsf->ram_size);
   }
-  TAILQ_REMOVE(&ts->files, tsf, link);
+  TAILQ_REMOVE(&tsb->files, tsf, link);
   if (tsf->path) {
-    assert(ts->file_segments > 0);
-    ts->file_segments--;
+    assert(tsb->file_segments > 0);
+    tsb->file_segments--;
   } else {
-    assert(ts->ram_segments > 0);
-    ts->ram_segments--;
+    assert(tsb->ram_segments > 0);
+    tsb->ram_segments--;
   }
   atomic_dec_u64(&timeshift_total_size, tsf->size);
   if (tsf->ram)
@@ -219,12 +222,12 @@ void timeshift_filemgr_remove
 /*
  * Flush all files
  */
-void timeshift_filemgr_flush ( timeshift_t *ts, timeshift_file_t *end )
+void timeshift_filemgr_flush ( timeshift_buffer_t *tsb, timeshift_file_t *end )
 {
   timeshift_file_t *tsf;
-  while ((tsf = TAILQ_FIRST(&ts->files))) {
+  while ((tsf = TAILQ_FIRST(&tsb->files))) {
     if (tsf == end) break;
-    timeshift_filemgr_remove(ts, tsf, 1);
+    timeshift_filemgr_remove(tsb, tsf, 1);
   }
 }
 
@@ -232,7 +235,7 @@ void timeshift_filemgr_flush ( timeshift_t *ts, timeshift_file_t *end )
  *
  */
 static timeshift_file_t * timeshift_filemgr_file_init
-  ( timeshift_t *ts, int64_t start_time )
+  ( timeshift_buffer_t *tsb, int64_t start_time )
 {
   timeshift_file_t *tsf;
 
@@ -241,10 +244,9 @@ static timeshift_file_t * timeshift_filemgr_file_init
   tsf->time     = mono2sec(start_time) / TIMESHIFT_FILE_PERIOD;
   tsf->last     = start_time;
   tsf->wfd      = -1;
-  tsf->rfd      = -1;
   TAILQ_INIT(&tsf->iframes);
   TAILQ_INIT(&tsf->sstart);
-  TAILQ_INSERT_TAIL(&ts->files, tsf, link);
+  TAILQ_INSERT_TAIL(&tsb->files, tsf, link);
   tvh_mutex_init(&tsf->ram_lock, NULL);
   return tsf;
 }
@@ -252,7 +254,7 @@ static timeshift_file_t * timeshift_filemgr_file_init
 /*
  * Get current / new file
  */
-timeshift_file_t *timeshift_filemgr_get ( timeshift_t *ts, int64_t start_time )
+timeshift_file_t *timeshift_filemgr_get ( timeshift_buffer_t *tsb, int64_t start_time )
 {
   int fd;
   timeshift_file_t *tsf_tl, *tsf_hd, *tsf_tmp;
@@ -263,18 +265,18 @@ timeshift_file_t *timeshift_filemgr_get ( timeshift_t *ts, int64_t start_time )
 
   /* Return last file */
   if (start_time < 0)
-    return timeshift_filemgr_newest(ts);
+    return timeshift_filemgr_newest(tsb);
 
   /* No space */
-  if (ts->full)
+  if (tsb->full)
     return NULL;
 
   /* Store to file */
-  tsf_tl = TAILQ_LAST(&ts->files, timeshift_file_list);
+  tsf_tl = TAILQ_LAST(&tsb->files, timeshift_file_list);
   time = mono2sec(start_time) / TIMESHIFT_FILE_PERIOD;
   if (!tsf_tl || tsf_tl->time < time ||
       (tsf_tl->ram && tsf_tl->woff >= timeshift_conf.ram_segment_size)) {
-    tsf_hd = TAILQ_FIRST(&ts->files);
+    tsf_hd = TAILQ_FIRST(&tsb->files);
 
     /* Close existing */
     if (tsf_tl)
@@ -282,15 +284,15 @@ timeshift_file_t *timeshift_filemgr_get ( timeshift_t *ts, int64_t start_time )
 
     /* Check period */
     if (!timeshift_conf.unlimited_period &&
-        ts->max_time && tsf_hd && tsf_tl) {
+        tsb->max_time && tsf_hd && tsf_tl) {
       time_t d = (tsf_tl->time - tsf_hd->time) * TIMESHIFT_FILE_PERIOD;
-      if (d > (ts->max_time+5)) {
+      if (d > (tsb->max_time+5)) {
         if (!tsf_hd->refcount) {
-          timeshift_filemgr_remove(ts, tsf_hd, 0);
+          timeshift_filemgr_remove(tsb, tsf_hd, 0);
           tsf_hd = NULL;
         } else {
-          tvhdebug(LS_TIMESHIFT, "ts %d buffer full", ts->id);
-          ts->full = 1;
+          tvhdebug(LS_TIMESHIFT, "buf %d buffer full", tsb->id);
+          tsb->full = 1;
         }
       }
     }
@@ -301,45 +303,45 @@ timeshift_file_t *timeshift_filemgr_get ( timeshift_t *ts, int64_t start_time )
 
       /* Remove the last file (if we can) */
       if (tsf_hd && !tsf_hd->refcount) {
-        timeshift_filemgr_remove(ts, tsf_hd, 0);
+        timeshift_filemgr_remove(tsb, tsf_hd, 0);
 
       /* Full */
       } else {
-        tvhdebug(LS_TIMESHIFT, "ts %d buffer full", ts->id);
-        ts->full = 1;
+        tvhdebug(LS_TIMESHIFT, "buf %d buffer full", tsb->id);
+        tsb->full = 1;
       }
     }
 
     /* Create new file */
     tsf_tmp = NULL;
-    if (!ts->full) {
+    if (!tsb->full) {
 
-      tvhtrace(LS_TIMESHIFT, "ts %d RAM total %"PRId64" requested %"PRId64" segment %"PRId64,
-                   ts->id, atomic_pre_add_u64(&timeshift_total_ram_size, 0),
+      tvhtrace(LS_TIMESHIFT, "buf %d RAM total %"PRId64" requested %"PRId64" segment %"PRId64,
+                   tsb->id, atomic_pre_add_u64(&timeshift_total_ram_size, 0),
                    timeshift_conf.ram_size, timeshift_conf.ram_segment_size);
       while (1) {
         if (timeshift_conf.ram_size >= 8*1024*1024 &&
             atomic_pre_add_u64(&timeshift_total_ram_size, 0) <
               timeshift_conf.ram_size + (timeshift_conf.ram_segment_size / 2)) {
-          tsf_tmp = timeshift_filemgr_file_init(ts, start_time);
+          tsf_tmp = timeshift_filemgr_file_init(tsb, start_time);
           tsf_tmp->ram_size = MIN(16*1024*1024, timeshift_conf.ram_segment_size);
           tsf_tmp->ram = malloc(tsf_tmp->ram_size);
           if (!tsf_tmp->ram) {
             free(tsf_tmp);
             tsf_tmp = NULL;
           } else {
-            tvhtrace(LS_TIMESHIFT, "ts %d create RAM segment with %"PRId64" bytes (time %"PRId64")",
-                     ts->id, tsf_tmp->ram_size, start_time);
-            ts->ram_segments++;
+            tvhtrace(LS_TIMESHIFT, "buf %d create RAM segment with %"PRId64" bytes (time %"PRId64")",
+                     tsb->id, tsf_tmp->ram_size, start_time);
+            tsb->ram_segments++;
             memoryinfo_alloc(&timeshift_memoryinfo_ram, tsf_tmp->ram_size);
           }
           break;
         } else {
-          tsf_hd = TAILQ_FIRST(&ts->files);
+          tsf_hd = TAILQ_FIRST(&tsb->files);
           if (timeshift_conf.ram_fit && tsf_hd && !tsf_hd->refcount &&
-              tsf_hd->ram && ts->file_segments == 0) {
-            tvhtrace(LS_TIMESHIFT, "ts %d remove RAM segment %"PRId64" (fit)", ts->id, tsf_hd->time);
-            timeshift_filemgr_remove(ts, tsf_hd, 0);
+              tsf_hd->ram && tsb->file_segments == 0) {
+            tvhtrace(LS_TIMESHIFT, "buf %d remove RAM segment %"PRId64" (fit)", tsb->id, tsf_hd->time);
+            timeshift_filemgr_remove(tsb, tsf_hd, 0);
           } else {
             break;
           }
@@ -348,43 +350,43 @@ timeshift_file_t *timeshift_filemgr_get ( timeshift_t *ts, int64_t start_time )
       
       if (!tsf_tmp && !timeshift_conf.ram_only) {
         /* Create directories */
-        if (!ts->path) {
-          if (timeshift_filemgr_makedirs(ts->id, path, sizeof(path)))
+        if (!tsb->path) {
+          if (timeshift_filemgr_makedirs(tsb->id, path, sizeof(path)))
             return NULL;
-          ts->path = strdup(path);
+          tsb->path = strdup(path);
         }
 
         /* Create File */
-        snprintf(path, sizeof(path), "%s/tvh-%"PRId64, ts->path, start_time);
-        tvhtrace(LS_TIMESHIFT, "ts %d create file %s", ts->id, path);
+        snprintf(path, sizeof(path), "%s/tvh-%"PRId64, tsb->path, start_time);
+        tvhtrace(LS_TIMESHIFT, "buf %d create file %s", tsb->id, path);
         if ((fd = tvh_open(path, O_WRONLY | O_CREAT, 0600)) > 0) {
-          tsf_tmp = timeshift_filemgr_file_init(ts, start_time);
+          tsf_tmp = timeshift_filemgr_file_init(tsb, start_time);
           tsf_tmp->wfd = fd;
           tsf_tmp->path = strdup(path);
-          ts->file_segments++;
+          tsb->file_segments++;
         }
       }
 
       if (tsf_tmp && tsf_tl) {
         /* Copy across last start message */
-        if ((ti = TAILQ_LAST(&tsf_tl->sstart, timeshift_index_data_list)) || ts->smt_start) {
-          tvhtrace(LS_TIMESHIFT, "ts %d copy smt_start to new file%s",
-                   ts->id, ti ? " (from last file)" : "");
+        if ((ti = TAILQ_LAST(&tsf_tl->sstart, timeshift_index_data_list)) || tsb->smt_start) {
+          tvhtrace(LS_TIMESHIFT, "buf %d copy smt_start to new file%s",
+                   tsb->id, ti ? " (from last file)" : "");
           timeshift_index_data_t *ti2 = calloc(1, sizeof(timeshift_index_data_t));
           if (ti) {
             memoryinfo_alloc(&timeshift_memoryinfo, sizeof(timeshift_index_data_t));
             sm = streaming_msg_clone(ti->data);
           } else {
             sm = streaming_msg_create(SMT_START);
-            streaming_start_ref(ts->smt_start);
-            sm->sm_data = ts->smt_start;
+            streaming_start_ref(tsb->smt_start);
+            sm->sm_data = tsb->smt_start;
           }
           ti2->data = sm;
           TAILQ_INSERT_TAIL(&tsf_tmp->sstart, ti2, link);
         }
       }
     }
-    timeshift_filemgr_dump(ts);
+    timeshift_filemgr_dump(tsb);
     tsf_tl = tsf_tmp;
   }
 
@@ -414,18 +416,18 @@ timeshift_file_t *timeshift_filemgr_prev
 /*
  * Get the oldest file
  */
-timeshift_file_t *timeshift_filemgr_oldest ( timeshift_t *ts )
+timeshift_file_t *timeshift_filemgr_oldest ( timeshift_buffer_t *tsb )
 {
-  timeshift_file_t *tsf = TAILQ_FIRST(&ts->files);
+  timeshift_file_t *tsf = TAILQ_FIRST(&tsb->files);
   return timeshift_file_get(tsf);
 }
 
 /*
  * Get the newest file
  */
-timeshift_file_t *timeshift_filemgr_newest ( timeshift_t *ts )
+timeshift_file_t *timeshift_filemgr_newest ( timeshift_buffer_t *tsb )
 {
-  timeshift_file_t *tsf = TAILQ_LAST(&ts->files, timeshift_file_list);
+  timeshift_file_t *tsf = TAILQ_LAST(&tsb->files, timeshift_file_list);
   return timeshift_file_get(tsf);
 }
 
@@ -44,8 +44,13 @@
 static timeshift_seek_t *_seek_reset ( timeshift_seek_t *seek )
 {
   timeshift_file_t *tsf = seek->file;
-  seek->file  = NULL;
-  seek->frame = NULL;
+  if (seek->rfd >= 0) {
+    close(seek->rfd);
+    seek->rfd = -1;
+  }
+  seek->file     = NULL;
+  seek->frame    = NULL;
+  seek->rbuf_len = 0;
   timeshift_file_put(tsf);
   return seek;
 }
@@ -53,70 +58,133 @@ static timeshift_seek_t *_seek_reset ( timeshift_seek_t *seek )
 static timeshift_seek_t *_seek_set_file
   ( timeshift_seek_t *seek, timeshift_file_t *tsf, off_t roff )
 {
-  seek->file  = tsf;
-  seek->frame = NULL;
-  if (tsf)
-    tsf->roff = roff;
+  seek->file     = tsf;
+  seek->frame    = NULL;
+  seek->roff     = roff;
+  seek->rbuf_len = 0;
   return seek;
 }
 
-static timeshift_seek_t *_read_close ( timeshift_seek_t *seek )
+/* **************************************************************************
+ * File Reading
+ * *************************************************************************/
+
+static ssize_t _read_fd ( int fd, void *buf, size_t size )
 {
-  if (seek->file && seek->file->rfd >= 0) {
-    close(seek->file->rfd);
-    seek->file->rfd = -1;
+  ssize_t r;
+  size_t ret = 0;
+
+  while (size > 0) {
+    r = read(fd, buf, size);
+    if (r < 0) {
+      if (ERRNO_AGAIN(errno))
+        continue;
+      tvhtrace(LS_TIMESHIFT, "read errno %d", errno);
+      return -1;
+    }
+    if (r == 0)
+      return 0;
+    size -= r;
+    ret += r;
+    buf += r;
   }
-  return _seek_reset(seek);
+  return ret;
 }
 
-/* **************************************************************************
- * File Reading
- * *************************************************************************/
+static ssize_t _pread_fd ( int fd, void *buf, size_t size, off_t off, int all )
+{
+  ssize_t r;
+  size_t ret = 0;
 
-static ssize_t _read_buf ( timeshift_file_t *tsf, int fd, void *buf, size_t size )
+  while (size > 0) {
+    r = pread(fd, buf, size, off);
+    if (r < 0) {
+      if (ERRNO_AGAIN(errno))
+        continue;
+      tvhtrace(LS_TIMESHIFT, "read errno %d", errno);
+      return -1;
+    }
+    if (r == 0)
+      return all ? 0 : ret;
+    size -= r;
+    ret += r;
+    buf += r;
+    off += r;
+  }
+  return ret;
+}
+
+/*
+ * The files are read through the read-ahead buffer of the seek position,
+ * so the small record fields do not cost a syscall. The large payloads
+ * are read directly to the destination.
+ *
+ * Only the complete messages (up to seek->rend) are read, the writer
+ * might append to the file meanwhile.
+ */
+static ssize_t _read_file ( timeshift_seek_t *seek, void *buf, size_t size )
 {
+  off_t o = seek->roff - seek->rbuf_off;
   ssize_t r;
-  size_t ret;
 
-  if (tsf && tsf->ram) {
-    if (tsf->roff == tsf->woff) return 0;
-    if (tsf->roff + size > tsf->woff) return -1;
-    tvh_mutex_lock(&tsf->ram_lock);
-    memcpy(buf, tsf->ram + tsf->roff, size);
-    tsf->roff += size;
-    tvh_mutex_unlock(&tsf->ram_lock);
-    return size;
-  } else {
-    ret = 0;
-    while (size > 0) {
-      r = read(tsf ? tsf->rfd : fd, buf, size);
-      if (r < 0) {
-        if (ERRNO_AGAIN(errno))
-          continue;
-        tvhtrace(LS_TIMESHIFT, "read errno %d", errno);
+  if (seek->roff + size > seek->rend)
+    return 0;
+  if (o < 0 || o + size > seek->rbuf_len) {
+    if (size >= TIMESHIFT_READ_SIZE / 2) {
+      r = _pread_fd(seek->rfd, buf, size, seek->roff, 1);
+      if (r > 0)
+        seek->roff += r;
+      return r;
+    }
+    if (seek->rbuf == NULL) {
+      seek->rbuf = malloc(TIMESHIFT_READ_SIZE);
+      if (seek->rbuf == NULL)
         return -1;
-      }
-      if (r > 0) {
-        size -= r;
-        ret += r;
-        buf += r;
-      }
-      if (r == 0)
-        return 0;
+      memoryinfo_alloc(&timeshift_memoryinfo, TIMESHIFT_READ_SIZE);
     }
-    if (ret > 0 && tsf)
-      tsf->roff += ret;
-    return ret;
+    seek->rbuf_len = 0;
+    r = _pread_fd(seek->rfd, seek->rbuf,
+                  MIN(TIMESHIFT_READ_SIZE, seek->rend - seek->roff),
+                  seek->roff, 0);
+    if (r < 0)
+      return -1;
+    seek->rbuf_off = seek->roff;
+    seek->rbuf_len = r;
+    if ((size_t)r < size)
+      return 0;
+    o = 0;
+  }
+  memcpy(buf, seek->rbuf + o, size);
+  seek->roff += size;
+  return size;
+}
+
+/*
+ * The RAM segments are read with the ram_lock held (see _timeshift_read)
+ */
+static ssize_t _read_buf ( timeshift_seek_t *seek, int fd, void *buf, size_t size )
+{
+  timeshift_file_t *tsf = seek ? seek->file : NULL;
+
+  if (tsf && tsf->ram) {
+    if (seek->roff == seek->rend) return 0;
+    if (seek->roff + size > seek->rend) return -1;
+    memcpy(buf, tsf->ram + seek->roff, size);
+    seek->roff += size;
+    return size;
   }
+  if (seek)
+    return _read_file(seek, buf, size);
+  return _read_fd(fd, buf, size);
 }
 
-static ssize_t _read_pktbuf ( timeshift_file_t *tsf, int fd, pktbuf_t **pktbuf )
+static ssize_t _read_pktbuf ( timeshift_seek_t *seek, int fd, pktbuf_t **pktbuf )
 {
   ssize_t r, cnt = 0;
   size_t sz;
 
   /* Size */
-  r = _read_buf(tsf, fd, &sz, sizeof(sz));
+  r = _read_buf(seek, fd, &sz, sizeof(sz));
   if (r < 0) return -1;
   if (r != sizeof(sz)) return 0;
   cnt += r;
@@ -129,7 +197,7 @@ static ssize_t _read_pktbuf ( timeshift_file_t *tsf, int fd, pktbuf_t **pktbuf )
 
   /* Data */
   *pktbuf = pktbuf_alloc(NULL, sz);
-  r = _read_buf(tsf, fd, pktbuf_ptr(*pktbuf), sz);
+  r = _read_buf(seek, fd, pktbuf_ptr(*pktbuf), sz);
   if (r != sz) {
     pktbuf_destroy(*pktbuf);
     *pktbuf = NULL;
@@ -141,7 +209,7 @@ static ssize_t _read_pktbuf ( timeshift_file_t *tsf, int fd, pktbuf_t **pktbuf )
 }
 
 
-static ssize_t _read_msg ( timeshift_file_t *tsf, int fd, streaming_message_t **sm )
+static ssize_t _read_msg ( timeshift_seek_t *seek, int fd, streaming_message_t **sm )
 {
   ssize_t r, cnt = 0;
   size_t sz;
@@ -154,7 +222,7 @@ static ssize_t _read_msg ( timeshift_file_t *tsf, int fd, streaming_message_t **
   *sm = NULL;
 
   /* Size */
-  r = _read_buf(tsf, fd, &sz, sizeof(sz));
+  r = _read_buf(seek, fd, &sz, sizeof(sz));
   if (r < 0) return -1;
   if (r != sizeof(sz)) return 0;
   cnt += r;
@@ -169,13 +237,13 @@ static ssize_t _read_msg ( timeshift_file_t *tsf, int fd, streaming_message_t **
   }
 
   /* Type */
-  r = _read_buf(tsf, fd, &type, sizeof(type));
+  r = _read_buf(seek, fd, &type, sizeof(type));
   if (r < 0) return -1;
   if (r != sizeof(type)) return 0;
   cnt += r;
 
   /* Time */
-  r = _read_buf(tsf, fd, &time, sizeof(time));
+  r = _read_buf(seek, fd, &time, sizeof(time));
   if (r < 0) return -1;
   if (r != sizeof(time)) return 0;
   cnt += r;
@@ -201,7 +269,7 @@ static ssize_t _read_msg ( timeshift_file_t *tsf, int fd, streaming_message_t **
     case SMT_EXIT:
     case SMT_SPEED:
       if (sz != sizeof(code)) return -1;
-      r = _read_buf(tsf, fd, &code, sz);
+      r = _read_buf(seek, fd, &code, sz);
       if (r != sz) {
         if (r < 0) return -1;
         return 0;
@@ -215,24 +283,30 @@ static ssize_t _read_msg ( timeshift_file_t *tsf, int fd, streaming_message_t **
     case SMT_MPEGTS:
     case SMT_PACKET:
       data = malloc(sz);
-      r = _read_buf(tsf, fd, data, sz);
+      r = _read_buf(seek, fd, data, sz);
       if (r != sz) {
         free(data);
         if (r < 0) return -1;
         return 0;
       }
       if (type == SMT_PACKET) {
-        th_pkt_t *pkt = data;
-        pkt->pkt_payload  = pkt->pkt_meta = NULL;
-        pkt->pkt_refcount = 0;
+        th_pkt_t *pkt;
+        if (sz != sizeof(*pkt)) {
+          free(data);
+          return -1;
+        }
+        /* the packets are released to the packet pool */
+        pkt = pkt_copy_nodata(data);
+        free(data);
         *sm = streaming_msg_create_pkt(pkt);
-        r   = _read_pktbuf(tsf, fd, &pkt->pkt_meta);
+        pkt_ref_dec(pkt);
+        r   = _read_pktbuf(seek, fd, &pkt->pkt_meta);
         if (r < 0) {
           streaming_msg_free(*sm);
           return r;
         }
         cnt += r;
-        r   = _read_pktbuf(tsf, fd, &pkt->pkt_payload);
+        r   = _read_pktbuf(seek, fd, &pkt->pkt_payload);
         if (r < 0) {
           streaming_msg_free(*sm);
           return r;
@@ -256,17 +330,120 @@ static ssize_t _read_msg ( timeshift_file_t *tsf, int fd, streaming_message_t **
  * Utilities
  * *************************************************************************/
 
+/*
+ * The buffer lock must be taken before the state lock
+ *
+ * The locks are held only for the buffer lookups and the state changes,
+ * the files are read and the messages delivered without them, so a slow
+ * subscriber does not stall the buffer writer (and so all others).
+ */
+static inline void _reader_lock ( timeshift_t *ts )
+{
+  tvh_mutex_lock(&ts->buf->lock);
+  tvh_mutex_lock(&ts->state_mutex);
+}
+
+static inline void _reader_unlock ( timeshift_t *ts )
+{
+  tvh_mutex_unlock(&ts->state_mutex);
+  tvh_mutex_unlock(&ts->buf->lock);
+}
+
+/*
+ * Queue a message for the output (must hold the reader locks)
+ */
+static void _reader_queue
+  ( timeshift_t *ts, struct streaming_message_queue *q, streaming_message_t *sm )
+{
+  if ((sm = timeshift_adjust(ts, sm)) != NULL)
+    TAILQ_INSERT_TAIL(q, sm, sm_link);
+}
+
+/*
+ * Deliver the queued messages (without the reader locks)
+ *
+ * The writer delivers to the live subscribers, so the state mutex
+ * serializes the output in the live mode. The state is changed only
+ * from this thread.
+ */
+static void _reader_deliver
+  ( timeshift_t *ts, struct streaming_message_queue *q )
+{
+  streaming_message_t *sm;
+  int live;
+
+  if (TAILQ_EMPTY(q))
+    return;
+  live = ts->state == TS_LIVE;
+  if (live)
+    tvh_mutex_lock(&ts->state_mutex);
+  while ((sm = TAILQ_FIRST(q)) != NULL) {
+    TAILQ_REMOVE(q, sm, sm_link);
+    streaming_target_deliver2(ts->output, sm);
+  }
+  if (live)
+    tvh_mutex_unlock(&ts->state_mutex);
+}
+
+/*
+ * The subscriber sees the buffered data since it was attached
+ */
+static inline int _timeshift_visible
+  ( timeshift_t *ts, timeshift_index_iframe_t *tsi )
+{
+  return ts->start_time == PTS_UNSET || tsi->time >= ts->start_time;
+}
+
+/*
+ * Binary search in the I-frame index of the file
+ *
+ * back - the last frame with time <= req_time
+ * else - the first frame with time >= req_time
+ */
+static timeshift_index_iframe_t *_timeshift_iframe_find
+  ( timeshift_file_t *tsf, int64_t req_time, int back )
+{
+  timeshift_index_iframe_t **idx = tsf->iframe_idx;
+  int lo = 0, hi = tsf->iframe_count, mid;
+
+  /* first frame with time > req_time (back) or >= req_time */
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (back ? idx[mid]->time <= req_time : idx[mid]->time < req_time)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (back)
+    return lo > 0 ? idx[lo - 1] : NULL;
+  return lo < tsf->iframe_count ? idx[lo] : NULL;
+}
+
+static timeshift_index_iframe_t *_timeshift_first_frame
+  ( timeshift_t *ts, timeshift_file_t **_tsf )
+{
+  int end;
+  timeshift_index_iframe_t *tsi = NULL;
+  timeshift_file_t *tsf = timeshift_filemgr_oldest(ts->buf);
+  while (tsf) {
+    if (ts->start_time == PTS_UNSET)
+      tsi = TAILQ_FIRST(&tsf->iframes);
+    else
+      tsi = _timeshift_iframe_find(tsf, ts->start_time, 0);
+    if (tsi)
+      break;
+    tsf = timeshift_filemgr_next(tsf, &end, 0);
+  }
+  *_tsf = tsf;
+  return tsi;
+}
+
 static int64_t _timeshift_first_time
   ( timeshift_t *ts, int *active )
 { 
   int64_t ret = 0;
-  int end;
-  timeshift_index_iframe_t *tsi = NULL;
-  timeshift_file_t *tsf = timeshift_filemgr_oldest(ts);
-  while (tsf && !tsi) {
-    if (!(tsi = TAILQ_FIRST(&tsf->iframes)))
-      tsf = timeshift_filemgr_next(tsf, &end, 0);
-  }
+  timeshift_file_t *tsf;
+  timeshift_index_iframe_t *tsi = _timeshift_first_frame(ts, &tsf);
   if (tsi) {
     *active = 1;
     ret = tsi->time;
@@ -285,63 +462,46 @@ static int _timeshift_skip
   int                       back = (req_time < cur_time) ? 1 : 0;
   int                       end  = 0;
 
-  /* Coarse search */
+  /* Coarse search (the current file is used for the frame stepping) */
   if (!tsi) {
     while (tsf && !end) {
       if (back) {
-        if ((tsf->time <= sec) &&
-            (tsi = TAILQ_LAST(&tsf->iframes, timeshift_index_iframe_list)))
+        if (tsf->time <= sec && tsf->iframe_count)
           break;
         tsf = timeshift_filemgr_prev(tsf, &end, 1);
       } else {
-        if ((tsf->time >= sec) &&
-            (tsi = TAILQ_FIRST(&tsf->iframes)))
+        if (tsf->time >= sec && tsf->iframe_count)
           break;
         tsf = timeshift_filemgr_next(tsf, &end, 0);
       }
-      tsi = NULL;
     }
   }
 
   /* Fine search */
-  if (back) {
-    while (!end && tsf && tsi && (tsi->time > req_time)) {
-      tsi = TAILQ_PREV(tsi, timeshift_index_iframe_list, link);
-      while (!end && tsf && !tsi) {
-        if ((tsf = timeshift_filemgr_prev(tsf, &end, 1)))
-          tsi = TAILQ_LAST(&tsf->iframes, timeshift_index_iframe_list);
-      }
-    }
-  } else {
-    while (!end && tsf && tsi && (tsi->time < req_time)) {
-      tsi = TAILQ_NEXT(tsi, link);
-      while (!end && tsf && !tsi) {
-        if ((tsf = timeshift_filemgr_next(tsf, &end, 0)))
-          tsi = TAILQ_FIRST(&tsf->iframes);
-      }
-    }
+  tsi = NULL;
+  while (!end && tsf) {
+    if ((tsi = _timeshift_iframe_find(tsf, req_time, back)) != NULL)
+      break;
+    if (back)
+      tsf = timeshift_filemgr_prev(tsf, &end, 1);
+    else
+      tsf = timeshift_filemgr_next(tsf, &end, 0);
   }
 
   /* End */
-  if (!tsf || !tsi)
+  if (!tsf || !tsi || !_timeshift_visible(ts, tsi))
     end = 1;
 
   /* Find start/end of buffer */
   if (end) {
     timeshift_file_put(tsf);
     if (back) {
-      tsf = tsf_last = timeshift_filemgr_oldest(ts);
-      tsi = NULL;
-      while (tsf && !tsi) {
-        tsf_last = tsf;
-        if (!(tsi = TAILQ_FIRST(&tsf->iframes)))
-          tsf = timeshift_filemgr_next(tsf, &end, 0);
-      }
+      tsi = _timeshift_first_frame(ts, &tsf);
       if (!tsf)
-        tsf = tsf_last;
+        tsf = timeshift_filemgr_newest(ts->buf);
       end = -1;
     } else {
-      tsf = tsf_last = timeshift_filemgr_newest(ts);
+      tsf = tsf_last = timeshift_filemgr_newest(ts->buf);
       tsi = NULL;
       while (tsf && !tsi) {
         tsf_last = tsf;
@@ -383,19 +543,20 @@ static int _timeshift_do_skip
 
   /* File changed (close) */
   if (nseek.file != seek->file)
-    _read_close(seek);
+    _seek_reset(seek);
 
   timeshift_file_put(seek->file);
 
   /* Position */
-  *seek = nseek;
+  seek->file  = nseek.file;
+  seek->frame = nseek.frame;
   if (nseek.file != NULL) {
     if (nseek.frame)
-      nseek.file->roff = nseek.frame->pos;
+      seek->roff = nseek.frame->pos;
     else
-      nseek.file->roff = req_time > last_time ? nseek.file->size : 0;
+      seek->roff = req_time > last_time ? nseek.file->size : 0;
     tvhtrace(LS_TIMESHIFT, "do skip seek->file %p roff %"PRId64,
-             nseek.file, (int64_t)nseek.file->roff);
+             nseek.file, (int64_t)seek->roff);
   }
 
   return end;
@@ -404,51 +565,74 @@ static int _timeshift_do_skip
 
 /*
  * Output packet
+ *
+ * Must hold the reader locks, they are released while the file is read
+ * (the file reference keeps it) and the queued messages are delivered.
+ * Returns 1 when the writer appended data meanwhile (read again).
  */
 static int _timeshift_read
   ( timeshift_t *ts, timeshift_seek_t *seek,
-    streaming_message_t **sm, int *wait )
+    streaming_message_t **sm, int *wait, struct streaming_message_queue *q )
 {
   timeshift_file_t *tsf = seek->file;
   ssize_t r;
-  off_t off = 0;
+  off_t off;
+  int ram;
 
   *sm = NULL;
 
   if (tsf) {
 
+    off = seek->roff;
+    seek->rend = tsf->size;
+    ram = tsf->ram != NULL;
+    _reader_unlock(ts);
+    _reader_deliver(ts, q);
+
     /* Open file */
-    if (tsf->rfd < 0 && !tsf->ram) {
-      tsf->rfd = tvh_open(tsf->path, O_RDONLY, 0);
-      tvhtrace(LS_TIMESHIFT, "ts %d open file %s (fd %i)", ts->id, tsf->path, tsf->rfd);
-      if (tsf->rfd < 0)
+    if (seek->rfd < 0 && !ram) {
+      seek->rfd = tvh_open(tsf->path, O_RDONLY, 0);
+      tvhtrace(LS_TIMESHIFT, "ts %d open file %s (fd %i)", ts->id, tsf->path, seek->rfd);
+      if (seek->rfd < 0) {
+        _reader_lock(ts);
         return -1;
+      }
     }
-    if (tsf->rfd >= 0)
-      if ((off = lseek(tsf->rfd, tsf->roff, SEEK_SET)) != tsf->roff)
-        tvherror(LS_TIMESHIFT, "ts %d seek to %s failed (off %"PRId64" != %"PRId64"): %s",
-                 ts->id, tsf->path, (int64_t)tsf->roff, (int64_t)off, strerror(errno));
 
     /* Read msg */
-    r = _read_msg(tsf, -1, sm);
+    if (ram) {
+      tvh_mutex_lock(&tsf->ram_lock);
+      r = _read_msg(seek, -1, sm);
+      tvh_mutex_unlock(&tsf->ram_lock);
+    } else {
+      r = _read_msg(seek, -1, sm);
+    }
+    _reader_lock(ts);
     if (r < 0) {
       streaming_message_t *e = streaming_msg_create_code(SMT_STOP, SM_CODE_UNDEFINED_ERROR);
-      streaming_target_deliver2(ts->output, e);
-      tvhtrace(LS_TIMESHIFT, "ts %d seek to %jd (woff %jd) (fd %i)", ts->id, (intmax_t)off, (intmax_t)tsf->woff, tsf->rfd);
+      _reader_queue(ts, q, e);
+      tvhtrace(LS_TIMESHIFT, "ts %d seek to %jd (size %jd) (fd %i)", ts->id, (intmax_t)off, (intmax_t)seek->rend, seek->rfd);
       tvherror(LS_TIMESHIFT, "ts %d could not read buffer", ts->id);
       return -1;
     }
     tvhtrace(LS_TIMESHIFT, "ts %d seek to %jd (fd %i) read msg %p/%"PRId64" (%"PRId64")",
-             ts->id, (intmax_t)off, tsf->rfd, *sm, *sm ? (*sm)->sm_time : -1, (int64_t)r);
+             ts->id, (intmax_t)off, seek->rfd, *sm, *sm ? (*sm)->sm_time : -1, (int64_t)r);
+
+    /* Appended meanwhile */
+    if (*sm == NULL && tsf->size != seek->rend) {
+      seek->roff = off;
+      *wait      = 0;
+      return 1;
+    }
 
     /* Special case - EOF */
-    if (r <= sizeof(size_t) || tsf->roff > tsf->size || *sm == NULL) {
-      timeshift_file_get(seek->file); /* _read_close decreases file reference */
-      _read_close(seek);
+    if (r <= sizeof(size_t) || seek->roff > seek->rend || *sm == NULL) {
+      timeshift_file_get(seek->file); /* _seek_reset decreases file reference */
+      _seek_reset(seek);
       _seek_set_file(seek, timeshift_filemgr_next(tsf, NULL, 0), 0);
       *wait     = 0;
       tvhtrace(LS_TIMESHIFT, "ts %d eof, seek->file %p (prev %p)", ts->id, seek->file, tsf);
-      timeshift_filemgr_dump(ts);
+      timeshift_filemgr_dump(ts->buf);
     }
   }
   return 0;
@@ -456,18 +640,24 @@ static int _timeshift_read
 
 /*
  * Flush all data to live
+ *
+ * The end of data is found with the buffer lock held, so the writer
+ * delivers the next message live after the state change.
  */
 static int _timeshift_flush_to_live
-  ( timeshift_t *ts, timeshift_seek_t *seek, int *wait )
+  ( timeshift_t *ts, timeshift_seek_t *seek, int *wait,
+    struct streaming_message_queue *q )
 {
   streaming_message_t *sm;
+  int r;
 
   while (seek->file) {
-    if (_timeshift_read(ts, seek, &sm, wait) == -1)
+    if ((r = _timeshift_read(ts, seek, &sm, wait, q)) == -1)
       return -1;
+    if (r > 0) continue;
     if (!sm) break;
-    timeshift_packet_log("ouf", ts, sm);
-    streaming_target_deliver2(ts->output, sm);
+    timeshift_packet_log("ouf", ts->id, sm);
+    _reader_queue(ts, q, sm);
   }
   return 0;
 }
@@ -482,7 +672,7 @@ static void timeshift_fill_status
   int64_t start, end;
 
   start = _timeshift_first_time(ts, &active);
-  end   = ts->buf_time;
+  end   = ts->buf->buf_time;
   if (ts->state <= TS_LIVE) {
     current_time = end;
   } else {
@@ -491,14 +681,14 @@ static void timeshift_fill_status
     if (current_time > end)
       current_time = end;
   }
-  status->full = ts->full;
+  status->full = ts->buf->full;
   tvhtrace(LS_TIMESHIFT, "ts %d status start %"PRId64" end %"PRId64
                         " current %"PRId64" state %d",
            ts->id, start, end, current_time, ts->state);
   status->shift = ts_rescale_inv(end - current_time, 1000000);
   if (active) {
-    status->pts_start = ts_rescale_inv(start, 1000000);
-    status->pts_end   = ts_rescale_inv(end,   1000000);
+    status->pts_start = ts_rescale_inv(start, 1000000) - timeshift_pts_delta(ts);
+    status->pts_end   = ts_rescale_inv(end,   1000000) - timeshift_pts_delta(ts);
   } else {
     status->pts_start = PTS_UNSET;
     status->pts_end   = PTS_UNSET;
@@ -506,7 +696,7 @@ static void timeshift_fill_status
 }
 
 static void timeshift_status
-  ( timeshift_t *ts, int64_t current_time )
+  ( timeshift_t *ts, struct streaming_message_queue *q, int64_t current_time )
 {
   streaming_message_t *tsm;
   timeshift_status_t *status;
@@ -514,7 +704,7 @@ static void timeshift_status
   status = calloc(1, sizeof(timeshift_status_t));
   timeshift_fill_status(ts, status, current_time);
   tsm = streaming_msg_create_data(SMT_TIMESHIFT_STATUS, status);
-  streaming_target_deliver2(ts->output, tsm);
+  _reader_queue(ts, q, tsm);
 }
 
 /* **************************************************************************
@@ -528,18 +718,20 @@ static void timeshift_status
 void *timeshift_reader ( void *p )
 {
   timeshift_t *ts = p;
+  timeshift_buffer_t *tsb = ts->buf;
   int nfds, end, run = 1, wait = -1, state;
   timeshift_seek_t *seek = &ts->seek;
   timeshift_file_t *tmp_file;
   int cur_speed = 100, keyframe_mode = 0;
   int64_t mono_now, mono_play_time = 0, mono_last_status = 0;
   int64_t deliver, deliver0, pause_time = 0, last_time = 0, skip_time = 0;
-  int64_t i64;
   streaming_message_t *sm = NULL, *ctrl = NULL;
   streaming_skip_t *skip = NULL;
+  struct streaming_message_queue out;
   tvhpoll_t *pd;
   tvhpoll_event_t ev = { 0 };
 
+  TAILQ_INIT(&out);
   pd = tvhpoll_create(1);
   tvhpoll_add1(pd, ts->rd_pipe.rd, TVHPOLL_IN, NULL);
 
@@ -562,7 +754,7 @@ void *timeshift_reader ( void *p )
     mono_now  = getfastmonoclock();
 
     /* Control */
-    tvh_mutex_lock(&ts->state_mutex);
+    _reader_lock(ts);
     if (nfds == 1) {
       if (_read_msg(NULL, ts->rd_pipe.rd, &ctrl) > 0) {
 
@@ -603,20 +795,13 @@ void *timeshift_reader ( void *p )
                 tvhdebug(LS_TIMESHIFT, "ts %d enter timeshift mode", ts->id);
                 ts->dobuf = 1;
                 _seek_reset(seek);
-                tmp_file = timeshift_filemgr_newest(ts);
+                tmp_file = timeshift_filemgr_newest(tsb);
                 if (tmp_file != NULL) {
-                  i64 = tmp_file->last;
-                  timeshift_file_put(tmp_file);
-                } else {
-                  i64 = ts->buf_time;
-                }
-                seek->file = timeshift_filemgr_get(ts, i64);
-                if (seek->file != NULL) {
-                  seek->file->roff = seek->file->size;
-                  pause_time       = seek->file->last;
+                  _seek_set_file(seek, tmp_file, tmp_file->size);
+                  pause_time       = tmp_file->last;
                   last_time        = pause_time;
                 } else {
-                  pause_time       = i64;
+                  pause_time       = tsb->buf_time;
                   last_time        = pause_time;
                 }
               }
@@ -651,7 +836,7 @@ void *timeshift_reader ( void *p )
 
           /* Send on the message */
           ctrl->sm_code = speed;
-          streaming_target_deliver2(ts->output, ctrl);
+          _reader_queue(ts, &out, ctrl);
           ctrl = NULL;
 
         /* Skip/Seek */
@@ -661,11 +846,12 @@ void *timeshift_reader ( void *p )
             case SMT_SKIP_LIVE:
               if (ts->state != TS_LIVE) {
 
-                /* Reset */
-                if (ts->full) {
-                  timeshift_filemgr_flush(ts, NULL);
+                /* Reset (the shared data are trimmed by the writer) */
+                if (tsb->full) {
                   _seek_reset(seek);
-                  ts->full = 0;
+                  if (tsb->refcount == 1)
+                    timeshift_filemgr_flush(tsb, NULL);
+                  tsb->full = 0;
                 }
 
                 /* Release */
@@ -683,22 +869,21 @@ void *timeshift_reader ( void *p )
             case SMT_SKIP_REL_TIME:
 
               /* Convert */
-              skip_time = ts_rescale(skip->time, 1000000);
+              if (skip->type == SMT_SKIP_ABS_TIME)
+                skip_time = ts_rescale(skip->time + timeshift_pts_delta(ts), 1000000);
+              else
+                skip_time = ts_rescale(skip->time, 1000000);
               tvhdebug(LS_TIMESHIFT, "ts %d skip %"PRId64" requested %"PRId64, ts->id, skip_time, skip->time);
 
               /* Live playback (stage1) */
               if (ts->state == TS_LIVE) {
                 _seek_reset(seek);
-                tmp_file = timeshift_filemgr_newest(ts);
+                tmp_file = timeshift_filemgr_newest(tsb);
                 if (tmp_file) {
-                  i64 = tmp_file->last;
-                  timeshift_file_put(tmp_file);
-                }
-                if (tmp_file && (seek->file = timeshift_filemgr_get(ts, i64)) != NULL) {
-                  seek->file->roff = seek->file->size;
-                  last_time        = seek->file->last;
+                  _seek_set_file(seek, tmp_file, tmp_file->size);
+                  last_time        = tmp_file->last;
                 } else {
-                  last_time        = ts->buf_time;
+                  last_time        = tsb->buf_time;
                 }
               }
 
@@ -709,7 +894,7 @@ void *timeshift_reader ( void *p )
 
               /* Live (stage2) */
               if (ts->state == TS_LIVE) {
-                if (skip_time >= ts->buf_time - TIMESHIFT_PLAY_BUF) {
+                if (skip_time >= tsb->buf_time - TIMESHIFT_PLAY_BUF) {
                   tvhdebug(LS_TIMESHIFT, "ts %d skip ignored, already live", ts->id);
                   skip = NULL;
                 } else {
@@ -753,7 +938,7 @@ void *timeshift_reader ( void *p )
           /* Error */
           if (!skip) {
             ((streaming_skip_t*)ctrl->sm_data)->type = SMT_SKIP_ERROR;
-            streaming_target_deliver2(ts->output, ctrl);
+            _reader_queue(ts, &out, ctrl);
             ctrl = NULL;
           }
 
@@ -766,13 +951,19 @@ void *timeshift_reader ( void *p )
     }
 
 
+    /* Buffering started after the pause (on-demand), play from its start */
+    if (run && !seek->file && ts->state == TS_PLAY && !skip &&
+        (tmp_file = timeshift_filemgr_oldest(tsb)) != NULL)
+      _seek_set_file(seek, tmp_file, 0);
+
     /* Done */
     if (!run || !seek->file || ((ts->state != TS_PLAY && !skip))) {
       if (mono_now >= (mono_last_status + sec2mono(1))) {
-        timeshift_status(ts, last_time);
+        timeshift_status(ts, &out, last_time);
         mono_last_status = mono_now;
       }
-      tvh_mutex_unlock(&ts->state_mutex);
+      _reader_unlock(ts);
+      _reader_deliver(ts, &out);
       continue;
     }
 
@@ -806,8 +997,8 @@ void *timeshift_reader ( void *p )
       }
 
       /* Find packet */
-      if (_timeshift_read(ts, seek, &sm, &wait) == -1) {
-        tvh_mutex_unlock(&ts->state_mutex);
+      if (_timeshift_read(ts, seek, &sm, &wait, &out) == -1) {
+        _reader_unlock(ts);
         break;
       }
     }
@@ -816,7 +1007,7 @@ void *timeshift_reader ( void *p )
     if (skip) {
       if (sm) {
         /* Status message */
-        skip->time = ts_rescale_inv(sm->sm_time, 1000000);
+        skip->time = ts_rescale_inv(sm->sm_time, 1000000) - timeshift_pts_delta(ts);
         skip->type = SMT_SKIP_ABS_TIME;
         tvhdebug(LS_TIMESHIFT, "ts %d skip to pts %"PRId64" ok", ts->id, sm->sm_time);
         /* Update timeshift status */
@@ -828,7 +1019,7 @@ void *timeshift_reader ( void *p )
         skip       = NULL;
         tvhdebug(LS_TIMESHIFT, "ts %d skip failed (%d)", ts->id, sm ? sm->sm_type : -1);
       }
-      streaming_target_deliver2(ts->output, ctrl);
+      _reader_queue(ts, &out, ctrl);
     } else {
       streaming_msg_free(ctrl);
     }
@@ -841,9 +1032,9 @@ void *timeshift_reader ( void *p )
 
       last_time = sm->sm_time;
       if (!skip && keyframe_mode) /* always send status on keyframe mode */
-        timeshift_status(ts, last_time);
-      timeshift_packet_log("out", ts, sm);
-      streaming_target_deliver2(ts->output, sm);
+        timeshift_status(ts, &out, last_time);
+      timeshift_packet_log("out", ts->id, sm);
+      _reader_queue(ts, &out, sm);
       sm        = NULL;
       wait      = 0;
 
@@ -861,7 +1052,7 @@ void *timeshift_reader ( void *p )
 
     /* Periodic timeshift status */
     if (mono_now >= (mono_last_status + sec2mono(1))) {
-      timeshift_status(ts, last_time);
+      timeshift_status(ts, &out, last_time);
       mono_last_status = mono_now;
     }
 
@@ -869,24 +1060,24 @@ void *timeshift_reader ( void *p )
     if (!seek->file || end != 0) {
 
       /* Back to live (unless buffer is full) */
-      if ((end == 1 && !ts->full) || !seek->file) {
+      if ((end == 1 && !tsb->full) || !seek->file) {
         tvhdebug(LS_TIMESHIFT, "ts %d eob revert to live mode", ts->id);
         cur_speed = 100;
         ctrl      = streaming_msg_create_code(SMT_SPEED, cur_speed);
-        streaming_target_deliver2(ts->output, ctrl);
+        _reader_queue(ts, &out, ctrl);
         ctrl      = NULL;
         tvhtrace(LS_TIMESHIFT, "reader - set TS_LIVE");
 
         /* Flush timeshift buffer to live */
-        if (_timeshift_flush_to_live(ts, seek, &wait) == -1) {
-          tvh_mutex_unlock(&ts->state_mutex);
+        if (_timeshift_flush_to_live(ts, seek, &wait, &out) == -1) {
+          _reader_unlock(ts);
           break;
         }
 
         ts->state = TS_LIVE;
 
         /* Close file (if open) */
-        _read_close(seek);
+        _seek_reset(seek);
 
       /* Pause */
       } else {
@@ -908,18 +1099,26 @@ void *timeshift_reader ( void *p )
         tvhdebug(LS_TIMESHIFT, "ts %d sob speed %d last time %"PRId64, ts->id, cur_speed, last_time);
         pause_time = last_time;
         ctrl       = streaming_msg_create_code(SMT_SPEED, cur_speed);
-        streaming_target_deliver2(ts->output, ctrl);
+        _reader_queue(ts, &out, ctrl);
         ctrl       = NULL;
       }
 
     }
 
-    tvh_mutex_unlock(&ts->state_mutex);
+    _reader_unlock(ts);
+    _reader_deliver(ts, &out);
   }
 
   /* Cleanup */
+  _reader_deliver(ts, &out);
   tvhpoll_destroy(pd);
-  _read_close(seek);
+  tvh_mutex_lock(&tsb->lock);
+  _seek_reset(seek);
+  tvh_mutex_unlock(&tsb->lock);
+  if (seek->rbuf) {
+    free(seek->rbuf);
+    memoryinfo_free(&timeshift_memoryinfo, TIMESHIFT_READ_SIZE);
+  }
   if (sm)       streaming_msg_free(sm);
   if (ctrl)     streaming_msg_free(ctrl);
   tvhtrace(LS_TIMESHIFT, "ts %d exit reader thread", ts->id);
@@ -234,27 +234,29 @@ ssize_t timeshift_write_eof ( timeshift_file_t *tsf )
 /*
  * Update smt_start
  */
-static void _update_smt_start ( timeshift_t *ts, streaming_start_t *ss )
+static void _update_smt_start ( timeshift_buffer_t *tsb, streaming_start_t *ss )
 {
   int i;
 
-  if (ts->smt_start)
-    streaming_start_unref(ts->smt_start);
+  if (tsb->smt_start)
+    streaming_start_unref(tsb->smt_start);
   streaming_start_ref(ss);
-  ts->smt_start = ss;
+  tsb->smt_start = ss;
 
-  /* Update video index */
+  /* Update video index (used also by the subscriber inputs) */
+  tvh_mutex_lock(&tsb->wr_mutex);
   for (i = 0; i < ss->ss_num_components; i++)
     if (SCT_ISVIDEO(ss->ss_components[i].es_type)) {
-      ts->vididx = ss->ss_components[i].es_index;
+      tsb->vididx = ss->ss_components[i].es_index;
       break;
     }
+  tvh_mutex_unlock(&tsb->wr_mutex);
 }
 
 /*
  * Stream start handling
  */
-static void _handle_sstart ( timeshift_t *ts, timeshift_file_t *tsf, streaming_message_t *sm )
+static void _handle_sstart ( timeshift_file_t *tsf, streaming_message_t *sm )
 {
   timeshift_index_data_t *ti = calloc(1, sizeof(timeshift_index_data_t));
 
@@ -264,18 +266,39 @@ static void _handle_sstart ( timeshift_t *ts, timeshift_file_t *tsf, streaming_m
   TAILQ_INSERT_TAIL(&tsf->sstart, ti, link);
 }
 
+/*
+ * I-frame lookup (the buffer time never goes back, the array is sorted)
+ */
+static void _index_iframe ( timeshift_file_t *tsf, timeshift_index_iframe_t *ti )
+{
+  timeshift_index_iframe_t **idx;
+  int alloc;
+
+  if (tsf->iframe_count == tsf->iframe_alloc) {
+    alloc = MAX(64, tsf->iframe_alloc * 2);
+    idx = realloc(tsf->iframe_idx, alloc * sizeof(*idx));
+    if (idx == NULL)
+      return;
+    memoryinfo_append(&timeshift_memoryinfo,
+                      (alloc - tsf->iframe_alloc) * sizeof(*idx));
+    tsf->iframe_idx   = idx;
+    tsf->iframe_alloc = alloc;
+  }
+  tsf->iframe_idx[tsf->iframe_count++] = ti;
+}
+
 /* **************************************************************************
  * Thread
  * *************************************************************************/
 
 static inline ssize_t _process_msg0
-  ( timeshift_t *ts, timeshift_file_t *tsf, streaming_message_t *sm )
+  ( timeshift_buffer_t *tsb, timeshift_file_t *tsf, streaming_message_t *sm )
 {
   ssize_t err;
 
   if (sm->sm_type == SMT_START) {
     err = 0;
-    _handle_sstart(ts, tsf, streaming_msg_clone(sm));
+    _handle_sstart(tsf, streaming_msg_clone(sm));
   } else if (sm->sm_type == SMT_SIGNAL_STATUS)
     err = timeshift_write_sigstat(tsf, sm->sm_time, sm->sm_data);
   else if (sm->sm_type == SMT_PACKET) {
@@ -284,13 +307,14 @@ static inline ssize_t _process_msg0
       th_pkt_t *pkt = sm->sm_data;
 
       /* Index video iframes */
-      if (pkt->pkt_componentindex == ts->vididx &&
+      if (pkt->pkt_componentindex == tsb->vididx &&
           pkt->v.pkt_frametype    == PKT_I_FRAME) {
         timeshift_index_iframe_t *ti = calloc(1, sizeof(timeshift_index_iframe_t));
         memoryinfo_alloc(&timeshift_memoryinfo, sizeof(*ti));
         ti->pos  = tsf->size;
         ti->time = sm->sm_time;
         TAILQ_INSERT_TAIL(&tsf->iframes, ti, link);
+        _index_iframe(tsf, ti);
       }
     }
   } else if (sm->sm_type == SMT_MPEGTS) {
@@ -310,8 +334,65 @@ static inline ssize_t _process_msg0
   return err;
 }
 
+/*
+ * Deliver a message to the originating subscriber (live mode only)
+ */
+static void _deliver_origin
+  ( timeshift_t *ts, streaming_message_t *sm )
+{
+  if (ts == NULL) {
+    streaming_msg_free(sm);
+    return;
+  }
+  tvh_mutex_lock(&ts->state_mutex);
+  if (sm->sm_type == SMT_START)
+    ts->started = 1;
+  else if (sm->sm_type == SMT_STOP)
+    ts->started = 0;
+  if (ts->state == TS_LIVE)
+    streaming_target_deliver2(ts->output, sm);
+  else
+    streaming_msg_free(sm);
+  tvh_mutex_unlock(&ts->state_mutex);
+}
+
+/*
+ * Deliver the buffered data to all live subscribers
+ */
+static void _deliver_live
+  ( timeshift_buffer_t *tsb, streaming_message_t *sm )
+{
+  timeshift_t *ts;
+
+  LIST_FOREACH(ts, &tsb->readers, buf_link) {
+    tvh_mutex_lock(&ts->state_mutex);
+    if (ts->state == TS_LIVE && ts->started && ts->pts_delta != PTS_UNSET &&
+        !ts->direct) {
+      if (ts->start_time == PTS_UNSET)
+        ts->start_time = sm->sm_time;
+      timeshift_deliver(ts, streaming_msg_clone(sm));
+      if (sm->sm_type == SMT_PACKET)
+        timeshift_packet_log("liv", ts->id, sm);
+    }
+    tvh_mutex_unlock(&ts->state_mutex);
+  }
+}
+
+/*
+ * Check if any subscriber wants the data to be stored
+ */
+static int _dobuf ( timeshift_buffer_t *tsb )
+{
+  timeshift_t *ts;
+
+  LIST_FOREACH(ts, &tsb->readers, buf_link)
+    if (ts->dobuf)
+      return 1;
+  return 0;
+}
+
 static void _process_msg
-  ( timeshift_t *ts, streaming_message_t *sm, int *run )
+  ( timeshift_buffer_t *tsb, timeshift_t *ts, streaming_message_t *sm )
 {
   int err, teletext = 0;
   timeshift_file_t *tsf;
@@ -322,12 +403,9 @@ static void _process_msg
 
     /* Terminate */
     case SMT_EXIT:
-      if (run) *run = 0;
       break;
     case SMT_STOP:
-      if (sm->sm_code != SM_CODE_SOURCE_RECONFIGURED && run)
-        *run = 0;
-      goto live;
+      goto origin;
 
     /* Timeshifting */
     case SMT_SKIP:
@@ -341,7 +419,7 @@ static void _process_msg
     case SMT_SERVICE_STATUS:
     case SMT_TIMESHIFT_STATUS:
     case SMT_DESCRAMBLE_INFO:
-      goto live;
+      goto origin;
 
     /* Store */
     case SMT_PACKET:
@@ -353,32 +431,35 @@ static void _process_msg
     case SMT_SIGNAL_STATUS:
     case SMT_START:
     case SMT_MPEGTS:
-      tvh_mutex_lock(&ts->state_mutex);
-      if (!teletext) /* do not use time from teletext packets */
-        ts->buf_time = sm->sm_time;
-      if (ts->state == TS_LIVE) {
-        streaming_target_deliver2(ts->output, streaming_msg_clone(sm));
+      /* the stream info is stored only from the buffer writer */
+      if (sm->sm_type == SMT_START || sm->sm_type == SMT_SIGNAL_STATUS) {
+        _deliver_origin(ts, streaming_msg_clone(sm));
+        if (ts == NULL || ts != tsb->writer)
+          break;
+      } else {
         if (sm->sm_type == SMT_PACKET)
-          timeshift_packet_log("liv", ts, sm);
+          timeshift_sync(tsb, sm->sm_data);
+        _deliver_live(tsb, sm);
       }
+      if (!teletext) /* do not use time from teletext packets */
+        tsb->buf_time = sm->sm_time;
       if (sm->sm_type == SMT_START)
-        _update_smt_start(ts, (streaming_start_t *)sm->sm_data);
+        _update_smt_start(tsb, (streaming_start_t *)sm->sm_data);
       /* do buffering, but without teletext packets */
-      if (ts->dobuf && !teletext) {
-        if ((tsf = timeshift_filemgr_get(ts, sm->sm_time)) != NULL) {
+      if (!teletext && _dobuf(tsb)) {
+        if ((tsf = timeshift_filemgr_get(tsb, sm->sm_time)) != NULL) {
           if (tsf->wfd >= 0 || tsf->ram) {
-            if ((err = _process_msg0(ts, tsf, sm)) < 0) {
+            if ((err = _process_msg0(tsb, tsf, sm)) < 0) {
               timeshift_filemgr_close(tsf);
               tsf->bad = 1;
-              ts->full = 1; ///< Stop any more writing
+              tsb->full = 1; ///< Stop any more writing
             } else {
-              timeshift_packet_log("sav", ts, sm);
+              timeshift_packet_log("sav", tsb->id, sm);
             }
           }
           timeshift_file_put(tsf);
         }
       }
-      tvh_mutex_unlock(&ts->state_mutex);
       break;
   }
 
@@ -386,40 +467,42 @@ static void _process_msg
   streaming_msg_free(sm);
   return;
 
-live:
-  tvh_mutex_lock(&ts->state_mutex);
-  if (ts->state == TS_LIVE)
-    streaming_target_deliver2(ts->output, sm);
-  else
-    streaming_msg_free(sm);
-  tvh_mutex_unlock(&ts->state_mutex);
+origin:
+  _deliver_origin(ts, sm);
 }
 
 void *timeshift_writer ( void *aux )
 {
-  int run = 1;
-  timeshift_t *ts = aux;
-  streaming_queue_t *sq = &ts->wr_queue;
-  streaming_message_t *sm;
+  timeshift_buffer_t *tsb = aux;
+  timeshift_msg_t *tm;
 
-  tvh_mutex_lock(&sq->sq_mutex);
+  tvh_mutex_lock(&tsb->wr_mutex);
 
-  while (run) {
+  while (tsb->wr_run) {
 
     /* Get message */
-    sm = TAILQ_FIRST(&sq->sq_queue);
-    if (sm == NULL) {
-      tvh_cond_wait(&sq->sq_cond, &sq->sq_mutex);
+    if (TAILQ_EMPTY(&tsb->wr_queue)) {
+      tvh_cond_wait(&tsb->wr_cond, &tsb->wr_mutex);
       continue;
     }
-    streaming_queue_remove(sq, sm);
-    tvh_mutex_unlock(&sq->sq_mutex);
-
-    _process_msg(ts, sm, &run);
+    tvh_mutex_unlock(&tsb->wr_mutex);
+
+    /* The subscribers are detached with the buffer lock held */
+    tvh_mutex_lock(&tsb->lock);
+    tvh_mutex_lock(&tsb->wr_mutex);
+    tm = TAILQ_FIRST(&tsb->wr_queue);
+    if (tm)
+      TAILQ_REMOVE(&tsb->wr_queue, tm, link);
+    tvh_mutex_unlock(&tsb->wr_mutex);
+    if (tm) {
+      _process_msg(tsb, tm->ts, tm->sm);
+      free(tm);
+    }
+    tvh_mutex_unlock(&tsb->lock);
 
-    tvh_mutex_lock(&sq->sq_mutex);
+    tvh_mutex_lock(&tsb->wr_mutex);
   }
 
-  tvh_mutex_unlock(&sq->sq_mutex);
+  tvh_mutex_unlock(&tsb->wr_mutex);
   return NULL;
 }
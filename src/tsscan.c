@@ -0,0 +1,369 @@
+/*
+ *  tvheadend, MPEG-TS packet scanning helpers
+ *  Copyright (C) 2026 Tvheadend Foundation CIC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This file is self-contained (no tvheadend headers), so the benchmark
+ * (make tsbench) builds exactly the same code as the server.
+ *
+ * The TS words are 188 bytes apart, so the vector variants load one
+ * word per packet to a lane (AVX2 uses a gather) and compare eight
+ * packets with one test. The scrambling bits can be cleared with one
+ * 16-byte masked store per packet.
+ *
+ * tsbench (cached 64kB chunks, x86_64): with long PID runs the AVX2
+ * gather scan is 5-50% faster than the scalar one, but with a real
+ * capture (short runs, early exits) it is ~30% slower. The SSE2 lane
+ * inserts are 3-6x slower and the scalar clear matches or beats the
+ * vector ones. The auto mode picks the first supported entry of the
+ * dispatch table (AVX2, NEON, scalar), SSE2 and the scalar code on
+ * the vector capable CPUs can be forced with --tsscan.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "tsscan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TSSCAN_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TSSCAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+#define TS 188
+
+typedef struct tsscan_ops {
+  const char *name;
+  int (*supported)(void);
+  int (*word_count)(const uint8_t *tsb, int len, uint32_t mask, uint32_t val);
+  void (*clear)(uint8_t *tsb, int len);
+} tsscan_ops_t;
+
+/*
+ * Word load in memory byte order (mask / val are in the same order)
+ */
+static inline uint32_t
+tsscan_word32 ( const uint8_t *tsb )
+{
+  uint32_t r;
+  memcpy(&r, tsb, sizeof(r));
+  return r;
+}
+
+static inline uint32_t
+tsscan_mask ( uint32_t mask )
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  return __builtin_bswap32(mask);
+#else
+  return mask;
+#endif
+}
+
+/*
+ * Scalar
+ */
+
+static int
+tsscan_supported_scalar ( void )
+{
+  return 1;
+}
+
+static inline int
+tsscan_word_count_tail
+  ( const uint8_t *tsb, int len, uint32_t mask, uint32_t val )
+{
+  int r = 0;
+
+  while (len >= TS && (tsscan_word32(tsb) & mask) == val) {
+    r   += TS;
+    len -= TS;
+    tsb += TS;
+  }
+  return r;
+}
+
+static int
+tsscan_word_count_scalar
+  ( const uint8_t *tsb, int len, uint32_t mask, uint32_t val )
+{
+  int r = 0;
+
+  while (len >= 8*TS) {
+    if (((tsscan_word32(tsb+0*TS) ^ val) |
+         (tsscan_word32(tsb+1*TS) ^ val) |
+         (tsscan_word32(tsb+2*TS) ^ val) |
+         (tsscan_word32(tsb+3*TS) ^ val) |
+         (tsscan_word32(tsb+4*TS) ^ val) |
+         (tsscan_word32(tsb+5*TS) ^ val) |
+         (tsscan_word32(tsb+6*TS) ^ val) |
+         (tsscan_word32(tsb+7*TS) ^ val)) & mask)
+      break;
+    r   += 8*TS;
+    len -= 8*TS;
+    tsb += 8*TS;
+  }
+  return r + tsscan_word_count_tail(tsb, len, mask, val);
+}
+
+static void
+tsscan_clear_scalar ( uint8_t *tsb, int len )
+{
+  while (len >= 4*TS) {
+    tsb[0*TS+3] &= ~0xc0;
+    tsb[1*TS+3] &= ~0xc0;
+    tsb[2*TS+3] &= ~0xc0;
+    tsb[3*TS+3] &= ~0xc0;
+    len -= 4*TS;
+    tsb += 4*TS;
+  }
+  for ( ; len >= TS; len -= TS, tsb += TS)
+    tsb[3] &= ~0xc0;
+}
+
+/*
+ * x86: SSE2 / AVX2 (compiled with target attributes, selected at runtime)
+ */
+
+#if TSSCAN_X86
+
+static int
+tsscan_supported_sse2 ( void )
+{
+  return __builtin_cpu_supports("sse2");
+}
+
+static int
+tsscan_supported_avx2 ( void )
+{
+  return __builtin_cpu_supports("avx2");
+}
+
+__attribute__((target("sse2")))
+static int
+tsscan_word_count_sse2
+  ( const uint8_t *tsb, int len, uint32_t mask, uint32_t val )
+{
+  const __m128i vm = _mm_set1_epi32((int)mask);
+  const __m128i vv = _mm_set1_epi32((int)val);
+  __m128i a, b;
+  int r = 0;
+
+  while (len >= 8*TS) {
+    a = _mm_set_epi32((int)tsscan_word32(tsb+3*TS), (int)tsscan_word32(tsb+2*TS),
+                      (int)tsscan_word32(tsb+1*TS), (int)tsscan_word32(tsb+0*TS));
+    b = _mm_set_epi32((int)tsscan_word32(tsb+7*TS), (int)tsscan_word32(tsb+6*TS),
+                      (int)tsscan_word32(tsb+5*TS), (int)tsscan_word32(tsb+4*TS));
+    a = _mm_and_si128(_mm_or_si128(_mm_xor_si128(a, vv), _mm_xor_si128(b, vv)), vm);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(a, _mm_setzero_si128())) != 0xffff)
+      break;
+    r   += 8*TS;
+    len -= 8*TS;
+    tsb += 8*TS;
+  }
+  return r + tsscan_word_count_tail(tsb, len, mask, val);
+}
+
+__attribute__((target("sse2")))
+static void
+tsscan_clear_sse2 ( uint8_t *tsb, int len )
+{
+  const __m128i m = _mm_setr_epi8(-1, -1, -1, 0x3f, -1, -1, -1, -1,
+                                  -1, -1, -1, -1, -1, -1, -1, -1);
+
+  for ( ; len >= TS; len -= TS, tsb += TS)
+    _mm_storeu_si128((__m128i *)tsb,
+                     _mm_and_si128(_mm_loadu_si128((const __m128i *)tsb), m));
+}
+
+__attribute__((target("avx2")))
+static int
+tsscan_word_count_avx2
+  ( const uint8_t *tsb, int len, uint32_t mask, uint32_t val )
+{
+  const __m256i idx = _mm256_setr_epi32(0*TS, 1*TS, 2*TS, 3*TS,
+                                        4*TS, 5*TS, 6*TS, 7*TS);
+  const __m256i vm = _mm256_set1_epi32((int)mask);
+  const __m256i vv = _mm256_set1_epi32((int)val);
+  __m256i a;
+  int r = 0;
+
+  while (len >= 8*TS) {
+    a = _mm256_i32gather_epi32((const int *)tsb, idx, 1);
+    a = _mm256_and_si256(_mm256_xor_si256(a, vv), vm);
+    if (!_mm256_testz_si256(a, a))
+      break;
+    r   += 8*TS;
+    len -= 8*TS;
+    tsb += 8*TS;
+  }
+  return r + tsscan_word_count_tail(tsb, len, mask, val);
+}
+
+#endif /* TSSCAN_X86 */
+
+/*
+ * ARM: NEON (compile time - always present on aarch64)
+ */
+
+#if TSSCAN_NEON
+
+static int
+tsscan_supported_neon ( void )
+{
+  return 1;
+}
+
+static int
+tsscan_word_count_neon
+  ( const uint8_t *tsb, int len, uint32_t mask, uint32_t val )
+{
+  const uint32x4_t vm = vdupq_n_u32(mask);
+  const uint32x4_t vv = vdupq_n_u32(val);
+  uint32x4_t a = vdupq_n_u32(0), b = vdupq_n_u32(0);
+  uint64x2_t t;
+  int r = 0;
+
+  while (len >= 8*TS) {
+    a = vsetq_lane_u32(tsscan_word32(tsb+0*TS), a, 0);
+    a = vsetq_lane_u32(tsscan_word32(tsb+1*TS), a, 1);
+    a = vsetq_lane_u32(tsscan_word32(tsb+2*TS), a, 2);
+    a = vsetq_lane_u32(tsscan_word32(tsb+3*TS), a, 3);
+    b = vsetq_lane_u32(tsscan_word32(tsb+4*TS), b, 0);
+    b = vsetq_lane_u32(tsscan_word32(tsb+5*TS), b, 1);
+    b = vsetq_lane_u32(tsscan_word32(tsb+6*TS), b, 2);
+    b = vsetq_lane_u32(tsscan_word32(tsb+7*TS), b, 3);
+    a = vandq_u32(vorrq_u32(veorq_u32(a, vv), veorq_u32(b, vv)), vm);
+    t = vreinterpretq_u64_u32(a);
+    if (vgetq_lane_u64(t, 0) | vgetq_lane_u64(t, 1))
+      break;
+    r   += 8*TS;
+    len -= 8*TS;
+    tsb += 8*TS;
+  }
+  return r + tsscan_word_count_tail(tsb, len, mask, val);
+}
+
+static void
+tsscan_clear_neon ( uint8_t *tsb, int len )
+{
+  static const uint8_t mask[16] = {
+    0xff, 0xff, 0xff, 0x3f, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+  };
+  const uint8x16_t m = vld1q_u8(mask);
+
+  for ( ; len >= TS; len -= TS, tsb += TS)
+    vst1q_u8(tsb, vandq_u8(vld1q_u8(tsb), m));
+}
+
+#endif /* TSSCAN_NEON */
+
+/*
+ * Dispatch, the preferred implementation first
+ */
+
+#define TSSCAN_SCALAR \
+  { "scalar", tsscan_supported_scalar, tsscan_word_count_scalar, tsscan_clear_scalar }
+
+static const tsscan_ops_t tsscan_ops_scalar = TSSCAN_SCALAR;
+
+static const tsscan_ops_t tsscan_ops[] = {
+#if TSSCAN_X86
+  { "avx2",   tsscan_supported_avx2,   tsscan_word_count_avx2,   tsscan_clear_scalar },
+#endif
+#if TSSCAN_NEON
+  { "neon",   tsscan_supported_neon,   tsscan_word_count_neon,   tsscan_clear_neon },
+#endif
+  TSSCAN_SCALAR,
+#if TSSCAN_X86
+  /* slower than scalar, only selected by name */
+  { "sse2",   tsscan_supported_sse2,   tsscan_word_count_sse2,   tsscan_clear_sse2 },
+#endif
+};
+
+#define TSSCAN_OPS_COUNT (sizeof(tsscan_ops) / sizeof(tsscan_ops[0]))
+
+/* scalar until tsscan_init() runs, so the early callers are safe, too */
+static const tsscan_ops_t *tsscan_cur = &tsscan_ops_scalar;
+
+static int
+tsscan_supported ( const tsscan_ops_t *ops )
+{
+#if TSSCAN_X86
+  __builtin_cpu_init();
+#endif
+  return ops->supported();
+}
+
+const char *
+tsscan_name ( int idx )
+{
+  int i;
+
+  for (i = 0; i < (int)TSSCAN_OPS_COUNT; i++)
+    if (tsscan_supported(&tsscan_ops[i]) && idx-- == 0)
+      return tsscan_ops[i].name;
+  return NULL;
+}
+
+const char *
+tsscan_init ( const char *name )
+{
+  int i;
+
+  if (name && strcmp(name, "auto") == 0)
+    name = NULL;
+  for (i = 0; i < (int)TSSCAN_OPS_COUNT; i++) {
+    if (name && strcmp(name, tsscan_ops[i].name))
+      continue;
+    if (!tsscan_supported(&tsscan_ops[i]))
+      continue;
+    tsscan_cur = &tsscan_ops[i];
+    return tsscan_cur->name;
+  }
+  return NULL;
+}
+
+/*
+ * Public API
+ */
+
+int
+mpegts_word_count ( const uint8_t *tsb, int len, uint32_t mask )
+{
+  mask = tsscan_mask(mask);
+  return tsscan_cur->word_count(tsb, len, mask, tsscan_word32(tsb) & mask);
+}
+
+int
+mpegts_sync_count ( const uint8_t *tsb, int len )
+{
+  return tsscan_cur->word_count(tsb, len, tsscan_mask(0xff000000),
+                                          tsscan_mask(0x47000000));
+}
+
+void
+mpegts_clear_scrambled ( uint8_t *tsb, int len )
+{
+  tsscan_cur->clear(tsb, len);
+}
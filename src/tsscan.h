@@ -0,0 +1,51 @@
+/*
+ *  tvheadend, MPEG-TS packet scanning helpers
+ *  Copyright (C) 2026 Tvheadend Foundation CIC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TVH_TSSCAN_H__
+#define __TVH_TSSCAN_H__
+
+#include <stdint.h>
+
+/*
+ * Number of bytes (multiple of 188) from tsb where the masked first
+ * TS word equals the first packet's one.
+ */
+int mpegts_word_count(const uint8_t *tsb, int len, uint32_t mask);
+
+/*
+ * Number of bytes (multiple of 188) with a valid sync byte.
+ */
+int mpegts_sync_count(const uint8_t *tsb, int len);
+
+/*
+ * Clear the transport scrambling control bits of all packets.
+ */
+void mpegts_clear_scrambled(uint8_t *tsb, int len);
+
+/*
+ * Select the implementation: NULL (or "auto") picks the best one the
+ * CPU supports. Returns the selected name or NULL when unsupported.
+ */
+const char *tsscan_init(const char *name);
+
+/*
+ * Enumerate the implementations usable on this CPU (benchmark).
+ */
+const char *tsscan_name(int idx);
+
+#endif /* __TVH_TSSCAN_H__ */
@@ -41,6 +41,7 @@
 #include "redblack.h"
 
 #include "tvh_locale.h"
+#include "tsscan.h"
 
 #define ERRNO_AGAIN(e) ((e) == EAGAIN || (e) == EINTR || (e) == EWOULDBLOCK)
 
@@ -245,6 +246,9 @@ void tvh_pipe_close(th_pipe_t *pipe);
 
 int tvh_write(int fd, const void *buf, size_t len);
 
+struct iovec;
+int tvh_writev(int fd, struct iovec *iov, int iovcnt);
+
 int tvh_write_in_chunks(int fd, const void *buf, size_t len, size_t chunkSize);
 
 int tvh_nonblock_write(int fd, const void *buf, size_t len);
@@ -289,6 +293,10 @@ uint8_t *tvh_gzip_inflate ( const uint8_t *data, size_t size, size_t orig );
 uint8_t *tvh_gzip_deflate ( const uint8_t *data, size_t orig, size_t *size );
 int      tvh_gzip_deflate_fd ( int fd, const uint8_t *data, size_t orig, size_t *size, int speed );
 int      tvh_gzip_deflate_fd_header ( int fd, const uint8_t *data, size_t orig, size_t *size, int speed , const char *signature);
+typedef struct tvh_gzip_reader tvh_gzip_reader_t;
+tvh_gzip_reader_t *tvh_gzip_reader_create ( int fd );
+ssize_t  tvh_gzip_reader_read ( tvh_gzip_reader_t *gr, void *buf, size_t size );
+void     tvh_gzip_reader_destroy ( tvh_gzip_reader_t *gr );
 #endif
 
 /* URL decoding */
@@ -296,8 +304,6 @@ char to_hex(char code);
 char *url_encode(const char *str);
 void http_deescape(char *str);
 
-int mpegts_word_count(const uint8_t *tsb, int len, uint32_t mask);
-
 int deferred_unlink(const char *filename, const char *rootdir);
 void dvr_cutpoint_delete_files (const char *s);
 
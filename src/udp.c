@@ -29,6 +29,7 @@
 #include <assert.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <netdb.h>
 #include <net/if.h>
 #ifndef IPV6_ADD_MEMBERSHIP
@@ -730,6 +731,7 @@ udp_multisend_init( udp_multisend_t *um, int packets, int psize,
   assert(um);
   um->um_psize   = psize;
   um->um_packets = packets;
+  um->um_gso     = 0;
   um->um_data    = malloc(packets * psize);
   um->um_iovec   = malloc(packets * sizeof(struct iovec));
   um->um_msg     = calloc(packets,  sizeof(struct mmsghdr));
@@ -762,32 +764,124 @@ udp_multisend_clean( udp_multisend_t *um )
     um->um_iovec[i].iov_len = 0;
 }
 
+/*
+ * UDP generic segmentation offload (linux 4.18+)
+ *
+ * The packet buffers are allocated in one contiguous block, so a run of
+ * the full sized packets can be passed to the kernel as one large
+ * datagram which is split to um_psize sized packets on the way out.
+ */
+
+#ifdef UDP_SEGMENT
+
+#define UDP_GSO_SEGMENTS 64     /* UDP_MAX_SEGMENTS in the kernel */
+#define UDP_GSO_SIZE     65000  /* keep below the IP datagram limit */
+
+int
+udp_multisend_gso( udp_multisend_t *um, int fd )
+{
+  int val;
+  socklen_t len = sizeof(val);
+
+  /* the older kernels ignore the unknown control messages silently */
+  um->um_gso = getsockopt(fd, IPPROTO_UDP, UDP_SEGMENT, &val, &len) == 0 &&
+               um->um_psize <= UDP_GSO_SIZE / 2;
+  return um->um_gso ? 0 : -1;
+}
+
+static int
+udp_multisend_gso_send( udp_multisend_t *um, int fd, int first, int packets )
+{
+  union {
+    char buf[CMSG_SPACE(sizeof(uint16_t))];
+    struct cmsghdr align;
+  } u;
+  struct msghdr msg;
+  struct cmsghdr *cm;
+  struct iovec iov;
+  int i, last, segs, max = MIN(UDP_GSO_SEGMENTS, UDP_GSO_SIZE / um->um_psize);
+
+  last = first + packets;
+  for (i = first; i < last; i += segs) {
+    iov.iov_base = um->um_iovec[i].iov_base;
+    iov.iov_len = 0;
+    for (segs = 0; segs < max && i + segs < last; ) {
+      iov.iov_len += um->um_iovec[i + segs++].iov_len;
+      /* only the last segment may be shorter */
+      if (iov.iov_len != (size_t)segs * um->um_psize)
+        break;
+    }
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (segs > 1) {
+      msg.msg_control = u.buf;
+      msg.msg_controllen = sizeof(u.buf);
+      cm = CMSG_FIRSTHDR(&msg);
+      cm->cmsg_level = IPPROTO_UDP;
+      cm->cmsg_type = UDP_SEGMENT;
+      cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+      *(uint16_t *)CMSG_DATA(cm) = um->um_psize;
+    }
+    if (sendmsg(fd, &msg, MSG_DONTWAIT) < 0)
+      return i > first ? i - first : -1;
+  }
+  return packets;
+}
+
+#else
+
 int
-udp_multisend_send( udp_multisend_t *um, int fd, int packets )
+udp_multisend_gso( udp_multisend_t *um, int fd )
+{
+  um->um_gso = 0;
+  return -1;
+}
+
+#endif
+
+/*
+ * Send the packets first .. first + packets - 1, returns the number
+ * of the sent packets (may be less than requested) or -1 (errno set)
+ */
+int
+udp_multisend_send( udp_multisend_t *um, int fd, int first, int packets )
 {
   static char use_emul = 0;
+  struct mmsghdr *msg;
   int n, i;
-  if (um == NULL) {
+  if (um == NULL || first < 0 || first >= um->um_packets) {
     errno = EINVAL;
     return -1;
   }
-  if (packets > um->um_packets)
-    packets = um->um_packets;
+  if (packets > um->um_packets - first)
+    packets = um->um_packets - first;
+#ifdef UDP_SEGMENT
+  if (um->um_gso) {
+    n = udp_multisend_gso_send(um, fd, first, packets);
+    if (n >= 0 || (errno != EIO && errno != EINVAL && errno != EOPNOTSUPP))
+      return n;
+    /* no checksum offload on the outgoing device and so on */
+    tvhdebug(LS_UDP, "GSO send failed (%s), using sendmmsg", strerror(errno));
+    um->um_gso = 0;
+  }
+#endif
+  msg = (struct mmsghdr *)um->um_msg + first;
   for (i = 0; i < packets; i++)
-    ((struct mmsghdr *)um->um_msg)[i].msg_len = um->um_iovec[i].iov_len;
+    msg[i].msg_len = um->um_iovec[first + i].iov_len;
   if (!use_emul) {
-    n = sendmmsg(fd, (struct mmsghdr *)um->um_msg, packets, MSG_DONTWAIT);
+    n = sendmmsg(fd, msg, packets, MSG_DONTWAIT);
   } else {
     n = -1;
     errno = ENOSYS;
   }
   if (n < 0 && errno == ENOSYS) {
     use_emul = 1;
-    n = sendmmsg_i(fd, (struct mmsghdr *)um->um_msg, packets, MSG_DONTWAIT);
+    n = sendmmsg_i(fd, msg, packets, MSG_DONTWAIT);
   }
   if (n > 0) {
     for (i = 0; i < n; i++)
-      um->um_iovec[i].iov_len = ((struct mmsghdr *)um->um_msg)[i].msg_len;
+      um->um_iovec[first + i].iov_len = msg[i].msg_len;
   }
   return n;
 }
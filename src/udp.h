@@ -88,6 +88,7 @@ typedef struct udp_multisend {
   int             um_psize;
   int             um_packets;
   uint8_t        *um_data;
+  int             um_gso;
   struct iovec   *um_iovec;
   struct mmsghdr *um_msg;
 } udp_multisend_t;
@@ -100,6 +101,8 @@ udp_multisend_clean( udp_multisend_t *um );
 void
 udp_multisend_free( udp_multisend_t *um );
 int
-udp_multisend_send( udp_multisend_t *um, int fd, int packets );
+udp_multisend_gso( udp_multisend_t *um, int fd );
+int
+udp_multisend_send( udp_multisend_t *um, int fd, int first, int packets );
 
 #endif /* UDP_H_ */
@@ -51,18 +51,162 @@ static memoryinfo_t comet_memoryinfo = {
   .my_name = "Comet",
 };
 
+/*
+ * Notifications are serialized to JSON once and the resulting text is
+ * shared (refcounted) by all mailboxes which should receive it. Messages
+ * rewritten per UI language get one payload per distinct language.
+ */
+typedef struct comet_payload {
+  int cp_refcount;
+  size_t cp_len;
+  char *cp_key;      /* coalescing key (class + object id) or NULL */
+  char cp_json[0];
+} comet_payload_t;
+
+typedef struct comet_entry {
+  TAILQ_ENTRY(comet_entry) ce_link;
+  RB_ENTRY(comet_entry) ce_key_link;
+  comet_payload_t *ce_payload;
+} comet_entry_t;
+
+TAILQ_HEAD(comet_entry_queue, comet_entry);
+
 typedef struct comet_mailbox {
   char *cmb_boxid; /* SHA-1 hash */
   char *cmb_lang;  /* UI language */
   int cmb_refcount;
   int cmb_restricted; /* !admin */
-  htsmsg_t *cmb_messages; /* A vector */
+  struct comet_entry_queue cmb_messages;
+  RB_HEAD(, comet_entry) cmb_keys; /* pending entries with a key */
   int64_t cmb_last_used;
   LIST_ENTRY(comet_mailbox) cmb_link;
   int cmb_debug;
 } comet_mailbox_t;
 
 
+/**
+ *
+ */
+static comet_payload_t *
+comet_payload_create(htsmsg_t *m, const char *key)
+{
+  comet_payload_t *cp;
+  htsbuf_queue_t q;
+  size_t len, klen = key ? strlen(key) + 1 : 0;
+
+  htsbuf_queue_init(&q, 0);
+  htsmsg_json_serialize(m, &q, 0);
+  len = q.hq_size;
+  cp = malloc(sizeof(*cp) + len + 1 + klen);
+  cp->cp_refcount = 1;
+  cp->cp_len = len;
+  htsbuf_read(&q, cp->cp_json, len);
+  cp->cp_json[len] = '\0';
+  htsbuf_queue_flush(&q);
+  if (key) {
+    cp->cp_key = cp->cp_json + len + 1;
+    memcpy(cp->cp_key, key, klen);
+  } else {
+    cp->cp_key = NULL;
+  }
+  memoryinfo_alloc(&comet_memoryinfo, sizeof(*cp) + len + 1 + klen);
+  return cp;
+}
+
+static void
+comet_payload_release(comet_payload_t *cp)
+{
+  if (atomic_dec(&cp->cp_refcount, 1) > 1)
+    return;
+  memoryinfo_free(&comet_memoryinfo, sizeof(*cp) + cp->cp_len + 1 +
+                                     (cp->cp_key ? strlen(cp->cp_key) + 1 : 0));
+  free(cp);
+}
+
+/**
+ * Build the coalescing key. Only periodic state updates of a single
+ * object are coalesced, a newer one makes the pending one obsolete.
+ */
+static char *
+comet_payload_key(htsmsg_t *m, char *buf, size_t buflen)
+{
+  const char *class = htsmsg_get_str(m, "notificationClass");
+  const char *uuid;
+  uint32_t id;
+
+  if (class == NULL)
+    return NULL;
+  if ((uuid = htsmsg_get_str(m, "uuid")) != NULL) {
+    if (strcmp(class, "title") && !htsmsg_get_u32_or_default(m, "update", 0))
+      return NULL;
+    snprintf(buf, buflen, "%s/%s", class, uuid);
+    return buf;
+  }
+  if (htsmsg_get_u32_or_default(m, "updateEntry", 0) &&
+      !htsmsg_get_u32(m, "id", &id)) {
+    snprintf(buf, buflen, "%s/%u", class, id);
+    return buf;
+  }
+  return NULL;
+}
+
+static int
+comet_entry_key_cmp(comet_entry_t *a, comet_entry_t *b)
+{
+  return strcmp(a->ce_payload->cp_key, b->ce_payload->cp_key);
+}
+
+/**
+ * Queue a payload to the mailbox, the pending entry with the same key
+ * is dropped (the new one is appended to keep the delivery order).
+ */
+static void
+comet_mailbox_queue(comet_mailbox_t *cmb, comet_payload_t *cp)
+{
+  comet_entry_t *ce = malloc(sizeof(*ce)), *old;
+
+  atomic_add(&cp->cp_refcount, 1);
+  ce->ce_payload = cp;
+  if (cp->cp_key) {
+    old = RB_INSERT_SORTED(&cmb->cmb_keys, ce, ce_key_link, comet_entry_key_cmp);
+    if (old) {
+      free(ce);
+      TAILQ_REMOVE(&cmb->cmb_messages, old, ce_link);
+      comet_payload_release(old->ce_payload);
+      old->ce_payload = cp;
+      ce = old;
+    }
+  }
+  TAILQ_INSERT_TAIL(&cmb->cmb_messages, ce, ce_link);
+}
+
+/**
+ * Queue a message for one mailbox only
+ */
+static void
+comet_mailbox_queue_msg(comet_mailbox_t *cmb, htsmsg_t *m)
+{
+  comet_payload_t *cp = comet_payload_create(m, NULL);
+  comet_mailbox_queue(cmb, cp);
+  comet_payload_release(cp);
+  htsmsg_destroy(m);
+}
+
+/**
+ *
+ */
+static void
+comet_entries_flush(struct comet_entry_queue *q)
+{
+  comet_entry_t *ce;
+
+  while ((ce = TAILQ_FIRST(q)) != NULL) {
+    TAILQ_REMOVE(q, ce, ce_link);
+    comet_payload_release(ce->ce_payload);
+    free(ce);
+  }
+}
+
 /**
  *
  */
@@ -71,8 +215,7 @@ cmb_destroy(comet_mailbox_t *cmb)
 {
   mbdebug("mailbox[%s]: destroyed\n", cmb->cmb_boxid);
 
-  if(cmb->cmb_messages != NULL)
-    htsmsg_destroy(cmb->cmb_messages);
+  comet_entries_flush(&cmb->cmb_messages);
 
   LIST_REMOVE(cmb, cmb_link);
 
@@ -136,6 +279,8 @@ comet_mailbox_create(const char *lang)
   cmb->cmb_boxid = strdup(id);
   cmb->cmb_lang = lang ? strdup(lang) : NULL;
   cmb->cmb_refcount = 1;
+  TAILQ_INIT(&cmb->cmb_messages);
+  RB_INIT(&cmb->cmb_keys);
   cmb->cmb_last_used = mclk();
   mailbox_tally++;
 
@@ -212,9 +357,7 @@ comet_access_update(http_connection_t *hc, comet_mailbox_t *cmb)
   if (admin && config.wizard)
     htsmsg_add_str(m, "wizard", config.wizard);
 
-  if(cmb->cmb_messages == NULL)
-    cmb->cmb_messages = htsmsg_create_list();
-  htsmsg_add_msg(cmb->cmb_messages, NULL, m);
+  comet_mailbox_queue_msg(cmb, m);
 }
 
 /**
@@ -242,28 +385,47 @@ comet_serverIpPort(http_connection_t *hc, comet_mailbox_t *cmb)
   htsmsg_add_str(m, "ip", buf);
   htsmsg_add_u32(m, "port", ntohs(port));
 
-  if(cmb->cmb_messages == NULL)
-    cmb->cmb_messages = htsmsg_create_list();
-  htsmsg_add_msg(cmb->cmb_messages, NULL, m);
+  comet_mailbox_queue_msg(cmb, m);
 }
 
 /**
- *
+ * Take the pending entries from the mailbox
  */
-static htsmsg_t *
-comet_message(comet_mailbox_t *cmb, int include_boxid, int ignore_null)
+static int
+comet_message(comet_mailbox_t *cmb, struct comet_entry_queue *q, int ignore_null)
 {
-  htsmsg_t *m;
-
-  if (ignore_null && cmb->cmb_messages == NULL)
-    return NULL;
-  m = htsmsg_create_map();
-  if (include_boxid)
-    htsmsg_add_str(m, "boxid", cmb->cmb_boxid);
-  htsmsg_add_msg(m, "messages", cmb->cmb_messages ?: htsmsg_create_list());
-  cmb->cmb_messages = NULL;
+  TAILQ_INIT(q);
+  if (ignore_null && TAILQ_EMPTY(&cmb->cmb_messages))
+    return 0;
+  TAILQ_MOVE(q, &cmb->cmb_messages, ce_link);
+  RB_INIT(&cmb->cmb_keys);
   cmb->cmb_last_used = mclk();
-  return m;
+  return 1;
+}
+
+/**
+ * Write the reply - the pre-encoded payloads are just concatenated
+ */
+static void
+comet_message_write(htsbuf_queue_t *hq, const char *boxid,
+                    struct comet_entry_queue *q)
+{
+  comet_entry_t *ce;
+
+  htsbuf_append(hq, "{", 1);
+  if (boxid) {
+    htsbuf_append_str(hq, "\"boxid\":");
+    htsbuf_append_and_escape_jsonstr(hq, boxid);
+    htsbuf_append(hq, ",", 1);
+  }
+  htsbuf_append_str(hq, "\"messages\":[");
+  TAILQ_FOREACH(ce, q, ce_link) {
+    if (ce != TAILQ_FIRST(q))
+      htsbuf_append(hq, ",", 1);
+    htsbuf_append(hq, ce->ce_payload->cp_json, ce->ce_payload->cp_len);
+  }
+  htsbuf_append(hq, "]}", 2);
+  comet_entries_flush(q);
 }
 
 /**
@@ -315,10 +477,14 @@ comet_mailbox_poll(http_connection_t *hc, const char *remain, void *opaque)
   const char *lang = hc->hc_access->aa_lang_ui;
   int im = immediate ? atoi(immediate) : 0, e;
   int64_t mono;
-  htsmsg_t *m;
+  struct comet_entry_queue q;
+  char boxid[41];
 
-  if(!im)
+  if(!im) {
+    /* long poll, do not block a worker from the HTTP pool */
+    tcp_connection_detach();
     tvh_safe_usleep(100000); /* Always sleep 0.1 sec to avoid comet storms */
+  }
 
   tvh_mutex_lock(&comet_mutex);
   cmb = comet_find_mailbox(hc, cometid, lang, 1);
@@ -327,7 +493,7 @@ comet_mailbox_poll(http_connection_t *hc, const char *remain, void *opaque)
     return HTTP_STATUS_BAD_REQUEST;
   }
 
-  if(!im && cmb->cmb_messages == NULL) {
+  if(!im && TAILQ_EMPTY(&cmb->cmb_messages)) {
     mono = mclk() + sec2mono(10);
     atomic_add(&comet_waiting, 1);
     do {
@@ -342,11 +508,11 @@ comet_mailbox_poll(http_connection_t *hc, const char *remain, void *opaque)
     }
   }
 
-  m = comet_message(cmb, 1, 0);
+  comet_message(cmb, &q, 0);
+  strlcpy(boxid, cmb->cmb_boxid, sizeof(boxid));
   tvh_mutex_unlock(&comet_mutex);
 
-  htsmsg_json_serialize(m, &hc->hc_reply, 0);
-  htsmsg_destroy(m);
+  comet_message_write(&hc->hc_reply, boxid, &q);
   http_output_content(hc, "application/json; charset=UTF-8");
   return 0;
 }
@@ -371,9 +537,6 @@ comet_mailbox_dbg(http_connection_t *hc, const char *remain, void *opaque)
     char buf[64];
     cmb->cmb_debug = !cmb->cmb_debug;
 
-    if(cmb->cmb_messages == NULL)
-      cmb->cmb_messages = htsmsg_create_list();
-
     if(cmb->cmb_restricted || http_access_verify(hc, ACCESS_ADMIN))
       s = N_("Only admin can watch the realtime log.");
     else if(cmb->cmb_debug)
@@ -385,7 +548,7 @@ comet_mailbox_dbg(http_connection_t *hc, const char *remain, void *opaque)
     htsmsg_t *m = htsmsg_create_map();
     htsmsg_add_str(m, "notificationClass", "logmessage");
     htsmsg_add_str(m, "logtxt", buf);
-    htsmsg_add_msg(cmb->cmb_messages, NULL, m);
+    comet_mailbox_queue_msg(cmb, m);
 
     tvh_cond_signal(&comet_cond, 1);
   }
@@ -401,18 +564,26 @@ comet_mailbox_dbg(http_connection_t *hc, const char *remain, void *opaque)
 static void
 comet_mailbox_ws_msg(http_connection_t *hc, comet_mailbox_t *cmb, int first, htsmsg_t *msg)
 {
-  htsmsg_t *m = NULL;
+  struct comet_entry_queue q;
+  htsbuf_queue_t hq;
+  char *s;
+  int r;
+
   tvh_mutex_lock(&comet_mutex);
   if (!atomic_get(&comet_running)) {
     tvh_mutex_unlock(&comet_mutex);
     return;
   }
-  m = comet_message(cmb, first, 1);
+  r = comet_message(cmb, &q, 1);
   cmb->cmb_last_used = 0;
   tvh_mutex_unlock(&comet_mutex);
-  if (m) {
-    http_websocket_send_json(hc, m);
-    htsmsg_destroy(m);
+  if (r) {
+    htsbuf_queue_init(&hq, 0);
+    comet_message_write(&hq, first ? cmb->cmb_boxid : NULL, &q);
+    s = htsbuf_to_string(&hq);
+    htsbuf_queue_flush(&hq);
+    http_websocket_send(hc, (uint8_t *)s, strlen(s), HTTP_WSOP_TEXT);
+    free(s);
   }
 }
 
@@ -428,6 +599,9 @@ comet_mailbox_ws(http_connection_t *hc, const char *remain, void *opaque)
   const char *lang = hc->hc_access->aa_lang_ui;
   comet_mailbox_t *cmb;
 
+  /* runs until the client leaves, use a dedicated thread */
+  tcp_connection_detach();
+
   res = http_send_header_websocket(hc, "tvheadend-comet");
 
   tvh_mutex_lock(&comet_mutex);
@@ -555,11 +729,20 @@ void
 comet_mailbox_add_message(htsmsg_t *m, int isdebug, int rewrite)
 {
   comet_mailbox_t *cmb;
+  comet_payload_t *cp = NULL, *lp;
+  struct {
+    const char *lang;
+    comet_payload_t *cp;
+  } langs[16];
+  int i, nlangs = 0;
+  char buf[128], *key;
   htsmsg_t *e;
 
   if (!atomic_get(&comet_running))
     return;
 
+  key = comet_payload_key(m, buf, sizeof(buf));
+
   tvh_mutex_lock(&comet_mutex);
 
   if (atomic_get(&comet_running)) {
@@ -570,18 +753,43 @@ comet_mailbox_add_message(htsmsg_t *m, int isdebug, int rewrite)
 
       if(isdebug && !cmb->cmb_debug)
         continue;
-        
-      if(cmb->cmb_messages == NULL)
-        cmb->cmb_messages = htsmsg_create_list();
-      e = htsmsg_copy(m);
-      if (cmb->cmb_lang && rewrite)
-        comet_mailbox_rewrite_msg(rewrite, e, cmb->cmb_lang);
-      htsmsg_add_msg(cmb->cmb_messages, NULL, e);
+
+      if (cmb->cmb_lang && rewrite) {
+        for (i = 0; i < nlangs; i++)
+          if (!strcmp(langs[i].lang, cmb->cmb_lang))
+            break;
+        if (i < nlangs) {
+          lp = langs[i].cp;
+        } else {
+          e = htsmsg_copy(m);
+          comet_mailbox_rewrite_msg(rewrite, e, cmb->cmb_lang);
+          lp = comet_payload_create(e, key);
+          htsmsg_destroy(e);
+          if (nlangs >= ARRAY_SIZE(langs)) {
+            comet_mailbox_queue(cmb, lp);
+            comet_payload_release(lp);
+            continue;
+          }
+          langs[nlangs].lang = cmb->cmb_lang;
+          langs[nlangs++].cp = lp;
+        }
+        comet_mailbox_queue(cmb, lp);
+        continue;
+      }
+
+      if (cp == NULL)
+        cp = comet_payload_create(m, key);
+      comet_mailbox_queue(cmb, cp);
     }
     tvh_cond_signal(&comet_cond, 1);
   }
 
   tvh_mutex_unlock(&comet_mutex);
+
+  if (cp)
+    comet_payload_release(cp);
+  for (i = 0; i < nlangs; i++)
+    comet_payload_release(langs[i].cp);
 }
 
 /**
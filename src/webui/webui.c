@@ -336,6 +336,7 @@ http_stream_run(http_connection_t *hc, profile_chain_t *prch,
 		const char *name, th_subscription_t *s)
 {
   streaming_message_t *sm;
+  struct streaming_message_queue batch;
   int run = 1, started = 0;
   streaming_queue_t *sq = &prch->prch_sq;
   muxer_t *mux = prch->prch_muxer;
@@ -346,6 +347,8 @@ http_stream_run(http_connection_t *hc, profile_chain_t *prch,
 
   if(muxer_open_stream(mux, hc->hc_fd))
     run = 0;
+  mux->m_config.m_write_size = config.http_write_size * 1024;
+  TAILQ_INIT(&batch);
 
   /* reduce timeout on write() for streaming */
   tp.tv_sec  = 5;
@@ -387,106 +390,122 @@ http_stream_run(http_connection_t *hc, profile_chain_t *prch,
       continue;
     }
 
-    streaming_queue_remove(sq, sm);
+    /* take all queued messages at once */
+    TAILQ_MOVE(&batch, &sq->sq_queue, sm_link);
+    sq->sq_size = 0;
     tvh_mutex_unlock(&sq->sq_mutex);
 
-    switch(sm->sm_type) {
-    case SMT_MPEGTS:
-    case SMT_PACKET:
-      if(started) {
-        pktbuf_t *pb;
-        int len;
-        if (sm->sm_type == SMT_PACKET)
-          pb = ((th_pkt_t*)sm->sm_data)->pkt_payload;
-        else
-          pb = sm->sm_data;
-        subscription_add_bytes_out(s, len = pktbuf_len(pb));
-        if (len > 0)
-          lastpkt = mclk();
-        muxer_write_pkt(mux, sm->sm_type, sm->sm_data);
-        sm->sm_data = NULL;
-      }
-      break;
+    while(run && (sm = TAILQ_FIRST(&batch)) != NULL) {
+      TAILQ_REMOVE(&batch, sm, sm_link);
+
+      switch(sm->sm_type) {
+      case SMT_MPEGTS:
+      case SMT_PACKET:
+        if(started) {
+          pktbuf_t *pb;
+          int len;
+          if (sm->sm_type == SMT_PACKET)
+            pb = ((th_pkt_t*)sm->sm_data)->pkt_payload;
+          else
+            pb = sm->sm_data;
+          subscription_add_bytes_out(s, len = pktbuf_len(pb));
+          if (len > 0)
+            lastpkt = mclk();
+          muxer_write_pkt(mux, sm->sm_type, sm->sm_data);
+          sm->sm_data = NULL;
+        }
+        break;
 
-    case SMT_GRACE:
-      grace = sm->sm_code < 5 ? 5 : grace;
-      break;
+      case SMT_GRACE:
+        grace = sm->sm_code < 5 ? 5 : grace;
+        break;
 
-    case SMT_START:
-      grace = 10;
-      if(!started) {
-        tvhdebug(LS_WEBUI, "%s streaming %s",
-                 hc->hc_no_output ? "Probe" : "Start", hc->hc_url_orig);
-        http_output_content(hc, muxer_mime(mux, sm->sm_data));
-
-        if (hc->hc_no_output) {
-          streaming_msg_free(sm);
-          mono = mclk() + sec2mono(2);
-          while (mclk() < mono) {
-            if (tcp_socket_dead(hc->hc_fd))
-              break;
-            tvh_safe_usleep(50000);
+      case SMT_START:
+        grace = 10;
+        if(!started) {
+          tvhdebug(LS_WEBUI, "%s streaming %s",
+                   hc->hc_no_output ? "Probe" : "Start", hc->hc_url_orig);
+          http_output_content(hc, muxer_mime(mux, sm->sm_data));
+
+          if (hc->hc_no_output) {
+            streaming_msg_free(sm);
+            streaming_queue_clear(&batch);
+            mono = mclk() + sec2mono(2);
+            while (mclk() < mono) {
+              if (tcp_socket_dead(hc->hc_fd))
+                break;
+              tvh_safe_usleep(50000);
+            }
+            return;
           }
-          return;
+
+          ss_copy = streaming_start_copy((streaming_start_t *)sm->sm_data);
+          if(muxer_init(mux, ss_copy, name) < 0)
+            run = 0;
+          streaming_start_unref(ss_copy);
+
+          started = 1;
+        } else if(muxer_reconfigure(mux, sm->sm_data) < 0) {
+          tvhwarn(LS_WEBUI,  "Unable to reconfigure stream %s", hc->hc_url_orig);
         }
+        break;
 
-        ss_copy = streaming_start_copy((streaming_start_t *)sm->sm_data);
-        if(muxer_init(mux, ss_copy, name) < 0)
+      case SMT_STOP:
+        if((mux->m_caps & MC_CAP_ANOTHER_SERVICE) != 0) /* give a chance to use another svc */
+          break;
+        if(sm->sm_code != SM_CODE_SOURCE_RECONFIGURED) {
+          tvhwarn(LS_WEBUI,  "Stop streaming %s, %s", hc->hc_url_orig, 
+                  streaming_code2txt(sm->sm_code));
           run = 0;
-        streaming_start_unref(ss_copy);
+        }
+        break;
 
-        started = 1;
-      } else if(muxer_reconfigure(mux, sm->sm_data) < 0) {
-        tvhwarn(LS_WEBUI,  "Unable to reconfigure stream %s", hc->hc_url_orig);
-      }
-      break;
+      case SMT_SERVICE_STATUS:
+      case SMT_SIGNAL_STATUS:
+      case SMT_DESCRAMBLE_INFO:
+        if(tcp_socket_dead(hc->hc_fd)) {
+          tvhdebug(LS_WEBUI,  "Stop streaming %s, client hung up",
+                   hc->hc_url_orig);
+          run = 0;
+        } else if((!started && mclk() - lastpkt > sec2mono(grace)) ||
+                   (started && ptimeout > 0 && mclk() - lastpkt > sec2mono(ptimeout))) {
+          tvhwarn(LS_WEBUI,  "Stop streaming %s, timeout waiting for packets", hc->hc_url_orig);
+          run = 0;
+        }
+        break;
 
-    case SMT_STOP:
-      if((mux->m_caps & MC_CAP_ANOTHER_SERVICE) != 0) /* give a chance to use another svc */
+      case SMT_NOSTART_WARN:
+      case SMT_SKIP:
+      case SMT_SPEED:
+      case SMT_TIMESHIFT_STATUS:
         break;
-      if(sm->sm_code != SM_CODE_SOURCE_RECONFIGURED) {
-        tvhwarn(LS_WEBUI,  "Stop streaming %s, %s", hc->hc_url_orig, 
-                streaming_code2txt(sm->sm_code));
-        run = 0;
-      }
-      break;
 
-    case SMT_SERVICE_STATUS:
-    case SMT_SIGNAL_STATUS:
-    case SMT_DESCRAMBLE_INFO:
-      if(tcp_socket_dead(hc->hc_fd)) {
-        tvhdebug(LS_WEBUI,  "Stop streaming %s, client hung up",
-                 hc->hc_url_orig);
+      case SMT_NOSTART:
+        tvhwarn(LS_WEBUI,  "Couldn't start streaming %s, %s",
+                hc->hc_url_orig, streaming_code2txt(sm->sm_code));
         run = 0;
-      } else if((!started && mclk() - lastpkt > sec2mono(grace)) ||
-                 (started && ptimeout > 0 && mclk() - lastpkt > sec2mono(ptimeout))) {
-        tvhwarn(LS_WEBUI,  "Stop streaming %s, timeout waiting for packets", hc->hc_url_orig);
+        break;
+
+      case SMT_EXIT:
+        tvhwarn(LS_WEBUI,  "Stop streaming %s, %s", hc->hc_url_orig,
+                streaming_code2txt(sm->sm_code));
         run = 0;
+        break;
       }
-      break;
-
-    case SMT_NOSTART_WARN:
-    case SMT_SKIP:
-    case SMT_SPEED:
-    case SMT_TIMESHIFT_STATUS:
-      break;
 
-    case SMT_NOSTART:
-      tvhwarn(LS_WEBUI,  "Couldn't start streaming %s, %s",
-              hc->hc_url_orig, streaming_code2txt(sm->sm_code));
-      run = 0;
-      break;
+      streaming_msg_free(sm);
 
-    case SMT_EXIT:
-      tvhwarn(LS_WEBUI,  "Stop streaming %s, %s", hc->hc_url_orig,
-              streaming_code2txt(sm->sm_code));
-      run = 0;
-      break;
+      if(mux->m_errors) {
+        if (!mux->m_eos)
+          tvhwarn(LS_WEBUI,  "Stop streaming %s, muxer reported errors", hc->hc_url_orig);
+        run = 0;
+      }
     }
 
-    streaming_msg_free(sm);
+    streaming_queue_clear(&batch);
 
-    if(mux->m_errors) {
+    /* write out the output gathered from this batch */
+    if(started && run && muxer_flush(mux)) {
       if (!mux->m_eos)
         tvhwarn(LS_WEBUI,  "Stop streaming %s, muxer reported errors", hc->hc_url_orig);
       run = 0;
@@ -182,3 +182,122 @@ int tvh_gzip_deflate_fd_header ( int fd, const uint8_t *data, size_t orig,
   data2[5] = (orig & 0xff);
   return tvh_write(fd, data2, 6);
 }
+
+/* **************************************************************************
+ * Streaming decompression
+ * *************************************************************************/
+
+#define GZIP_READER_BUF (64 * 1024)
+
+struct tvh_gzip_reader {
+  int       fd;
+  int       gzip;  /* -1 = not known yet */
+  int       eof;
+  int       end;   /* the last inflate() finished a gzip member */
+  z_stream  zstr;
+  uint8_t  *buf;
+  size_t    len;   /* plain data left in buf */
+  uint8_t  *ptr;
+};
+
+static ssize_t tvh_gzip_reader_fill ( tvh_gzip_reader_t *gr )
+{
+  ssize_t r;
+
+  do {
+    r = read(gr->fd, gr->buf, GZIP_READER_BUF);
+  } while (r < 0 && ERRNO_AGAIN(errno));
+  if (r == 0)
+    gr->eof = 1;
+  return r;
+}
+
+tvh_gzip_reader_t *tvh_gzip_reader_create ( int fd )
+{
+  tvh_gzip_reader_t *gr = calloc(1, sizeof(*gr));
+  gr->fd   = fd;
+  gr->gzip = -1;
+  gr->buf  = malloc(GZIP_READER_BUF);
+  return gr;
+}
+
+/*
+ * Read the data (decompressed when the input starts with the gzip magic)
+ */
+ssize_t tvh_gzip_reader_read ( tvh_gzip_reader_t *gr, void *buf, size_t size )
+{
+  ssize_t r;
+  int err;
+
+  if (gr->gzip < 0) {
+    if ((r = tvh_gzip_reader_fill(gr)) < 0)
+      return -1;
+    gr->gzip = r >= 2 && gr->buf[0] == 0x1f && gr->buf[1] == 0x8b;
+    if (gr->gzip) {
+      memset(&gr->zstr, 0, sizeof(gr->zstr));
+      if (inflateInit2(&gr->zstr, MAX_WBITS + 16 /* gzip */) != Z_OK) {
+        gr->gzip = 0;
+        return -1;
+      }
+      gr->zstr.next_in  = gr->buf;
+      gr->zstr.avail_in = r;
+    } else {
+      gr->ptr = gr->buf;
+      gr->len = r;
+    }
+  }
+
+  if (!gr->gzip) {
+    if (gr->len > 0) {
+      r = MIN(size, gr->len);
+      memcpy(buf, gr->ptr, r);
+      gr->ptr += r;
+      gr->len -= r;
+      return r;
+    }
+    do {
+      r = read(gr->fd, buf, size);
+    } while (r < 0 && ERRNO_AGAIN(errno));
+    return r;
+  }
+
+  gr->zstr.next_out  = buf;
+  gr->zstr.avail_out = size;
+  while (gr->zstr.avail_out == size) {
+    if (gr->zstr.avail_in == 0) {
+      if (gr->eof) {
+        if (!gr->end) {
+          errno = EIO; /* truncated input */
+          return -1;
+        }
+        break;
+      }
+      if ((r = tvh_gzip_reader_fill(gr)) < 0)
+        return -1;
+      gr->zstr.next_in  = gr->buf;
+      gr->zstr.avail_in = r;
+      continue;
+    }
+    err = inflate(&gr->zstr, Z_NO_FLUSH);
+    gr->end = err == Z_STREAM_END;
+    if (err == Z_STREAM_END) {
+      /* concatenated members */
+      if (inflateReset(&gr->zstr) != Z_OK)
+        return -1;
+    } else if (err != Z_OK && err != Z_BUF_ERROR) {
+      errno = EILSEQ;
+      return -1;
+    }
+  }
+  return size - gr->zstr.avail_out;
+}
+
+void tvh_gzip_reader_destroy ( tvh_gzip_reader_t *gr )
+{
+  if (gr == NULL)
+    return;
+  if (gr->gzip > 0)
+    inflateEnd(&gr->zstr);
+  free(gr->buf);
+  free(gr);
+}
@@ -0,0 +1,180 @@
+/*
+ *  tvheadend, AES-128 ECB descrambler benchmark
+ *  Copyright (C) 2026 Tvheadend Foundation CIC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Usage: aesbench [packets [parity-run]]
+ *
+ * Scrambles a generated stream (every 8th packet has an adaptation
+ * field, the parity changes every parity-run packets), then compares
+ * the former low-level AES_ecb_encrypt() per 16-byte block code with
+ * the EVP based aes128_decrypt_packets() in 64 kB chunks (the input
+ * read size). Both results are checked against the clear stream.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "openssl/evp.h"
+#include "openssl/aes.h"
+#include "descrambler/algo/libaes128dec.h"
+
+#define CHUNK 348
+
+static const uint8_t key[2][16] = {
+  { 0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+    0x10, 0x32, 0x54, 0x76, 0x98, 0xba, 0xdc, 0xfe },
+  { 0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10,
+    0xef, 0xcd, 0xab, 0x89, 0x67, 0x45, 0x23, 0x01 }
+};
+
+static double
+now ( void )
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+generate ( uint8_t *clear, uint8_t *scrambled, int count, int run )
+{
+  EVP_CIPHER_CTX *ctx[2];
+  uint8_t *p, *s;
+  int i, j, offset, parity, len;
+
+  for (j = 0; j < 2; j++) {
+    ctx[j] = EVP_CIPHER_CTX_new();
+    EVP_EncryptInit_ex(ctx[j], EVP_aes_128_ecb(), NULL, key[j], NULL);
+    EVP_CIPHER_CTX_set_padding(ctx[j], 0);
+  }
+  for (i = 0; i < count; i++) {
+    p = clear + i * 188;
+    s = scrambled + i * 188;
+    for (j = 0; j < 188; j++)
+      p[j] = rand();
+    p[0] = 0x47;
+    p[1] = 0x01;
+    p[2] = 0x00;
+    p[3] = 0x10 | (i & 0x0f);
+    offset = 4;
+    if ((i & 7) == 7) {
+      p[3] |= 0x20;
+      p[4] = i % 100;
+      offset = 4 + p[4] + 1;
+    }
+    memcpy(s, p, 188);
+    parity = (i / run) & 1;
+    s[3] |= 0x80 | (parity << 6);
+    if (offset + 16 <= 188)
+      EVP_EncryptUpdate(ctx[parity], s + offset, &len, p + offset,
+                        (188 - offset) & ~15);
+  }
+  for (j = 0; j < 2; j++)
+    EVP_CIPHER_CTX_free(ctx[j]);
+}
+
+/* the code before the EVP conversion */
+static void
+legacy_decrypt_packet ( AES_KEY *keys, uint8_t *pkt )
+{
+  uint_fast8_t ev_od = 0;
+  uint_fast8_t xc0, offset;
+
+  if (((xc0 = pkt[3]) & 0x80) == 0)
+    return;
+  ev_od = (xc0 & 0x40) >> 6;
+  pkt[3] = xc0 & 0x3f;
+  if (xc0 & 0x20) {
+    offset = 4 + pkt[4] + 1;
+    if (offset + 16 > 188)
+      return;
+  } else {
+    offset = 4;
+  }
+  for (; offset <= (188 - 16); offset += 16)
+    AES_ecb_encrypt(pkt + offset, pkt + offset, &keys[ev_od], AES_DECRYPT);
+}
+
+static double
+bench ( void *keys, uint8_t *buf, const uint8_t *src, int count, int evp )
+{
+  double t, best = 1e9;
+  int i, j, k, n;
+
+  for (i = 0; i < 5; i++) {
+    memcpy(buf, src, count * 188);
+    t = now();
+    for (j = 0; j < count; j += CHUNK) {
+      n = count - j < CHUNK ? count - j : CHUNK;
+      if (evp) {
+        aes128_decrypt_packets(keys, buf + j * 188, n * 188);
+      } else {
+        for (k = 0; k < n; k++)
+          legacy_decrypt_packet(keys, buf + (j + k) * 188);
+      }
+    }
+    t = now() - t;
+    if (t < best) best = t;
+  }
+  return count * 188.0 / best / 1e6;
+}
+
+int
+main ( int argc, char **argv )
+{
+  int count = argc > 1 ? atoi(argv[1]) : 100000;
+  int run = argc > 2 ? atoi(argv[2]) : 1000;
+  uint8_t *clear, *scrambled, *buf;
+  AES_KEY legacy[2];
+  void *keys;
+  double single, evp;
+  int fails = 0;
+
+  if (count <= 0 || run <= 0)
+    return 1;
+  clear = malloc(count * 188);
+  scrambled = malloc(count * 188);
+  buf = malloc(count * 188);
+  generate(clear, scrambled, count, run);
+
+  AES_set_decrypt_key(key[0], 128, &legacy[0]);
+  AES_set_decrypt_key(key[1], 128, &legacy[1]);
+  keys = aes128_get_priv_struct();
+  aes128_set_control_words(keys, key[0], key[1]);
+
+  single = bench(legacy, buf, scrambled, count, 0);
+  if (memcmp(buf, clear, count * 188)) {
+    printf("AES_ecb_encrypt: MISMATCH\n");
+    fails++;
+  }
+  evp = bench(keys, buf, scrambled, count, 1);
+  if (memcmp(buf, clear, count * 188)) {
+    printf("EVP: MISMATCH\n");
+    fails++;
+  }
+  printf("%d packets, parity run %d\n", count, run);
+  printf("AES_ecb_encrypt %8.1f MB/s\n", single);
+  printf("EVP             %8.1f MB/s (%.2fx)\n", evp, evp / single);
+
+  aes128_free_priv_struct(keys);
+  free(buf);
+  free(scrambled);
+  free(clear);
+  return fails ? 1 : 0;
+}
@@ -0,0 +1,168 @@
+/*
+ *  tvheadend, MPEG-TS packet scanning benchmark
+ *  Copyright (C) 2026 Tvheadend Foundation CIC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Usage: tsbench [capture.ts|- [MB]]
+ *
+ * Runs every src/tsscan.c implementation the CPU supports over the
+ * capture (or a generated stream when no file is given), checks that
+ * the results match the scalar ones and prints the throughput.
+ * The input is scanned in 64 kB chunks (the typical frontend read).
+ * A small MB value (1) keeps the data in the cache like the live path.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "tsscan.h"
+
+#define CHUNK (348*188)
+
+static uint8_t *buf;
+static size_t   buflen;
+
+static double
+now ( void )
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+generate ( size_t len )
+{
+  static const int pids[] = { 0x100, 0x100, 0x100, 0x101, 0x100, 0x100 };
+  size_t i;
+  int pid;
+
+  buflen = len - len % 188;
+  buf = malloc(buflen);
+  for (i = 0; i < buflen; i += 188) {
+    /* runs of 32 packets with the same PID, like a video PES */
+    pid = pids[(i / 188 / 32) % 6];
+    memset(buf + i, 0xff, 188);
+    buf[i+0] = 0x47;
+    buf[i+1] = pid >> 8;
+    buf[i+2] = pid & 0xff;
+    buf[i+3] = 0x90 | ((i / 188) & 0x0f);
+  }
+}
+
+static int
+load ( const char *filename, size_t max )
+{
+  FILE *f = fopen(filename, "rb");
+  size_t r;
+
+  if (f == NULL) {
+    perror(filename);
+    return -1;
+  }
+  buf = malloc(max);
+  r = fread(buf, 1, max, f);
+  fclose(f);
+  /* align to the first sync */
+  while (r >= 188 && buf[0] != 0x47) {
+    memmove(buf, buf + 1, --r);
+  }
+  buflen = r - r % 188;
+  return buflen ? 0 : -1;
+}
+
+/*
+ * One pass like the input path: sync count, then the PID runs
+ */
+static unsigned long
+pass_scan ( void )
+{
+  unsigned long sum = 0;
+  size_t off;
+  int len, l, r;
+
+  for (off = 0; off < buflen; off += CHUNK) {
+    len = buflen - off < CHUNK ? buflen - off : CHUNK;
+    sum += r = mpegts_sync_count(buf + off, len);
+    for (l = 0; l < r; l += mpegts_word_count(buf + off + l, r - l, 0xFF9FFFD0))
+      sum++;
+  }
+  return sum;
+}
+
+static void
+pass_clear ( void )
+{
+  size_t off;
+  int len;
+
+  for (off = 0; off < buflen; off += CHUNK) {
+    len = buflen - off < CHUNK ? buflen - off : CHUNK;
+    mpegts_clear_scrambled(buf + off, len);
+  }
+}
+
+static double
+bench ( void (*fcn)(void), unsigned long (*fcn2)(void), unsigned long *res )
+{
+  double t, best = 1e9;
+  int i, j, loops = 1 + (256 << 20) / buflen;
+
+  for (i = 0; i < 5; i++) {
+    t = now();
+    for (j = 0; j < loops; j++)
+      if (fcn) fcn(); else *res = fcn2();
+    t = now() - t;
+    if (t < best) best = t;
+  }
+  return (double)buflen * loops / best / 1e6;
+}
+
+int
+main ( int argc, char **argv )
+{
+  unsigned long ref = 0, res = 0;
+  size_t mb = argc > 2 ? atoi(argv[2]) : 256;
+  const char *name;
+  double scan, clear;
+  int i, fails = 0;
+
+  if (argc > 1 && strcmp(argv[1], "-")) {
+    if (load(argv[1], mb << 20))
+      return 1;
+  } else {
+    generate(mb << 20);
+  }
+  printf("%zu bytes, %zu packets\n", buflen, buflen / 188);
+
+  tsscan_init("scalar");
+  ref = pass_scan();
+
+  for (i = 0; (name = tsscan_name(i)) != NULL; i++) {
+    tsscan_init(name);
+    scan = bench(NULL, pass_scan, &res);
+    clear = bench(pass_clear, NULL, NULL);
+    printf("%-8s scan %8.1f MB/s  clear %8.1f MB/s%s\n",
+           name, scan, clear, res == ref ? "" : "  MISMATCH");
+    if (res != ref)
+      fails++;
+  }
+  printf("auto: %s\n", tsscan_init(NULL));
+  free(buf);
+  return fails ? 1 : 0;
+}